@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Throughput of data-moving pipelines under different HASH_PIPE_SIZE settings
+# Usage: bench/pipe_throughput.sh [megabytes] [sizes...]
+# Each pipeline moves the given amount (default 2048 MB) and is timed as a
+# whole, including starting hash-shell. A size of "default" leaves
+# HASH_PIPE_SIZE unset.
+
+HASH_BIN="${HASH_BIN:-./hash-shell}"
+MB="${1:-2048}"
+shift
+SIZES="${*:-default 256K 1M}"
+
+if [ ! -x "$HASH_BIN" ]; then
+    echo "hash-shell not found at $HASH_BIN (run make first)" >&2
+    exit 1
+fi
+
+PIPELINES=(
+    "yes | head -c ${MB}M | wc -c"
+    "head -c ${MB}M /dev/zero | tr '\\0' x | wc -c"
+    "yes | head -c ${MB}M | cat | cat | wc -c"
+)
+
+now_ns() {
+    date +%s%N
+}
+
+printf "%-9s %9s %10s  %s\n" "pipe" "seconds" "MB/s" "pipeline"
+for pipeline in "${PIPELINES[@]}"; do
+    for size in $SIZES; do
+        if [ "$size" = "default" ]; then
+            setting=""
+        else
+            setting="HASH_PIPE_SIZE=$size; "
+        fi
+
+        start=$(now_ns)
+        bytes=$("$HASH_BIN" -c "$setting$pipeline")
+        end=$(now_ns)
+
+        if [ "$bytes" != "$((MB * 1024 * 1024))" ]; then
+            echo "$pipeline: moved '$bytes' bytes" >&2
+            exit 1
+        fi
+        rate=$(awk -v ns=$((end - start)) -v mb="$MB" \
+            'BEGIN { s = ns / 1e9; printf "%9.3f %10.1f", s, mb / s }')
+        printf "%-9s %s  %s\n" "$size" "$rate" "$pipeline"
+    done
+done
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "arena.h"
+#include "hash.h"
+
+// Allocations are aligned for any type
+#define ARENA_ALIGN 16
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *prev;    // Chunk below this one in the stack
+    size_t size;                // Bytes of data
+    size_t used;                // Bytes handed out
+    _Alignas(ARENA_ALIGN) char data[];
+} ArenaChunk;
+
+static struct {
+    ArenaChunk *top;            // Chunk allocations come from
+    ArenaChunk *spare;          // Released regular chunks, linked by prev
+    size_t in_use;              // Bytes handed out and not yet released
+    size_t high_water;
+#ifdef DEBUG
+    size_t chunks;              // Chunks currently allocated
+    size_t max_chunks;
+    size_t largest;             // Largest single request
+#endif
+} arena;
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+#ifdef DEBUG
+static void arena_report(void) {
+    fprintf(stderr, "%s: arena high water %zu bytes, %zu chunks of %d, largest request %zu\n",
+            HASH_NAME, arena.high_water, arena.max_chunks, ARENA_CHUNK_SIZE, arena.largest);
+}
+#endif
+
+static ArenaChunk *chunk_new(size_t size) {
+    ArenaChunk *chunk;
+    if (size <= ARENA_CHUNK_SIZE && arena.spare) {
+        chunk = arena.spare;
+        arena.spare = chunk->prev;
+    } else {
+        if (size < ARENA_CHUNK_SIZE) size = ARENA_CHUNK_SIZE;
+        chunk = malloc(sizeof(ArenaChunk) + size);
+        if (!chunk) {
+            fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+            exit(EXIT_FAILURE);
+        }
+        chunk->size = size;
+#ifdef DEBUG
+        static int registered = 0;
+        if (!registered) {
+            atexit(arena_report);
+            registered = 1;
+        }
+        if (++arena.chunks > arena.max_chunks) arena.max_chunks = arena.chunks;
+#endif
+    }
+    chunk->used = 0;
+    chunk->prev = arena.top;
+    arena.top = chunk;
+    return chunk;
+}
+
+// Pop the top chunk; regular chunks are kept for reuse
+static void chunk_drop(void) {
+    ArenaChunk *chunk = arena.top;
+    arena.top = chunk->prev;
+    arena.in_use -= chunk->used;
+
+    if (chunk->size == ARENA_CHUNK_SIZE) {
+        chunk->prev = arena.spare;
+        arena.spare = chunk;
+    } else {
+        free(chunk);
+#ifdef DEBUG
+        arena.chunks--;
+#endif
+    }
+}
+
+void *arena_alloc(size_t size) {
+    size = align_up(size ? size : 1);
+
+    ArenaChunk *chunk = arena.top;
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunk = chunk_new(size);
+    }
+
+    void *p = chunk->data + chunk->used;
+    chunk->used += size;
+    arena.in_use += size;
+    if (arena.in_use > arena.high_water) arena.high_water = arena.in_use;
+#ifdef DEBUG
+    if (size > arena.largest) arena.largest = size;
+#endif
+    return p;
+}
+
+void *arena_realloc(void *ptr, size_t old_size, size_t size) {
+    if (!ptr) return arena_alloc(size);
+
+    // The most recent allocation can grow in place
+    ArenaChunk *chunk = arena.top;
+    size_t old_aligned = align_up(old_size ? old_size : 1);
+    if (chunk && (char *)ptr + old_aligned == chunk->data + chunk->used) {
+        size_t offset = (size_t)((char *)ptr - chunk->data);
+        size_t new_aligned = align_up(size ? size : 1);
+        if (new_aligned <= chunk->size - offset) {
+            chunk->used = offset + new_aligned;
+            arena.in_use = arena.in_use - old_aligned + new_aligned;
+            if (arena.in_use > arena.high_water) arena.high_water = arena.in_use;
+            return ptr;
+        }
+    }
+
+    void *p = arena_alloc(size);
+    memcpy(p, ptr, old_size < size ? old_size : size);
+    return p;
+}
+
+char *arena_strndup(const char *s, size_t n) {
+    char *copy = arena_alloc(n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+ArenaMark arena_mark(void) {
+    ArenaMark mark = { arena.top, arena.top ? arena.top->used : 0 };
+    return mark;
+}
+
+void arena_release(ArenaMark mark) {
+    while (arena.top && arena.top != mark.chunk) {
+        chunk_drop();
+    }
+    if (arena.top) {
+        arena.in_use -= arena.top->used - mark.used;
+        arena.top->used = mark.used;
+    }
+}
+
+size_t arena_high_water(void) {
+    return arena.high_water;
+}
+
+void arena_cleanup(void) {
+    ArenaMark empty = { NULL, 0 };
+    arena_release(empty);
+    while (arena.spare) {
+        ArenaChunk *chunk = arena.spare;
+        arena.spare = chunk->prev;
+        free(chunk);
+#ifdef DEBUG
+        arena.chunks--;
+#endif
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// ============================================================================
+// COMMAND ARENA
+// ============================================================================
+//
+// A bump allocator for temporaries that live no longer than one command:
+// expansion work buffers, glob patterns, fragments handed between the
+// expansion passes. execute() and chain_execute() take a mark on entry and
+// release back to it on return, so everything allocated while the command
+// ran is dropped at once instead of being freed piece by piece. Scopes nest
+// (command substitution runs commands inside a command), and chunks are
+// kept for reuse, so a steady loop allocates nothing from the heap.
+//
+// Memory from the arena must never be passed to free() and must not be kept
+// past the scope it was allocated in. Building with `make debug` reports
+// the high-water mark at exit to help size ARENA_CHUNK_SIZE.
+//
+// ============================================================================
+
+// Size of a regular chunk; larger requests get a chunk of their own
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+struct ArenaChunk;
+
+// Position in the arena to release back to
+typedef struct {
+    struct ArenaChunk *chunk;
+    size_t used;
+} ArenaMark;
+
+/**
+ * Allocate memory from the command arena
+ * Exits the shell if memory is exhausted, like the other allocators.
+ *
+ * @param size Number of bytes (aligned for any type)
+ * @return Uninitialized memory valid until the enclosing scope is released
+ */
+void *arena_alloc(size_t size);
+
+/**
+ * Resize the most recent allocation, or copy it into a new one
+ *
+ * @param ptr Memory from arena_alloc (NULL allocates)
+ * @param old_size Current size of ptr
+ * @param size New size
+ * @return Memory holding the first min(old_size, size) bytes of ptr
+ */
+void *arena_realloc(void *ptr, size_t old_size, size_t size);
+
+/**
+ * Copy n bytes of a string into the command arena
+ *
+ * @param s String to copy
+ * @param n Number of bytes to copy
+ * @return Null-terminated copy
+ */
+char *arena_strndup(const char *s, size_t n);
+
+/**
+ * Record the current position of the command arena
+ *
+ * @return Mark to pass to arena_release()
+ */
+ArenaMark arena_mark(void);
+
+/**
+ * Drop everything allocated since a mark was taken
+ *
+ * @param mark Mark from arena_mark()
+ */
+void arena_release(ArenaMark mark);
+
+/**
+ * Get the largest number of bytes the arena has held at once
+ *
+ * @return High-water mark in bytes
+ */
+size_t arena_high_water(void);
+
+/**
+ * Free all chunks (at shell exit)
+ */
+void arena_cleanup(void);
+
+#endif // ARENA_H
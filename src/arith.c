@@ -15,32 +15,18 @@
 #include "jobs.h"
 #include "config.h"
 #include "utils.h"
+#include "arena.h"
 
-// Forward declaration to access positional parameters
+// Forward declarations to access positional parameters
 // (We can't include script.h due to TokenType name collision)
 const char *script_get_positional_param(int index);
+int script_get_positional_count(void);
 
 // External reference to last command exit code (from builtins.c)
 extern int last_command_exit_code;
 
-// External reference to script_state for positional_count
-typedef struct {
-    void *context_stack;
-    int context_depth;
-    void *functions;
-    int function_count;
-    bool in_script;
-    const char *script_path;
-    int script_line;
-    bool silent_errors;
-    char **positional_params;
-    int positional_count;
-    int function_call_depth;
-    bool exit_requested;
-} ScriptStateArith;
-extern ScriptStateArith script_state;
-
-#define MAX_ARITH_LENGTH 8192
+// Room kept free in the arith_expand() result for one formatted number
+#define ARITH_RESULT_SLACK 64
 
 // Track if an unset variable error occurred during evaluation
 static bool arith_unset_error = false;
@@ -92,6 +78,7 @@ typedef enum {
     TOK_PERCENTEQ,
     TOK_INC,
     TOK_DEC,
+    TOK_COMMA,
     TOK_ERROR
 } TokenType;
 
@@ -102,29 +89,111 @@ typedef struct {
     char name[256];
 } Token;
 
+// ============================================================================
+// Compiled expressions
+// ============================================================================
+//
+// An expression is compiled once into postfix bytecode for a small stack
+// machine and kept in an LRU cache keyed by its source text, so a $((...))
+// in a loop is tokenized and parsed only on the first iteration. Variables
+// are compiled into handles that keep their table entry between runs.
+
+// Bytecode operations; each pushes at most one value
+typedef enum {
+    OP_NUM,         // Push arg
+    OP_LOAD,        // Push variable arg
+    OP_STORE,       // Assign the top value to variable arg, leaving it pushed
+    OP_PREINC,      // ++var, --var, var++, var-- on variable arg
+    OP_PREDEC,
+    OP_POSTINC,
+    OP_POSTDEC,
+    OP_NEG,
+    OP_NOT,
+    OP_BNOT,
+    OP_BOOL,        // Normalize the top value to 0 or 1
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_ADD,
+    OP_SUB,
+    OP_SHL,
+    OP_SHR,
+    OP_LT,
+    OP_GT,
+    OP_LE,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_BAND,
+    OP_BXOR,
+    OP_BOR,
+    OP_JZ,          // Pop; jump to arg if zero
+    OP_JNZ,         // Pop; jump to arg if nonzero
+    OP_JMP,         // Jump to arg
+    OP_POP
+} OpCode;
+
+typedef struct {
+    OpCode op;
+    long arg;
+} Insn;
+
+// Variable referenced by an expression
+typedef struct {
+    char *name;
+    bool special;           // $?, $1, ... are read through get_variable()
+    ShellVarRef ref;
+} ArithVar;
+
+typedef struct ArithProgram {
+    char *source;
+    unsigned int hash;
+    Insn *code;
+    size_t len;
+    ArithVar *vars;
+    size_t var_count;
+    struct ArithProgram *next;      // Hash chain
+    struct ArithProgram *newer;     // LRU list
+    struct ArithProgram *older;
+} ArithProgram;
+
+// Compiled expressions kept at most
+#define ARITH_CACHE_SIZE 64
+#define ARITH_CACHE_BUCKETS 128
+
+static struct {
+    ArithProgram *buckets[ARITH_CACHE_BUCKETS];
+    ArithProgram *newest;
+    ArithProgram *oldest;
+    size_t count;
+} arith_cache;
+
 // Parser state
 typedef struct {
     const char *input;
     size_t pos;
     Token current;
     int error;
+    ArithProgram *prog;     // Program being compiled
+    size_t code_cap;
+    size_t var_cap;
 } Parser;
 
 // Forward declarations
-static long parse_expression(Parser *p);
-static long parse_ternary(Parser *p);
-static long parse_logical_or(Parser *p);
-static long parse_logical_and(Parser *p);
-static long parse_bitwise_or(Parser *p);
-static long parse_bitwise_xor(Parser *p);
-static long parse_bitwise_and(Parser *p);
-static long parse_equality(Parser *p);
-static long parse_relational(Parser *p);
-static long parse_shift(Parser *p);
-static long parse_additive(Parser *p);
-static long parse_multiplicative(Parser *p);
-static long parse_unary(Parser *p);
-static long parse_primary(Parser *p);
+static void compile_expression(Parser *p);
+static void compile_ternary(Parser *p);
+static void compile_logical_or(Parser *p);
+static void compile_logical_and(Parser *p);
+static void compile_bitwise_or(Parser *p);
+static void compile_bitwise_xor(Parser *p);
+static void compile_bitwise_and(Parser *p);
+static void compile_equality(Parser *p);
+static void compile_relational(Parser *p);
+static void compile_shift(Parser *p);
+static void compile_additive(Parser *p);
+static void compile_multiplicative(Parser *p);
+static void compile_unary(Parser *p);
+static void compile_primary(Parser *p);
 
 // Skip whitespace
 static void skip_whitespace(Parser *p) {
@@ -156,7 +225,7 @@ static long get_variable(const char *name) {
             case '!':  // $! - last background PID
                 return (long)jobs_get_last_bg_pid();
             case '#':  // $# - number of positional params
-                return (long)script_state.positional_count;
+                return (long)script_get_positional_count();
             case '-':  // $- - current options (return 0 for arithmetic)
                 return 0;
             case '0':  // $0 - script/shell name
@@ -204,6 +273,12 @@ static long get_variable(const char *name) {
         return 0;
     }
 
+    // Integer variables are read without a round trip through text
+    long n;
+    if (shellvar_get_int(name, &n)) {
+        return n;
+    }
+
     // Regular shell variable (checks shell vars first, then environment)
     const char *val = shellvar_get(name);
     if (!val) {
@@ -216,9 +291,7 @@ static long get_variable(const char *name) {
 
 // Set variable in shell variable system
 static void set_variable(const char *name, long value) {
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%ld", value);
-    shellvar_set(name, buf);
+    shellvar_set_int(name, value);
 }
 
 static bool is_special_variable(char c) {
@@ -237,11 +310,9 @@ static void get_variable_token(Parser *p) {
 
     // Handle special variables
     if (c == '$' && is_special_variable(nc)) {
-        // Handle special variables
         p->current.name[0] = nc;
         p->current.name[1] = '\0';
-        p->current.value = get_variable(p->current.name);
-        p->pos++;
+        p->pos += 2;
         return;
     }
 
@@ -275,12 +346,13 @@ static void get_variable_token(Parser *p) {
     }
 
     // Copy the name
-    if (len < sizeof(p->current.name)) {
-        memcpy(p->current.name, p->input + start, len);
-        p->current.name[len] = '\0';
+    if (len >= sizeof(p->current.name)) {
+        p->current.type = TOK_ERROR;
+        p->error = 1;
+        return;
     }
-
-    p->current.value = get_variable(p->current.name);
+    memcpy(p->current.name, p->input + start, len);
+    p->current.name[len] = '\0';
 }
 
 // Get next token
@@ -346,6 +418,7 @@ static void next_token(Parser *p) {
         case '?': p->current.type = TOK_QUESTION; break;
         case ':': p->current.type = TOK_COLON; break;
         case '=': p->current.type = TOK_ASSIGN; break;
+        case ',': p->current.type = TOK_COMMA; break;
         default:
             p->current.type = TOK_ERROR;
             p->error = 1;
@@ -354,255 +427,223 @@ static void next_token(Parser *p) {
     p->pos++;
 }
 
-// Returns false if result is not set
-static bool parse_post_ops(Parser *p, const char *name, long val, long *result) {
-    if (p->error) return false;
+// Append an instruction; returns its index
+static size_t emit(Parser *p, OpCode op, long arg) {
+    ArithProgram *prog = p->prog;
+    if (prog->len == p->code_cap) {
+        size_t cap = p->code_cap ? p->code_cap * 2 : 16;
+        Insn *code = realloc(prog->code, cap * sizeof(Insn));
+        if (!code) {
+            p->error = 1;
+            return 0;
+        }
+        prog->code = code;
+        p->code_cap = cap;
+    }
+    prog->code[prog->len].op = op;
+    prog->code[prog->len].arg = arg;
+    return prog->len++;
+}
 
-    switch (p->current.type) {
-        // Check for post-increment/decrement
-        case TOK_INC:
-            set_variable(name, val + 1);
-            next_token(p);
-            *result = val; // Return original value
-            return true;
-        case TOK_DEC:
-            set_variable(name, val - 1);
-            next_token(p);
-            *result = val;  // Return original value
-            return true;
-        // Check for assignment operators
-        case TOK_ASSIGN: {
-                next_token(p);
-                long newval = parse_ternary(p);
-                set_variable(name, newval);
-                *result = newval;
-                return true;
-            }
-        case TOK_PLUSEQ: {
-                next_token(p);
-                long newval = val + parse_ternary(p);
-                set_variable(name, newval);
-                *result = newval;
-                return true;
-            }
-        case TOK_MINUSEQ: {
-                next_token(p);
-                long newval = val - parse_ternary(p);
-                set_variable(name, newval);
-                *result = newval;
-                return true;
-            }
-        case TOK_STAREQ: {
-                next_token(p);
-                long newval = val * parse_ternary(p);
-                set_variable(name, newval);
-                *result = newval;
-                return true;
-            }
-        case TOK_SLASHEQ: {
-                next_token(p);
-                long divisor = parse_ternary(p);
-                if (divisor == 0) {
-                    p->error = 1;
-                    *result = 0;
-                    return true;
-                }
-                long newval = val / divisor;
-                set_variable(name, newval);
-                *result = newval;
-                return true;
-            }
-        case TOK_PERCENTEQ: {
-                next_token(p);
-                long divisor = parse_ternary(p);
-                if (divisor == 0) {
-                    p->error = 1;
-                    *result = 0;
-                    return true;
-                }
-                long newval = val % divisor;
-                set_variable(name, newval);
-                *result = newval;
-                return true;
-            }
-        default:
-            break;
+// Point a jump at the next instruction to be emitted
+static void patch_jump(Parser *p, size_t at) {
+    if (!p->error) p->prog->code[at].arg = (long)p->prog->len;
+}
+
+// Get the slot of a variable, adding it on first use
+static long var_slot(Parser *p, const char *name) {
+    ArithProgram *prog = p->prog;
+    for (size_t i = 0; i < prog->var_count; i++) {
+        if (strcmp(prog->vars[i].name, name) == 0) return (long)i;
     }
 
-    return false;
+    if (prog->var_count == p->var_cap) {
+        size_t cap = p->var_cap ? p->var_cap * 2 : 4;
+        ArithVar *vars = realloc(prog->vars, cap * sizeof(ArithVar));
+        if (!vars) {
+            p->error = 1;
+            return 0;
+        }
+        prog->vars = vars;
+        p->var_cap = cap;
+    }
+
+    ArithVar *var = &prog->vars[prog->var_count];
+    var->name = strdup(name);
+    if (!var->name) {
+        p->error = 1;
+        return 0;
+    }
+
+    // Anything but a plain name is a special or positional parameter
+    var->special = !(isalpha((unsigned char)name[0]) || name[0] == '_');
+    for (const char *c = name; *c && !var->special; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '_') var->special = true;
+    }
+    shellvar_ref_init(&var->ref, var->name);
+    return (long)prog->var_count++;
+}
+
+// Compile a compound assignment: var op= expression
+static void compile_compound_assign(Parser *p, long slot, OpCode op) {
+    next_token(p);
+    emit(p, OP_LOAD, slot);
+    compile_ternary(p);
+    emit(p, op, 0);
+    emit(p, OP_STORE, slot);
 }
 
 // Primary: number, variable, (expression)
-static long parse_primary(Parser *p) {
-    if (p->error) return 0;
+static void compile_primary(Parser *p) {
+    if (p->error) return;
 
     switch (p->current.type) {
-        case TOK_NUMBER: {
-                long val = p->current.value;
-                next_token(p);
-                return val;
-            }
+        case TOK_NUMBER:
+            emit(p, OP_NUM, p->current.value);
+            next_token(p);
+            return;
         case TOK_VAR: {
-                char name[256];
-                safe_strcpy(name, p->current.name, sizeof(name));
-                long val = p->current.value;
+                long slot = var_slot(p, p->current.name);
                 next_token(p);
-
-                long result;
-                if (parse_post_ops(p, name, val, &result)) {
-                    return result;
+                if (p->error) return;
+
+                // Post-increment/decrement and assignment operators
+                switch (p->current.type) {
+                    case TOK_INC:
+                        next_token(p);
+                        emit(p, OP_POSTINC, slot);
+                        return;
+                    case TOK_DEC:
+                        next_token(p);
+                        emit(p, OP_POSTDEC, slot);
+                        return;
+                    case TOK_ASSIGN:
+                        next_token(p);
+                        compile_ternary(p);
+                        emit(p, OP_STORE, slot);
+                        return;
+                    case TOK_PLUSEQ:
+                        compile_compound_assign(p, slot, OP_ADD);
+                        return;
+                    case TOK_MINUSEQ:
+                        compile_compound_assign(p, slot, OP_SUB);
+                        return;
+                    case TOK_STAREQ:
+                        compile_compound_assign(p, slot, OP_MUL);
+                        return;
+                    case TOK_SLASHEQ:
+                        compile_compound_assign(p, slot, OP_DIV);
+                        return;
+                    case TOK_PERCENTEQ:
+                        compile_compound_assign(p, slot, OP_MOD);
+                        return;
+                    default:
+                        emit(p, OP_LOAD, slot);
+                        return;
                 }
-
-                return val;
             }
-        case TOK_LPAREN: {
+        case TOK_LPAREN:
+            next_token(p);
+            compile_expression(p);
+            if (p->current.type == TOK_RPAREN) {
                 next_token(p);
-                long val = parse_expression(p);
-                if (p->current.type == TOK_RPAREN) {
-                    next_token(p);
-                } else {
-                    p->error = 1;
-                }
-                return val;
+            } else {
+                p->error = 1;
             }
+            return;
         default:
             break;
     }
 
     // Unexpected token
     p->error = 1;
-    return 0;
 }
 
 // Unary: +, -, !, ~, ++var, --var
-static long parse_unary(Parser *p) {
-    if (p->error) return 0;
+static void compile_unary(Parser *p) {
+    if (p->error) return;
 
     switch (p->current.type) {
         case TOK_PLUS:
             next_token(p);
-            return parse_unary(p);
+            compile_unary(p);
+            return;
         case TOK_MINUS:
             next_token(p);
-            return -parse_unary(p);
+            compile_unary(p);
+            emit(p, OP_NEG, 0);
+            return;
         case TOK_NOT:
             next_token(p);
-            return !parse_unary(p);
+            compile_unary(p);
+            emit(p, OP_NOT, 0);
+            return;
         case TOK_BNOT:
             next_token(p);
-            return ~parse_unary(p);
+            compile_unary(p);
+            emit(p, OP_BNOT, 0);
+            return;
         case TOK_INC:
-            next_token(p);
-            if (p->current.type == TOK_VAR) {
-                char name[256];
-                safe_strcpy(name, p->current.name, sizeof(name));
-                long val = p->current.value + 1;
-                set_variable(name, val);
+        case TOK_DEC: {
+                OpCode op = p->current.type == TOK_INC ? OP_PREINC : OP_PREDEC;
                 next_token(p);
-                return val;
-            }
-            p->error = 1;
-            return 0;
-        case TOK_DEC:
-            next_token(p);
-            if (p->current.type == TOK_VAR) {
-                char name[256];
-                safe_strcpy(name, p->current.name, sizeof(name));
-                long val = p->current.value - 1;
-                set_variable(name, val);
+                if (p->current.type != TOK_VAR) {
+                    p->error = 1;
+                    return;
+                }
+                emit(p, op, var_slot(p, p->current.name));
                 next_token(p);
-                return val;
+                return;
             }
-            p->error = 1;
-            return 0;
         default:
             break;
     }
-    return parse_primary(p);
+    compile_primary(p);
 }
 
 // Multiplicative: *, /, %
-static long parse_multiplicative(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_unary(p);
+static void compile_multiplicative(Parser *p) {
+    compile_unary(p);
 
     while (!p->error && (p->current.type == TOK_STAR ||
                          p->current.type == TOK_SLASH ||
                          p->current.type == TOK_PERCENT)) {
         TokenType op = p->current.type;
         next_token(p);
-        long right = parse_unary(p);
-
-        if (op == TOK_STAR) {
-            left = left * right;
-        } else if (op == TOK_SLASH) {
-            if (right == 0) {
-                p->error = 1;
-                return 0;
-            }
-            left = left / right;
-        } else {
-            if (right == 0) {
-                p->error = 1;
-                return 0;
-            }
-            left = left % right;
-        }
+        compile_unary(p);
+        emit(p, op == TOK_STAR ? OP_MUL : op == TOK_SLASH ? OP_DIV : OP_MOD, 0);
     }
-
-    return left;
 }
 
 // Additive: +, -
-static long parse_additive(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_multiplicative(p);
+static void compile_additive(Parser *p) {
+    compile_multiplicative(p);
 
     while (!p->error && (p->current.type == TOK_PLUS ||
                          p->current.type == TOK_MINUS)) {
         TokenType op = p->current.type;
         next_token(p);
-        long right = parse_multiplicative(p);
-
-        if (op == TOK_PLUS) {
-            left = left + right;
-        } else {
-            left = left - right;
-        }
+        compile_multiplicative(p);
+        emit(p, op == TOK_PLUS ? OP_ADD : OP_SUB, 0);
     }
-
-    return left;
 }
 
 // Shift: <<, >>
-static long parse_shift(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_additive(p);
+static void compile_shift(Parser *p) {
+    compile_additive(p);
 
     while (!p->error && (p->current.type == TOK_LSHIFT ||
                          p->current.type == TOK_RSHIFT)) {
         TokenType op = p->current.type;
         next_token(p);
-        long right = parse_additive(p);
-
-        if (op == TOK_LSHIFT) {
-            left = left << right;
-        } else {
-            left = left >> right;
-        }
+        compile_additive(p);
+        emit(p, op == TOK_LSHIFT ? OP_SHL : OP_SHR, 0);
     }
-
-    return left;
 }
 
 // Relational: <, >, <=, >=
-static long parse_relational(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_shift(p);
+static void compile_relational(Parser *p) {
+    compile_shift(p);
 
     while (!p->error && (p->current.type == TOK_LT ||
                          p->current.type == TOK_GT ||
@@ -610,179 +651,349 @@ static long parse_relational(Parser *p) {
                          p->current.type == TOK_GE)) {
         TokenType op = p->current.type;
         next_token(p);
-        long right = parse_shift(p);
+        compile_shift(p);
 
-        if (op == TOK_LT) left = left < right;
-        else if (op == TOK_GT) left = left > right;
-        else if (op == TOK_LE) left = left <= right;
-        else left = left >= right;
+        if (op == TOK_LT) emit(p, OP_LT, 0);
+        else if (op == TOK_GT) emit(p, OP_GT, 0);
+        else if (op == TOK_LE) emit(p, OP_LE, 0);
+        else emit(p, OP_GE, 0);
     }
-
-    return left;
 }
 
 // Equality: ==, !=
-static long parse_equality(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_relational(p);
+static void compile_equality(Parser *p) {
+    compile_relational(p);
 
     while (!p->error && (p->current.type == TOK_EQ ||
                          p->current.type == TOK_NE)) {
         TokenType op = p->current.type;
         next_token(p);
-        long right = parse_relational(p);
-
-        if (op == TOK_EQ) left = left == right;
-        else left = left != right;
+        compile_relational(p);
+        emit(p, op == TOK_EQ ? OP_EQ : OP_NE, 0);
     }
-
-    return left;
 }
 
 // Bitwise AND: &
-static long parse_bitwise_and(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_equality(p);
+static void compile_bitwise_and(Parser *p) {
+    compile_equality(p);
 
     while (!p->error && p->current.type == TOK_BAND) {
         next_token(p);
-        long right = parse_equality(p);
-        left = left & right;
+        compile_equality(p);
+        emit(p, OP_BAND, 0);
     }
-
-    return left;
 }
 
 // Bitwise XOR: ^
-static long parse_bitwise_xor(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_bitwise_and(p);
+static void compile_bitwise_xor(Parser *p) {
+    compile_bitwise_and(p);
 
     while (!p->error && p->current.type == TOK_BXOR) {
         next_token(p);
-        long right = parse_bitwise_and(p);
-        left = left ^ right;
+        compile_bitwise_and(p);
+        emit(p, OP_BXOR, 0);
     }
-
-    return left;
 }
 
 // Bitwise OR: |
-static long parse_bitwise_or(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_bitwise_xor(p);
+static void compile_bitwise_or(Parser *p) {
+    compile_bitwise_xor(p);
 
     while (!p->error && p->current.type == TOK_BOR) {
         next_token(p);
-        long right = parse_bitwise_xor(p);
-        left = left | right;
+        compile_bitwise_xor(p);
+        emit(p, OP_BOR, 0);
     }
-
-    return left;
 }
 
-// Logical AND: &&
-static long parse_logical_and(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_bitwise_or(p);
+// Logical AND: && (the right side runs only if the left is nonzero)
+static void compile_logical_and(Parser *p) {
+    compile_bitwise_or(p);
 
     while (!p->error && p->current.type == TOK_AND) {
         next_token(p);
-        // Short-circuit evaluation
-        if (!left) {
-            parse_bitwise_or(p);  // Parse but ignore result
-            left = 0;
-        } else {
-            left = parse_bitwise_or(p) ? 1 : 0;
-        }
+        size_t skip = emit(p, OP_JZ, 0);
+        compile_bitwise_or(p);
+        emit(p, OP_BOOL, 0);
+        size_t done = emit(p, OP_JMP, 0);
+        patch_jump(p, skip);
+        emit(p, OP_NUM, 0);
+        patch_jump(p, done);
     }
-
-    return left;
 }
 
-// Logical OR: ||
-static long parse_logical_or(Parser *p) {
-    if (p->error) return 0;
-
-    long left = parse_logical_and(p);
+// Logical OR: || (the right side runs only if the left is zero)
+static void compile_logical_or(Parser *p) {
+    compile_logical_and(p);
 
     while (!p->error && p->current.type == TOK_OR) {
         next_token(p);
-        // Short-circuit evaluation
-        if (left) {
-            parse_logical_and(p);  // Parse but ignore result
-            left = 1;
-        } else {
-            left = parse_logical_and(p) ? 1 : 0;
-        }
+        size_t skip = emit(p, OP_JNZ, 0);
+        compile_logical_and(p);
+        emit(p, OP_BOOL, 0);
+        size_t done = emit(p, OP_JMP, 0);
+        patch_jump(p, skip);
+        emit(p, OP_NUM, 1);
+        patch_jump(p, done);
     }
-
-    return left;
 }
 
-// Ternary: cond ? true_expr : false_expr
-static long parse_ternary(Parser *p) {
-    if (p->error) return 0;
+// Ternary: cond ? true_expr : false_expr (only one branch runs)
+static void compile_ternary(Parser *p) {
+    compile_logical_or(p);
 
-    long cond = parse_logical_or(p);
-
-    if (p->current.type == TOK_QUESTION) {
+    if (!p->error && p->current.type == TOK_QUESTION) {
         next_token(p);
-        long true_val = parse_ternary(p);
+        size_t to_false = emit(p, OP_JZ, 0);
+        compile_ternary(p);
 
         if (p->current.type != TOK_COLON) {
             p->error = 1;
-            return 0;
+            return;
         }
         next_token(p);
-        long false_val = parse_ternary(p);
-
-        return cond ? true_val : false_val;
+        size_t done = emit(p, OP_JMP, 0);
+        patch_jump(p, to_false);
+        compile_ternary(p);
+        patch_jump(p, done);
     }
-
-    return cond;
 }
 
 // Top-level expression (handles comma operator)
-static long parse_expression(Parser *p) {
-    if (p->error) return 0;
-
-    long result = parse_ternary(p);
+static void compile_expression(Parser *p) {
+    compile_ternary(p);
 
-    // Handle comma operator (rare, but POSIX)
-    while (!p->error && p->input[p->pos] == ',') {
-        p->pos++;
+    while (!p->error && p->current.type == TOK_COMMA) {
         next_token(p);
-        result = parse_ternary(p);
+        emit(p, OP_POP, 0);
+        compile_ternary(p);
     }
+}
 
-    return result;
+static void program_free(ArithProgram *prog) {
+    for (size_t i = 0; i < prog->var_count; i++) {
+        free(prog->vars[i].name);
+    }
+    free(prog->vars);
+    free(prog->code);
+    free(prog->source);
+    free(prog);
 }
 
-// Main evaluation function
-int arith_evaluate(const char *expr, long *result) {
-    if (!expr || !result) return -1;
+// Compile an expression; returns NULL on a syntax error
+static ArithProgram *compile(const char *expr, unsigned int hash) {
+    ArithProgram *prog = calloc(1, sizeof(ArithProgram));
+    if (!prog) return NULL;
+    prog->source = strdup(expr);
+    prog->hash = hash;
 
     Parser p = {0};
     p.input = expr;
-    p.pos = 0;
-    p.error = 0;
+    p.prog = prog;
 
     next_token(&p);
-    *result = parse_expression(&p);
+    compile_expression(&p);
 
-    // Check for trailing garbage
-    skip_whitespace(&p);
-    if (p.input[p.pos] != '\0') {
+    // Everything must have been consumed
+    if (!prog->source || p.current.type != TOK_EOF) {
         p.error = 1;
     }
+    if (p.error) {
+        program_free(prog);
+        return NULL;
+    }
+    return prog;
+}
+
+static long load_var(ArithVar *var) {
+    if (var->special) return get_variable(var->name);
+
+    long value;
+    if (shellvar_ref_get_number(&var->ref, &value)) {
+        return value;
+    }
+    // Check for unset variable with -u
+    check_arith_unset_error(var->name);
+    return 0;
+}
+
+static void store_var(ArithVar *var, long value) {
+    if (var->special) {
+        set_variable(var->name, value);
+    } else {
+        shellvar_ref_set_int(&var->ref, value);
+    }
+}
+
+// Run a compiled expression; returns -1 on division by zero
+static int run_program(ArithProgram *prog, long *result) {
+    ArenaMark mark = arena_mark();
+    long *stack = arena_alloc((prog->len + 1) * sizeof(long));
+    size_t sp = 0;
+    int rc = 0;
+
+    for (size_t pc = 0; pc < prog->len && rc == 0; pc++) {
+        const Insn *in = &prog->code[pc];
+        ArithVar *var = in->op <= OP_POSTDEC && in->op != OP_NUM ? &prog->vars[in->arg] : NULL;
+        long a, b;
+
+        switch (in->op) {
+            case OP_NUM:
+                stack[sp++] = in->arg;
+                break;
+            case OP_LOAD:
+                stack[sp++] = load_var(var);
+                break;
+            case OP_STORE:
+                store_var(var, stack[sp - 1]);
+                break;
+            case OP_PREINC:
+            case OP_PREDEC:
+                a = load_var(var) + (in->op == OP_PREINC ? 1 : -1);
+                store_var(var, a);
+                stack[sp++] = a;
+                break;
+            case OP_POSTINC:
+            case OP_POSTDEC:
+                a = load_var(var);
+                store_var(var, a + (in->op == OP_POSTINC ? 1 : -1));
+                stack[sp++] = a;
+                break;
+            case OP_NEG:  stack[sp - 1] = -stack[sp - 1]; break;
+            case OP_NOT:  stack[sp - 1] = !stack[sp - 1]; break;
+            case OP_BNOT: stack[sp - 1] = ~stack[sp - 1]; break;
+            case OP_BOOL: stack[sp - 1] = stack[sp - 1] != 0; break;
+            case OP_JZ:
+                if (stack[--sp] == 0) pc = (size_t)in->arg - 1;
+                break;
+            case OP_JNZ:
+                if (stack[--sp] != 0) pc = (size_t)in->arg - 1;
+                break;
+            case OP_JMP:
+                pc = (size_t)in->arg - 1;
+                break;
+            case OP_POP:
+                sp--;
+                break;
+            default:
+                // Binary operators
+                b = stack[--sp];
+                a = stack[sp - 1];
+                switch (in->op) {
+                    case OP_MUL: a = a * b; break;
+                    case OP_DIV:
+                    case OP_MOD:
+                        if (b == 0) {
+                            rc = -1;
+                        } else if (b == -1) {
+                            // LONG_MIN / -1 would trap
+                            a = in->op == OP_DIV ? (long)(0UL - (unsigned long)a) : 0;
+                        } else {
+                            a = in->op == OP_DIV ? a / b : a % b;
+                        }
+                        break;
+                    case OP_ADD:  a = a + b; break;
+                    case OP_SUB:  a = a - b; break;
+                    case OP_SHL:  a = a << b; break;
+                    case OP_SHR:  a = a >> b; break;
+                    case OP_LT:   a = a < b; break;
+                    case OP_GT:   a = a > b; break;
+                    case OP_LE:   a = a <= b; break;
+                    case OP_GE:   a = a >= b; break;
+                    case OP_EQ:   a = a == b; break;
+                    case OP_NE:   a = a != b; break;
+                    case OP_BAND: a = a & b; break;
+                    case OP_BXOR: a = a ^ b; break;
+                    case OP_BOR:  a = a | b; break;
+                    default: break;
+                }
+                stack[sp - 1] = a;
+                break;
+        }
+    }
 
-    return p.error ? -1 : 0;
+    if (rc == 0) *result = sp > 0 ? stack[sp - 1] : 0;
+    arena_release(mark);
+    return rc;
+}
+
+static unsigned int hash_source(const char *s) {
+    unsigned int hash = 2166136261u;
+    while (*s) {
+        hash = (hash ^ (unsigned char)*s++) * 16777619u;
+    }
+    return hash;
+}
+
+static void lru_unlink(ArithProgram *prog) {
+    if (prog->newer) prog->newer->older = prog->older;
+    else arith_cache.newest = prog->older;
+    if (prog->older) prog->older->newer = prog->newer;
+    else arith_cache.oldest = prog->newer;
+}
+
+static void lru_push(ArithProgram *prog) {
+    prog->newer = NULL;
+    prog->older = arith_cache.newest;
+    if (arith_cache.newest) arith_cache.newest->newer = prog;
+    arith_cache.newest = prog;
+    if (!arith_cache.oldest) arith_cache.oldest = prog;
+}
+
+// Find the compiled form of an expression, compiling it on a miss
+static ArithProgram *cache_get(const char *expr) {
+    unsigned int hash = hash_source(expr);
+    ArithProgram **bucket = &arith_cache.buckets[hash % ARITH_CACHE_BUCKETS];
+
+    for (ArithProgram *prog = *bucket; prog; prog = prog->next) {
+        if (prog->hash == hash && strcmp(prog->source, expr) == 0) {
+            if (arith_cache.newest != prog) {
+                lru_unlink(prog);
+                lru_push(prog);
+            }
+            return prog;
+        }
+    }
+
+    ArithProgram *prog = compile(expr, hash);
+    if (!prog) return NULL;
+
+    // Evict the least recently used expression
+    if (arith_cache.count == ARITH_CACHE_SIZE) {
+        ArithProgram *old = arith_cache.oldest;
+        ArithProgram **link = &arith_cache.buckets[old->hash % ARITH_CACHE_BUCKETS];
+        while (*link != old) link = &(*link)->next;
+        *link = old->next;
+        lru_unlink(old);
+        program_free(old);
+        arith_cache.count--;
+    }
+
+    prog->next = *bucket;
+    *bucket = prog;
+    lru_push(prog);
+    arith_cache.count++;
+    return prog;
+}
+
+void arith_cache_clear(void) {
+    while (arith_cache.oldest) {
+        ArithProgram *prog = arith_cache.oldest;
+        lru_unlink(prog);
+        program_free(prog);
+    }
+    memset(arith_cache.buckets, 0, sizeof(arith_cache.buckets));
+    arith_cache.count = 0;
+}
+
+// Main evaluation function
+int arith_evaluate(const char *expr, long *result) {
+    if (!expr || !result) return -1;
+
+    ArithProgram *prog = cache_get(expr);
+    if (!prog) return -1;
+
+    return run_program(prog, result);
 }
 
 // Check if string contains arithmetic expansion
@@ -834,19 +1045,13 @@ static const char *find_arith_end(const char *start) {
 }
 
 static int expand_and_evaluate_expr(const char *expr_start, size_t expr_len, long *result) {
-    char *expr= malloc(expr_len + 1);
-    if (!expr) {
-        return -2;
-    }
-
-    memcpy(expr, expr_start, expr_len);
-    expr[expr_len] = '\0';
+    ArenaMark mark = arena_mark();
+    char *expr = arena_strndup(expr_start, expr_len);
 
     // First, expand any command substitutions in the expression
     char *cmdsub_expanded = cmdsub_expand(expr);
     if (cmdsub_expanded) {
-        free(expr);
-        expr= cmdsub_expanded;
+        expr = cmdsub_expanded;
         // Strip \x03 IFS markers from cmdsub output - they're not needed
         // for arithmetic and would cause the parser to error
         const char *read = expr;
@@ -862,29 +1067,46 @@ static int expand_and_evaluate_expr(const char *expr_start, size_t expr_len, lon
 
     int ret = arith_evaluate(expr, result);
 
-    free(expr);
+    free(cmdsub_expanded);
+    arena_release(mark);
 
     return ret;
 }
 
+// Evaluate the body of one $((...)) substitution
+const char *arith_substitute(const char *start, long *value) {
+    const char *end = find_arith_end(start);
+    if (!end) return NULL;
+
+    // Errors evaluate to 0, as in arith_expand()
+    if (expand_and_evaluate_expr(start, end - start, value) != 0) {
+        *value = 0;
+    }
+    return end + 2;
+}
+
 // Expand arithmetic substitutions in a string
 char *arith_expand(const char *str) {
     if (!str || !has_arith(str)) return NULL;
 
-    // Allocate proportionally to input size
+    // Allocate proportionally to input size; grown below if results run longer
     size_t input_len = strlen(str);
-    size_t result_size = input_len + 4096;
-    if (result_size < MAX_ARITH_LENGTH) {
-        result_size = MAX_ARITH_LENGTH;
-    }
+    size_t result_size = input_len + ARITH_RESULT_SLACK;
 
-    char *result = malloc(result_size);
-    if (!result) return NULL;
+    // Work in the command arena; only the finished string goes to the heap
+    ArenaMark mark = arena_mark();
+    char *result = arena_alloc(result_size);
 
     size_t out_pos = 0;
     const char *p = str;
 
-    while (*p && out_pos < result_size - 1) {
+    while (*p) {
+        // Keep room for one formatted number, doubling so output stays linear
+        if (out_pos + ARITH_RESULT_SLACK >= result_size) {
+            result = arena_realloc(result, result_size, result_size * 2);
+            result_size *= 2;
+        }
+
         // Check if regular characters Regular character
         if (!(*p == '$' && *(p + 1) == '(' && *(p + 2) == '(')) {
             result[out_pos++] = *p++;
@@ -904,11 +1126,9 @@ char *arith_expand(const char *str) {
         const char *end = find_arith_end(p);
         if (!end) {
             // Malformed, copy literally
-            if (out_pos < result_size - 3) {
-                result[out_pos++] = '$';
-                result[out_pos++] = '(';
-                result[out_pos++] = '(';
-            }
+            result[out_pos++] = '$';
+            result[out_pos++] = '(';
+            result[out_pos++] = '(';
             continue;
         }
 
@@ -919,14 +1139,10 @@ char *arith_expand(const char *str) {
             // Format result
             char buf[32];
             int n = snprintf(buf, sizeof(buf), "%ld", value);
-            if (n > 0 && (size_t)n + out_pos < result_size) {
+            if (n > 0) {
                 memcpy(result + out_pos, buf, n);
                 out_pos += n;
             }
-        } else if (ret == -2) {
-            // Failed malloc
-            free(result);
-            return NULL;
         } else {
             // Error - output 0 or keep original?
             // POSIX says error, but let's be lenient
@@ -937,20 +1153,8 @@ char *arith_expand(const char *str) {
     }
 
     result[out_pos] = '\0';
-    return result;
-}
-
-// Expand arithmetic substitutions in all arguments
-int arith_args(char **args) {
-    if (!args) return -1;
-
-    for (int i = 0; args[i] != NULL; i++) {
-        // arith_expand checks for has_arith()
-        char *expanded = arith_expand(args[i]);
-        if (expanded) {
-            args[i] = expanded;
-        }
-    }
-
-    return 0;
+    char *expanded = malloc(out_pos + 1);
+    if (expanded) memcpy(expanded, result, out_pos + 1);
+    arena_release(mark);
+    return expanded;
 }
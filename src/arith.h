@@ -37,13 +37,14 @@ int arith_evaluate(const char *expr, long *result);
 char *arith_expand(const char *str);
 
 /**
- * Expand arithmetic substitutions in all arguments
- * Modifies args array in place (replaces with expanded versions)
- *
- * @param args Null-terminated argument array
- * @return 0 on success, -1 on error
+ * Evaluate one $((...)) substitution
+ * Command substitutions in the expression are expanded first; an
+ * expression that fails to evaluate yields 0.
+ * @param start First character after "$(("
+ * @param value Receives the result
+ * @return Pointer just past the closing "))", or NULL if unterminated
  */
-int arith_args(char **args);
+const char *arith_substitute(const char *start, long *value);
 
 /**
  * Check if a string contains arithmetic expansion
@@ -66,4 +67,11 @@ bool arith_had_unset_error(void);
  */
 void arith_clear_unset_error(void);
 
+/**
+ * Free the cache of compiled expressions
+ * Expressions are compiled to bytecode on first use and the most
+ * recently used ones are kept, so loops skip parsing.
+ */
+void arith_cache_clear(void);
+
 #endif // ARITH_H
@@ -0,0 +1,2075 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "ast.h"
+#include "hash.h"
+#include "parser.h"
+#include "execute.h"
+#include "script.h"
+#include "pipeline.h"
+#include "redirect.h"
+#include "varexpand.h"
+#include "cmdsub.h"
+#include "arith.h"
+#include "shellvar.h"
+#include "trap.h"
+#include "jobs.h"
+#include "config.h"
+#include "builtins.h"
+#include "wordexpand.h"
+#include "fileglob.h"
+#include "brace.h"
+
+extern int last_command_exit_code;
+
+// ============================================================================
+// Parser State
+// ============================================================================
+
+// A here-document whose body starts after the next newline
+typedef struct {
+    AstNode *node;
+    char *delim;
+    bool strip_tabs;
+    bool quoted;
+} HeredocRequest;
+
+typedef struct {
+    const char *src;
+    size_t len;
+    size_t pos;
+    bool at_eof;            // No more text will be appended
+    bool incomplete;        // Input ended inside a command
+    bool error;             // Syntax error reported
+    HeredocRequest *heredocs;
+    int heredoc_count;
+    int heredoc_cap;
+} AstParser;
+
+static AstNode *parse_list(AstParser *p, const char *const *stops, bool top_level);
+static AstNode *parse_and_or(AstParser *p);
+static AstNode *parse_command(AstParser *p);
+
+static const char *const STOP_THEN[] = { "then", NULL };
+static const char *const STOP_IF_BODY[] = { "elif", "else", "fi", NULL };
+static const char *const STOP_FI[] = { "fi", NULL };
+static const char *const STOP_DO[] = { "do", NULL };
+static const char *const STOP_DONE[] = { "done", NULL };
+static const char *const STOP_ESAC[] = { "esac", NULL };
+static const char *const STOP_RBRACE[] = { "}", NULL };
+
+// Reserved words that can never start a command
+static const char *const TERMINATORS[] = {
+    "then", "elif", "else", "fi", "do", "done", "esac", "}", NULL
+};
+
+static bool parser_failed(const AstParser *p) {
+    return p->incomplete || p->error;
+}
+
+// Character at offset from the current position ('\0' past the end)
+static char peek(const AstParser *p, size_t offset) {
+    return (p->pos + offset < p->len) ? p->src[p->pos + offset] : '\0';
+}
+
+static bool is_meta(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == ';' || c == '&' ||
+           c == '|' || c == '(' || c == ')' || c == '<' || c == '>';
+}
+
+static AstNode *node_new(AstNodeType type) {
+    AstNode *node = calloc(1, sizeof(AstNode));
+    if (!node) {
+        fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+        exit(EXIT_FAILURE);
+    }
+    node->type = type;
+    return node;
+}
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+// Copy raw source text, trimming surrounding whitespace
+static char *dup_raw(const char *s, size_t n) {
+    while (n > 0 && isspace((unsigned char)*s)) { s++; n--; }
+    while (n > 0 && isspace((unsigned char)s[n - 1])) n--;
+    char *copy = xrealloc(NULL, n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+// Copy command text, removing backslash-newline continuations
+// (literal inside single quotes)
+static char *dup_word(const char *s, size_t n) {
+    char *copy = xrealloc(NULL, n + 1);
+    size_t j = 0;
+    bool in_single = false;
+    bool in_double = false;
+
+    for (size_t i = 0; i < n; i++) {
+        char c = s[i];
+        if (c == '\\' && !in_single && i + 1 < n) {
+            if (s[i + 1] == '\n') {
+                i++;
+                continue;
+            }
+            copy[j++] = c;
+            copy[j++] = s[++i];
+            continue;
+        }
+        if (c == '\'' && !in_double) in_single = !in_single;
+        else if (c == '"' && !in_single) in_double = !in_double;
+        copy[j++] = c;
+    }
+    while (j > 0 && isspace((unsigned char)copy[j - 1])) j--;
+    copy[j] = '\0';
+    return copy;
+}
+
+static void report_unexpected(AstParser *p, const char *token) {
+    if (parser_failed(p)) return;
+    p->error = true;
+    if (!script_state.silent_errors) {
+        fprintf(stderr, "%s: syntax error: unexpected '%s'\n", HASH_NAME, token);
+    }
+}
+
+// ============================================================================
+// Lexical Scanning
+// ============================================================================
+
+// Input ran out in the middle of a quote or substitution
+static void ran_out(AstParser *p) {
+    p->pos = p->len;
+    // At end of input, accept the unterminated word and let parse_line cope
+    if (!p->at_eof) p->incomplete = true;
+}
+
+static bool scan_parens(AstParser *p);
+static bool scan_braces(AstParser *p);
+
+// Skip '...' starting at the opening quote
+static bool scan_single_quote(AstParser *p) {
+    const char *end = memchr(p->src + p->pos + 1, '\'', p->len - p->pos - 1);
+    if (!end) return false;
+    p->pos = (size_t)(end - p->src) + 1;
+    return true;
+}
+
+// Skip `...` starting at the opening backquote
+static bool scan_backquote(AstParser *p) {
+    p->pos++;
+    while (p->pos < p->len) {
+        char c = p->src[p->pos];
+        if (c == '\\') {
+            p->pos += 2;
+            continue;
+        }
+        p->pos++;
+        if (c == '`') return true;
+    }
+    return false;
+}
+
+// Skip "..." starting at the opening quote
+static bool scan_double_quote(AstParser *p) {
+    p->pos++;
+    while (p->pos < p->len) {
+        char c = p->src[p->pos];
+        if (c == '\\') {
+            p->pos += 2;
+            continue;
+        }
+        if (c == '"') {
+            p->pos++;
+            return true;
+        }
+        bool ok = true;
+        if (c == '`') {
+            ok = scan_backquote(p);
+        } else if (c == '$' && peek(p, 1) == '(') {
+            p->pos++;
+            ok = scan_parens(p);
+        } else if (c == '$' && peek(p, 1) == '{') {
+            p->pos++;
+            ok = scan_braces(p);
+        } else {
+            p->pos++;
+        }
+        if (!ok) return false;
+    }
+    return false;
+}
+
+// Check whether the current position starts a command: it follows a
+// separator or one of the reserved words a command may come after
+static bool at_command_start(const AstParser *p) {
+    static const char *const LEADERS[] = {
+        "then", "do", "else", "elif", "if", "while", "until", "!", "{", NULL
+    };
+    size_t end = p->pos;
+    while (end > 0 && (p->src[end - 1] == ' ' || p->src[end - 1] == '\t')) end--;
+    if (end == 0 || strchr(";&|()\n", p->src[end - 1])) return true;
+    size_t start = end;
+    while (start > 0 && !is_meta(p->src[start - 1])) start--;
+    for (int i = 0; LEADERS[i]; i++) {
+        if (strlen(LEADERS[i]) == end - start &&
+            memcmp(p->src + start, LEADERS[i], end - start) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check for a reserved word in command position at the current position
+static bool keyword_here(const AstParser *p, const char *word) {
+    size_t n = strlen(word);
+    if (p->pos + n > p->len || memcmp(p->src + p->pos, word, n) != 0) return false;
+    char next = peek(p, n);
+    if (next != '\0' && !is_meta(next)) return false;
+    return p->pos == 0 || (is_meta(p->src[p->pos - 1]) && at_command_start(p));
+}
+
+// Skip a balanced (...) group starting at the opening paren
+// A case pattern's ')' does not close the group: each open case records
+// the depth it started at, and a ')' at that depth belongs to a pattern
+static bool scan_parens(AstParser *p) {
+    int depth = 0;
+    int case_base[32];
+    int cases = 0;
+    while (p->pos < p->len) {
+        char c = p->src[p->pos];
+        bool ok = true;
+        if (c == '\\') {
+            p->pos += 2;
+            continue;
+        } else if (c == '\'') {
+            ok = scan_single_quote(p);
+        } else if (c == '"') {
+            ok = scan_double_quote(p);
+        } else if (c == '`') {
+            ok = scan_backquote(p);
+        } else if (c == 'c' && keyword_here(p, "case")) {
+            if (cases < (int)(sizeof(case_base) / sizeof(case_base[0]))) {
+                case_base[cases] = depth;
+            }
+            cases++;
+            p->pos += 4;
+        } else if (c == 'e' && cases > 0 && keyword_here(p, "esac")) {
+            cases--;
+            p->pos += 4;
+        } else {
+            p->pos++;
+            if (c == '(') {
+                depth++;
+            } else if (c == ')') {
+                if (cases > 0 && cases <= (int)(sizeof(case_base) / sizeof(case_base[0])) &&
+                    depth == case_base[cases - 1]) {
+                    continue;
+                }
+                if (--depth == 0) return true;
+            }
+        }
+        if (!ok) return false;
+    }
+    return false;
+}
+
+// Skip a balanced {...} group (parameter expansion) starting at the brace
+static bool scan_braces(AstParser *p) {
+    int depth = 0;
+    while (p->pos < p->len) {
+        char c = p->src[p->pos];
+        bool ok = true;
+        if (c == '\\') {
+            p->pos += 2;
+            continue;
+        } else if (c == '\'') {
+            ok = scan_single_quote(p);
+        } else if (c == '"') {
+            ok = scan_double_quote(p);
+        } else if (c == '`') {
+            ok = scan_backquote(p);
+        } else if (c == '$' && peek(p, 1) == '(') {
+            p->pos++;
+            ok = scan_parens(p);
+        } else {
+            p->pos++;
+            if (c == '{') {
+                depth++;
+            } else if (c == '}' && --depth == 0) {
+                return true;
+            }
+        }
+        if (!ok) return false;
+    }
+    return false;
+}
+
+// Check whether text so far is "name=" or "name+=" (array assignment follows)
+static bool is_assignment_prefix(const char *s, size_t n) {
+    if (n < 2 || s[n - 1] != '=') return false;
+    n--;
+    if (n > 0 && s[n - 1] == '+') n--;
+    if (n == 0 || !(isalpha((unsigned char)s[0]) || s[0] == '_')) return false;
+    for (size_t i = 1; i < n; i++) {
+        if (!isalnum((unsigned char)s[i]) && s[i] != '_') return false;
+    }
+    return true;
+}
+
+// Skip one word: quotes, escapes and substitutions are kept intact
+static void scan_word(AstParser *p) {
+    size_t start = p->pos;
+    while (p->pos < p->len) {
+        char c = p->src[p->pos];
+        bool ok = true;
+        if (c == '\\') {
+            p->pos += 2;
+            if (p->pos > p->len) p->pos = p->len;
+            continue;
+        } else if (c == '\'') {
+            ok = scan_single_quote(p);
+        } else if (c == '"') {
+            ok = scan_double_quote(p);
+        } else if (c == '`') {
+            ok = scan_backquote(p);
+        } else if (c == '$' && (peek(p, 1) == '(' || peek(p, 1) == '{')) {
+            p->pos++;
+            ok = (c = p->src[p->pos]) == '(' ? scan_parens(p) : scan_braces(p);
+        } else if (c == '(' && is_assignment_prefix(p->src + start, p->pos - start)) {
+            ok = scan_parens(p);
+        } else if (is_meta(c)) {
+            break;
+        } else {
+            p->pos++;
+        }
+        if (!ok) {
+            ran_out(p);
+            return;
+        }
+    }
+    if (p->pos > p->len) p->pos = p->len;
+}
+
+// Length of the word at the current position (without consuming it)
+static size_t peek_word_len(AstParser *p) {
+    size_t saved = p->pos;
+    bool saved_incomplete = p->incomplete;
+    scan_word(p);
+    size_t n = p->pos - saved;
+    p->pos = saved;
+    p->incomplete = saved_incomplete;
+    return n;
+}
+
+// Check whether the next word is exactly the given reserved word
+static bool next_is(AstParser *p, const char *word) {
+    size_t n = strlen(word);
+    if (p->pos + n > p->len || memcmp(p->src + p->pos, word, n) != 0) return false;
+    return peek_word_len(p) == n;
+}
+
+static bool next_is_any(AstParser *p, const char *const *words) {
+    for (int i = 0; words && words[i]; i++) {
+        if (next_is(p, words[i])) return true;
+    }
+    return false;
+}
+
+// Report the token at the current position as unexpected
+static void unexpected(AstParser *p) {
+    if (parser_failed(p)) return;
+    if (p->pos >= p->len) {
+        p->incomplete = true;
+        return;
+    }
+    char token[64];
+    size_t n = peek_word_len(p);
+    if (p->src[p->pos] == '\n') {
+        snprintf(token, sizeof(token), "newline");
+    } else {
+        if (n == 0) {
+            n = 1;
+            char c = p->src[p->pos];
+            if ((c == ';' || c == '&' || c == '|') && peek(p, 1) == c) n = 2;
+        }
+        if (n >= sizeof(token)) n = sizeof(token) - 1;
+        memcpy(token, p->src + p->pos, n);
+        token[n] = '\0';
+    }
+    report_unexpected(p, token);
+}
+
+// Skip blanks, line continuations and comments (not newlines)
+static void skip_blanks(AstParser *p) {
+    while (p->pos < p->len) {
+        char c = p->src[p->pos];
+        if (c == ' ' || c == '\t') {
+            p->pos++;
+        } else if (c == '\\' && peek(p, 1) == '\n') {
+            p->pos += 2;
+        } else if (c == '#') {
+            const char *nl = memchr(p->src + p->pos, '\n', p->len - p->pos);
+            p->pos = nl ? (size_t)(nl - p->src) : p->len;
+        } else {
+            break;
+        }
+    }
+}
+
+// ============================================================================
+// Here-Documents
+// ============================================================================
+
+static void buf_append(char **buf, size_t *len, size_t *cap, const char *s, size_t n) {
+    if (*len + n + 1 > *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 256;
+        while (new_cap < *len + n + 1) new_cap *= 2;
+        *buf = xrealloc(*buf, new_cap);
+        *cap = new_cap;
+    }
+    memcpy(*buf + *len, s, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+}
+
+// Collect a here-document body from the lines after the current position
+// For unquoted delimiters, backslash-newline joins lines
+static void read_heredoc_body(AstParser *p, const HeredocRequest *req) {
+    char *body = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    size_t delim_len = strlen(req->delim);
+    bool joining = false;
+    bool found = false;
+
+    buf_append(&body, &len, &cap, "", 0);
+
+    while (p->pos < p->len) {
+        const char *line = p->src + p->pos;
+        const char *nl = memchr(line, '\n', p->len - p->pos);
+        if (!nl && !p->at_eof) break;  // Need the whole line
+
+        size_t n = nl ? (size_t)(nl - line) : p->len - p->pos;
+        p->pos += n + (nl ? 1 : 0);
+
+        if (req->strip_tabs) {
+            while (n > 0 && *line == '\t') {
+                line++;
+                n--;
+            }
+        }
+
+        // Delimiter is only recognized on a line of its own
+        if (!joining && n == delim_len && memcmp(line, req->delim, n) == 0) {
+            found = true;
+            break;
+        }
+
+        if (!req->quoted && n > 0 && line[n - 1] == '\\') {
+            buf_append(&body, &len, &cap, line, n - 1);
+            joining = true;
+            continue;
+        }
+
+        buf_append(&body, &len, &cap, line, n);
+        buf_append(&body, &len, &cap, "\n", 1);
+        joining = false;
+    }
+
+    if (!found) {
+        if (!p->at_eof) {
+            free(body);
+            p->incomplete = true;
+            return;
+        }
+        if (joining) buf_append(&body, &len, &cap, "\n", 1);
+        // POSIX allows end-of-file as the delimiter (with a warning)
+        if (!script_state.silent_errors) {
+            fprintf(stderr, "%s: warning: here-document delimited by end-of-file (wanted '%s')\n",
+                    HASH_NAME, req->delim);
+        }
+    }
+
+    // Only one here-document per command is supported; keep the first
+    if (!req->node->heredoc) {
+        req->node->heredoc = body;
+        req->node->heredoc_quoted = req->quoted;
+    } else {
+        free(body);
+    }
+}
+
+static void clear_heredoc_requests(AstParser *p) {
+    for (int i = 0; i < p->heredoc_count; i++) {
+        free(p->heredocs[i].delim);
+    }
+    p->heredoc_count = 0;
+}
+
+// Consume a newline and any here-document bodies queued on its line
+static void consume_newline(AstParser *p) {
+    p->pos++;
+    for (int i = 0; i < p->heredoc_count && !parser_failed(p); i++) {
+        read_heredoc_body(p, &p->heredocs[i]);
+    }
+    clear_heredoc_requests(p);
+}
+
+// Skip blanks, comments and newlines between commands
+static void skip_linebreaks(AstParser *p) {
+    for (;;) {
+        skip_blanks(p);
+        if (parser_failed(p) || p->pos >= p->len || p->src[p->pos] != '\n') return;
+        consume_newline(p);
+    }
+}
+
+// ============================================================================
+// Redirections
+// ============================================================================
+
+// Length of a redirection operator (with leading fd digits) at the current
+// position, or 0 if there is none
+static size_t redirect_op_len(const AstParser *p, bool *heredoc, bool *strip_tabs) {
+    size_t i = 0;
+    *heredoc = false;
+    *strip_tabs = false;
+
+    if (peek(p, 0) == '&' && peek(p, 1) == '>') {
+        return peek(p, 2) == '>' ? 3 : 2;
+    }
+    while (isdigit((unsigned char)peek(p, i))) i++;
+
+    char c = peek(p, i);
+    char next = peek(p, i + 1);
+    if (c == '<') {
+        if (next == '<') {
+            if (peek(p, i + 2) == '<') return i + 3;  // Here-string
+            *heredoc = true;
+            if (peek(p, i + 2) == '-') {
+                *strip_tabs = true;
+                return i + 3;
+            }
+            return i + 2;
+        }
+        return (next == '&' || next == '>') ? i + 2 : i + 1;
+    }
+    if (c == '>') {
+        return (next == '>' || next == '&' || next == '|') ? i + 2 : i + 1;
+    }
+    return 0;
+}
+
+// Parse one redirection (operator already measured) and its target word
+static void parse_redirection(AstParser *p, AstNode *node, size_t op_len, bool heredoc, bool strip_tabs) {
+    p->pos += op_len;
+    skip_blanks(p);
+    if (p->pos >= p->len || is_meta(p->src[p->pos])) {
+        unexpected(p);
+        return;
+    }
+
+    size_t start = p->pos;
+    scan_word(p);
+    if (!heredoc || parser_failed(p)) return;
+
+    // Queue the here-document; its body follows the end of this line
+    const char *raw = p->src + start;
+    size_t n = p->pos - start;
+    char *delim = xrealloc(NULL, n + 1);
+    size_t j = 0;
+    bool quoted = false;
+    for (size_t i = 0; i < n; i++) {
+        if (raw[i] == '\'' || raw[i] == '"') {
+            quoted = true;
+            continue;
+        }
+        if (raw[i] == '\\' && i + 1 < n) {
+            quoted = true;
+            i++;
+        }
+        delim[j++] = raw[i];
+    }
+    delim[j] = '\0';
+
+    if (p->heredoc_count >= p->heredoc_cap) {
+        p->heredoc_cap = p->heredoc_cap ? p->heredoc_cap * 2 : 4;
+        p->heredocs = xrealloc(p->heredocs, (size_t)p->heredoc_cap * sizeof(HeredocRequest));
+    }
+    p->heredocs[p->heredoc_count++] = (HeredocRequest){ node, delim, strip_tabs, quoted };
+}
+
+// Tokenize text once for later execution
+static void args_compile(AstArgs *args, const char *text) {
+    args->parsed = parse_line(text);
+    args->argc = 0;
+    args->len = 0;
+    if (!args->parsed.tokens) return;
+
+    // Tokens point into the buffer; find how much of it is in use
+    for (int i = 0; args->parsed.tokens[i]; i++) {
+        size_t end = (size_t)(args->parsed.tokens[i] - args->parsed.buffer) +
+                     strlen(args->parsed.tokens[i]) + 1;
+        if (end > args->len) args->len = end;
+        args->argc++;
+    }
+}
+
+// Parse redirections following a compound command
+static void parse_compound_redirects(AstParser *p, AstNode *node) {
+    size_t start = 0;
+    size_t end = 0;
+    bool found = false;
+
+    for (;;) {
+        skip_blanks(p);
+        bool heredoc, strip_tabs;
+        size_t op_len = redirect_op_len(p, &heredoc, &strip_tabs);
+        if (op_len == 0) break;
+        if (!found) start = p->pos;
+        found = true;
+        parse_redirection(p, node, op_len, heredoc, strip_tabs);
+        if (parser_failed(p)) return;
+        end = p->pos;
+    }
+
+    if (found) {
+        char *text = dup_word(p->src + start, end - start);
+        args_compile(&node->redirects, text);
+        free(text);
+        node->has_redirects = true;
+    }
+}
+
+// ============================================================================
+// Commands
+// ============================================================================
+
+// Expect a reserved word at the current position
+static bool expect_word(AstParser *p, const char *word) {
+    skip_blanks(p);
+    if (!next_is(p, word)) {
+        unexpected(p);
+        return false;
+    }
+    p->pos += strlen(word);
+    return true;
+}
+
+static AstNode *parse_simple(AstParser *p) {
+    AstNode *node = node_new(AST_SIMPLE);
+    size_t start = p->pos;
+    size_t end = p->pos;
+
+    while (!parser_failed(p)) {
+        skip_blanks(p);
+        if (p->pos >= p->len) break;
+
+        bool heredoc, strip_tabs;
+        size_t op_len = redirect_op_len(p, &heredoc, &strip_tabs);
+        if (op_len > 0) {
+            parse_redirection(p, node, op_len, heredoc, strip_tabs);
+            end = p->pos;
+            continue;
+        }
+
+        char c = p->src[p->pos];
+        if (c == '(') {
+            unexpected(p);
+            break;
+        }
+        if (is_meta(c)) break;
+
+        scan_word(p);
+        end = p->pos;
+    }
+
+    if (parser_failed(p)) {
+        ast_free(node);
+        return NULL;
+    }
+
+    char *text = dup_word(p->src + start, end - start);
+    args_compile(&node->args, text);
+    free(text);
+    return node;
+}
+
+// if/elif clause after the keyword: cond then body [elif...|else body] fi
+static AstNode *parse_if_clause(AstParser *p) {
+    AstNode *node = node_new(AST_IF);
+
+    node->cond = parse_list(p, STOP_THEN, false);
+    if (parser_failed(p) || !expect_word(p, "then")) goto fail;
+    node->body = parse_list(p, STOP_IF_BODY, false);
+    if (parser_failed(p)) goto fail;
+
+    skip_blanks(p);
+    if (next_is(p, "elif")) {
+        p->pos += 4;
+        node->else_part = parse_if_clause(p);
+        if (!node->else_part) goto fail;
+        return node;
+    }
+    if (next_is(p, "else")) {
+        p->pos += 4;
+        node->else_part = parse_list(p, STOP_FI, false);
+        if (parser_failed(p)) goto fail;
+    }
+    if (!expect_word(p, "fi")) goto fail;
+    return node;
+
+fail:
+    ast_free(node);
+    return NULL;
+}
+
+static AstNode *parse_while(AstParser *p, bool until) {
+    AstNode *node = node_new(AST_WHILE);
+    node->until = until;
+    p->pos += 5;  // "while" or "until"
+
+    node->cond = parse_list(p, STOP_DO, false);
+    if (parser_failed(p) || !expect_word(p, "do")) goto fail;
+    node->body = parse_list(p, STOP_DONE, false);
+    if (parser_failed(p) || !expect_word(p, "done")) goto fail;
+    return node;
+
+fail:
+    ast_free(node);
+    return NULL;
+}
+
+static bool is_name(const char *s, size_t n) {
+    if (n == 0 || !(isalpha((unsigned char)s[0]) || s[0] == '_')) return false;
+    for (size_t i = 1; i < n; i++) {
+        if (!isalnum((unsigned char)s[i]) && s[i] != '_') return false;
+    }
+    return true;
+}
+
+static AstNode *parse_for(AstParser *p) {
+    AstNode *node = node_new(AST_FOR);
+    p->pos += 3;
+    skip_blanks(p);
+
+    size_t start = p->pos;
+    scan_word(p);
+    if (parser_failed(p)) goto fail;
+    if (!is_name(p->src + start, p->pos - start)) {
+        if (p->pos == start && p->pos >= p->len) {
+            p->incomplete = true;
+        } else if (!script_state.silent_errors) {
+            fprintf(stderr, "%s: syntax error: expected variable name after 'for'\n", HASH_NAME);
+            p->error = true;
+        } else {
+            p->error = true;
+        }
+        goto fail;
+    }
+    node->var = dup_raw(p->src + start, p->pos - start);
+
+    skip_blanks(p);
+    if (peek(p, 0) == ';') p->pos++;
+    skip_linebreaks(p);
+
+    if (next_is(p, "in")) {
+        p->pos += 2;
+        size_t words_start = p->pos;
+        size_t words_end = p->pos;
+        for (;;) {
+            skip_blanks(p);
+            if (p->pos >= p->len) {
+                unexpected(p);
+                goto fail;
+            }
+            char c = p->src[p->pos];
+            if (c == ';' || c == '\n') break;
+            if (is_meta(c)) {
+                unexpected(p);
+                goto fail;
+            }
+            scan_word(p);
+            if (parser_failed(p)) goto fail;
+            words_end = p->pos;
+        }
+        if (p->src[p->pos] == ';') {
+            p->pos++;
+        } else {
+            consume_newline(p);
+        }
+        char *text = dup_word(p->src + words_start, words_end - words_start);
+        args_compile(&node->args, text);
+        free(text);
+        node->has_words = true;
+    }
+
+    skip_linebreaks(p);
+    if (parser_failed(p) || !expect_word(p, "do")) goto fail;
+    node->body = parse_list(p, STOP_DONE, false);
+    if (parser_failed(p) || !expect_word(p, "done")) goto fail;
+    return node;
+
+fail:
+    ast_free(node);
+    return NULL;
+}
+
+static AstNode *parse_case(AstParser *p) {
+    AstNode *node = node_new(AST_CASE);
+    p->pos += 4;
+    skip_blanks(p);
+
+    size_t start = p->pos;
+    scan_word(p);
+    if (parser_failed(p)) goto fail;
+    if (p->pos == start) {
+        unexpected(p);
+        goto fail;
+    }
+    node->word = dup_word(p->src + start, p->pos - start);
+
+    skip_linebreaks(p);
+    if (parser_failed(p) || !expect_word(p, "in")) goto fail;
+
+    int cap = 0;
+    for (;;) {
+        skip_linebreaks(p);
+        if (parser_failed(p)) goto fail;
+        if (p->pos >= p->len) {
+            p->incomplete = true;
+            goto fail;
+        }
+        if (next_is(p, "esac")) {
+            p->pos += 4;
+            break;
+        }
+
+        if (node->item_count >= cap) {
+            cap = cap ? cap * 2 : 4;
+            node->items = xrealloc(node->items, (size_t)cap * sizeof(AstCaseItem));
+        }
+        AstCaseItem *item = &node->items[node->item_count++];
+        memset(item, 0, sizeof(*item));
+
+        if (peek(p, 0) == '(') {
+            p->pos++;
+        }
+
+        // pattern [| pattern]... )
+        for (;;) {
+            skip_blanks(p);
+            size_t pat_start = p->pos;
+            scan_word(p);
+            if (parser_failed(p)) goto fail;
+            if (p->pos == pat_start) {
+                unexpected(p);
+                goto fail;
+            }
+            item->patterns = xrealloc(item->patterns, (size_t)(item->pattern_count + 1) * sizeof(char *));
+            item->patterns[item->pattern_count++] = dup_word(p->src + pat_start, p->pos - pat_start);
+            skip_blanks(p);
+            if (peek(p, 0) != '|') break;
+            p->pos++;
+        }
+        if (peek(p, 0) != ')') {
+            unexpected(p);
+            goto fail;
+        }
+        p->pos++;
+
+        item->body = parse_list(p, STOP_ESAC, false);
+        if (parser_failed(p)) goto fail;
+
+        skip_blanks(p);
+        if (peek(p, 0) == ';' && peek(p, 1) == ';') {
+            p->pos += (peek(p, 2) == '&') ? 3 : 2;
+        } else if (peek(p, 0) == ';' && peek(p, 1) == '&') {
+            item->fallthrough = true;
+            p->pos += 2;
+        } else if (!next_is(p, "esac")) {
+            unexpected(p);
+            goto fail;
+        }
+    }
+    return node;
+
+fail:
+    ast_free(node);
+    return NULL;
+}
+
+// { list; } -- inner text span is returned for function definitions
+static AstNode *parse_brace(AstParser *p, size_t *inner_start, size_t *inner_end) {
+    AstNode *node = node_new(AST_BRACE);
+    p->pos++;
+    if (inner_start) *inner_start = p->pos;
+
+    node->body = parse_list(p, STOP_RBRACE, false);
+    if (parser_failed(p)) goto fail;
+    skip_blanks(p);
+    if (inner_end) *inner_end = p->pos;
+    if (!expect_word(p, "}")) goto fail;
+    return node;
+
+fail:
+    ast_free(node);
+    return NULL;
+}
+
+static AstNode *parse_subshell(AstParser *p) {
+    AstNode *node = node_new(AST_SUBSHELL);
+    p->pos++;
+
+    node->body = parse_list(p, NULL, false);
+    if (parser_failed(p)) goto fail;
+    skip_blanks(p);
+    if (peek(p, 0) != ')') {
+        unexpected(p);
+        goto fail;
+    }
+    p->pos++;
+    return node;
+
+fail:
+    ast_free(node);
+    return NULL;
+}
+
+// Compound commands: if, loops, case, brace group, subshell (NULL if none)
+static AstNode *parse_compound(AstParser *p, size_t *inner_start, size_t *inner_end) {
+    if (peek(p, 0) == '(') return parse_subshell(p);
+    if (next_is(p, "{")) return parse_brace(p, inner_start, inner_end);
+    if (next_is(p, "if")) {
+        p->pos += 2;
+        return parse_if_clause(p);
+    }
+    if (next_is(p, "while")) return parse_while(p, false);
+    if (next_is(p, "until")) return parse_while(p, true);
+    if (next_is(p, "for")) return parse_for(p);
+    if (next_is(p, "case")) return parse_case(p);
+    return NULL;
+}
+
+// name() compound-command [redirections], or function name [()] compound-command
+static AstNode *parse_funcdef(AstParser *p, size_t name_start, size_t name_len) {
+    AstNode *node = node_new(AST_FUNCDEF);
+    node->name = dup_raw(p->src + name_start, name_len);
+
+    skip_blanks(p);
+    if (peek(p, 0) == '(') {
+        p->pos++;
+        skip_blanks(p);
+        if (peek(p, 0) != ')') {
+            unexpected(p);
+            goto fail;
+        }
+        p->pos++;
+    }
+    skip_linebreaks(p);
+    if (parser_failed(p)) goto fail;
+
+    size_t body_start = p->pos;
+    size_t inner_start = 0;
+    size_t inner_end = 0;
+    node->body = parse_compound(p, &inner_start, &inner_end);
+    if (!node->body) {
+        unexpected(p);
+        goto fail;
+    }
+    parse_compound_redirects(p, node->body);
+    if (parser_failed(p)) goto fail;
+
+    // The function table stores body text; a plain { } body keeps only
+    // the commands between the braces
+    if (node->body->type == AST_BRACE && !node->body->has_redirects) {
+        node->func_body = dup_raw(p->src + inner_start, inner_end - inner_start);
+    } else {
+        node->func_body = dup_raw(p->src + body_start, p->pos - body_start);
+    }
+    return node;
+
+fail:
+    ast_free(node);
+    return NULL;
+}
+
+// Function names may use more characters than variable names
+static bool is_func_name(const char *s, size_t n) {
+    if (n == 0 || isdigit((unsigned char)s[0])) return false;
+    for (size_t i = 0; i < n; i++) {
+        char c = s[i];
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-' && c != '.' && c != ':') return false;
+    }
+    return true;
+}
+
+static AstNode *parse_command(AstParser *p) {
+    skip_blanks(p);
+    if (p->pos >= p->len) {
+        p->incomplete = true;
+        return NULL;
+    }
+
+    bool heredoc, strip_tabs;
+    if (redirect_op_len(p, &heredoc, &strip_tabs) > 0) {
+        return parse_simple(p);
+    }
+    if (p->src[p->pos] != '(' && is_meta(p->src[p->pos])) {
+        unexpected(p);
+        return NULL;
+    }
+    if (next_is_any(p, TERMINATORS)) {
+        unexpected(p);
+        return NULL;
+    }
+
+    AstNode *node = parse_compound(p, NULL, NULL);
+    if (node) {
+        parse_compound_redirects(p, node);
+        if (parser_failed(p)) {
+            ast_free(node);
+            return NULL;
+        }
+        return node;
+    }
+    if (parser_failed(p)) return NULL;
+
+    size_t word_start = p->pos;
+    size_t word_len = peek_word_len(p);
+
+    if (next_is(p, "function")) {
+        p->pos += 8;
+        skip_blanks(p);
+        size_t name_start = p->pos;
+        scan_word(p);
+        if (parser_failed(p)) return NULL;
+        if (!is_func_name(p->src + name_start, p->pos - name_start)) {
+            unexpected(p);
+            return NULL;
+        }
+        return parse_funcdef(p, name_start, p->pos - name_start);
+    }
+
+    // name ( ) starts a function definition
+    if (is_func_name(p->src + word_start, word_len)) {
+        size_t saved = p->pos;
+        p->pos += word_len;
+        skip_blanks(p);
+        if (peek(p, 0) == '(') {
+            size_t after = p->pos + 1;
+            while (after < p->len && (p->src[after] == ' ' || p->src[after] == '\t')) after++;
+            if (after < p->len && p->src[after] == ')') {
+                return parse_funcdef(p, word_start, word_len);
+            }
+        }
+        p->pos = saved;
+    }
+
+    return parse_simple(p);
+}
+
+// [!] command [| command]...
+static AstNode *parse_pipeline(AstParser *p) {
+    skip_blanks(p);
+    bool negate = false;
+    if (next_is(p, "!")) {
+        negate = true;
+        p->pos++;
+        skip_blanks(p);
+    }
+
+    AstNode *first = parse_command(p);
+    if (!first) return NULL;
+
+    AstNode *node = NULL;
+    for (;;) {
+        skip_blanks(p);
+        if (peek(p, 0) != '|' || peek(p, 1) == '|') break;
+        p->pos++;
+        skip_linebreaks(p);
+        AstNode *next = parse_command(p);
+        if (!next) {
+            ast_free(node ? node : first);
+            return NULL;
+        }
+        if (!node) {
+            node = node_new(AST_PIPELINE);
+            node->children = xrealloc(NULL, 2 * sizeof(AstNode *));
+            node->children[0] = first;
+            node->child_count = 1;
+        } else {
+            node->children = xrealloc(node->children, (size_t)(node->child_count + 1) * sizeof(AstNode *));
+        }
+        node->children[node->child_count++] = next;
+    }
+
+    if (!node) node = first;
+    node->negate = negate;
+    return node;
+}
+
+// pipeline [&& pipeline | || pipeline]...
+static AstNode *parse_and_or(AstParser *p) {
+    AstNode *first = parse_pipeline(p);
+    if (!first) return NULL;
+
+    AstNode *node = NULL;
+    for (;;) {
+        skip_blanks(p);
+        char c = peek(p, 0);
+        if (!((c == '&' || c == '|') && peek(p, 1) == c)) break;
+        p->pos += 2;
+        skip_linebreaks(p);
+        AstNode *next = parse_pipeline(p);
+        if (!next) {
+            ast_free(node ? node : first);
+            return NULL;
+        }
+        if (!node) {
+            node = node_new(AST_AND_OR);
+            node->children = xrealloc(NULL, 2 * sizeof(AstNode *));
+            node->ops = xrealloc(NULL, sizeof(AstAndOrOp));
+            node->children[0] = first;
+            node->child_count = 1;
+        } else {
+            node->children = xrealloc(node->children, (size_t)(node->child_count + 1) * sizeof(AstNode *));
+            node->ops = xrealloc(node->ops, (size_t)node->child_count * sizeof(AstAndOrOp));
+        }
+        node->ops[node->child_count - 1] = (c == '&') ? AST_OP_AND : AST_OP_OR;
+        node->children[node->child_count++] = next;
+    }
+
+    return node ? node : first;
+}
+
+// A list ends at a closing paren, a case item terminator or a stop word
+static bool at_list_end(AstParser *p, const char *const *stops) {
+    char c = peek(p, 0);
+    if (c == ')') return true;
+    if (c == ';' && (peek(p, 1) == ';' || peek(p, 1) == '&')) return true;
+    return next_is_any(p, stops);
+}
+
+// Sequence of and-or lists separated by ; & or newlines
+// A top-level list is one complete command and ends at the first newline;
+// otherwise the list is the body of a compound command and ends at a stop word
+static AstNode *parse_list(AstParser *p, const char *const *stops, bool top_level) {
+    AstNode **items = NULL;
+    int count = 0;
+
+    for (;;) {
+        if (top_level) {
+            skip_blanks(p);
+        } else {
+            skip_linebreaks(p);
+        }
+        if (parser_failed(p)) goto fail;
+        if (p->pos >= p->len) {
+            if (top_level) break;
+            p->incomplete = true;
+            goto fail;
+        }
+        if (top_level && p->src[p->pos] == '\n') {
+            consume_newline(p);
+            break;
+        }
+        if (!top_level && at_list_end(p, stops)) break;
+
+        size_t start = p->pos;
+        AstNode *node = parse_and_or(p);
+        if (!node) goto fail;
+        items = xrealloc(items, (size_t)(count + 1) * sizeof(AstNode *));
+        items[count++] = node;
+        size_t end = p->pos;
+
+        skip_blanks(p);
+        char c = peek(p, 0);
+        if (c == '&') {
+            node->background = true;
+            free(node->text);
+            node->text = dup_raw(p->src + start, end - start);
+            p->pos++;
+        } else if (c == ';' && peek(p, 1) != ';' && peek(p, 1) != '&') {
+            p->pos++;
+        } else if (c == '\n') {
+            consume_newline(p);
+            if (top_level) break;
+        } else if (p->pos >= p->len) {
+            // A top-level command must see its newline unless input is over
+            if (top_level && !p->at_eof) {
+                p->incomplete = true;
+                goto fail;
+            }
+        } else if (top_level || !at_list_end(p, stops)) {
+            unexpected(p);
+            goto fail;
+        }
+    }
+
+    if (count == 0) {
+        free(items);
+        return NULL;
+    }
+    if (count == 1 && !items[0]->background) {
+        AstNode *node = items[0];
+        free(items);
+        return node;
+    }
+
+    AstNode *list = node_new(AST_LIST);
+    list->children = items;
+    list->child_count = count;
+    return list;
+
+fail:
+    for (int i = 0; i < count; i++) {
+        ast_free(items[i]);
+    }
+    free(items);
+    return NULL;
+}
+
+AstParseStatus ast_parse_next(const char *src, size_t len, size_t *pos, bool at_eof, AstNode **out) {
+    AstParser parser = {
+        .src = src,
+        .len = len,
+        .pos = *pos,
+        .at_eof = at_eof,
+    };
+
+    *out = NULL;
+
+    // Skip blank lines and comments before the command
+    skip_linebreaks(&parser);
+    size_t start = parser.pos;
+
+    AstNode *node = parse_list(&parser, NULL, true);
+    clear_heredoc_requests(&parser);
+    free(parser.heredocs);
+
+    if (parser.incomplete) {
+        ast_free(node);
+        // Blank lines before the command can be dropped
+        *pos = start;
+        return AST_PARSE_INCOMPLETE;
+    }
+    if (parser.error) {
+        ast_free(node);
+        // Resume after the offending line
+        const char *nl = memchr(src + parser.pos, '\n', len - parser.pos);
+        *pos = nl ? (size_t)(nl - src) + 1 : len;
+        return AST_PARSE_ERROR;
+    }
+
+    *pos = parser.pos;
+    *out = node;
+    return AST_PARSE_OK;
+}
+
+AstParseStatus ast_parse_program(const char *src, size_t len, AstNode **out) {
+    AstNode **items = NULL;
+    int count = 0;
+    size_t pos = 0;
+    AstParseStatus status = AST_PARSE_OK;
+
+    *out = NULL;
+    while (pos < len) {
+        AstNode *node = NULL;
+        status = ast_parse_next(src, len, &pos, true, &node);
+        if (status != AST_PARSE_OK) break;
+        if (!node) continue;
+        items = xrealloc(items, (size_t)(count + 1) * sizeof(AstNode *));
+        items[count++] = node;
+    }
+
+    if (status != AST_PARSE_OK) {
+        for (int i = 0; i < count; i++) {
+            ast_free(items[i]);
+        }
+        free(items);
+        return status;
+    }
+
+    if (count == 1) {
+        *out = items[0];
+        free(items);
+    } else if (count > 1) {
+        AstNode *list = node_new(AST_LIST);
+        list->children = items;
+        list->child_count = count;
+        *out = list;
+    }
+    return AST_PARSE_OK;
+}
+
+// ============================================================================
+// Execution
+// ============================================================================
+
+static int exec_node(AstNode *node, bool last);
+
+// Copy compiled tokens into scratch space that execute() may modify
+static char **args_acquire(AstArgs *args) {
+    size_t vec_size = (size_t)(args->argc + 1) * sizeof(char *);
+    char *block;
+
+    if (!args->busy) {
+        if (!args->scratch) args->scratch = xrealloc(NULL, vec_size + args->len);
+        block = args->scratch;
+        args->busy = true;
+    } else {
+        // Re-entered (recursive function): use a private copy
+        block = xrealloc(NULL, vec_size + args->len);
+    }
+
+    char **argv = (char **)block;
+    char *buf = block + vec_size;
+    memcpy(buf, args->parsed.buffer, args->len);
+    for (int i = 0; i < args->argc; i++) {
+        argv[i] = buf + (args->parsed.tokens[i] - args->parsed.buffer);
+    }
+    argv[args->argc] = NULL;
+    return argv;
+}
+
+static void args_release(AstArgs *args, char **argv) {
+    if ((char *)argv == args->scratch) {
+        args->busy = false;
+    } else {
+        free(argv);
+    }
+}
+
+static void args_free(AstArgs *args) {
+    if (args->parsed.tokens) parse_result_free(&args->parsed);
+    free(args->scratch);
+}
+
+static bool flow_pending(void) {
+    return script_get_break_pending() > 0 || script_get_continue_pending() > 0 ||
+           script_get_return_pending();
+}
+
+static int flow_result(void) {
+    if (script_get_break_pending() > 0) return -3;
+    if (script_get_continue_pending() > 0) return -4;
+    return -2;
+}
+
+// errexit: a failed command outside any tested context ends the shell
+static bool errexit_triggered(void) {
+    return shell_option_errexit() && last_command_exit_code != 0 && !script_get_in_condition();
+}
+
+static void free_word_array(char **words, int count) {
+    for (int i = 0; i < count; i++) {
+        free(words[i]);
+    }
+    free(words);
+}
+
+// A brace sequence of a for loop's word list, generated as the loop runs
+typedef struct {
+    BraceSequence seq;
+    int before;             // Index of the expanded word it comes before
+} LoopSequence;
+
+// Expand words the way execute() expands command arguments, with brace
+// expansion, field splitting and globbing
+// When seqs is given, words that are a plain brace sequence are left for
+// the caller to step through and returned there instead
+// Returns a malloc'd array of malloc'd strings, or NULL on expansion error
+static char **expand_words(char **argv, int argc, int *out_count,
+                           LoopSequence **seqs, int *seq_count) {
+    FieldList fields;
+    fieldlist_init(&fields);
+
+    cmdsub_reset_exit_code();
+    arith_clear_unset_error();
+    varexpand_clear_error();
+    fileglob_cache_recheck();
+
+    for (int i = 0; i < argc; i++) {
+        BraceSequence seq;
+        if (seqs && brace_sequence_init(argv[i], &seq)) {
+            *seqs = xrealloc(*seqs, (size_t)(*seq_count + 1) * sizeof(LoopSequence));
+            (*seqs)[*seq_count].seq = seq;
+            (*seqs)[*seq_count].before = fields.count;
+            (*seq_count)++;
+            continue;
+        }
+        if (wordexpand(argv[i], WORDEXP_BRACE | WORDEXP_SPLIT | WORDEXP_GLOB, &fields) != 0) {
+            fieldlist_free(&fields);
+            return NULL;
+        }
+    }
+
+    // Callers only need the strings
+    char **words = fields.fields ? fields.fields : xrealloc(NULL, sizeof(char *));
+    words[fields.count] = NULL;
+    free(fields.flags);
+    *out_count = fields.count;
+    return words;
+}
+
+static int exec_simple(AstNode *node, bool last) {
+    if (!node->args.parsed.tokens) {
+        last_command_exit_code = 1;
+        return 1;
+    }
+
+    char **argv = args_acquire(&node->args);
+
+    // Here-document body for this command only; an enclosing command's
+    // body (e.g. a function called with <<) is restored afterwards
+    char *outer_heredoc = NULL;
+    int outer_quoted = 0;
+    if (node->heredoc) {
+        const char *pending = script_get_pending_heredoc();
+        if (pending) {
+            outer_heredoc = strdup(pending);
+            outer_quoted = script_get_pending_heredoc_quoted();
+        }
+        script_set_pending_heredoc(node->heredoc, node->heredoc_quoted);
+    }
+
+    // Only the final command of a command substitution child may replace it
+    bool saved_exec_directly = exec_directly_in_child;
+    if (!last) exec_directly_in_child = false;
+    int result = execute(argv);
+    exec_directly_in_child = saved_exec_directly;
+
+    if (node->heredoc) {
+        script_set_pending_heredoc(outer_heredoc, outer_quoted);
+        free(outer_heredoc);
+    }
+    args_release(&node->args, argv);
+
+    if (result == 1 && errexit_triggered()) return 0;
+    return result;
+}
+
+// Pipeline stage body (runs in the forked child)
+// A pipeline being run, and the result of its last stage when that stage
+// runs in this shell
+typedef struct {
+    AstNode *node;
+    int result;
+} PipelineRun;
+
+static int run_pipeline_stage(int index, void *data) {
+    AstNode *node = ((PipelineRun *)data)->node;
+
+    // Each stage is a subshell: no job control, fresh loop and trap state
+    is_interactive = false;
+    trap_reset_for_subshell();
+    script_reset_for_subshell();
+    exec_directly_in_child = true;
+
+    exec_node(node->children[index], true);
+    return last_command_exit_code;
+}
+
+static int wait_status(pid_t pid) {
+    int status;
+    pid_t wpid;
+    do {
+        wpid = waitpid(pid, &status, 0);
+    } while (wpid == -1 && errno == EINTR);
+
+    if (wpid <= 0) return 1;
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 1;
+}
+
+static int exec_subshell(AstNode *node, bool last) {
+    fflush(stdout);
+    fflush(stderr);
+
+    // Block SIGCHLD so the job handler cannot reap the child first
+    sigset_t block_mask, old_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block_mask, &old_mask);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+        trap_reset_for_subshell();
+        script_reset_for_subshell();
+        exec_node(node->body, last);
+        fflush(stdout);
+        fflush(stderr);
+        // POSIX: The exit status of the trap action becomes the exit status
+        int trap_exit = trap_execute_exit();
+        _exit((trap_exit >= 0) ? trap_exit : last_command_exit_code);
+    }
+
+    if (pid < 0) {
+        perror(HASH_NAME);
+        last_command_exit_code = 1;
+    } else {
+        last_command_exit_code = wait_status(pid);
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    if (errexit_triggered()) return 0;
+    return 1;
+}
+
+// Run a loop body and account for break/continue
+// Returns 1 to keep looping, 2 to leave the loop normally, or a result to propagate
+static int loop_step(AstNode *body, int *body_status, bool *ran) {
+    int result = exec_node(body, false);
+    *ran = true;
+    *body_status = last_command_exit_code;
+
+    int break_pending = script_get_break_pending();
+    if (break_pending > 0) {
+        script_set_break_pending(break_pending - 1);
+        return (break_pending > 1) ? -3 : 2;
+    }
+    int continue_pending = script_get_continue_pending();
+    if (continue_pending > 0) {
+        script_set_continue_pending(continue_pending - 1);
+        return (continue_pending > 1) ? -4 : 1;
+    }
+    if (result <= 0) return result;
+    if (script_get_return_pending()) return -2;
+    return 1;
+}
+
+// Finish a loop: POSIX exit status is that of the last body command, or 0
+static int loop_finish(int step, int body_status, bool ran) {
+    script_pop_context();
+    if (step == 0 || step == -2 || step == -1) return step;
+    last_command_exit_code = ran ? body_status : 0;
+    return (step == 2) ? 1 : step;
+}
+
+static int exec_while(AstNode *node) {
+    if (script_push_context(node->until ? CTX_UNTIL : CTX_WHILE) < 0) return -1;
+
+    int body_status = 0;
+    bool ran = false;
+    int step = 1;
+
+    while (step == 1) {
+        bool old_in_condition = script_get_in_condition();
+        script_set_in_condition(true);
+        int result = exec_node(node->cond, false);
+        script_set_in_condition(old_in_condition);
+
+        if (result <= 0 || script_get_return_pending()) {
+            step = (result <= 0) ? result : -2;
+            break;
+        }
+        if ((last_command_exit_code == 0) == node->until) {
+            step = 2;
+            break;
+        }
+        step = loop_step(node->body, &body_status, &ran);
+    }
+
+    return loop_finish(step, body_status, ran);
+}
+
+// Run a for loop over expanded values, with brace sequences stepped
+// through in their places among them; frees values
+static int run_for(AstNode *node, char **values, int count, LoopSequence *seqs, int seq_count) {
+    if ((count > 0 || seq_count > 0) && shellvar_is_readonly(node->var)) {
+        fprintf(stderr, "%s: %s: readonly variable\n", HASH_NAME, node->var);
+        free_word_array(values, count);
+        last_command_exit_code = 1;
+        return is_interactive ? 1 : 0;  // Exit in non-interactive mode
+    }
+
+    if (script_push_context(CTX_FOR) < 0) {
+        free_word_array(values, count);
+        return -1;
+    }
+
+    int body_status = 0;
+    bool ran = false;
+    int step = 1;
+
+    int s = 0;
+    for (int i = 0; i <= count && step == 1; i++) {
+        for (; s < seq_count && seqs[s].before == i && step == 1; s++) {
+            const char *value;
+            while (step == 1 && (value = brace_sequence_next(&seqs[s].seq))) {
+                shellvar_set(node->var, value);
+                step = loop_step(node->body, &body_status, &ran);
+            }
+        }
+        if (i < count && step == 1) {
+            shellvar_set(node->var, values[i]);
+            step = loop_step(node->body, &body_status, &ran);
+        }
+    }
+
+    free_word_array(values, count);
+    return loop_finish(step, body_status, ran);
+}
+
+static void free_loop_sequences(LoopSequence *seqs, int seq_count) {
+    for (int i = 0; i < seq_count; i++) {
+        brace_sequence_free(&seqs[i].seq);
+    }
+    free(seqs);
+}
+
+static int exec_for(AstNode *node) {
+    char **values = NULL;
+    int count = 0;
+    LoopSequence *seqs = NULL;
+    int seq_count = 0;
+
+    if (node->has_words) {
+        if (node->args.argc > 0) {
+            char **argv = args_acquire(&node->args);
+            values = expand_words(argv, node->args.argc, &count, &seqs, &seq_count);
+            if (!values || seq_count == 0) {
+                free_loop_sequences(seqs, seq_count);
+                args_release(&node->args, argv);
+                if (!values) {
+                    last_command_exit_code = 1;
+                    return is_interactive ? 1 : 0;
+                }
+            } else {
+                // Sequences point into the words, so they are kept until
+                // the loop ends
+                int result = run_for(node, values, count, seqs, seq_count);
+                free_loop_sequences(seqs, seq_count);
+                args_release(&node->args, argv);
+                return result;
+            }
+        }
+    } else {
+        // No word list: iterate over the positional parameters
+        int params = script_state.positional_count;
+        values = xrealloc(NULL, (size_t)(params > 0 ? params : 1) * sizeof(char *));
+        for (int i = 1; i < params; i++) {
+            values[count++] = strdup(script_state.positional_params[i] ? script_state.positional_params[i] : "");
+        }
+    }
+
+    return run_for(node, values, count, NULL, 0);
+}
+
+static bool case_item_matches(const AstCaseItem *item, const char *word) {
+    for (int i = 0; i < item->pattern_count; i++) {
+        char *pattern = script_expand_case_pattern(item->patterns[i]);
+        bool match = pattern && fnmatch(pattern, word, 0) == 0;
+        free(pattern);
+        if (match) return true;
+    }
+    return false;
+}
+
+static int exec_case(AstNode *node, bool last) {
+    char *word = script_expand_case_word(node->word);
+    if (!word) return 1;
+
+    int result = 1;
+    bool matched = false;
+    for (int i = 0; i < node->item_count; i++) {
+        const AstCaseItem *item = &node->items[i];
+        if (!matched && !case_item_matches(item, word)) continue;
+
+        // Run this item, then fall through to the next one on ;&
+        matched = true;
+        last_command_exit_code = 0;
+        result = exec_node(item->body, last && !item->fallthrough);
+        if (result <= 0 || flow_pending() || !item->fallthrough) break;
+    }
+
+    if (!matched) last_command_exit_code = 0;
+    free(word);
+    return result;
+}
+
+static int exec_and_or(AstNode *node, bool last) {
+    int result = 1;
+    bool old_in_condition = script_get_in_condition();
+
+    for (int i = 0; i < node->child_count; i++) {
+        if (i > 0) {
+            bool succeeded = (last_command_exit_code == 0);
+            if ((node->ops[i - 1] == AST_OP_AND) != succeeded) continue;
+        }
+
+        // Only the final command of the list is subject to errexit
+        bool final = (i == node->child_count - 1);
+        if (!final) script_set_in_condition(true);
+        result = exec_node(node->children[i], last && final);
+        script_set_in_condition(old_in_condition);
+
+        if (result <= 0) return result;
+        if (flow_pending()) return flow_result();
+    }
+    return result;
+}
+
+static int exec_list(AstNode *node, bool last) {
+    int result = 1;
+    for (int i = 0; i < node->child_count; i++) {
+        result = exec_node(node->children[i], last && i == node->child_count - 1);
+        if (result <= 0) return result;
+        if (flow_pending()) return flow_result();
+    }
+    return result;
+}
+
+// Last pipeline stage run in this shell (lastpipe)
+static int run_last_stage(void *data) {
+    PipelineRun *run = data;
+    run->result = exec_node(run->node->children[run->node->child_count - 1], false);
+    return last_command_exit_code;
+}
+
+static int exec_pipeline(AstNode *node) {
+    // With lastpipe and no job control, the last stage runs in this shell
+    // and the variables it sets remain
+    PipelineRun run = { node, 1 };
+    bool lastpipe = shell_option_lastpipe() && !is_interactive;
+    int status = pipeline_run(node->child_count, run_pipeline_stage,
+                              lastpipe ? run_last_stage : NULL, &run);
+    last_command_exit_code = (status < 0) ? 1 : status;
+
+    if (run.result <= 0) return run.result;
+    if (errexit_triggered()) return 0;
+    return 1;
+}
+
+static int exec_command(AstNode *node, bool last) {
+    switch (node->type) {
+        case AST_SIMPLE:
+            return exec_simple(node, last);
+        case AST_PIPELINE:
+            return exec_pipeline(node);
+        case AST_AND_OR:
+            return exec_and_or(node, last);
+        case AST_LIST:
+            return exec_list(node, last);
+        case AST_IF: {
+            bool old_in_condition = script_get_in_condition();
+            script_set_in_condition(true);
+            int result = exec_node(node->cond, false);
+            script_set_in_condition(old_in_condition);
+            if (result <= 0) return result;
+            if (flow_pending()) return flow_result();
+
+            if (last_command_exit_code == 0) return exec_node(node->body, last);
+            if (node->else_part) return exec_node(node->else_part, last);
+            last_command_exit_code = 0;
+            return 1;
+        }
+        case AST_FOR:
+            return exec_for(node);
+        case AST_WHILE:
+            return exec_while(node);
+        case AST_CASE:
+            return exec_case(node, last);
+        case AST_BRACE:
+            return exec_node(node->body, last);
+        case AST_SUBSHELL:
+            return exec_subshell(node, last);
+        case AST_FUNCDEF:
+            if (script_define_function(node->name, node->func_body) < 0) {
+                last_command_exit_code = 1;
+            }
+            return 1;
+    }
+    return 1;
+}
+
+static void restore_fds(int saved[3]) {
+    fflush(stdout);
+    fflush(stderr);
+    for (int fd = 0; fd < 3; fd++) {
+        if (saved[fd] >= 0) {
+            dup2(saved[fd], fd);
+            close(saved[fd]);
+        }
+    }
+}
+
+// Compound command with redirections, run in the current shell
+static int exec_redirected(AstNode *node) {
+    char **argv = args_acquire(&node->redirects);
+
+    // Targets get the same expansions as command arguments, minus splitting
+    FieldList fields;
+    fieldlist_init(&fields);
+    varexpand_clear_error();
+    int expand_rc = wordexpand_command(argv, &fields);
+    args_release(&node->redirects, argv);
+
+    int result = 1;
+    RedirInfo *redir = expand_rc == 0 && fields.fields ? redirect_parse_fields(fields.fields, fields.flags) : NULL;
+    if (!redir) {
+        last_command_exit_code = 1;
+        fieldlist_free(&fields);
+        return is_interactive ? 1 : 0;
+    }
+    if (node->heredoc) {
+        redirect_set_heredoc_content(redir, node->heredoc, node->heredoc_quoted);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    int saved[3];
+    for (int fd = 0; fd < 3; fd++) {
+        saved[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    }
+
+    if (redirect_apply(redir) != 0) {
+        restore_fds(saved);
+        last_command_exit_code = 1;
+    } else {
+        result = exec_command(node, false);
+        restore_fds(saved);
+    }
+
+    redirect_free(redir);
+    fieldlist_free(&fields);
+    return result;
+}
+
+static int exec_foreground(AstNode *node, bool last) {
+    bool old_in_condition = script_get_in_condition();
+
+    // Negated commands are tested, so errexit does not apply inside them
+    if (node->negate) script_set_in_condition(true);
+    int result = node->has_redirects ? exec_redirected(node) : exec_command(node, last);
+    if (node->negate) {
+        script_set_in_condition(old_in_condition);
+        // return's exit code is never negated
+        if (!script_get_return_pending()) {
+            last_command_exit_code = (last_command_exit_code == 0) ? 1 : 0;
+        }
+    }
+    return result;
+}
+
+static int exec_background(AstNode *node) {
+    // Flush so the child does not inherit buffered output
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror(HASH_NAME);
+        last_command_exit_code = 1;
+        return 1;
+    }
+
+    if (pid == 0) {
+        // Child process: own process group, immune to keyboard interrupts
+        setpgid(0, 0);
+        signal(SIGINT, SIG_IGN);
+        signal(SIGQUIT, SIG_IGN);
+
+        // Keep the job from competing for the shell's input
+        int devnull = open("/dev/null", O_RDONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+            if (devnull != STDIN_FILENO) close(devnull);
+        }
+
+        trap_reset_for_subshell();
+        script_reset_for_subshell();
+
+        // The background fork already is the subshell for ( ... ) &
+        if (node->type == AST_SUBSHELL && !node->has_redirects && !node->negate) {
+            exec_node(node->body, false);
+            fflush(stdout);
+            fflush(stderr);
+            int trap_exit = trap_execute_exit();
+            _exit((trap_exit >= 0) ? trap_exit : last_command_exit_code);
+        }
+
+        exec_foreground(node, false);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(last_command_exit_code);
+    }
+
+    // Parent: set the process group from both sides to avoid races
+    setpgid(pid, pid);
+    jobs_set_last_bg_pid(pid);
+    int job_id = jobs_add(pid, node->text ? node->text : "");
+
+    // Only print job notification in interactive mode with job control
+    if (job_id > 0 && isatty(STDIN_FILENO) && shell_option_monitor()) {
+        printf("[%d] %d\n", job_id, pid);
+    }
+
+    last_command_exit_code = 0;
+    return 1;
+}
+
+static int exec_node(AstNode *node, bool last) {
+    if (!node) return 1;
+    if (node->background) return exec_background(node);
+    return exec_foreground(node, last);
+}
+
+int ast_execute(AstNode *node, bool last) {
+    return exec_node(node, last);
+}
+
+// ============================================================================
+// In-Process Check
+// ============================================================================
+
+// Builtins that only print or test their arguments
+static const char *const OUTPUT_ONLY_BUILTINS[] = { "echo", "true", "false", ":", "test", "[", "[[", NULL };
+
+// Function calls followed before giving up (recursive functions)
+#define IN_PROCESS_MAX_DEPTH 8
+
+static bool in_process_ok(const AstNode *node, int depth, bool in_function);
+
+static bool word_is_assignment(const char *w) {
+    ArrayAssignment assign;
+    if (wordexpand_array_assignment(w, &assign)) return true;
+    if (!isalpha((unsigned char)*w) && *w != '_') return false;
+    while (isalnum((unsigned char)*w) || *w == '_') w++;
+    return *w == '=';
+}
+
+// Unquoted < or > (quoted ones carry a \x01 marker)
+static bool word_has_redirect(const char *w) {
+    for (const char *p = w; *p; p++) {
+        if (*p == '\x01' && p[1]) {
+            p++;
+        } else if (*p == '<' || *p == '>') {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool simple_in_process_ok(const AstNode *node, int depth, bool in_function) {
+    char **tokens = node->args.parsed.tokens;
+    if (!tokens || node->heredoc) return false;
+
+    for (int i = 0; tokens[i]; i++) {
+        if (word_has_redirect(tokens[i])) return false;
+    }
+
+    int i = 0;
+    while (tokens[i] && word_is_assignment(tokens[i])) i++;
+    const char *name = tokens[i];
+    if (!name) return true;  // Assignments only
+
+    if (config_get_alias(name)) return false;
+    for (int k = 0; OUTPUT_ONLY_BUILTINS[k]; k++) {
+        if (strcmp(name, OUTPUT_ONLY_BUILTINS[k]) == 0) return true;
+    }
+    if (in_function && strcmp(name, "return") == 0) return true;
+
+    // Builtins take precedence over functions of the same name
+    if (is_builtin(name)) return false;
+    const ShellFunction *func = script_get_function(name);
+    if (!func || !func->program || depth >= IN_PROCESS_MAX_DEPTH) return false;
+    return in_process_ok(func->program->root, depth + 1, true);
+}
+
+static bool in_process_ok(const AstNode *node, int depth, bool in_function) {
+    if (!node) return true;
+    if (node->background || node->has_redirects) return false;
+
+    switch (node->type) {
+        case AST_SIMPLE:
+            return simple_in_process_ok(node, depth, in_function);
+
+        case AST_AND_OR:
+        case AST_LIST:
+            for (int i = 0; i < node->child_count; i++) {
+                if (!in_process_ok(node->children[i], depth, in_function)) return false;
+            }
+            return true;
+
+        case AST_IF:
+        case AST_WHILE:
+            return in_process_ok(node->cond, depth, in_function) &&
+                   in_process_ok(node->body, depth, in_function) &&
+                   in_process_ok(node->else_part, depth, in_function);
+
+        case AST_FOR:
+        case AST_BRACE:
+            return in_process_ok(node->body, depth, in_function);
+
+        case AST_CASE:
+            for (int i = 0; i < node->item_count; i++) {
+                if (!in_process_ok(node->items[i].body, depth, in_function)) return false;
+            }
+            return true;
+
+        default:
+            // Pipelines, subshells and function definitions
+            return false;
+    }
+}
+
+bool ast_can_run_in_process(const AstNode *node) {
+    return in_process_ok(node, 0, false);
+}
+
+void ast_free(AstNode *node) {
+    if (!node) return;
+
+    free(node->text);
+    args_free(&node->args);
+    args_free(&node->redirects);
+    free(node->heredoc);
+
+    for (int i = 0; i < node->child_count; i++) {
+        ast_free(node->children[i]);
+    }
+    free(node->children);
+    free(node->ops);
+
+    ast_free(node->cond);
+    ast_free(node->body);
+    ast_free(node->else_part);
+    free(node->var);
+    free(node->word);
+
+    for (int i = 0; i < node->item_count; i++) {
+        for (int j = 0; j < node->items[i].pattern_count; j++) {
+            free(node->items[i].patterns[j]);
+        }
+        free(node->items[i].patterns);
+        ast_free(node->items[i].body);
+    }
+    free(node->items);
+
+    free(node->name);
+    free(node->func_body);
+    free(node);
+}
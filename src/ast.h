@@ -0,0 +1,162 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "parser.h"
+
+// ============================================================================
+// SCRIPT SYNTAX TREE
+// ============================================================================
+//
+// Scripts, -c strings and function bodies are compiled once into a tree of
+// AstNode and then executed by walking the tree. Loop bodies are therefore
+// tokenized a single time no matter how many iterations run: each simple
+// command keeps the ParseResult produced by parse_line() and only copies it
+// into a scratch buffer before handing it to execute().
+//
+// ============================================================================
+
+typedef enum {
+    AST_SIMPLE,         // Simple command: assignments, words, redirections
+    AST_PIPELINE,       // cmd | cmd | ...
+    AST_AND_OR,         // cmd && cmd || cmd
+    AST_LIST,           // cmd ; cmd & cmd (sequence)
+    AST_IF,             // if/elif/else/fi (elif is a nested AST_IF in else_part)
+    AST_FOR,            // for name [in words]; do body; done
+    AST_WHILE,          // while/until cond; do body; done
+    AST_CASE,           // case word in pattern) body ;; esac
+    AST_BRACE,          // { list; }
+    AST_SUBSHELL,       // ( list )
+    AST_FUNCDEF         // name() compound-command
+} AstNodeType;
+
+typedef enum {
+    AST_OP_AND,         // &&
+    AST_OP_OR           // ||
+} AstAndOrOp;
+
+struct AstNode;
+
+// Tokens produced once by parse_line() and copied into scratch space for
+// each execution, since execute() rewrites its arguments in place
+typedef struct {
+    ParseResult parsed;
+    size_t len;             // Bytes of parsed.buffer in use
+    int argc;
+    char *scratch;          // Argument vector followed by buffer copy
+    bool busy;              // Scratch space in use (recursive execution)
+} AstArgs;
+
+// A single "pattern|pattern) body ;;" item of a case statement
+typedef struct {
+    char **patterns;        // Raw pattern words (expanded at run time)
+    int pattern_count;
+    struct AstNode *body;   // May be NULL for an empty item
+    bool fallthrough;       // Item ended with ;& instead of ;;
+} AstCaseItem;
+
+typedef struct AstNode {
+    AstNodeType type;
+    bool negate;            // Preceded by ! (pipeline negation)
+    bool background;        // Followed by & in a list
+    char *text;             // Source text of a background command (job table)
+
+    // AST_SIMPLE: command words; AST_FOR: the word list after "in"
+    AstArgs args;
+
+    // Redirections attached to a compound command, e.g. "done < file"
+    AstArgs redirects;
+    bool has_redirects;
+    char *heredoc;          // Here-document body for << on this command
+    int heredoc_quoted;     // Delimiter was quoted (no expansion)
+
+    // AST_PIPELINE, AST_AND_OR, AST_LIST
+    struct AstNode **children;
+    AstAndOrOp *ops;        // AST_AND_OR: ops[i] joins children[i] and children[i + 1]
+    int child_count;
+
+    // AST_IF, AST_WHILE
+    struct AstNode *cond;
+    struct AstNode *body;   // Also AST_FOR, AST_BRACE, AST_SUBSHELL, AST_FUNCDEF
+    struct AstNode *else_part;
+    bool until;             // AST_WHILE: loop while condition fails
+
+    // AST_FOR
+    char *var;
+    bool has_words;         // false when "in" was omitted (iterate "$@")
+
+    // AST_CASE
+    char *word;
+    AstCaseItem *items;
+    int item_count;
+
+    // AST_FUNCDEF
+    char *name;
+    char *func_body;        // Body text stored in the function table
+} AstNode;
+
+typedef enum {
+    AST_PARSE_OK,           // A complete command was parsed (node may be NULL)
+    AST_PARSE_INCOMPLETE,   // More input is needed to finish the command
+    AST_PARSE_ERROR         // Syntax error (already reported)
+} AstParseStatus;
+
+/**
+ * Parse the next complete command from a script buffer
+ * Blank lines and comments before the command are consumed. A command
+ * ends at an unquoted newline outside any compound command; here-document
+ * bodies following that newline are consumed too.
+ *
+ * @param src Script text
+ * @param len Length of src
+ * @param pos In/out: offset to start at; advanced past the command on
+ *            success or past the offending line on a syntax error
+ * @param at_eof true if no more text will be appended to src
+ * @param out Receives the parsed node, or NULL if only blank lines were read
+ * @return Parse status; INCOMPLETE leaves *pos unchanged
+ */
+AstParseStatus ast_parse_next(const char *src, size_t len, size_t *pos, bool at_eof, AstNode **out);
+
+/**
+ * Parse a complete script into a single tree
+ * Used for text that is compiled once and run many times (function bodies).
+ *
+ * @param src Script text
+ * @param len Length of src
+ * @param out Receives the tree, or NULL if src has no commands
+ * @return AST_PARSE_OK, or the status of the first command that failed
+ */
+AstParseStatus ast_parse_program(const char *src, size_t len, AstNode **out);
+
+/**
+ * Execute a parsed command
+ *
+ * @param node Node to execute
+ * @param last true if nothing runs after this command in the current
+ *             process, allowing a command substitution child to exec the
+ *             final external command directly
+ * @return 1 to continue, 0 to exit, -2 return, -3 break, -4 continue
+ */
+int ast_execute(AstNode *node, bool last);
+
+/**
+ * Check whether a tree can run inside the shell process
+ * True when every command is an assignment, an output-only builtin (echo,
+ * test, true, ...) or a call to a function whose body qualifies in turn.
+ * Such a tree touches no shell state other than variables, so command
+ * substitution can run it without forking.
+ *
+ * @param node Tree to check (NULL is allowed)
+ * @return true if no child process is needed
+ */
+bool ast_can_run_in_process(const AstNode *node);
+
+/**
+ * Free a node and all of its children
+ *
+ * @param node Node to free (NULL is allowed)
+ */
+void ast_free(AstNode *node);
+
+#endif // AST_H
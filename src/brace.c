@@ -0,0 +1,325 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "brace.h"
+#include "cmdsub.h"
+#include "hash.h"
+
+// Longest number a sequence produces, with its sign
+#define SEQUENCE_NUMBER_MAX 21
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+// Skip a quoted byte, ${...}, $(...) or `...` starting at p
+// Returns p itself if none starts there
+static const char *skip_quoted(const char *p, const char *end) {
+    if (*p == '\x01' && p + 1 < end) return p + 2;
+    if (*p == '$' && p + 1 < end && p[1] == '{') {
+        int depth = 0;
+        for (const char *q = p + 1; q < end; q++) {
+            if (*q == '\x01' && q + 1 < end) {
+                q++;
+            } else if (*q == '{') {
+                depth++;
+            } else if (*q == '}' && --depth == 0) {
+                return q + 1;
+            }
+        }
+        return end;
+    }
+    if ((*p == '$' && p + 1 < end && p[1] == '(') || *p == '`') {
+        bool backtick = *p == '`';
+        const char *close = cmdsub_find_end(p + (backtick ? 1 : 2), backtick);
+        return (close && close < end) ? close + 1 : end;
+    }
+    return p;
+}
+
+// Find the } closing the { at open, noting whether a comma separates
+// alternatives at its top level
+static const char *match_brace(const char *open, const char *end, bool *comma) {
+    int depth = 0;
+    *comma = false;
+    const char *p = open;
+    while (p < end) {
+        const char *q = skip_quoted(p, end);
+        if (q != p) {
+            p = q;
+            continue;
+        }
+        if (*p == '{') {
+            depth++;
+        } else if (*p == '}' && --depth == 0) {
+            return p;
+        } else if (*p == ',' && depth == 1) {
+            *comma = true;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+// Parse an integer bound or step of a sequence; the whole text must be used
+static bool parse_number(const char *s, size_t len, long long *value) {
+    if (len == 0 || len >= 32) return false;
+    char buf[32];
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+
+    const char *digits = buf + (buf[0] == '-' || buf[0] == '+');
+    if (!*digits) return false;
+    for (const char *d = digits; *d; d++) {
+        if (!isdigit((unsigned char)*d)) return false;
+    }
+
+    char *endp;
+    errno = 0;
+    *value = strtoll(buf, &endp, 10);
+    return errno == 0 && *endp == '\0';
+}
+
+// Width of a zero-padded bound (01, -007), or 0
+static int padded_width(const char *s, size_t len) {
+    size_t sign = (len > 0 && s[0] == '-');
+    return (len > sign + 1 && s[sign] == '0') ? (int)len : 0;
+}
+
+// Parse x..y or x..y..step between a pair of braces
+static bool parse_sequence(const char *s, const char *end, BraceSequence *seq) {
+    const char *dots = NULL;
+    for (const char *p = s; p + 1 < end; p++) {
+        if (p[0] == '.' && p[1] == '.') {
+            dots = p;
+            break;
+        }
+    }
+    if (!dots) return false;
+
+    const char *rhs = dots + 2;
+    const char *rhs_end = end;
+    const char *step_text = NULL;
+    for (const char *p = rhs; p + 1 < end; p++) {
+        if (p[0] == '.' && p[1] == '.') {
+            rhs_end = p;
+            step_text = p + 2;
+            break;
+        }
+    }
+
+    size_t lhs_len = (size_t)(dots - s);
+    size_t rhs_len = (size_t)(rhs_end - rhs);
+    long long first, last;
+    seq->chars = false;
+    seq->width = 0;
+    if (parse_number(s, lhs_len, &first) && parse_number(rhs, rhs_len, &last)) {
+        int lhs_width = padded_width(s, lhs_len);
+        int rhs_width = padded_width(rhs, rhs_len);
+        if (lhs_width || rhs_width) {
+            seq->width = (int)(lhs_len > rhs_len ? lhs_len : rhs_len);
+        }
+    } else if (lhs_len == 1 && rhs_len == 1 && !isdigit((unsigned char)*s) &&
+               !isdigit((unsigned char)*rhs) && (unsigned char)*s > 0x04 &&
+               (unsigned char)*rhs > 0x04) {
+        seq->chars = true;
+        first = (unsigned char)*s;
+        last = (unsigned char)*rhs;
+    } else {
+        return false;
+    }
+
+    // The step's sign is ignored: the sequence always runs from x to y
+    unsigned long long step = 1;
+    if (step_text) {
+        long long value;
+        if (!parse_number(step_text, (size_t)(end - step_text), &value)) return false;
+        step = value < 0 ? -(unsigned long long)value : (unsigned long long)value;
+        if (step == 0) step = 1;
+    }
+
+    unsigned long long span = first <= last ? (unsigned long long)last - (unsigned long long)first
+                                            : (unsigned long long)first - (unsigned long long)last;
+    seq->next = first;
+    seq->left = span / step + 1;
+    seq->step = first <= last ? (long long)step : -(long long)step;
+    return true;
+}
+
+// Write the current value of a sequence and step past it
+// Characters other than letters and digits are marked literal when mark is set
+static size_t sequence_format(BraceSequence *seq, char *buf, bool mark) {
+    size_t n = 0;
+    if (seq->chars) {
+        if (mark && !isalnum((unsigned char)seq->next)) buf[n++] = '\x01';
+        buf[n++] = (char)seq->next;
+    } else if (seq->width) {
+        n = (size_t)sprintf(buf, "%0*lld", seq->width, seq->next);
+    } else {
+        n = (size_t)sprintf(buf, "%lld", seq->next);
+    }
+
+    // The last value may sit at the edge of the range; don't step past it
+    if (--seq->left > 0) seq->next += seq->step;
+    return n;
+}
+
+// Find the first brace expression in [s, end)
+static bool find_expression(const char *s, const char *end, const char **open,
+                            const char **close, bool *list) {
+    const char *p = s;
+    while (p < end) {
+        const char *q = skip_quoted(p, end);
+        if (q != p) {
+            p = q;
+            continue;
+        }
+        if (*p == '{') {
+            bool comma;
+            const char *c = match_brace(p, end, &comma);
+            BraceSequence seq;
+            if (c && (comma || parse_sequence(p + 1, c, &seq))) {
+                *open = p;
+                *close = c;
+                *list = comma;
+                return true;
+            }
+        }
+        p++;
+    }
+    return false;
+}
+
+static void push_copy(FieldList *out, const char *s, size_t len) {
+    char *copy = xrealloc(NULL, len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    fieldlist_push(out, copy, 0);
+}
+
+// Expand [s, end) into out
+static void expand_range(const char *s, const char *end, FieldList *out) {
+    const char *open, *close;
+    bool list;
+    if (!find_expression(s, end, &open, &close, &list)) {
+        push_copy(out, s, (size_t)(end - s));
+        return;
+    }
+
+    // Each alternative is expanded on its own, then joined with every
+    // expansion of the rest of the word
+    FieldList alternatives;
+    fieldlist_init(&alternatives);
+    if (list) {
+        const char *start = open + 1;
+        const char *p = start;
+        int depth = 0;
+        while (p < close) {
+            const char *q = skip_quoted(p, close);
+            if (q != p) {
+                p = q;
+                continue;
+            }
+            if (*p == '{') {
+                depth++;
+            } else if (*p == '}') {
+                depth--;
+            } else if (*p == ',' && depth == 0) {
+                expand_range(start, p, &alternatives);
+                start = p + 1;
+            }
+            p++;
+        }
+        expand_range(start, close, &alternatives);
+    } else {
+        BraceSequence seq;
+        parse_sequence(open + 1, close, &seq);
+        char buf[SEQUENCE_NUMBER_MAX + 2];
+        while (seq.left > 0) {
+            if (seq.width > SEQUENCE_NUMBER_MAX) {
+                // Padding wider than any number; format on the heap
+                char *wide = xrealloc(NULL, (size_t)seq.width + 1);
+                size_t n = sequence_format(&seq, wide, true);
+                wide[n] = '\0';
+                fieldlist_push(&alternatives, wide, 0);
+            } else {
+                push_copy(&alternatives, buf, sequence_format(&seq, buf, true));
+            }
+        }
+    }
+
+    FieldList rest;
+    fieldlist_init(&rest);
+    expand_range(close + 1, end, &rest);
+
+    size_t prefix_len = (size_t)(open - s);
+    for (int i = 0; i < alternatives.count; i++) {
+        size_t alt_len = strlen(alternatives.fields[i]);
+        for (int j = 0; j < rest.count; j++) {
+            size_t rest_len = strlen(rest.fields[j]);
+            char *word = xrealloc(NULL, prefix_len + alt_len + rest_len + 1);
+            memcpy(word, s, prefix_len);
+            memcpy(word + prefix_len, alternatives.fields[i], alt_len);
+            memcpy(word + prefix_len + alt_len, rest.fields[j], rest_len + 1);
+            fieldlist_push(out, word, 0);
+        }
+    }
+    fieldlist_free(&alternatives);
+    fieldlist_free(&rest);
+}
+
+bool brace_expand(const char *word, FieldList *out) {
+    const char *end = word + strlen(word);
+    const char *open, *close;
+    bool list;
+    if (!find_expression(word, end, &open, &close, &list)) return false;
+
+    expand_range(word, end, out);
+    return true;
+}
+
+bool brace_sequence_init(const char *word, BraceSequence *seq) {
+    const char *end = word + strlen(word);
+    const char *open, *close;
+    bool list;
+    if (!find_expression(word, end, &open, &close, &list) || list) return false;
+
+    // The text around it must come out of word expansion unchanged
+    const char *plain = "\x01\x02$`~\\*?[{";
+    for (const char *p = word; p < end; p++) {
+        if (p == open) p = close;
+        else if (strchr(plain, *p)) return false;
+    }
+
+    parse_sequence(open + 1, close, seq);
+    seq->prefix_len = (size_t)(open - word);
+    seq->suffix = close + 1;
+    seq->suffix_len = (size_t)(end - seq->suffix);
+
+    size_t value_max = seq->width > SEQUENCE_NUMBER_MAX ? (size_t)seq->width : SEQUENCE_NUMBER_MAX;
+    seq->text = xrealloc(NULL, seq->prefix_len + value_max + seq->suffix_len + 1);
+    memcpy(seq->text, word, seq->prefix_len);
+    return true;
+}
+
+const char *brace_sequence_next(BraceSequence *seq) {
+    if (seq->left == 0) return NULL;
+
+    char *value = seq->text + seq->prefix_len;
+    size_t n = sequence_format(seq, value, false);
+    memcpy(value + n, seq->suffix, seq->suffix_len);
+    value[n + seq->suffix_len] = '\0';
+    return seq->text;
+}
+
+void brace_sequence_free(BraceSequence *seq) {
+    free(seq->text);
+    seq->text = NULL;
+}
@@ -0,0 +1,73 @@
+#ifndef BRACE_H
+#define BRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "wordexpand.h"
+
+// ============================================================================
+// BRACE EXPANSION
+// ============================================================================
+//
+// Expands {a,b,c} lists and {x..y[..step]} sequences in a parser token into
+// several tokens, before any other expansion. The results still carry the
+// parser's quoting markers and go through word expansion one by one, so
+// `src/{a,b}/*.c` globs each directory. Quoted or escaped braces and commas
+// reach this stage behind a \x01 marker and are taken literally, and the
+// braces of ${...} are skipped.
+//
+// A for loop over a word that is a single sequence with plain text around
+// it (`for i in {1..1000000}`) does not expand it up front: the sequence is
+// stepped as the loop runs, one value at a time.
+//
+// ============================================================================
+
+// A {x..y[..step]} sequence between literal text, generated one word at a time
+typedef struct {
+    long long next;         // Value of the next word
+    long long step;         // Signed distance between values
+    unsigned long long left;// Words still to generate
+    bool chars;             // {a..z}: values are characters, not numbers
+    int width;              // Zero padding of numbers ({01..10})
+    char *text;             // Prefix, value and suffix of the current word
+    size_t prefix_len;
+    const char *suffix;     // Points into the word the sequence came from
+    size_t suffix_len;
+} BraceSequence;
+
+/**
+ * Expand the brace expressions of a parser token
+ * Expressions are expanded left to right; one nested inside another or
+ * following it multiplies the words, as in bash.
+ *
+ * @param word Parser token
+ * @param out List the resulting tokens are appended to
+ * @return true if word had a brace expression; nothing is appended otherwise
+ */
+bool brace_expand(const char *word, FieldList *out);
+
+/**
+ * Recognize a word that is one sequence between text needing no expansion
+ *
+ * @param word Parser token (must outlive the sequence)
+ * @param seq Receives the sequence positioned at its first word
+ * @return true if word is such a sequence; free it with brace_sequence_free
+ */
+bool brace_sequence_init(const char *word, BraceSequence *seq);
+
+/**
+ * Generate the next word of a sequence
+ *
+ * @param seq Sequence from brace_sequence_init
+ * @return The word, valid until the next call, or NULL when done
+ */
+const char *brace_sequence_next(BraceSequence *seq);
+
+/**
+ * Release a sequence
+ *
+ * @param seq Sequence from brace_sequence_init
+ */
+void brace_sequence_free(BraceSequence *seq);
+
+#endif // BRACE_H
@@ -32,6 +32,7 @@
 #include "shellvar.h"
 #include "trap.h"
 #include "utils.h"
+#include "pathindex.h"
 
 extern int last_command_exit_code;
 
@@ -80,6 +81,8 @@ Builtin builtins[BUILTIN_FUNC_MAX] = {
     [BUILTIN_FUNC_WAIT]             = (Builtin){"wait",         &shell_wait},
     [BUILTIN_FUNC_KILL]             = (Builtin){"kill",         &shell_kill},
     [BUILTIN_FUNC_HASH]             = (Builtin){"hash",         &shell_hash},
+    [BUILTIN_FUNC_DECLARE]          = (Builtin){"declare",      &shell_declare},
+    [BUILTIN_FUNC_TYPESET]          = (Builtin){"typeset",      &shell_declare},        // Alias for declare
 };
 
 // Parse job ID from argument (handles %n, %%, %+, %-, n)
@@ -113,7 +116,7 @@ int shell_cd(char **args) {
 
     // Handle cd - (go to previous directory)
     if (path != NULL && strcmp(path, "-") == 0) {
-        path = getenv("OLDPWD");
+        path = shellvar_get("OLDPWD");
         if (!path) {
             color_error("%s: cd: OLDPWD not set", HASH_NAME);
             last_command_exit_code = 1;
@@ -124,7 +127,7 @@ int shell_cd(char **args) {
     }
 
     if (path == NULL) {
-        path = getenv("HOME");
+        path = shellvar_get("HOME");
 
         if (!path) {
             struct passwd pw;
@@ -144,7 +147,8 @@ int shell_cd(char **args) {
     // Save current directory as OLDPWD before changing
     char oldpwd[PATH_MAX];
     if (getcwd(oldpwd, sizeof(oldpwd)) != NULL) {
-        setenv("OLDPWD", oldpwd, 1);
+        shellvar_set("OLDPWD", oldpwd);
+        shellvar_set_export("OLDPWD");
     }
 
     if (chdir(path) != 0) {
@@ -154,7 +158,8 @@ int shell_cd(char **args) {
         // Update PWD after successful change
         char newpwd[PATH_MAX];
         if (getcwd(newpwd, sizeof(newpwd)) != NULL) {
-            setenv("PWD", newpwd, 1);
+            shellvar_set("PWD", newpwd);
+            shellvar_set_export("PWD");
         }
         last_command_exit_code = 0;
     }
@@ -366,7 +371,6 @@ int shell_export(char **args) {
         // Set and export the variable
         if (shellvar_set(name, value) == 0) {
             shellvar_set_export(name);
-            setenv(name, value, 1);
             last_command_exit_code = 0;
         } else {
             last_command_exit_code = 1;
@@ -460,6 +464,14 @@ static bool handle_posix_shell_options(char **args, int *i) {
             shell_option_set_nonlexicalctrl(true);
         } else if (strcmp(opt, "nolog") == 0) {
             shell_option_set_nolog(true);
+        } else if (strcmp(opt, "spawn") == 0) {
+            shell_option_set_spawn(true);
+        } else if (strcmp(opt, "globstar") == 0) {
+            shell_option_set_globstar(true);
+        } else if (strcmp(opt, "lastpipe") == 0) {
+            shell_option_set_lastpipe(true);
+        } else if (strcmp(opt, "pipefail") == 0) {
+            shell_option_set_pipefail(true);
         } else {
             // POSIX: unknown option is an error
             color_error("%s: set: %s: invalid option name", HASH_NAME, opt);
@@ -481,6 +493,14 @@ static bool handle_posix_shell_options(char **args, int *i) {
             shell_option_set_nonlexicalctrl(false);
         } else if (strcmp(opt, "nolog") == 0) {
             shell_option_set_nolog(false);
+        } else if (strcmp(opt, "spawn") == 0) {
+            shell_option_set_spawn(false);
+        } else if (strcmp(opt, "globstar") == 0) {
+            shell_option_set_globstar(false);
+        } else if (strcmp(opt, "lastpipe") == 0) {
+            shell_option_set_lastpipe(false);
+        } else if (strcmp(opt, "pipefail") == 0) {
+            shell_option_set_pipefail(false);
         } else {
             // POSIX: unknown option is an error
             color_error("%s: set: %s: invalid option name", HASH_NAME, opt);
@@ -728,8 +748,22 @@ int shell_unset(char **args) {
     int error = 0;
     for (int i = start; args[i] != NULL; i++) {
         if (unset_var) {
+            // unset 'name[subscript]' removes one element of an array
+            int rc;
+            char *bracket = strchr(args[i], '[');
+            size_t len = strlen(args[i]);
+            if (bracket && bracket > args[i] && args[i][len - 1] == ']') {
+                *bracket = '\0';
+                args[i][len - 1] = '\0';
+                rc = shellvar_array_unset(args[i], bracket + 1);
+                *bracket = '[';
+                args[i][len - 1] = ']';
+            } else {
+                rc = shellvar_unset(args[i]);
+            }
+
             // Check for readonly variable
-            if (shellvar_unset(args[i]) != 0) {
+            if (rc != 0) {
                 // shellvar_unset prints error for readonly
                 error = 1;
                 // In non-interactive mode, exit shell per POSIX
@@ -854,9 +888,12 @@ int shell_read(char **args) {
         start++;
     }
 
-    // Read a line from stdin
-    char line[4096];
-    if (fgets(line, sizeof(line), stdin) == NULL) {
+    // Read a line from fd 0 without buffering past it, so the rest of the
+    // input stays available to the shell and to later commands
+    char *line = NULL;
+    size_t line_cap = 0;
+    if (fd_read_line(STDIN_FILENO, &line, &line_cap) <= 0) {
+        free(line);
         last_command_exit_code = 1;
         return 1;
     }
@@ -869,7 +906,8 @@ int shell_read(char **args) {
 
     // If no variables specified, use REPLY
     if (args[start] == NULL) {
-        setenv("REPLY", line, 1);
+        shellvar_set("REPLY", line);
+        free(line);
         last_command_exit_code = 0;
         return 1;
     }
@@ -892,12 +930,12 @@ int shell_read(char **args) {
                     safe_strcat(rest, " ", sizeof(rest));
                     safe_strcat(rest, remaining, sizeof(rest));
                 }
-                setenv(args[i], rest, 1);
+                shellvar_set(args[i], rest);
             } else {
-                setenv(args[i], "", 1);
+                shellvar_set(args[i], "");
             }
         } else {
-            setenv(args[i], word ? word : "", 1);
+            shellvar_set(args[i], word ? word : "");
             if (word) {
                 // TODO: Use the IFS
                 word = strtok_r(NULL, " \t", &saveptr);
@@ -908,6 +946,7 @@ int shell_read(char **args) {
 
     (void)raw;  // TODO: Handle -r flag for backslash escapes
 
+    free(line);
     last_command_exit_code = 0;
     return 1;
 }
@@ -1118,30 +1157,7 @@ char *find_in_path(const char *cmd) {
         return NULL;
     }
 
-    const char *path_env = getenv("PATH");
-    if (!path_env) {
-        path_env = "/usr/bin:/bin";
-    }
-
-    char *path_copy = strdup(path_env);
-    if (!path_copy) return NULL;
-
-    char *saveptr;
-    char *dir = strtok_r(path_copy, ":", &saveptr);
-
-    while (dir) {
-        char fullpath[4096];
-        snprintf(fullpath, sizeof(fullpath), "%s/%s", dir, cmd);
-
-        if (access(fullpath, X_OK) == 0) {
-            free(path_copy);
-            return strdup(fullpath);
-        }
-        dir = strtok_r(NULL, ":", &saveptr);
-    }
-
-    free(path_copy);
-    return NULL;
+    return pathindex_find(cmd);
 }
 
 static bool find_command(const char *cmd, bool verbose) {
@@ -1440,6 +1456,7 @@ int shell_exec(char **args) {
                 // Flush all output buffers before replacing the process
                 fflush(stdout);
                 fflush(stderr);
+                shellvar_environ();  // execvp passes environ
                 execvp(args[i], args + i);
                 // If we get here, exec failed
                 fprintf(stderr, "%s: %s: %s\n", HASH_NAME, args[i], strerror(errno));
@@ -1587,9 +1604,6 @@ int shell_readonly(char **args) {
             // Then mark as readonly
             shellvar_set_readonly(name);
 
-            // Also set in environment
-            setenv(name, value, 1);
-
             *equals = '=';
         } else {
             // readonly name: just mark as readonly
@@ -1601,6 +1615,102 @@ int shell_readonly(char **args) {
     return 1;
 }
 
+int shell_declare(char **args) {
+    int set_attrs = 0;
+    int clear_attrs = 0;
+    bool print = false;
+
+    // Parse options; -a, -A, -i, -r and -x set attributes, +i and +x remove them
+    int start = 1;
+    while (args[start] && (args[start][0] == '-' || args[start][0] == '+') && args[start][1]) {
+        if (strcmp(args[start], "--") == 0) {
+            start++;
+            break;
+        }
+        bool add = args[start][0] == '-';
+        for (const char *opt = args[start] + 1; *opt; opt++) {
+            int attr = 0;
+            switch (*opt) {
+                case 'a': attr = VAR_ATTR_ARRAY; break;
+                case 'A': attr = VAR_ATTR_ASSOC; break;
+                case 'i': attr = VAR_ATTR_INTEGER; break;
+                case 'r': attr = VAR_ATTR_READONLY; break;
+                case 'x': attr = VAR_ATTR_EXPORT; break;
+                case 'p': print = true; break;
+                default:
+                    fprintf(stderr, "%s: %s: %c%c: invalid option\n", HASH_NAME, args[0], args[start][0], *opt);
+                    last_command_exit_code = 2;
+                    return 1;
+            }
+            if (add) {
+                set_attrs |= attr;
+            } else if (attr == VAR_ATTR_READONLY) {
+                fprintf(stderr, "%s: %s: +r: cannot remove readonly attribute\n", HASH_NAME, args[0]);
+                last_command_exit_code = 1;
+                return 1;
+            } else if (attr & (VAR_ATTR_ARRAY | VAR_ATTR_ASSOC)) {
+                fprintf(stderr, "%s: %s: +%c: cannot destroy array variables in this way\n", HASH_NAME, args[0], *opt);
+                last_command_exit_code = 1;
+                return 1;
+            } else {
+                clear_attrs |= attr;
+            }
+        }
+        start++;
+    }
+
+    // No names: list variables
+    if (args[start] == NULL) {
+        if (print || set_attrs) {
+            shellvar_list_declare(set_attrs);
+        } else {
+            shellvar_list_all();
+        }
+        last_command_exit_code = 0;
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = start; args[i] != NULL; i++) {
+        char *equals = strchr(args[i], '=');
+
+        if (print && !equals) {
+            if (shellvar_print_declare(args[i]) != 0) {
+                fprintf(stderr, "%s: %s: %s: not found\n", HASH_NAME, args[0], args[i]);
+                status = 1;
+            }
+            continue;
+        }
+
+        if (equals) *equals = '\0';
+        const char *name = args[i];
+
+        if ((set_attrs & (VAR_ATTR_ARRAY | VAR_ATTR_ASSOC)) &&
+            shellvar_declare_array(name, (set_attrs & VAR_ATTR_ASSOC) != 0) != 0) {
+            status = 1;
+            if (equals) *equals = '=';
+            continue;
+        }
+
+        // The integer attribute applies to the value assigned here
+        if (clear_attrs & VAR_ATTR_INTEGER) shellvar_clear_integer(name);
+        if (set_attrs & VAR_ATTR_INTEGER) shellvar_set_integer(name);
+
+        if (equals && shellvar_set(name, equals + 1) != 0) {
+            status = 1;
+        } else {
+            if (set_attrs & VAR_ATTR_EXPORT) shellvar_set_export(name);
+            if (clear_attrs & VAR_ATTR_EXPORT) shellvar_clear_export(name);
+            if (set_attrs & VAR_ATTR_READONLY) shellvar_set_readonly(name);
+        }
+
+        if (equals) *equals = '=';  // Restore
+    }
+
+    last_command_exit_code = status;
+    return 1;
+}
+
 int shell_trap(char **args) {
     // trap with no args: list all traps
     if (args[1] == NULL) {
@@ -2012,6 +2122,17 @@ typedef struct CmdHashEntry {
 
 static CmdHashEntry *cmd_hash_table[CMD_HASH_SIZE];
 
+// PATH the table was filled under (NULL while the table is empty)
+static char *cmd_hash_path = NULL;
+
+// Check whether the remembered paths are valid for the current PATH
+// A different PATH (e.g. a PATH=... prefix assignment) bypasses the table
+static bool cmd_hash_path_matches(void) {
+    const char *path_env = shellvar_get("PATH");
+    if (!cmd_hash_path) return true;
+    return strcmp(cmd_hash_path, path_env ? path_env : "") == 0;
+}
+
 // Simple hash function for command names
 static unsigned int cmd_hash_func(const char *s) {
     unsigned int hash = 0;
@@ -2023,6 +2144,13 @@ static unsigned int cmd_hash_func(const char *s) {
 
 // Add a command to the hash table
 void cmd_hash_add(const char *name, const char *path) {
+    if (!cmd_hash_path_matches()) return;
+    if (!cmd_hash_path) {
+        const char *path_env = shellvar_get("PATH");
+        cmd_hash_path = strdup(path_env ? path_env : "");
+        if (!cmd_hash_path) return;
+    }
+
     unsigned int h = cmd_hash_func(name);
 
     // Check if already exists
@@ -2051,8 +2179,35 @@ void cmd_hash_add(const char *name, const char *path) {
     }
 }
 
+// Look up a remembered command path
+const char *cmd_hash_lookup(const char *name) {
+    if (!cmd_hash_path || !cmd_hash_path_matches()) return NULL;
+
+    CmdHashEntry *e = cmd_hash_table[cmd_hash_func(name)];
+    while (e) {
+        if (strcmp(e->name, name) == 0) {
+            e->hits++;
+            return e->path;
+        }
+        e = e->next;
+    }
+    return NULL;
+}
+
+// Resolve a command name to a path, searching PATH only on a table miss
+char *cmd_hash_find(const char *name) {
+    if (strchr(name, '/') != NULL) return NULL;
+
+    const char *cached = cmd_hash_lookup(name);
+    if (cached) return strdup(cached);
+
+    char *path = find_in_path(name);
+    if (path) cmd_hash_add(name, path);
+    return path;
+}
+
 // Clear all entries from hash table
-static void cmd_hash_clear(void) {
+void cmd_hash_clear(void) {
     for (int i = 0; i < CMD_HASH_SIZE; i++) {
         CmdHashEntry *e = cmd_hash_table[i];
         while (e) {
@@ -2064,6 +2219,8 @@ static void cmd_hash_clear(void) {
         }
         cmd_hash_table[i] = NULL;
     }
+    free(cmd_hash_path);
+    cmd_hash_path = NULL;
 }
 
 // List all hashed commands
@@ -40,6 +40,8 @@ typedef enum {
     BUILTIN_FUNC_WAIT,
     BUILTIN_FUNC_KILL,
     BUILTIN_FUNC_HASH,
+    BUILTIN_FUNC_DECLARE,
+    BUILTIN_FUNC_TYPESET,
 
     BUILTIN_FUNC_MAX
 } BuiltinFunc;
@@ -330,6 +332,17 @@ int shell_type(char **args);
  */
 int shell_readonly(char **args);
 
+/**
+ * Built-in command: declare/typeset - set variable attributes and values
+ * -i gives the integer attribute, so assignments are evaluated as
+ * arithmetic and the value is stored natively
+ *
+ * @param args Arguments for the command
+ *
+ * @return
+ */
+int shell_declare(char **args);
+
 /**
  * Built-in command: trap - set signal handlers
  *
@@ -374,6 +387,31 @@ int shell_hash(char **args);
  */
 void cmd_hash_add(const char *name, const char *path);
 
+/**
+ * Look up a remembered command path
+ * Entries are only used while PATH matches the value they were found under
+ *
+ * @param name Name of the command
+ *
+ * @return Returns the remembered path, or NULL if none
+ */
+const char *cmd_hash_lookup(const char *name);
+
+/**
+ * Resolve a command name through the hash table, searching PATH and
+ * remembering the result on a miss
+ *
+ * @param name Name of the command (names containing '/' are not looked up)
+ *
+ * @return Returns full path (caller must free) or NULL if not found
+ */
+char *cmd_hash_find(const char *name);
+
+/**
+ * Forget all remembered command paths (hash -r, PATH assignment)
+ */
+void cmd_hash_clear(void);
+
 /**
  * Find command in PATH and return full path (caller must free)
  *
@@ -18,6 +18,7 @@
 #include "trap.h"
 #include "config.h"
 #include "utils.h"
+#include "arena.h"
 
 #define INITIAL_CHAIN_CAPACITY 8
 
@@ -457,7 +458,7 @@ static int execute_background(const char *cmd_line) {
 }
 
 // Execute a command chain
-int chain_execute(const CommandChain *chain) {
+static int chain_execute_commands(const CommandChain *chain) {
     if (!chain || chain->count == 0) return 1;
 
     int last_exit_code = 0;
@@ -765,3 +766,11 @@ handle_pipeline:;
 
     return shell_continue;
 }
+
+int chain_execute(const CommandChain *chain) {
+    // Temporaries of the whole chain are dropped together when it finishes
+    ArenaMark mark = arena_mark();
+    int result = chain_execute_commands(chain);
+    arena_release(mark);
+    return result;
+}
@@ -15,10 +15,18 @@
 #include "trap.h"
 #include "hash.h"
 #include "utils.h"
+#include "ast.h"
+#include "config.h"
+#include "shellvar.h"
+#include "arena.h"
+#include "fileglob.h"
+#include "pipeline.h"
 
 #define INITIAL_BUF_SIZE 65536
 
-// Dynamic buffer for building command substitution results
+extern int last_command_exit_code;
+
+// Dynamic buffer for building command substitution results (in the command arena)
 typedef struct {
     char *data;
     size_t len;
@@ -34,11 +42,7 @@ static int cmdsub_buf_ensure(CmdSubBuf *buf, size_t additional) {
     while (new_cap <= needed) {
         new_cap *= 2;
     }
-    char *new_data = realloc(buf->data, new_cap);
-    if (!new_data) {
-        return -1;
-    }
-    buf->data = new_data;
+    buf->data = arena_realloc(buf->data, buf->cap, new_cap);
     buf->cap = new_cap;
     return 0;
 }
@@ -72,7 +76,27 @@ void cmdsub_reset_exit_code(void) {
     last_cmdsub_exit_code = 0;
 }
 
+// Parsed bodies of recent substitutions, so $(...) in a loop is parsed once
+#define CAPTURE_CACHE_SIZE 32
+
+typedef struct {
+    char *text;
+    AstNode *tree;
+} CaptureCacheEntry;
+
+static CaptureCacheEntry capture_cache[CAPTURE_CACHE_SIZE];
+
+// The shell's real stdout while output is captured in-process
+static FILE *capture_real_stdout = NULL;
+
 static void child_process(const char *cmd, const int pipefd[2]) {
+    // A substitution nested in an in-process capture must not write into
+    // the parent's capture buffer
+    if (capture_real_stdout) {
+        stdout = capture_real_stdout;
+        capture_real_stdout = NULL;
+    }
+
     close(pipefd[0]);
     dup2(pipefd[1], STDOUT_FILENO);
     close(pipefd[1]);
@@ -105,37 +129,30 @@ static void child_process(const char *cmd, const int pipefd[2]) {
 static char *get_child_output(pid_t pid, const int pipefd[2]) {
     close(pipefd[1]);
 
+    // Read into the command arena; only the trimmed output goes to the heap
+    ArenaMark mark = arena_mark();
     size_t buf_size = INITIAL_BUF_SIZE;
-    char *output = malloc(buf_size);
-    if (!output) {
-        close(pipefd[0]);
-        waitpid(pid, NULL, 0);
-        return NULL;
-    }
+    char *buffer = arena_alloc(buf_size);
 
     size_t total_read = 0;
     ssize_t bytes_read;
 
-    while ((bytes_read = read(pipefd[0], output + total_read,
+    while ((bytes_read = read(pipefd[0], buffer + total_read,
                               buf_size - total_read - 1)) > 0) {
         total_read += bytes_read;
         if (total_read >= buf_size - 1) {
-            size_t new_size = buf_size * 2;
-            char *new_output = realloc(output, new_size);
-            if (!new_output) {
-                break;
-            }
-            output = new_output;
-            buf_size = new_size;
+            buffer = arena_realloc(buffer, buf_size, buf_size * 2);
+            buf_size *= 2;
         }
     }
 
     close(pipefd[0]);
-    output[total_read] = '\0';
 
     // Wait for child and capture exit status
     int status;
     waitpid(pid, &status, 0);
+    // The command may have changed directories that later patterns read
+    fileglob_cache_recheck();
     if (WIFEXITED(status)) {
         last_cmdsub_exit_code = WEXITSTATUS(status);
     } else if (WIFSIGNALED(status)) {
@@ -145,10 +162,130 @@ static char *get_child_output(pid_t pid, const int pipefd[2]) {
     }
 
     // Remove trailing newlines (like bash does)
-    while (total_read > 0 && output[total_read - 1] == '\n') {
-        output[--total_read] = '\0';
+    while (total_read > 0 && buffer[total_read - 1] == '\n') {
+        total_read--;
+    }
+
+    char *output = malloc(total_read + 1);
+    if (output) {
+        memcpy(output, buffer, total_read);
+        output[total_read] = '\0';
+    }
+    arena_release(mark);
+    return output;
+}
+
+static size_t capture_cache_slot(const char *cmd) {
+    unsigned int hash = 0;
+    while (*cmd) {
+        hash = hash * 31 + (unsigned char)*cmd++;
+    }
+    return hash % CAPTURE_CACHE_SIZE;
+}
+
+// Take the parsed tree for cmd out of the cache, parsing it on a miss
+// The caller owns the tree until it hands it back with capture_cache_put()
+// Returns false if cmd does not parse
+static bool capture_cache_take(const char *cmd, AstNode **tree) {
+    CaptureCacheEntry *entry = &capture_cache[capture_cache_slot(cmd)];
+    if (entry->text && strcmp(entry->text, cmd) == 0) {
+        *tree = entry->tree;
+        free(entry->text);
+        entry->text = NULL;
+        entry->tree = NULL;
+        return true;
+    }
+
+    // Syntax errors are reported by the child that runs the fork path
+    bool old_silent = script_state.silent_errors;
+    script_state.silent_errors = true;
+    AstParseStatus status = ast_parse_program(cmd, strlen(cmd), tree);
+    script_state.silent_errors = old_silent;
+    return status == AST_PARSE_OK;
+}
+
+static void capture_cache_put(const char *cmd, AstNode *tree) {
+    CaptureCacheEntry *entry = &capture_cache[capture_cache_slot(cmd)];
+    char *text = strdup(cmd);
+    if (!text) {
+        ast_free(tree);
+        return;
+    }
+    free(entry->text);
+    ast_free(entry->tree);
+    entry->text = text;
+    entry->tree = tree;
+}
+
+// Run a substitution without forking when it only uses assignments,
+// output-only builtins and such functions. stdout goes to a memory
+// buffer, and the variables a subshell would isolate are put back after.
+// Returns NULL if the body needs a child process
+static char *capture_in_process(const char *cmd) {
+    // An unset-variable error must only end the subshell
+    if (shell_option_nounset()) return NULL;
+
+    AstNode *tree = NULL;
+    if (!capture_cache_take(cmd, &tree)) return NULL;
+    if (!ast_can_run_in_process(tree)) {
+        capture_cache_put(cmd, tree);
+        return NULL;
+    }
+
+    char *output = NULL;
+    size_t output_len = 0;
+    fflush(stdout);
+    FILE *mem = open_memstream(&output, &output_len);
+    ShellVarSnapshot *vars = mem ? shellvar_snapshot() : NULL;
+    if (!vars) {
+        if (mem) fclose(mem);
+        free(output);
+        capture_cache_put(cmd, tree);
+        return NULL;
+    }
+
+    // Heredoc content and $? belong to the command being expanded
+    char *outer_heredoc = NULL;
+    int outer_quoted = script_get_pending_heredoc_quoted();
+    if (script_get_pending_heredoc()) {
+        outer_heredoc = strdup(script_get_pending_heredoc());
+        script_clear_pending_heredoc();
+    }
+    int saved_exit_code = last_command_exit_code;
+    bool saved_exec_directly = exec_directly_in_child;
+    exec_directly_in_child = false;
+
+    FILE *saved_stdout = stdout;
+    if (!capture_real_stdout) capture_real_stdout = stdout;
+    stdout = mem;
+
+    if (tree) {
+        ast_execute(tree, false);
+        last_cmdsub_exit_code = last_command_exit_code;
+    } else {
+        last_cmdsub_exit_code = 0;
+    }
+
+    fflush(stdout);
+    stdout = saved_stdout;
+    if (capture_real_stdout == saved_stdout) capture_real_stdout = NULL;
+    fclose(mem);
+
+    exec_directly_in_child = saved_exec_directly;
+    last_command_exit_code = saved_exit_code;
+    if (outer_heredoc) {
+        script_set_pending_heredoc(outer_heredoc, outer_quoted);
+        free(outer_heredoc);
     }
+    shellvar_restore(vars);
+    capture_cache_put(cmd, tree);
+
+    if (!output) return strdup("");
 
+    // Remove trailing newlines (like bash does)
+    while (output_len > 0 && output[output_len - 1] == '\n') {
+        output[--output_len] = '\0';
+    }
     return output;
 }
 
@@ -156,8 +293,11 @@ static char *get_child_output(pid_t pid, const int pipefd[2]) {
 static char *execute_and_capture(const char *cmd) {
     if (!cmd || *cmd == '\0') return strdup("");
 
+    char *output = capture_in_process(cmd);
+    if (output) return output;
+
     int pipefd[2];
-    if (pipe(pipefd) == -1) {
+    if (pipeline_pipe(pipefd) == -1) {
         return NULL;
     }
 
@@ -179,9 +319,47 @@ static char *execute_and_capture(const char *cmd) {
     return get_child_output(pid, pipefd);
 }
 
+// Check whether p starts a command inside a body beginning at start
+static bool at_command_start(const char *start, const char *p) {
+    static const char *const LEADERS[] = {
+        "then", "do", "else", "elif", "if", "while", "until", "!", "{", NULL
+    };
+    const char *end = p;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    if (end == start || char_in_string(end[-1], ";&|()\n")) return true;
+    const char *word = end;
+    while (word > start && !isspace((unsigned char)word[-1]) &&
+           !char_in_string(word[-1], ";&|()<>")) {
+        word--;
+    }
+    for (int i = 0; LEADERS[i]; i++) {
+        if (strlen(LEADERS[i]) == (size_t)(end - word) &&
+            strncmp(word, LEADERS[i], end - word) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check for a reserved word in command position at p
+static bool keyword_at(const char *start, const char *p, const char *word) {
+    size_t n = strlen(word);
+    if (strncmp(p, word, n) != 0) return false;
+    if (p[n] && !isspace((unsigned char)p[n]) && !char_in_string(p[n], ";&|()<>")) return false;
+    if (p > start && !isspace((unsigned char)p[-1]) && !char_in_string(p[-1], ";&|()<>")) {
+        return false;
+    }
+    return at_command_start(start, p);
+}
+
 // Find matching closing parenthesis, handling nesting
+// Inside case ... esac, a ')' at the depth the case started at ends a
+// pattern rather than the substitution
 static const char *find_closing_paren(const char *start) {
     int depth = 1;
+    int case_base[32];
+    int cases = 0;
+    const int max_cases = (int)(sizeof(case_base) / sizeof(case_base[0]));
     const char *p = start;
 
     while (*p && depth > 0) {
@@ -189,8 +367,22 @@ static const char *find_closing_paren(const char *start) {
             p += 2;
             continue;
         }
-        if (*p == '(') depth++;
-        else if (*p == ')') depth--;
+        if (*p == 'c' && keyword_at(start, p, "case")) {
+            if (cases < max_cases) case_base[cases] = depth;
+            cases++;
+            p += 4;
+            continue;
+        }
+        if (*p == 'e' && cases > 0 && keyword_at(start, p, "esac")) {
+            cases--;
+            p += 4;
+            continue;
+        }
+        if (*p == '(') {
+            depth++;
+        } else if (*p == ')') {
+            if (cases == 0 || cases > max_cases || depth != case_base[cases - 1]) depth--;
+        }
         if (depth > 0) p++;
     }
 
@@ -215,6 +407,24 @@ static const char *find_closing_backtick(const char *start) {
     return NULL;
 }
 
+// Find the end of a substitution body
+const char *cmdsub_find_end(const char *start, bool backtick) {
+    if (!start) return NULL;
+    return backtick ? find_closing_backtick(start) : find_closing_paren(start);
+}
+
+// Run a substitution body and return its output
+char *cmdsub_capture(const char *cmd, size_t len) {
+    char *body = malloc(len + 1);
+    if (!body) return NULL;
+    memcpy(body, cmd, len);
+    body[len] = '\0';
+
+    char *output = execute_and_capture(body);
+    free(body);
+    return output;
+}
+
 // Check if string contains command substitution or escaped sequences that need processing
 static int has_cmdsub(const char *str) {
     if (!str) return 0;
@@ -324,9 +534,9 @@ static bool handle_soh_marker(const char **read_char, CmdSubBuf *buf) {
         }
         goto handled;
     }
-    // Handle SOH marker (single-quoted dollar sign from parser)
-    // Pass through to varexpand which will output literal $
-    if (*p == '\x01' && *(p + 1) == '$') {
+    // Handle SOH marker (single-quoted dollar sign or backtick from parser)
+    // Pass through to varexpand which will output literal $ or `
+    if (*p == '\x01' && char_in_string(*(p + 1), "$`")) {
         if (cmdsub_buf_ensure(buf, 2) == 0) {
             buf->data[buf->len++] = *p++;  // marker
             buf->data[buf->len++] = *p++;  // $
@@ -387,9 +597,9 @@ char *cmdsub_expand(const char *str) {
         initial_cap = INITIAL_BUF_SIZE;
     }
 
+    ArenaMark mark = arena_mark();
     CmdSubBuf buf;
-    buf.data = malloc(initial_cap);
-    if (!buf.data) return NULL;
+    buf.data = arena_alloc(initial_cap);
     buf.len = 0;
     buf.cap = initial_cap;
 
@@ -440,6 +650,22 @@ char *cmdsub_expand(const char *str) {
         }
 
 
+        // Backtick marked by the parser as being inside double quotes
+        if (*p == '\x02' && *(p + 1) == '`') {
+            p += 2;
+            const char *end = find_closing_backtick(p);
+            if (!end) {
+                cmdsub_buf_putc(&buf, '`');
+                continue;
+            }
+            if (process_substitution(p, end - p, &buf, 1) < 0) {
+                arena_release(mark);
+                return NULL;
+            }
+            p = end + 1;
+            continue;
+        }
+
         // Handle \x02 marker (indicates $ is in double-quoted context)
         // Consume the marker and set flag for next $ expansion
         if (*p == '\x02' && *(p + 1) == '$') {
@@ -457,7 +683,7 @@ char *cmdsub_expand(const char *str) {
                 }
                 // Process with in_quoted=1 to protect glob chars
                 if (process_substitution(p, end - p, &buf, 1) < 0) {
-                    free(buf.data);
+                    arena_release(mark);
                     return NULL;
                 }
                 p = end + 1;
@@ -482,7 +708,7 @@ char *cmdsub_expand(const char *str) {
             }
 
             if (process_substitution(p, end - p, &buf, 0) < 0) {
-                free(buf.data);
+                arena_release(mark);
                 return NULL;
             }
             p = end + 1;
@@ -502,7 +728,7 @@ char *cmdsub_expand(const char *str) {
             }
 
             if (process_substitution(p, end - p, &buf, in_dquote) < 0) {
-                free(buf.data);
+                arena_release(mark);
                 return NULL;
             }
             p = end + 1;
@@ -513,27 +739,11 @@ char *cmdsub_expand(const char *str) {
         cmdsub_buf_putc(&buf, *p++);
     }
 
-    // Null-terminate
-    if (cmdsub_buf_ensure(&buf, 1) < 0) {
-        free(buf.data);
-        return NULL;
+    char *result = malloc(buf.len + 1);
+    if (result) {
+        memcpy(result, buf.data, buf.len);
+        result[buf.len] = '\0';
     }
-    buf.data[buf.len] = '\0';
-    return buf.data;
-}
-
-// Expand command substitutions in all arguments
-int cmdsub_args(char **args) {
-    if (!args) return -1;
-
-    for (int i = 0; args[i] != NULL; i++) {
-        if (has_cmdsub(args[i])) {
-            char *expanded = cmdsub_expand(args[i]);
-            if (expanded) {
-                args[i] = expanded;
-            }
-        }
-    }
-
-    return 0;
+    arena_release(mark);
+    return result;
 }
@@ -1,6 +1,9 @@
 #ifndef CMDSUB_H
 #define CMDSUB_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 /**
  * Expand command substitutions in a string
  *
@@ -18,13 +21,22 @@
 char *cmdsub_expand(const char *str);
 
 /**
- * Expand command substitutions in all arguments
- * Modifies args array in place (replaces with expanded versions)
- *
- * @param args Null-terminated argument array
- * @return 0 on success, -1 on error
+ * Find the end of a command substitution body
+ * @param start First character after "$(" or the opening backtick
+ * @param backtick true for `...`, false for $(...)
+ * @return Pointer to the closing ) or backtick, or NULL if unterminated
+ */
+const char *cmdsub_find_end(const char *start, bool backtick);
+
+/**
+ * Run a command substitution body and capture its output
+ * Trailing newlines are removed and the exit status is recorded for
+ * cmdsub_get_last_exit_code().
+ * @param cmd Body text (need not be null-terminated)
+ * @param len Length of the body
+ * @return Output (newly allocated), or NULL on failure
  */
-int cmdsub_args(char **args);
+char *cmdsub_capture(const char *cmd, size_t len);
 
 /**
  * Get the exit code from the last command substitution
@@ -14,6 +14,7 @@
 #include "builtins.h"
 #include "expand.h"
 #include "utils.h"
+#include "pathindex.h"
 
 // Initialize completion
 void completion_init(void) {
@@ -101,52 +102,25 @@ static void add_aliases(CompletionResult *result, const char *prefix, size_t pre
     }
 }
 
-static void add_executables_from_path(CompletionResult *result, const char *prefix, size_t prefix_len) {
-    const char *path_env = getenv("PATH");
-    if (!path_env) return;
-
-    char *path_copy = strdup(path_env);
-    if (!path_copy) return;
-
-    char *saveptr;
-    char *dir = strtok_r(path_copy, ":", &saveptr);
-    while (dir && result->count < MAX_COMPLETIONS) {
-        DIR *dp = opendir(dir);
-        if (!dp) {
-            dir = strtok_r(NULL, ":", &saveptr);
-            continue;
-        }
-
-        struct dirent *entry;
-        while ((entry = readdir(dp)) != NULL && result->count < MAX_COMPLETIONS) {
-            // Check if name matches prefix
-            if (strncmp(entry->d_name, prefix, prefix_len) == 0) {
-                // Check if it's executable
-                char full_path[PATH_MAX];
-                snprintf(full_path, sizeof(full_path), "%s/%s", dir, entry->d_name);
-
-                if (access(full_path, X_OK) == 0) {
-                    // Check for duplicates
-                    int is_dup = 0;
-                    for (int i = 0; i < result->count; i++) {
-                        if (strcmp(result->matches[i], entry->d_name) == 0) {
-                            is_dup = 1;
-                            break;
-                        }
-                    }
-
-                    if (!is_dup) {
-                        add_match(result, entry->d_name);
-                    }
-                }
+static void add_executables_from_path(CompletionResult *result, const char *prefix) {
+    const char *names[MAX_COMPLETIONS];
+    int count = pathindex_complete(prefix, names, MAX_COMPLETIONS);
+
+    // Names from the index are distinct; only builtins and aliases can repeat them
+    int before = result->count;
+    for (int i = 0; i < count && result->count < MAX_COMPLETIONS; i++) {
+        int is_dup = 0;
+        for (int j = 0; j < before; j++) {
+            if (strcmp(result->matches[j], names[i]) == 0) {
+                is_dup = 1;
+                break;
             }
         }
 
-        closedir(dp);
-        dir = strtok_r(NULL, ":", &saveptr);
+        if (!is_dup) {
+            add_match(result, names[i]);
+        }
     }
-
-    free(path_copy);
 }
 
 // Complete commands from PATH
@@ -160,7 +134,7 @@ static void complete_commands(CompletionResult *result, const char *prefix) {
     add_aliases(result, prefix, prefix_len);
 
     // Search PATH for executables
-    add_executables_from_path(result, prefix, prefix_len);
+    add_executables_from_path(result, prefix);
 }
 
 static void build_full_match(const struct dirent *entry, char *full_match,
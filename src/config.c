@@ -16,6 +16,7 @@
 #include "varexpand.h"
 #include "expand.h"
 #include "cmdsub.h"
+#include "shellvar.h"
 #include "utils.h"
 
 Config shell_config;
@@ -44,6 +45,10 @@ void shell_options_init(void) {
     shell_config.options.noclobber = false;
     shell_config.options.allexport = false;
     shell_config.options.monitor = false;
+    shell_config.options.spawn = true;
+    shell_config.options.globstar = false;
+    shell_config.options.lastpipe = false;
+    shell_config.options.pipefail = false;
 }
 
 // Get the nounset option value
@@ -96,6 +101,46 @@ void shell_option_set_nolog(bool value) {
     shell_config.options.nolog = value;
 }
 
+// Get the spawn option value
+bool shell_option_spawn(void) {
+    return shell_config.options.spawn;
+}
+
+// Set the spawn option value
+void shell_option_set_spawn(bool value) {
+    shell_config.options.spawn = value;
+}
+
+// Get the globstar option value
+bool shell_option_globstar(void) {
+    return shell_config.options.globstar;
+}
+
+// Set the globstar option value
+void shell_option_set_globstar(bool value) {
+    shell_config.options.globstar = value;
+}
+
+// Get the lastpipe option value
+bool shell_option_lastpipe(void) {
+    return shell_config.options.lastpipe;
+}
+
+// Set the lastpipe option value
+void shell_option_set_lastpipe(bool value) {
+    shell_config.options.lastpipe = value;
+}
+
+// Get the pipefail option value
+bool shell_option_pipefail(void) {
+    return shell_config.options.pipefail;
+}
+
+// Set the pipefail option value
+void shell_option_set_pipefail(bool value) {
+    shell_config.options.pipefail = value;
+}
+
 // Trim whitespace from string
 static char *trim_whitespace(char *str) {
     char *end;
@@ -264,10 +309,12 @@ static int handle_export(char *line) {
         }
         *dst = '\0';
 
-        setenv(name, var_expanded, 1);
+        shellvar_set(name, var_expanded);
+        shellvar_set_export(name);
         free(var_expanded);
     } else {
-        setenv(name, value, 1);
+        shellvar_set(name, value);
+        shellvar_set_export(name);
     }
 
     free(tilde_expanded);  // Safe to free NULL
@@ -428,7 +475,7 @@ int config_load(const char *filepath) {
 
 // Get home directory helper
 static const char *get_home_dir(void) {
-    const char *home = getenv("HOME");
+    const char *home = shellvar_get("HOME");
     if (home) return home;
 
     // Fallback to passwd entry
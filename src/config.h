@@ -25,6 +25,10 @@ typedef struct {
     bool monitor;      // -m: Enable job control (monitor mode)
     bool nonlexicalctrl; // Enable dynamic scoping for break/continue across functions
     bool nolog;        // Disable command history logging
+    bool spawn;        // Start simple external commands with posix_spawn
+    bool globstar;     // ** in a pattern matches any depth of directories
+    bool lastpipe;     // Run the last stage of a pipeline in the current shell
+    bool pipefail;     // A pipeline fails if any of its stages fails
 } ShellOptions;
 
 // Configuration structure
@@ -200,4 +204,60 @@ bool shell_option_nolog(void);
  */
 void shell_option_set_nolog(bool value);
 
+/**
+ * Get the spawn option value
+ *
+ * @return Value of spawn option
+ */
+bool shell_option_spawn(void);
+
+/**
+ * Set the spawn option value
+ *
+ * @param value The value to set to
+ */
+void shell_option_set_spawn(bool value);
+
+/**
+ * Get the globstar option value
+ *
+ * @return Value of globstar option
+ */
+bool shell_option_globstar(void);
+
+/**
+ * Set the globstar option value
+ *
+ * @param value The value to set to
+ */
+void shell_option_set_globstar(bool value);
+
+/**
+ * Get the lastpipe option value
+ *
+ * @return Value of lastpipe option
+ */
+bool shell_option_lastpipe(void);
+
+/**
+ * Set the lastpipe option value
+ *
+ * @param value The value to set to
+ */
+void shell_option_set_lastpipe(bool value);
+
+/**
+ * Get the pipefail option value
+ *
+ * @return Value of pipefail option
+ */
+bool shell_option_pipefail(void);
+
+/**
+ * Set the pipefail option value
+ *
+ * @param value The value to set to
+ */
+void shell_option_set_pipefail(bool value);
+
 #endif // CONFIG_H
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+#include "datamove.h"
+
+// Bytes asked for per kernel copy call
+#define DATAMOVE_CHUNK (1 << 30)
+
+// Buffer of the read()/write() fallback
+#define DATAMOVE_BUFFER (128 * 1024)
+
+// Kernel calls that copy without a user space buffer
+typedef enum {
+    MOVE_COPY_FILE_RANGE,
+    MOVE_SPLICE,
+    MOVE_SENDFILE
+} MoveKind;
+
+// Result of one way of copying
+typedef enum {
+    MOVE_DONE,          // Reached end of input
+    MOVE_UNSUPPORTED,   // Refused before moving anything; try another way
+    MOVE_FAILED         // Failed part way; errno is set
+} MoveResult;
+
+#ifdef __linux__
+// Run one kernel copy call until end of input
+// A call that fails before anything was copied means the descriptors are
+// not supported by it
+static MoveResult move_loop(MoveKind kind, int in_fd, int out_fd) {
+    bool moved = false;
+    for (;;) {
+        ssize_t n;
+        switch (kind) {
+#ifdef SYS_copy_file_range
+            case MOVE_COPY_FILE_RANGE:
+                n = syscall(SYS_copy_file_range, in_fd, NULL, out_fd, NULL,
+                            (size_t)DATAMOVE_CHUNK, 0U);
+                break;
+#endif
+            case MOVE_SPLICE:
+                n = splice(in_fd, NULL, out_fd, NULL, DATAMOVE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+                break;
+            case MOVE_SENDFILE:
+                n = sendfile(out_fd, in_fd, NULL, DATAMOVE_CHUNK);
+                break;
+            default:
+                return MOVE_UNSUPPORTED;
+        }
+
+        if (n > 0) {
+            moved = true;
+        } else if (n == 0) {
+            return MOVE_DONE;
+        } else if (errno != EINTR) {
+            if (moved || errno == EPIPE) return MOVE_FAILED;
+            return MOVE_UNSUPPORTED;
+        }
+    }
+}
+#endif
+
+// Copy through a buffer, for descriptors the kernel calls refuse
+static int copy_buffered(int in_fd, int out_fd) {
+    char *buf = malloc(DATAMOVE_BUFFER);
+    if (!buf) return -1;
+
+    int rc = 0;
+    for (;;) {
+        ssize_t n = read(in_fd, buf, DATAMOVE_BUFFER);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            rc = -1;
+            break;
+        }
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = write(out_fd, buf + done, (size_t)(n - done));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                rc = -1;
+                break;
+            }
+            done += w;
+        }
+        if (rc != 0) break;
+    }
+
+    int saved = errno;
+    free(buf);
+    errno = saved;
+    return rc;
+}
+
+int datamove_copy(int in_fd, int out_fd) {
+#ifdef __linux__
+    struct stat in_st, out_st;
+    if (fstat(in_fd, &in_st) == 0 && fstat(out_fd, &out_st) == 0) {
+        // Files reporting no size (/proc, /sys) are generated on read and
+        // may look empty to the kernel copy calls
+        bool in_file = S_ISREG(in_st.st_mode) && in_st.st_size > 0;
+        bool in_pipe = S_ISFIFO(in_st.st_mode);
+        bool out_pipe = S_ISFIFO(out_st.st_mode);
+
+        // Cheapest first: a file to file copy can share extents, a pipe
+        // takes page references, sendfile needs a file it can map
+        MoveKind kinds[3];
+        int count = 0;
+        if (in_file && S_ISREG(out_st.st_mode)) kinds[count++] = MOVE_COPY_FILE_RANGE;
+        if (in_pipe || (out_pipe && in_file)) kinds[count++] = MOVE_SPLICE;
+        if (in_file) kinds[count++] = MOVE_SENDFILE;
+
+        for (int i = 0; i < count; i++) {
+            MoveResult r = move_loop(kinds[i], in_fd, out_fd);
+            if (r == MOVE_DONE) return 0;
+            if (r == MOVE_FAILED) return -1;
+        }
+    }
+#endif
+    return copy_buffered(in_fd, out_fd);
+}
+
+// Check whether path is the system cat rather than some other program
+// named cat found earlier in PATH
+static bool is_system_cat(const char *path) {
+    static const char *const system_cats[] = { "/bin/cat", "/usr/bin/cat" };
+    static struct stat cat_st[2];
+    static bool cat_found[2];
+    static bool looked_up;
+
+    if (!looked_up) {
+        for (int i = 0; i < 2; i++) {
+            cat_found[i] = stat(system_cats[i], &cat_st[i]) == 0;
+        }
+        looked_up = true;
+    }
+
+    struct stat st;
+    if (!path || stat(path, &st) != 0) return false;
+    for (int i = 0; i < 2; i++) {
+        if (cat_found[i] && st.st_dev == cat_st[i].st_dev && st.st_ino == cat_st[i].st_ino) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool datamove_is_cat(const char *path, char **args) {
+    if (!args || !args[0]) return false;
+    const char *base = strrchr(args[0], '/');
+    base = base ? base + 1 : args[0];
+    if (strcmp(base, "cat") != 0) return false;
+
+    // Any option, even --, is left to the real cat
+    for (int i = 1; args[i]; i++) {
+        if (args[i][0] == '-' && args[i][1] != '\0') return false;
+    }
+    return is_system_cat(path);
+}
+
+int datamove_cat(const char *path, char **args) {
+    if (!datamove_is_cat(path, args)) return -1;
+
+    // With no operands cat copies its input
+    char *stdin_only[] = {"-", NULL};
+    char **files = args[1] ? args + 1 : stdin_only;
+
+    // Only pipes and files with data are copied here. Files reporting no
+    // size are generated on read and may describe the reader (/proc/self
+    // would show this shell rather than cat), and cat refuses to copy a
+    // regular file onto itself; leave those, and any error, to it
+    struct stat out_st;
+    bool out_file = fstat(STDOUT_FILENO, &out_st) == 0 && S_ISREG(out_st.st_mode);
+    for (int i = 0; files[i]; i++) {
+        struct stat st;
+        int rc = strcmp(files[i], "-") == 0 ? fstat(STDIN_FILENO, &st) : stat(files[i], &st);
+        if (rc != 0) return -1;
+        if (!S_ISFIFO(st.st_mode) && !(S_ISREG(st.st_mode) && st.st_size > 0)) return -1;
+        if (out_file && st.st_dev == out_st.st_dev && st.st_ino == out_st.st_ino) return -1;
+    }
+
+    // Anything buffered for stdout goes before the files
+    fflush(stdout);
+
+    int status = 0;
+    for (int i = 0; files[i]; i++) {
+        bool is_stdin = strcmp(files[i], "-") == 0;
+        int fd = is_stdin ? STDIN_FILENO : open(files[i], O_RDONLY | O_CLOEXEC);
+        if (fd == -1 || datamove_copy(fd, STDOUT_FILENO) != 0) {
+            fprintf(stderr, "cat: %s: %s\n", files[i], strerror(errno));
+            status = 1;
+        }
+        if (fd != -1 && !is_stdin) close(fd);
+    }
+    return status;
+}
@@ -0,0 +1,59 @@
+#ifndef DATAMOVE_H
+#define DATAMOVE_H
+
+#include <stdbool.h>
+
+// ============================================================================
+// DATA MOVERS
+// ============================================================================
+//
+// Copies between descriptors that keep the bytes in the kernel where it can:
+// copy_file_range() between regular files, splice() when either end is a
+// pipe, sendfile() from a regular file to anything else. Descriptors none
+// of these accept (terminals, O_APPEND files on older kernels, ...) fall
+// back to read() and write().
+//
+// `cat FILE...` with no options is the usual data mover of a pipeline
+// (`cat big.log | grep x`, `... | cat > out`). In a child that would
+// exec it, the files are copied to stdout here instead, after the
+// redirections have been applied, which also saves the exec. Only the
+// system cat (/bin/cat or /usr/bin/cat) reading pipes or non-empty regular
+// files is taken over; another program called cat earlier in PATH, and
+// files such as /proc/self/status whose contents depend on the reader,
+// are left to the real cat.
+//
+// ============================================================================
+
+/**
+ * Copy everything readable from in_fd to out_fd
+ * Reads and writes at the descriptors' current offsets.
+ *
+ * @param in_fd Descriptor to read until end of file
+ * @param out_fd Descriptor to write to
+ * @return 0 on success, -1 on error with errno set
+ */
+int datamove_copy(int in_fd, int out_fd);
+
+/**
+ * Check whether a command is the system cat with only file operands
+ *
+ * @param path Program the command resolved to
+ * @param args Command and arguments, NULL-terminated
+ * @return true if datamove_cat() can run it
+ */
+bool datamove_is_cat(const char *path, char **args);
+
+/**
+ * Run a cat command without options by copying its files to stdout
+ * Called in a child in place of exec; errors are reported like cat does.
+ * Commands other than the system cat, options, operands that are not
+ * pipes or non-empty regular files, and files that are also the output
+ * are left to the real program.
+ *
+ * @param path Program the command resolved to
+ * @param args Command and arguments, NULL-terminated
+ * @return Exit status, or -1 if the command must be executed instead
+ */
+int datamove_cat(const char *path, char **args);
+
+#endif // DATAMOVE_H
@@ -4,6 +4,7 @@
 #include <sys/wait.h>
 #include <string.h>
 #include <signal.h>
+#include <spawn.h>
 #include <termios.h>
 #include <errno.h>
 #include <ctype.h>
@@ -12,7 +13,6 @@
 #include "builtins.h"
 #include "config.h"
 #include "parser.h"
-#include "expand.h"
 #include "varexpand.h"
 #include "cmdsub.h"
 #include "arith.h"
@@ -21,9 +21,12 @@
 #include "safe_string.h"
 #include "script.h"
 #include "shellvar.h"
-#include "ifs.h"
 #include "syslimits.h"
+#include "wordexpand.h"
+#include "fileglob.h"
+#include "arena.h"
 #include "utils.h"
+#include "datamove.h"
 
 // Global to store last exit code
 int last_command_exit_code = 0;
@@ -31,16 +34,78 @@ int last_command_exit_code = 0;
 // Debug flag - set to 1 to enable exit code tracing
 #define DEBUG_EXIT_CODE 0
 
+int execute_exec_path(const char *path, char **args) {
+    if (path) {
+        execve(path, args, shellvar_environ());
+        // A stale hashed path or a script without #! is retried via execvp
+        if (errno != ENOENT && errno != ENOEXEC) return -1;
+    }
+    shellvar_environ();  // execvp passes environ
+    return execvp(args[0], args);
+}
+
+// Start an external command with posix_spawn (vfork + exec in glibc), so the
+// shell's address space is never copied. Returns 0 and sets *pid on success,
+// an errno value if the command could not be started, or -1 if it must be
+// run through fork instead (here-documents, scripts without #!).
+static int spawn_command(char **exec_args, const char *cmd_path, const RedirInfo *redir,
+                         const sigset_t *child_mask, pid_t *pid) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+
+    if (posix_spawn_file_actions_init(&actions) != 0) return -1;
+    if (redirect_spawn_actions(redir, &actions) != 0 || posix_spawnattr_init(&attr) != 0) {
+        posix_spawn_file_actions_destroy(&actions);
+        return -1;
+    }
+
+    // Same signal setup the forked child does by hand
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGTSTP);
+    sigaddset(&defaults, SIGTTIN);
+    sigaddset(&defaults, SIGTTOU);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, child_mask);
+
+    // Put child in its own process group (only in interactive mode)
+    if (is_interactive) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    char **envp = shellvar_environ();
+    int rc;
+    if (cmd_path) {
+        rc = posix_spawn(pid, cmd_path, &actions, &attr, exec_args, envp);
+        // A stale hashed path is retried with a PATH search
+        if (rc == ENOENT) {
+            rc = posix_spawnp(pid, exec_args[0], &actions, &attr, exec_args, envp);
+        }
+    } else {
+        rc = posix_spawnp(pid, exec_args[0], &actions, &attr, exec_args, envp);
+    }
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    // posix_spawn does not fall back to /bin/sh like execvp does
+    if (rc == ENOEXEC) return -1;
+    return rc;
+}
+
 // Launch an external program
-static int launch(char **args, const char *cmd_string) {
+// redir holds the redirections parsed from args (NULL if none); the caller frees it
+static int launch(char **args, RedirInfo *redir, const char *cmd_string) {
     if (!args || !args[0]) return 1;
 
     pid_t pid;
     int status;
 
-    // Parse redirections
-    RedirInfo *redir = redirect_parse(args);
-
     // Set heredoc content if pending
     const char *heredoc = script_get_pending_heredoc();
     char *expanded_heredoc = NULL;
@@ -59,17 +124,19 @@ static int launch(char **args, const char *cmd_string) {
             if (varexpand_had_error()) {
                 // Expansion error (like ${x?z}) - exit non-interactive shell
                 free(var_result);
-                redirect_free(redir);
                 last_command_exit_code = 1;
                 return is_interactive ? 1 : 0;
             }
             expanded_heredoc = var_result;
-            // Strip \x03 IFS markers from heredoc content (heredocs don't undergo IFS splitting)
+            // Strip \x03 IFS markers from heredoc content (heredocs don't undergo IFS splitting);
+            // the fields of $@ and ${a[@]} are joined with spaces
             if (expanded_heredoc) {
                 const char *read = expanded_heredoc;
                 char *write = expanded_heredoc;
                 while (*read) {
-                    if (*read != '\x03') {
+                    if (*read == '\x04') {
+                        *write++ = ' ';
+                    } else if (*read != '\x03') {
                         *write++ = *read;
                     }
                     read++;
@@ -85,22 +152,18 @@ static int launch(char **args, const char *cmd_string) {
     // Use cleaned args (or original if no redirections)
     char **exec_args = redir ? redir->args : args;
 
-    // Strip quote markers after redirect parsing (for external commands)
-    strip_quote_markers_args(exec_args);
-
     // Check if arguments would exceed system ARG_MAX limit
     if (syslimits_check_exec_args(exec_args) != 0) {
         fprintf(stderr, "%s: argument list too long\n", HASH_NAME);
         free(expanded_heredoc);
-        redirect_free(redir);
         last_command_exit_code = 126;
         return 1;
     }
 
-    // Find and cache the command path before forking
+    // Resolve the command path before forking (remembered in the hash table)
     char *cmd_path = NULL;
-    if (exec_args[0] && strchr(exec_args[0], '/') == NULL) {
-        cmd_path = find_in_path(exec_args[0]);
+    if (exec_args[0]) {
+        cmd_path = cmd_hash_find(exec_args[0]);
     }
 
     // If we're in a command substitution child, exec directly without forking.
@@ -116,7 +179,6 @@ static int launch(char **args, const char *cmd_string) {
         // Apply redirections
         if (redir && redirect_apply(redir) != 0) {
             free(expanded_heredoc);
-            redirect_free(redir);
             free(cmd_path);
             last_command_exit_code = 1;
             return 1;
@@ -125,77 +187,69 @@ static int launch(char **args, const char *cmd_string) {
         // Execute command (replaces this process)
         if (!exec_args || !exec_args[0]) {
             free(expanded_heredoc);
-            redirect_free(redir);
             free(cmd_path);
             last_command_exit_code = 127;
             return 1;
         }
-        execvp(exec_args[0], exec_args);
-        // If we get here, execvp failed
+
+        // A plain cat copies its files here instead of being executed
+        int cat_status = cmd_path ? datamove_cat(cmd_path, exec_args) : -1;
+        if (cat_status >= 0) _exit(cat_status);
+
+        execute_exec_path(cmd_path, exec_args);
+        // If we get here, exec failed
         if (!script_state.silent_errors) {
             perror(HASH_NAME);
         }
         free(expanded_heredoc);
-        redirect_free(redir);
         free(cmd_path);
         last_command_exit_code = 127;
         return 1;  // Return instead of _exit since we might want to continue
     }
 
-    pid = fork();
-    if (pid == 0) {
-        // Child process
-
-        // Put child in its own process group (only in interactive mode)
-        if (is_interactive) {
-            setpgid(0, 0);
-        }
-
-        // Restore default signal handlers in child
-        signal(SIGINT, SIG_DFL);
-        signal(SIGQUIT, SIG_DFL);
-        signal(SIGTSTP, SIG_DFL);
-        signal(SIGTTIN, SIG_DFL);
-        signal(SIGTTOU, SIG_DFL);
+    // Flush buffered output so it is not written after the child's
+    fflush(stdout);
+    fflush(stderr);
+
+    // Block SIGCHLD while waiting for foreground process
+    // This prevents the SIGCHLD handler from reaping our child; it is
+    // blocked before the child exists since a spawned child may exit at once
+    sigset_t block_mask, old_mask;
+    sigprocmask(SIG_SETMASK, NULL, &old_mask);
+    if (is_interactive) {
+        sigemptyset(&block_mask);
+        sigaddset(&block_mask, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &block_mask, NULL);
+    }
 
-        // Apply redirections
-        if (redir && redirect_apply(redir) != 0) {
-            _exit(EXIT_FAILURE);
-        }
+    // Simple external commands skip fork when the spawn option is set
+    // A plain cat is forked instead, so the child can copy its files
+    // without executing it
+    bool mover = cmd_path && datamove_is_cat(cmd_path, exec_args);
+    pid = -1;
+    int spawn_rc = -1;
+    if (shell_option_spawn() && exec_args[0] && !mover) {
+        spawn_rc = spawn_command(exec_args, cmd_path, redir, &old_mask, &pid);
+    }
+    if (spawn_rc < 0) {
+        pid = fork();
+    }
 
-        // Execute command
-        if (!exec_args || !exec_args[0]) {
-            _exit(EXIT_FAILURE);
-        }
-        if (execvp(exec_args[0], exec_args) == -1) {
-            if (!script_state.silent_errors) {
-                perror(HASH_NAME);
-            }
-        }
-        // Use _exit() instead of exit() to avoid flushing parent's stdio buffers
-        // This prevents file position corruption when reading scripts
-        _exit(EXIT_FAILURE);
-    } else if (pid < 0) {
-        // Fork error
+    if (spawn_rc > 0) {
+        // Report like a forked child whose open or exec failed
+        errno = spawn_rc;
         if (!script_state.silent_errors) {
             perror(HASH_NAME);
         }
         last_command_exit_code = 1;
-    } else {
+    } else if (pid > 0) {
         // Parent process
 
         // Job control setup only in interactive mode
-        sigset_t block_mask, old_mask;
         if (is_interactive) {
             // Put child in its own process group
             setpgid(pid, pid);
 
-            // Block SIGCHLD while waiting for foreground process
-            // This prevents the SIGCHLD handler from reaping our child
-            sigemptyset(&block_mask);
-            sigaddset(&block_mask, SIGCHLD);
-            sigprocmask(SIG_BLOCK, &block_mask, &old_mask);
-
             // Give terminal control to child process group
             tcsetpgrp(STDIN_FILENO, pid);
         }
@@ -209,9 +263,6 @@ static int launch(char **args, const char *cmd_string) {
         if (is_interactive) {
             // Take back terminal control
             tcsetpgrp(STDIN_FILENO, getpgrp());
-
-            // Restore SIGCHLD handling
-            sigprocmask(SIG_SETMASK, &old_mask, NULL);
         }
 
         // Handle the result
@@ -244,17 +295,61 @@ static int launch(char **args, const char *cmd_string) {
             // The child may have been reaped unexpectedly
             last_command_exit_code = 1;
         }
+    } else if (pid == 0) {
+        // Child process
 
-        // Add command to hash table if we found its path
-        if (cmd_path) {
-            cmd_hash_add(exec_args[0], cmd_path);
+        // Put child in its own process group (only in interactive mode)
+        if (is_interactive) {
+            setpgid(0, 0);
         }
+
+        // Undo the SIGCHLD block taken for the parent
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+        // Restore default signal handlers in child
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL);
+        signal(SIGTTOU, SIG_DFL);
+
+        // Apply redirections
+        if (redir && redirect_apply(redir) != 0) {
+            _exit(EXIT_FAILURE);
+        }
+
+        // Execute command
+        if (!exec_args || !exec_args[0]) {
+            _exit(EXIT_FAILURE);
+        }
+        if (mover) {
+            int cat_status = datamove_cat(cmd_path, exec_args);
+            if (cat_status >= 0) _exit(cat_status);
+        }
+        if (execute_exec_path(cmd_path, exec_args) == -1) {
+            if (!script_state.silent_errors) {
+                perror(HASH_NAME);
+            }
+        }
+        // Use _exit() instead of exit() to avoid flushing parent's stdio buffers
+        // This prevents file position corruption when reading scripts
+        _exit(EXIT_FAILURE);
+    } else {
+        // Fork error
+        if (!script_state.silent_errors) {
+            perror(HASH_NAME);
+        }
+        last_command_exit_code = 1;
+    }
+
+    // Restore SIGCHLD handling
+    if (is_interactive) {
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
     }
 
     // Clean up
     free(cmd_path);
     free(expanded_heredoc);
-    redirect_free(redir);
 
     return 1;
 }
@@ -271,31 +366,19 @@ static char *build_cmd_string(char **args) {
     char *cmd = malloc(total_len);
     if (!cmd) return NULL;
 
-    cmd[0] = '\0';
+    // Copy at a running offset; appending with strcat is quadratic in argc
+    size_t pos = 0;
     for (int i = 0; args[i] != NULL; i++) {
-        if (i > 0) safe_strcat(cmd, " ", total_len);
-        safe_strcat(cmd, args[i], total_len);
+        if (i > 0) cmd[pos++] = ' ';
+        size_t len = strlen(args[i]);
+        memcpy(cmd + pos, args[i], len);
+        pos += len;
     }
+    cmd[pos] = '\0';
 
     return cmd;
 }
 
-// Free expanded arguments
-static void free_expanded_args(char **expanded_args, int count) {
-    for (int i = 0; i < count; i++) {
-        free(expanded_args[i]);
-    }
-}
-
-// Free glob-expanded array (all strings and the array itself)
-static void free_glob_args(char **glob_args, int count) {
-    if (!glob_args) return;
-    for (int i = 0; i < count; i++) {
-        free(glob_args[i]);
-    }
-    free(glob_args);
-}
-
 // Check if string is a valid variable assignment (VAR=VALUE)
 // Returns pointer to '=' if valid, NULL otherwise
 static char *is_var_assignment(const char *arg) {
@@ -316,101 +399,61 @@ static char *is_var_assignment(const char *arg) {
     return equals;
 }
 
-// Check if string is a redirection operator or contains one
-// Returns true if arg is or contains a redirection target
-static bool is_redirection_arg(const char *arg) {
-    if (!arg || arg[0] == '\x01') return false;  // Skip quoted args
-
-    // Standalone operators
-    if (strcmp(arg, "<") == 0 || strcmp(arg, ">") == 0 ||
-        strcmp(arg, ">>") == 0 || strcmp(arg, "<<") == 0 ||
-        strcmp(arg, "<<-") == 0 || strcmp(arg, "2>") == 0 ||
-        strcmp(arg, "2>>") == 0 || strcmp(arg, "&>") == 0 ||
-        strcmp(arg, "2>&1") == 0 || strcmp(arg, ">&2") == 0 ||
-        strcmp(arg, "1>&2") == 0) {
-        return false;  // Operators themselves don't need expansion
-    }
-
-    // Attached redirections: >file, <file, >>file, 2>file, etc.
-    if (char_in_string(arg[0], "<>")) {
-        return true;
-    }
-
-    // N>file, N>>file patterns
-    const char *p = arg;
-    while (*p && isdigit(*p)) p++;
-    if (p != arg && char_in_string(*p, "<>")) {
-        return true;
-    }
-
-    return false;
-}
-
 // Structure to store prefix assignments for restoration
-#define MAX_PREFIX_VARS 64
 typedef struct {
     char *name;
-    char *old_env_value;    // Old value from environment
-    char *old_shell_value;  // Old value from shell variable table
-    bool env_was_set;
-    bool shell_was_set;
+    char *old_value;        // Old value from shell variable table
+    bool was_set;
+    bool was_exported;
 } PrefixVar;
 
-static PrefixVar prefix_vars[MAX_PREFIX_VARS];
+static PrefixVar *prefix_vars = NULL;
 static int prefix_var_count = 0;
+static int prefix_var_cap = 0;
 
-// Save a variable's current value before prefix assignment (from both env and shell table)
+// Save a variable's current value and export state before prefix assignment
 static void save_prefix_var(const char *name) {
-    if (prefix_var_count >= MAX_PREFIX_VARS) return;
+    if (prefix_var_count >= prefix_var_cap) {
+        int new_cap = prefix_var_cap ? prefix_var_cap * 2 : 16;
+        PrefixVar *grown = realloc(prefix_vars, (size_t)new_cap * sizeof(PrefixVar));
+        if (!grown) {
+            fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+            exit(EXIT_FAILURE);
+        }
+        prefix_vars = grown;
+        prefix_var_cap = new_cap;
+    }
 
     prefix_vars[prefix_var_count].name = strdup(name);
 
-    // Save from environment
-    const char *env_val = getenv(name);
-    if (env_val) {
-        prefix_vars[prefix_var_count].old_env_value = strdup(env_val);
-        prefix_vars[prefix_var_count].env_was_set = true;
-    } else {
-        prefix_vars[prefix_var_count].old_env_value = NULL;
-        prefix_vars[prefix_var_count].env_was_set = false;
-    }
-
-    // Save from shell variable table
-    const char *shell_val = shellvar_get(name);
-    if (shell_val) {
-        prefix_vars[prefix_var_count].old_shell_value = strdup(shell_val);
-        prefix_vars[prefix_var_count].shell_was_set = true;
+    const char *old_val = shellvar_get(name);
+    if (old_val) {
+        prefix_vars[prefix_var_count].old_value = strdup(old_val);
+        prefix_vars[prefix_var_count].was_set = true;
     } else {
-        prefix_vars[prefix_var_count].old_shell_value = NULL;
-        prefix_vars[prefix_var_count].shell_was_set = false;
+        prefix_vars[prefix_var_count].old_value = NULL;
+        prefix_vars[prefix_var_count].was_set = false;
     }
+    prefix_vars[prefix_var_count].was_exported = shellvar_is_exported(name);
 
     prefix_var_count++;
 }
 
-// Set prefix variable in both environment and shell table
+// Set prefix variable in the shell table, exported for child processes
 static void set_prefix_var(const char *name, const char *value) {
-    // Set in environment for child processes
-    setenv(name, value, 1);
-    // Set in shell variable table for shell expansion
     shellvar_set(name, value);
+    shellvar_set_export(name);
 }
 
 // Restore prefix variables to their original state
 static void restore_prefix_vars(void) {
     for (int i = 0; i < prefix_var_count; i++) {
-        // Restore environment
-        if (prefix_vars[i].env_was_set) {
-            setenv(prefix_vars[i].name, prefix_vars[i].old_env_value, 1);
-            free(prefix_vars[i].old_env_value);
-        } else {
-            unsetenv(prefix_vars[i].name);
-        }
-
-        // Restore shell variable table
-        if (prefix_vars[i].shell_was_set) {
-            shellvar_set(prefix_vars[i].name, prefix_vars[i].old_shell_value);
-            free(prefix_vars[i].old_shell_value);
+        if (prefix_vars[i].was_set) {
+            shellvar_set(prefix_vars[i].name, prefix_vars[i].old_value);
+            free(prefix_vars[i].old_value);
+            if (!prefix_vars[i].was_exported) {
+                shellvar_clear_export(prefix_vars[i].name);
+            }
         } else {
             shellvar_unset(prefix_vars[i].name);
         }
@@ -423,8 +466,7 @@ static void restore_prefix_vars(void) {
 // Clear prefix var tracking without restoring (for special builtins where vars persist)
 static void clear_prefix_vars(void) {
     for (int i = 0; i < prefix_var_count; i++) {
-        free(prefix_vars[i].old_env_value);
-        free(prefix_vars[i].old_shell_value);
+        free(prefix_vars[i].old_value);
         free(prefix_vars[i].name);
     }
     prefix_var_count = 0;
@@ -452,60 +494,145 @@ static bool is_posix_special_builtin(const char *cmd) {
             strcmp(cmd, "unset") == 0);
 }
 
-// Helper: expand a single assignment value through all expansion phases
-// Returns newly allocated string (caller must free), or NULL on error
-static char *expand_assignment_value(const char *value, int *had_error) {
-    char *result = strdup(value);
-    if (!result) return NULL;
-
-    // Command substitution
-    char *cmdsub_result = cmdsub_expand(result);
-    if (cmdsub_result) {
-        free(result);
-        result = cmdsub_result;
+static int execute_command(char **args);
+
+// Carry out name=(list), name[subscript]=value or their += forms
+// Returns 0 on success, -1 if an expansion or the assignment failed
+static int assign_array_word(const ArrayAssignment *assign) {
+    char *name = arena_strndup(assign->name, assign->name_len);
+
+    if (assign->list) {
+        FieldList fields;
+        fieldlist_init(&fields);
+        if (wordexpand_array_list(assign->value, assign->value_len, &fields) != 0) {
+            fieldlist_free(&fields);
+            return -1;
+        }
+
+        ShellVarElement *elems = arena_alloc((size_t)(fields.count + 1) * sizeof(ShellVarElement));
+        size_t count = 0;
+        for (int i = 0; i < fields.count; i++) {
+            elems[count].key = NULL;
+            if ((fields.flags[i] & FIELD_KEY) && i + 1 < fields.count) {
+                elems[count].key = fields.fields[i++];
+            }
+            elems[count++].value = fields.fields[i];
+        }
+        int rc = shellvar_array_assign(name, elems, count, assign->append);
+        fieldlist_free(&fields);
+        return rc;
     }
 
-    // Arithmetic expansion
-    char *arith_result = arith_expand(result);
-    if (arith_result) {
-        free(result);
-        result = arith_result;
+    char *subscript = wordexpand_string(arena_strndup(assign->subscript, assign->subscript_len), 0);
+    char *value = wordexpand_string(arena_strndup(assign->value, assign->value_len), WORDEXP_ASSIGN);
+    int rc = -1;
+    if (subscript && value) {
+        const char *new_value = value;
+        const char *old = assign->append ? shellvar_array_get(name, subscript) : NULL;
+        if (old) {
+            // += adds to an integer element and appends to any other
+            size_t size = strlen(old) + strlen(value) + 8;
+            char *joined = arena_alloc(size);
+            snprintf(joined, size, shellvar_is_integer(name) ? "%s+(%s)" : "%s%s", old, value);
+            new_value = joined;
+        }
+        rc = shellvar_array_set(name, subscript, new_value);
     }
+    free(subscript);
+    free(value);
+    return rc;
+}
 
-    // Variable expansion
-    varexpand_clear_error();
-    char *var_result = varexpand_expand(result, last_command_exit_code);
-    if (var_result) {
-        free(result);
-        result = var_result;
+// Assignment-only command with array assignments: each word is expanded
+// and assigned in turn, so later words see earlier ones
+static int execute_assignments(char **args) {
+    bool failed = false;
+    for (int i = 0; args[i] != NULL; i++) {
+        ArrayAssignment assign;
+        int rc;
+        if (wordexpand_array_assignment(args[i], &assign)) {
+            rc = assign_array_word(&assign);
+        } else {
+            char *word = wordexpand_string(args[i], WORDEXP_ASSIGN);
+            rc = -1;
+            if (word) {
+                char *equals = is_var_assignment(word);
+                *equals = '\0';
+                rc = shellvar_set(word, equals + 1);
+                free(word);
+            }
+        }
+        if (rc != 0) {
+            failed = true;
+            if (!is_interactive) {
+                last_command_exit_code = 1;
+                return 0;  // Signal to exit shell
+            }
+        }
+    }
+
+    last_command_exit_code = failed ? 1 : cmdsub_get_last_exit_code();
+    return 1;
+}
+
+// declare name=(list): the array kind and integer attribute come first so
+// the elements are stored accordingly, then the assignments, then the
+// builtin itself for the remaining attributes (readonly last)
+static int execute_declare_arrays(char **args) {
+    int count = 0;
+    while (args[count]) count++;
+
+    ArrayAssignment *assigns = arena_alloc((size_t)count * sizeof(ArrayAssignment));
+    bool *is_array = arena_alloc((size_t)count * sizeof(bool));
+    is_array[0] = false;
+    bool assoc = false;
+    bool indexed = false;
+    bool integer = false;
+    bool options = true;
+    for (int i = 1; i < count; i++) {
+        is_array[i] = wordexpand_array_assignment(args[i], &assigns[i]);
+        if (options && args[i][0] == '-' && args[i][1] && strcmp(args[i], "--") != 0) {
+            assoc |= strchr(args[i], 'A') != NULL;
+            indexed |= strchr(args[i], 'a') != NULL;
+            integer |= strchr(args[i], 'i') != NULL;
+        } else if (args[i][0] != '+') {
+            options = false;
+        }
     }
-    if (varexpand_had_error()) {
-        *had_error = 1;
+
+    bool failed = false;
+    for (int i = 1; i < count; i++) {
+        if (!is_array[i]) continue;
+        char *name = arena_strndup(assigns[i].name, assigns[i].name_len);
+        if ((assoc || indexed) && shellvar_declare_array(name, assoc) != 0) {
+            failed = true;
+            continue;
+        }
+        if (integer) shellvar_set_integer(name);
+        if (assign_array_word(&assigns[i]) != 0) failed = true;
     }
 
+    // The builtin sees only the names
+    char **names = arena_alloc((size_t)(count + 1) * sizeof(char *));
+    for (int i = 0; i < count; i++) {
+        names[i] = is_array[i] ? arena_strndup(assigns[i].name, assigns[i].name_len) : args[i];
+    }
+    names[count] = NULL;
+    int result = execute_command(names);
+    if (failed) last_command_exit_code = 1;
     return result;
 }
 
 // Execute command (built-in or external)
-int execute(char **args) {
+static int execute_command(char **args) {
     if (args[0] == NULL) {
         // Empty command
         last_command_exit_code = 0;
         return 1;
     }
 
-    // Track original args to know which ones we allocated
-    // We need to free expanded args later
-    char *expanded_args[MAX_ARGS];
-    int expanded_count = 0;
-
-    // Count args and save original pointers
-    char *original_ptrs[MAX_ARGS];
     int arg_count = 0;
-    for (int i = 0; args[i] != NULL && i < MAX_ARGS - 1; i++) {
-        original_ptrs[i] = args[i];
-        arg_count++;
-    }
+    while (args[arg_count] != NULL) arg_count++;
 
     // POSIX 2.9.1: For special builtins, prefix variable assignments must be
     // visible during expansion of subsequent arguments in the same command.
@@ -514,8 +641,13 @@ int execute(char **args) {
     // First, identify how many prefix assignments there are (before first command word)
     // Look at raw args before any expansion to find VAR=VALUE patterns
     int early_prefix_count = 0;
+    bool has_array_assignment = false;
     for (int i = 0; i < arg_count; i++) {
-        if (is_var_assignment(args[i])) {
+        ArrayAssignment assign;
+        if (wordexpand_array_assignment(args[i], &assign)) {
+            has_array_assignment = true;
+            early_prefix_count++;
+        } else if (is_var_assignment(args[i])) {
             early_prefix_count++;
         } else {
             break;  // First non-assignment is the command
@@ -529,217 +661,54 @@ int execute(char **args) {
 
     // Reset command substitution exit code tracker before expansion
     cmdsub_reset_exit_code();
+    varexpand_clear_error();
+    arith_clear_unset_error();
+
+    // Array assignments: a=(...) and a[i]=v on their own, or given to declare
+    if (has_array_assignment && !cmd_token) {
+        return execute_assignments(args);
+    }
+    if (early_prefix_count == 0 && (strcmp(args[0], "declare") == 0 || strcmp(args[0], "typeset") == 0)) {
+        for (int i = 1; i < arg_count; i++) {
+            ArrayAssignment assign;
+            if (wordexpand_array_assignment(args[i], &assign)) return execute_declare_arrays(args);
+        }
+    }
+
+    // Expanded fields; quoting is already removed
+    FieldList fields;
+    fieldlist_init(&fields);
 
     // For special builtins, process prefix assignments one-by-one so each
     // assignment is visible to subsequent expansions (POSIX 2.9.1 requirement).
     // Note: For assignment-only commands (cmd_token == NULL), POSIX says
     // visibility is unspecified, so we use the simpler bulk expansion path.
+    int done = 0;
     if (early_prefix_count > 0 && is_special) {
-        for (int i = 0; i < early_prefix_count; i++) {
-            const char *equals = is_var_assignment(args[i]);
-            if (!equals) continue;
-
-            // Extract variable name
-            size_t name_len = equals - args[i];
-            char *name = malloc(name_len + 1);
-            if (!name) continue;
-            memcpy(name, args[i], name_len);
-            name[name_len] = '\0';
-
-            // Get value part
-            const char *value = equals + 1;
-
-            // Expand tilde in value
-            char *tilde_exp = expand_tilde_in_assignment(value);
-            if (tilde_exp) {
-                value = tilde_exp;
-            }
-
-            // Expand the value through all phases
-            int had_error = 0;
-            char *expanded_value = expand_assignment_value(value, &had_error);
-            if (tilde_exp) free(tilde_exp);
-
-            if (had_error) {
-                free(name);
-                free(expanded_value);
+        for (; done < early_prefix_count; done++) {
+            const char *equals = is_var_assignment(args[done]);
+            size_t name_len = equals - args[done];
+
+            char *value = wordexpand_string(args[done], WORDEXP_ASSIGN);
+            if (!value) {
+                fieldlist_free(&fields);
+                clear_prefix_vars();
                 last_command_exit_code = 1;
                 return is_interactive ? 1 : 0;
             }
 
-            // Strip quote markers from value
-            if (expanded_value) {
-                strip_quote_markers(expanded_value);
-            }
-
             // Save old value and set new value so it's visible to subsequent expansions
-            save_prefix_var(name);
-            set_prefix_var(name, expanded_value ? expanded_value : "");
-
-            // Build new arg string with expanded value for later processing
-            size_t new_len = name_len + 1 + (expanded_value ? strlen(expanded_value) : 0) + 1;
-            char *new_arg = malloc(new_len);
-            if (new_arg) {
-                snprintf(new_arg, new_len, "%s=%s", name, expanded_value ? expanded_value : "");
-                if (args[i] != original_ptrs[i]) {
-                    free(args[i]);
-                }
-                args[i] = new_arg;
-                expanded_args[expanded_count++] = new_arg;
-                original_ptrs[i] = new_arg;
-            }
-
-            free(name);
-            free(expanded_value);
-        }
-    }
-
-    // Expand tilde in all arguments (for args starting with ~)
-    expand_tilde(args);
-
-    // Also expand tildes in assignment values BEFORE command substitution
-    // Skip prefix assignments that were already processed above (only for special builtins)
-    int assign_start = (early_prefix_count > 0 && is_special) ? early_prefix_count : 0;
-    for (int i = assign_start; i < arg_count; i++) {
-        const char *eq = is_var_assignment(args[i]);
-        if (eq) {
-            // This is an assignment - expand tildes in the value part
-            const char *value = eq + 1;
-            char *tilde_exp = expand_tilde_in_assignment(value);
-            if (tilde_exp) {
-                // Build new argument with expanded value
-                size_t name_len = eq - args[i] + 1;  // includes '='
-                size_t new_len = name_len + strlen(tilde_exp) + 1;
-                char *new_arg = malloc(new_len);
-                if (new_arg) {
-                    memcpy(new_arg, args[i], name_len);
-                    strcpy(new_arg + name_len, tilde_exp);
-                    // Track if we need to free the original
-                    if (args[i] != original_ptrs[i]) {
-                        // Already expanded, free the old one
-                        free(args[i]);
-                    }
-                    args[i] = new_arg;
-                    expanded_args[expanded_count++] = new_arg;
-                    original_ptrs[i] = new_arg;
-                }
-                free(tilde_exp);
-            }
-        }
-    }
-
-    // Track which args were expanded by tilde
-    for (int i = 0; i < arg_count; i++) {
-        if (args[i] != original_ptrs[i]) {
-            expanded_args[expanded_count++] = args[i];
-            original_ptrs[i] = args[i];  // Update for next expansion check
-        }
-    }
-
-    // Expand command substitutions in non-prefix arguments
-    // (prefix assignments for special builtins were already expanded above)
-    // Check for both $() and backtick `` syntax
-    for (int i = assign_start; i < arg_count; i++) {
-        if (args[i] && (strchr(args[i], '$') != NULL || strchr(args[i], '`') != NULL)) {
-            char *result = cmdsub_expand(args[i]);
-            if (result) {
-                if (args[i] != original_ptrs[i]) {
-                    free(args[i]);
-                }
-                args[i] = result;
-            }
-        }
-    }
-
-    // Track which args were expanded by cmdsub
-    for (int i = 0; i < arg_count; i++) {
-        if (args[i] != original_ptrs[i]) {
-            expanded_args[expanded_count++] = args[i];
-            original_ptrs[i] = args[i];
-        }
-    }
-
-    // Clear arith error flag before expansion
-    arith_clear_unset_error();
-
-    // Expand arithmetic substitutions in non-prefix arguments
-    for (int i = assign_start; i < arg_count; i++) {
-        if (args[i] && strstr(args[i], "$((") != NULL) {
-            char *result = arith_expand(args[i]);
-            if (result) {
-                if (args[i] != original_ptrs[i]) {
-                    free(args[i]);
-                }
-                args[i] = result;
-            }
-        }
-    }
-
-    // Check for unset variable error in arithmetic (set -u)
-    if (arith_had_unset_error()) {
-        // Free any expanded args before returning
-        for (int i = 0; i < arg_count; i++) {
-            if (args[i] != original_ptrs[i]) {
-                free(args[i]);
-            }
-        }
-        if (is_special) {
-            clear_prefix_vars();
-        } else {
-            restore_prefix_vars();
-        }
-        last_command_exit_code = 1;
-        return is_interactive ? 1 : 0;  // Continue in interactive mode, exit in non-interactive
-    }
-
-    // Track which args were expanded by arith
-    for (int i = 0; i < arg_count; i++) {
-        if (args[i] != original_ptrs[i]) {
-            expanded_args[expanded_count++] = args[i];
-            original_ptrs[i] = args[i];
+            value[name_len] = '\0';
+            save_prefix_var(value);
+            set_prefix_var(value, value + name_len + 1);
+            value[name_len] = '=';
+            fieldlist_push(&fields, value, FIELD_ASSIGNMENT);
         }
     }
 
-    // Clear varexpand error flag before expansion
-    varexpand_clear_error();
-
-    // POSIX evaluation order: expand redirections BEFORE variable assignments
-    // This ensures ${x=redir} in redirections takes effect before ${x=assign} in assignments
-    // First pass: expand only redirection arguments
-    for (int i = 0; i < arg_count; i++) {
-        const char *arg = args[i];
-        if (arg == NULL) continue;
-        if (is_redirection_arg(arg) && strchr(arg, '$') != NULL) {
-            char *expanded = varexpand_expand(args[i], last_command_exit_code);
-            if (expanded) {
-                args[i] = expanded;
-            }
-        }
-    }
-
-    // Second pass: expand non-redirection arguments (assignments and command words)
-    // Skip prefix assignments that were already expanded for special builtins
-    for (int i = 0; i < arg_count; i++) {
-        const char *arg = args[i];
-        if (arg == NULL) continue;
-        // Skip already-processed prefix assignments (only for special builtins)
-        if (i < early_prefix_count && is_special) continue;
-        if (!is_redirection_arg(original_ptrs[i]) && strchr(arg, '$') != NULL) {
-            char *expanded = varexpand_expand(args[i], last_command_exit_code);
-            if (expanded) {
-                args[i] = expanded;
-            }
-        }
-    }
-
-    // Check for unset variable error (set -u)
-    if (varexpand_had_error()) {
-        // Free any expanded args before returning
-        for (int i = 0; i < arg_count; i++) {
-            if (args[i] != original_ptrs[i]) {
-                free(args[i]);
-            }
-        }
+    // Everything else: redirections first, then assignments and arguments
+    if (wordexpand_command(args + done, &fields) != 0) {
+        fieldlist_free(&fields);
         // For special builtins with prefix assignments that persisted, keep them
         // (Don't restore - the error happened but assignments already took effect)
         if (is_special) {
@@ -751,91 +720,19 @@ int execute(char **args) {
         return is_interactive ? 1 : 0;  // Continue in interactive mode, exit in non-interactive
     }
 
-    // Track which args were expanded by varexpand
-    for (int i = 0; i < arg_count; i++) {
-        if (args[i] != original_ptrs[i]) {
-            expanded_args[expanded_count++] = args[i];
-        }
-    }
-
-    // IFS word splitting - may change the number of arguments
-    // ifs_split_args processes \x03 markers from unquoted expansions
-    char **ifs_args = NULL;
-    int ifs_arg_count = arg_count;
-    bool ifs_expanded = false;
-
-    // Make a copy of args for ifs_split_args to potentially replace
-    ifs_args = malloc((arg_count + 1) * sizeof(char *));
-    if (ifs_args) {
-        for (int i = 0; i < arg_count; i++) {
-            ifs_args[i] = args[i];
-        }
-        ifs_args[arg_count] = NULL;
-
-        char **old_ifs_args = ifs_args;
-        if (ifs_split_args(&ifs_args, &ifs_arg_count) == 0 && ifs_args != old_ifs_args) {
-            ifs_expanded = true;
-            // ifs_split_args created a new array - free the temp one we made
-            free(old_ifs_args);
-            // Update args and arg_count for subsequent phases
-            arg_count = ifs_arg_count;
-        } else {
-            // No splitting happened or same array returned - free our temp array
-            free(ifs_args);
-            ifs_args = NULL;
-        }
-    }
-
-    // Use IFS-split args if expansion happened
-    char **glob_input = ifs_expanded ? ifs_args : args;
-
-    // Glob (pathname) expansion - may change the number of arguments
-    // expand_glob creates a new array with all strings strdup'd
-    char **glob_args = NULL;
-    int glob_arg_count = arg_count;
-    bool glob_expanded = false;
-
-    // Check if any argument has glob characters
-    bool has_globs = false;
-    for (int i = 0; i < arg_count; i++) {
-        if (has_glob_chars(glob_input[i])) {
-            has_globs = true;
-            break;
-        }
-    }
-
-    if (has_globs) {
-        // Create a copy of args pointers for expand_glob
-        glob_args = malloc((arg_count + 1) * sizeof(char *));
-        if (glob_args) {
-            for (int i = 0; i < arg_count; i++) {
-                glob_args[i] = glob_input[i];
-            }
-            glob_args[arg_count] = NULL;
-
-            char **old_glob_args = glob_args;
-            if (expand_glob(&glob_args, &glob_arg_count) == 0 && glob_args != old_glob_args) {
-                glob_expanded = true;
-                // expand_glob created a new array - free the temp one we made
-                free(old_glob_args);
-            } else {
-                // No expansion happened - free our temp array
-                free(glob_args);
-                glob_args = NULL;
-            }
-        }
+    char **exec_input = fields.fields;
+    const unsigned char *input_flags = fields.flags;
+    if (!exec_input || !exec_input[0]) {
+        // Every word expanded to nothing
+        fieldlist_free(&fields);
+        last_command_exit_code = cmdsub_get_last_exit_code();
+        return 1;
     }
 
-    // Use expanded args if glob expansion happened, otherwise use IFS-split args (or original)
-    char **exec_input = glob_expanded ? glob_args : glob_input;
-
-    // Note: Don't strip quote markers here - they're needed for redirect parsing in launch()
-    // Markers will be stripped in launch() after redirections are parsed
-
     // Handle variable assignments
     // Count leading VAR=VALUE assignments
     int prefix_count = 0;
-    while (exec_input[prefix_count] && is_var_assignment(exec_input[prefix_count])) {
+    while (exec_input[prefix_count] && (input_flags[prefix_count] & FIELD_ASSIGNMENT)) {
         prefix_count++;
     }
 
@@ -848,11 +745,6 @@ int execute(char **args) {
             const char *name = exec_input[i];
             char *value = equals + 1;
 
-            // Strip quote markers from value before storing
-            strip_quote_markers(value);
-
-            // Tilde expansion already happened BEFORE command substitution
-            // (in the earlier expansion phase), so just use the value directly
             int result = shellvar_set(name, value);
             if (result < 0) {
                 assignment_failed = 1;
@@ -861,9 +753,7 @@ int execute(char **args) {
                 if (!is_interactive) {
                     *equals = '=';  // Restore
                     last_command_exit_code = 1;
-                    if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-                    if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-                    free_expanded_args(expanded_args, expanded_count);
+                    fieldlist_free(&fields);
                     return 0;  // Signal to exit shell
                 }
             }
@@ -877,14 +767,12 @@ int execute(char **args) {
             // Use the exit code from command substitution if any occurred
             last_command_exit_code = cmdsub_get_last_exit_code();
         }
-        if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-        if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-        free_expanded_args(expanded_args, expanded_count);
+        fieldlist_free(&fields);
         return 1;
     }
 
     // If there are prefix assignments followed by a command,
-    // set them temporarily for the command (both in environment and shell table)
+    // set them temporarily for the command (exported in the shell table)
     // Skip if we already processed them for special builtins (early processing above)
     bool has_prefix_assignments = (prefix_count > 0 && exec_input[prefix_count] != NULL);
     bool prefix_vars_already_set = (early_prefix_count > 0 && is_special && prefix_count == early_prefix_count);
@@ -895,22 +783,21 @@ int execute(char **args) {
             const char *name = exec_input[i];
             char *value = equals + 1;
 
-            // Strip quote markers from value before storing
-            strip_quote_markers(value);
-
             // Save old value for restoration
             save_prefix_var(name);
 
-            // Set in environment and shell table for visibility to command
+            // Export for visibility to command
             set_prefix_var(name, value);
 
             *equals = '=';  // Restore
         }
         // Shift exec_input to point to the actual command
         exec_input = &exec_input[prefix_count];
+        input_flags = &input_flags[prefix_count];
     } else if (prefix_vars_already_set) {
         // Already processed, just shift past prefix assignments
         exec_input = &exec_input[prefix_count];
+        input_flags = &input_flags[prefix_count];
     }
 
     int result = 1;  // Default: continue shell
@@ -922,9 +809,7 @@ int execute(char **args) {
         char *alias_line = strdup(alias_value);
         if (!alias_line) {
             last_command_exit_code = 1;
-            if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-            if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-            free_expanded_args(expanded_args, expanded_count);
+            fieldlist_free(&fields);
             restore_prefix_vars();
             return 1;
         }
@@ -933,9 +818,7 @@ int execute(char **args) {
         if (!alias_parsed.tokens) {
             free(alias_line);
             last_command_exit_code = 1;
-            if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-            if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-            free_expanded_args(expanded_args, expanded_count);
+            fieldlist_free(&fields);
             restore_prefix_vars();
             return 1;
         }
@@ -961,21 +844,25 @@ int execute(char **args) {
                 for (int i = 0; i < alias_arg_count; i++) {
                     combined_args[i] = alias_parsed.tokens[i];
                 }
-                // Append original args (skip command name)
+                // Append original args (skip command name), quoted so that
+                // the recursive call does not expand them a second time
                 for (int i = 0; i < orig_arg_count; i++) {
-                    combined_args[alias_arg_count + i] = exec_input[i + 1];
+                    const char *arg = exec_input[i + 1];
+                    combined_args[alias_arg_count + i] = (input_flags[i + 1] & FIELD_OPERATOR)
+                                                         ? strdup(arg) : wordexpand_quote(arg);
                 }
                 combined_args[alias_arg_count + orig_arg_count] = NULL;
 
                 // Execute with combined args
                 result = execute(combined_args);
 
+                for (int i = 0; i < orig_arg_count; i++) {
+                    free(combined_args[alias_arg_count + i]);
+                }
                 free(combined_args);
                 parse_result_free(&alias_parsed);
                 free(alias_line);
-                if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-                if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-                free_expanded_args(expanded_args, expanded_count);
+                fieldlist_free(&fields);
                 restore_prefix_vars();
                 return result;
             }
@@ -995,18 +882,16 @@ int execute(char **args) {
 #if DEBUG_EXIT_CODE
         fprintf(stderr, "DEBUG: After freeing alias stuff, last_command_exit_code=%d\n", last_command_exit_code);
 #endif
-        if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-        if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-        free_expanded_args(expanded_args, expanded_count);
+        fieldlist_free(&fields);
 #if DEBUG_EXIT_CODE
-        fprintf(stderr, "DEBUG: After free_expanded_args, last_command_exit_code=%d\n", last_command_exit_code);
+        fprintf(stderr, "DEBUG: After fieldlist_free, last_command_exit_code=%d\n", last_command_exit_code);
 #endif
         restore_prefix_vars();
         return result;
     }
 
     // Check for redirections
-    RedirInfo *redir = redirect_parse(exec_input);
+    RedirInfo *redir = redirect_parse_fields(exec_input, input_flags);
 
     // Set heredoc content if pending
     const char *heredoc = script_get_pending_heredoc();
@@ -1019,12 +904,6 @@ int execute(char **args) {
     // Check if this is a builtin first (without executing it)
     int is_builtin_cmd = exec_args[0] ? is_builtin(exec_args[0]) : 0;
 
-    // Strip quote markers only for builtins
-    // External commands go through launch() which does its own redirect parsing and marker stripping
-    if (is_builtin_cmd) {
-        strip_quote_markers_args(exec_args);
-    }
-
     // Check if this is a builtin that must NOT run in a child process
     // These include:
     // - Flow control: break, continue, return, exit (affect execution flow)
@@ -1079,9 +958,7 @@ int execute(char **args) {
             }
         }
         redirect_free(redir);
-        if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-        if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-        free_expanded_args(expanded_args, expanded_count);
+        fieldlist_free(&fields);
         restore_prefix_vars();
         return 1;
     }
@@ -1098,9 +975,7 @@ int execute(char **args) {
         result = try_builtin(exec_input);
         if (result != -1) {
             redirect_free(redir);
-            if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-            if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-            free_expanded_args(expanded_args, expanded_count);
+            fieldlist_free(&fields);
             // exec is a special builtin - prefix assignments persist
             clear_prefix_vars();
             return result;
@@ -1119,9 +994,7 @@ int execute(char **args) {
             if (saved_fds[1] != -1) { dup2(saved_fds[1], STDOUT_FILENO); close(saved_fds[1]); }
             if (saved_fds[2] != -1) { dup2(saved_fds[2], STDERR_FILENO); close(saved_fds[2]); }
             redirect_free(redir);
-            if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-            if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-            free_expanded_args(expanded_args, expanded_count);
+            fieldlist_free(&fields);
             // Special builtin redirect error - vars still persist per POSIX
             clear_prefix_vars();
             last_command_exit_code = 1;
@@ -1144,9 +1017,7 @@ int execute(char **args) {
 
     if (result != -1) {
         redirect_free(redir);
-        if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-        if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-        free_expanded_args(expanded_args, expanded_count);
+        fieldlist_free(&fields);
         // For special builtins, prefix assignments persist; for others, restore
         if (is_special_builtin) {
             clear_prefix_vars();
@@ -1175,9 +1046,7 @@ int execute(char **args) {
                 if (func_saved_fds[1] != -1) { dup2(func_saved_fds[1], STDOUT_FILENO); close(func_saved_fds[1]); }
                 if (func_saved_fds[2] != -1) { dup2(func_saved_fds[2], STDERR_FILENO); close(func_saved_fds[2]); }
                 redirect_free(redir);
-                if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-                if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-                free_expanded_args(expanded_args, expanded_count);
+                fieldlist_free(&fields);
                 restore_prefix_vars();
                 last_command_exit_code = 1;
                 return 1;
@@ -1197,31 +1066,35 @@ int execute(char **args) {
         // by shell_return (or the last command in the function body).
         // The result is a control flow signal (1=continue, 0=exit, -2=return, etc.)
         redirect_free(redir);
-        if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-        if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-        free_expanded_args(expanded_args, expanded_count);
+        fieldlist_free(&fields);
         restore_prefix_vars();
         return result;
     }
 
-    // Free redir before launching external command (launch() does its own redirect parsing)
-    redirect_free(redir);
-
     // Build command string for job display
     char *cmd_string = build_cmd_string(exec_input);
 
     // Launch external program
-    result = launch(exec_input, cmd_string);
+    result = launch(exec_input, redir, cmd_string);
 
     free(cmd_string);
-    if (ifs_expanded) free_glob_args(ifs_args, ifs_arg_count);
-    if (glob_expanded) free_glob_args(glob_args, glob_arg_count);
-    free_expanded_args(expanded_args, expanded_count);
+    redirect_free(redir);
+    fieldlist_free(&fields);
     restore_prefix_vars();
 
     return result;
 }
 
+int execute(char **args) {
+    // Temporaries of this command are dropped together when it finishes
+    ArenaMark mark = arena_mark();
+    int result = execute_command(args);
+    arena_release(mark);
+    fileglob_cache_recheck();
+    shellvar_set_pipestatus(&last_command_exit_code, 1);
+    return result;
+}
+
 // Get last exit code
 int execute_get_last_exit_code(void) {
     return last_command_exit_code;
@@ -22,4 +22,17 @@ int execute(char **args);
  */
 int execute_get_last_exit_code(void);
 
+/**
+ * Replace the current process with an external command
+ * Uses execve on a path resolved before fork, so PATH is not searched
+ * again in the child. Falls back to execvp if the path is missing or
+ * stale, or names a script without a #! line.
+ *
+ * @param path Resolved path (see cmd_hash_find), or NULL to search PATH
+ * @param args The arguments (including command)
+ *
+ * @return Returns only on failure, with errno set
+ */
+int execute_exec_path(const char *path, char **args);
+
 #endif
@@ -67,6 +67,16 @@ int has_glob_chars(const char *s);
  */
 int expand_glob(char ***args, int *arg_count);
 
+/**
+ * Expand a single glob pattern
+ * Literal characters are escaped with a backslash, as for glob(3).
+ * @param pattern Pattern to match
+ * @param count Receives the number of matches
+ * @return Sorted matches (caller frees each string and the array),
+ *         or NULL if nothing matches
+ */
+char **expand_glob_pattern(const char *pattern, int *count);
+
 /**
  * Remove \x01 quote markers from a string (in-place)
  * These markers protect quoted characters from expansion
@@ -75,11 +85,4 @@ int expand_glob(char ***args, int *arg_count);
  */
 void strip_quote_markers(char *s);
 
-/**
- * Remove \x01 quote markers from all arguments
- *
- * @param args Null-terminated argument array
- */
-void strip_quote_markers_args(char **args);
-
 #endif // EXPAND_H
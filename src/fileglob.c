@@ -0,0 +1,759 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "fileglob.h"
+#include "arena.h"
+#include "hash.h"
+
+// Bytes of directory entries fetched per getdents64() call
+#define FILEGLOB_READ_SIZE (256 * 1024)
+
+// Initial number of cache buckets; doubles as directories are added
+#define FILEGLOB_CACHE_BUCKETS 64
+
+// Cached names beyond this many bytes are dropped between commands
+#define FILEGLOB_CACHE_MAX_BYTES (64 * 1024 * 1024)
+
+#ifndef DT_UNKNOWN
+#define DT_UNKNOWN 0
+#define DT_DIR 4
+#define DT_LNK 10
+#endif
+
+// ============================================================================
+// Directory listings
+// ============================================================================
+
+typedef struct {
+    char *names;            // Entry names, each NUL-terminated
+    size_t names_len;
+    size_t names_cap;
+    size_t *offsets;        // Start of each name; offsets[count] is names_len
+    unsigned char *types;   // d_type of each entry (DT_UNKNOWN if not reported)
+    size_t count;
+    size_t cap;
+} DirListing;
+
+typedef struct CachedDir {
+    struct CachedDir *next;
+    char *path;
+    bool readable;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    bool racy;              // Modified too close to the read to trust mtime
+    unsigned long checked;  // Generation the listing was last checked in
+    DirListing list;
+} CachedDir;
+
+static struct {
+    CachedDir **buckets;
+    size_t bucket_count;
+    size_t count;
+    size_t bytes;           // Names held by all listings
+    unsigned long generation;
+} cache;
+
+static struct timespec stat_mtime(const struct stat *st) {
+#ifdef __APPLE__
+    return st->st_mtimespec;
+#else
+    return st->st_mtim;
+#endif
+}
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void listing_add(DirListing *list, const char *name, unsigned char type) {
+    size_t len = strlen(name) + 1;
+    if (list->names_len + len > list->names_cap) {
+        size_t cap = list->names_cap ? list->names_cap * 2 : 4096;
+        while (cap < list->names_len + len) cap *= 2;
+        list->names = xrealloc(list->names, cap);
+        list->names_cap = cap;
+    }
+    if (list->count + 2 > list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        list->offsets = xrealloc(list->offsets, cap * sizeof(size_t));
+        list->types = xrealloc(list->types, cap);
+        list->cap = cap;
+    }
+
+    memcpy(list->names + list->names_len, name, len);
+    list->offsets[list->count] = list->names_len;
+    list->types[list->count] = type;
+    list->count++;
+    list->names_len += len;
+    list->offsets[list->count] = list->names_len;
+}
+
+#ifdef __linux__
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Read a whole directory with as few system calls as possible
+static bool read_dir(const char *path, DirListing *list, struct stat *st) {
+    static _Alignas(8) char batch[FILEGLOB_READ_SIZE];
+
+    int fd = open(path[0] ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    if (fstat(fd, st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, batch, sizeof(batch));
+        if (n <= 0) {
+            close(fd);
+            return n == 0;
+        }
+        for (long pos = 0; pos < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(batch + pos);
+            listing_add(list, d->d_name, d->d_type);
+            pos += d->d_reclen;
+        }
+    }
+}
+#else
+static bool read_dir(const char *path, DirListing *list, struct stat *st) {
+    DIR *dir = opendir(path[0] ? path : ".");
+    if (!dir) return false;
+    if (fstat(dirfd(dir), st) != 0) {
+        closedir(dir);
+        return false;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+#ifdef _DIRENT_HAVE_D_TYPE
+        listing_add(list, entry->d_name, entry->d_type);
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+        listing_add(list, entry->d_name, entry->d_type);
+#else
+        listing_add(list, entry->d_name, DT_UNKNOWN);
+#endif
+    }
+    closedir(dir);
+    return true;
+}
+#endif
+
+static size_t hash_path(const char *path, size_t len) {
+    size_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)path[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void cache_grow(void) {
+    size_t new_count = cache.bucket_count ? cache.bucket_count * 2 : FILEGLOB_CACHE_BUCKETS;
+    CachedDir **buckets = calloc(new_count, sizeof(CachedDir *));
+    if (!buckets) {
+        fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < cache.bucket_count; i++) {
+        CachedDir *d = cache.buckets[i];
+        while (d) {
+            CachedDir *next = d->next;
+            size_t slot = hash_path(d->path, strlen(d->path)) & (new_count - 1);
+            d->next = buckets[slot];
+            buckets[slot] = d;
+            d = next;
+        }
+    }
+    free(cache.buckets);
+    cache.buckets = buckets;
+    cache.bucket_count = new_count;
+}
+
+static void listing_free(DirListing *list) {
+    free(list->names);
+    free(list->offsets);
+    free(list->types);
+    memset(list, 0, sizeof(*list));
+}
+
+static void load_dir(CachedDir *d) {
+    cache.bytes -= d->list.names_len;
+    listing_free(&d->list);
+
+    time_t read_time = time(NULL);
+    struct stat st;
+    d->readable = read_dir(d->path, &d->list, &st);
+    cache.bytes += d->list.names_len;
+    if (d->readable) {
+        d->dev = st.st_dev;
+        d->ino = st.st_ino;
+        d->mtime = stat_mtime(&st);
+        // An entry added within the same clock tick as the read would leave
+        // the mtime unchanged; such listings are read again on next use
+        d->racy = d->mtime.tv_sec >= read_time - 1;
+    }
+    d->checked = cache.generation;
+}
+
+static bool dir_unchanged(const CachedDir *d) {
+    if (!d->readable || d->racy) return false;
+
+    struct stat st;
+    if (stat(d->path[0] ? d->path : ".", &st) != 0) return false;
+    struct timespec mtime = stat_mtime(&st);
+    return st.st_dev == d->dev && st.st_ino == d->ino &&
+           mtime.tv_sec == d->mtime.tv_sec && mtime.tv_nsec == d->mtime.tv_nsec;
+}
+
+// Listing of the directory named by the first len bytes of path, read on
+// first use and checked once per command after that; NULL if it cannot be read
+static const DirListing *cache_get(const char *path, size_t len) {
+    if (cache.count >= cache.bucket_count) cache_grow();
+
+    size_t slot = hash_path(path, len) & (cache.bucket_count - 1);
+    CachedDir *d = cache.buckets[slot];
+    while (d && !(strncmp(d->path, path, len) == 0 && d->path[len] == '\0')) {
+        d = d->next;
+    }
+
+    if (!d) {
+        d = calloc(1, sizeof(CachedDir));
+        if (!d) {
+            fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+            exit(EXIT_FAILURE);
+        }
+        d->path = xrealloc(NULL, len + 1);
+        memcpy(d->path, path, len);
+        d->path[len] = '\0';
+        d->next = cache.buckets[slot];
+        cache.buckets[slot] = d;
+        cache.count++;
+        load_dir(d);
+    } else if (d->checked != cache.generation) {
+        if (dir_unchanged(d)) {
+            d->checked = cache.generation;
+        } else {
+            load_dir(d);
+        }
+    }
+    return d->readable ? &d->list : NULL;
+}
+
+void fileglob_cache_recheck(void) {
+    cache.generation++;
+    if (cache.bytes > FILEGLOB_CACHE_MAX_BYTES) fileglob_cache_clear();
+}
+
+void fileglob_cache_clear(void) {
+    if (cache.count == 0) return;
+
+    for (size_t i = 0; i < cache.bucket_count; i++) {
+        CachedDir *d = cache.buckets[i];
+        while (d) {
+            CachedDir *next = d->next;
+            listing_free(&d->list);
+            free(d->path);
+            free(d);
+            d = next;
+        }
+        cache.buckets[i] = NULL;
+    }
+    cache.count = 0;
+    cache.bytes = 0;
+}
+
+// ============================================================================
+// Pattern compilation
+// ============================================================================
+
+typedef enum { TOK_CHAR, TOK_ANY, TOK_SET, TOK_STAR } TokenKind;
+
+typedef struct {
+    unsigned char kind;
+    unsigned char c;        // TOK_CHAR
+    unsigned int set;       // TOK_SET: index into the segment's sets
+} GlobToken;
+
+typedef enum { SEG_LITERAL, SEG_MATCH, SEG_GLOBSTAR } SegmentKind;
+
+typedef struct {
+    SegmentKind kind;
+    size_t slashes;         // Separators before the component, kept as written
+    char *text;             // Literal name, or the escaped pattern for fnmatch()
+    GlobToken *tokens;
+    size_t token_count;
+    uint8_t (*sets)[32];    // Bracket expressions as 256-bit sets
+    char *tail;             // Literal bytes after the last *, checked first
+    size_t tail_len;
+    size_t min_len;         // Fewest bytes a matching name can have
+    bool use_fnmatch;       // ? or [ in a multibyte locale
+} GlobSegment;
+
+static void set_add(uint8_t *set, unsigned char c) {
+    set[c >> 3] |= (uint8_t)(1u << (c & 7));
+}
+
+static bool set_has(const uint8_t *set, unsigned char c) {
+    return (set[c >> 3] >> (c & 7)) & 1;
+}
+
+// Add the bytes of a [:class:] to set; false for an unknown class
+static bool set_add_class(uint8_t *set, const char *name, size_t len) {
+    static const struct {
+        const char *name;
+        int (*test)(int);
+    } classes[] = {
+        { "alnum", isalnum }, { "alpha", isalpha }, { "blank", isblank },
+        { "cntrl", iscntrl }, { "digit", isdigit }, { "graph", isgraph },
+        { "lower", islower }, { "print", isprint }, { "punct", ispunct },
+        { "space", isspace }, { "upper", isupper }, { "xdigit", isxdigit },
+    };
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        if (strlen(classes[i].name) == len && strncmp(classes[i].name, name, len) == 0) {
+            for (int c = 1; c < 256; c++) {
+                if (classes[i].test(c)) set_add(set, (unsigned char)c);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse a bracket expression; p points at the [
+// Returns the position after the closing ], or NULL if it is not one
+static const char *parse_bracket(const char *p, const char *end, uint8_t *set) {
+    memset(set, 0, 32);
+    p++;
+    bool negate = false;
+    if (p < end && (*p == '!' || *p == '^')) {
+        negate = true;
+        p++;
+    }
+
+    bool first = true;
+    while (p < end && (*p != ']' || first)) {
+        first = false;
+        unsigned char lo;
+        if (*p == '[' && p + 1 < end && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+            // [:class:], or a [.x.] or [=x=] taken as its characters
+            char delim = p[1];
+            const char *start = p + 2;
+            const char *close = start;
+            while (close + 1 < end && !(*close == delim && close[1] == ']')) close++;
+            if (close + 1 >= end) return NULL;
+            if (delim == ':') {
+                if (!set_add_class(set, start, (size_t)(close - start))) return NULL;
+            } else {
+                for (const char *c = start; c < close; c++) set_add(set, (unsigned char)*c);
+            }
+            p = close + 2;
+            continue;
+        } else if (*p == '\\' && p + 1 < end) {
+            lo = (unsigned char)p[1];
+            p += 2;
+        } else {
+            lo = (unsigned char)*p++;
+        }
+
+        if (p + 1 < end && *p == '-' && p[1] != ']') {
+            p++;
+            unsigned char hi;
+            if (*p == '\\' && p + 1 < end) {
+                hi = (unsigned char)p[1];
+                p += 2;
+            } else {
+                hi = (unsigned char)*p++;
+            }
+            for (unsigned int c = lo; c <= hi; c++) set_add(set, (unsigned char)c);
+        } else {
+            set_add(set, lo);
+        }
+    }
+    if (p >= end) return NULL;
+
+    if (negate) {
+        for (int i = 0; i < 32; i++) set[i] = (uint8_t)~set[i];
+    }
+    set[0] &= (uint8_t)~1u;     // NUL never matches
+    return p + 1;
+}
+
+// Compile one path component of length len (still backslash-escaped)
+static void compile_segment(GlobSegment *seg, const char *text, size_t len, bool recurse) {
+    memset(seg, 0, sizeof(*seg));
+    if (recurse && len == 2 && text[0] == '*' && text[1] == '*') {
+        seg->kind = SEG_GLOBSTAR;
+        return;
+    }
+
+    const char *end = text + len;
+    seg->tokens = arena_alloc(len * sizeof(GlobToken));
+    size_t set_count = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '[') set_count++;
+    }
+    seg->sets = arena_alloc((set_count ? set_count : 1) * 32);
+
+    bool magic = false;
+    bool needs_mb = false;
+    size_t n = 0;
+    size_t sets = 0;
+    for (const char *p = text; p < end;) {
+        GlobToken *t = &seg->tokens[n];
+        if (*p == '\\' && p + 1 < end) {
+            t->kind = TOK_CHAR;
+            t->c = (unsigned char)p[1];
+            p += 2;
+        } else if (*p == '*') {
+            p++;
+            if (n > 0 && seg->tokens[n - 1].kind == TOK_STAR) continue;
+            t->kind = TOK_STAR;
+            magic = true;
+        } else if (*p == '?') {
+            t->kind = TOK_ANY;
+            p++;
+            magic = needs_mb = true;
+        } else if (*p == '[') {
+            const char *after = parse_bracket(p, end, seg->sets[sets]);
+            if (after) {
+                t->kind = TOK_SET;
+                t->set = (unsigned int)sets++;
+                p = after;
+                magic = needs_mb = true;
+            } else {
+                t->kind = TOK_CHAR;
+                t->c = '[';
+                p++;
+            }
+        } else {
+            t->kind = TOK_CHAR;
+            t->c = (unsigned char)*p++;
+        }
+        n++;
+    }
+    seg->token_count = n;
+
+    if (!magic) {
+        seg->kind = SEG_LITERAL;
+        seg->text = arena_alloc(n + 1);
+        for (size_t i = 0; i < n; i++) seg->text[i] = (char)seg->tokens[i].c;
+        seg->text[n] = '\0';
+        return;
+    }
+
+    seg->kind = SEG_MATCH;
+    if (needs_mb && MB_CUR_MAX > 1) {
+        // ? and brackets match characters, not bytes
+        seg->use_fnmatch = true;
+        seg->text = arena_strndup(text, len);
+        return;
+    }
+
+    size_t last_star = n;
+    for (size_t i = 0; i < n; i++) {
+        if (seg->tokens[i].kind == TOK_STAR) {
+            last_star = i;
+        } else {
+            seg->min_len++;
+        }
+    }
+    if (last_star < n) {
+        seg->tail = arena_alloc(n - last_star);
+        for (size_t i = last_star + 1; i < n && seg->tokens[i].kind == TOK_CHAR; i++) {
+            seg->tail[seg->tail_len++] = (char)seg->tokens[i].c;
+        }
+        // Only a run of plain bytes reaching the end can be compared directly
+        if (last_star + 1 + seg->tail_len != n) seg->tail_len = 0;
+    }
+}
+
+static bool token_matches(const GlobSegment *seg, const GlobToken *t, unsigned char c) {
+    switch (t->kind) {
+        case TOK_CHAR: return t->c == c;
+        case TOK_ANY: return true;
+        case TOK_SET: return set_has(seg->sets[t->set], c);
+        default: return false;
+    }
+}
+
+static bool segment_matches(const GlobSegment *seg, const char *name, size_t len) {
+    // A leading dot must be matched by a literal dot
+    if (name[0] == '.' && (seg->token_count == 0 || seg->tokens[0].kind != TOK_CHAR ||
+                           seg->tokens[0].c != '.')) {
+        return false;
+    }
+    if (seg->use_fnmatch) return fnmatch(seg->text, name, FNM_PERIOD) == 0;
+
+    if (len < seg->min_len) return false;
+    if (seg->tail_len && memcmp(name + len - seg->tail_len, seg->tail, seg->tail_len) != 0) {
+        return false;
+    }
+
+    // A * that failed to match is retried one byte further on; only the
+    // last * needs to be remembered
+    const GlobToken *t = seg->tokens;
+    size_t ti = 0;
+    size_t si = 0;
+    size_t star_ti = SIZE_MAX;
+    size_t star_si = 0;
+    while (si < len) {
+        if (ti < seg->token_count && t[ti].kind == TOK_STAR) {
+            star_ti = ti++;
+            star_si = si;
+        } else if (ti < seg->token_count && token_matches(seg, &t[ti], (unsigned char)name[si])) {
+            ti++;
+            si++;
+        } else if (star_ti != SIZE_MAX) {
+            ti = star_ti + 1;
+            si = ++star_si;
+        } else {
+            return false;
+        }
+    }
+    while (ti < seg->token_count && t[ti].kind == TOK_STAR) ti++;
+    return ti == seg->token_count;
+}
+
+// ============================================================================
+// Matching
+// ============================================================================
+
+typedef struct {
+    GlobSegment *segs;
+    size_t seg_count;
+    bool dir_only;          // Pattern ended in /
+    char *path;             // Path being built
+    size_t path_cap;
+    char **results;
+    size_t count;
+    size_t cap;
+} GlobWalk;
+
+// Append a component after the given number of slashes to the first len
+// bytes of the path; returns the new length
+static size_t path_append(GlobWalk *w, size_t len, size_t slashes, const char *name,
+                          size_t name_len) {
+    size_t needed = len + slashes + name_len + 1;
+    if (needed > w->path_cap) {
+        size_t cap = w->path_cap * 2;
+        while (cap < needed) cap *= 2;
+        w->path = xrealloc(w->path, cap);
+        w->path_cap = cap;
+    }
+    if (len == 0) slashes = 0;     // ** matched no directories
+    memset(w->path + len, '/', slashes);
+    len += slashes;
+    memcpy(w->path + len, name, name_len);
+    len += name_len;
+    w->path[len] = '\0';
+    return len;
+}
+
+// Directory, following symbolic links
+static bool is_dir(GlobWalk *w, unsigned char type) {
+    if (type == DT_DIR) return true;
+    if (type != DT_UNKNOWN && type != DT_LNK) return false;
+    struct stat st;
+    return stat(w->path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Directory that is not a symbolic link (** does not follow links)
+static bool is_real_dir(GlobWalk *w, unsigned char type) {
+    if (type != DT_UNKNOWN) return type == DT_DIR;
+    struct stat st;
+    return lstat(w->path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void emit(GlobWalk *w, size_t len, unsigned char type) {
+    if (len == 0) return;
+    bool slash = false;
+    if (w->dir_only) {
+        w->path[len] = '\0';
+        if (!is_dir(w, type)) return;
+        slash = w->path[len - 1] != '/';
+    }
+
+    if (w->count + 2 > w->cap) {
+        w->cap = w->cap ? w->cap * 2 : 16;
+        w->results = xrealloc(w->results, w->cap * sizeof(char *));
+    }
+    char *match = xrealloc(NULL, len + 2);
+    memcpy(match, w->path, len);
+    if (slash) match[len++] = '/';
+    match[len] = '\0';
+    w->results[w->count++] = match;
+}
+
+static void walk(GlobWalk *w, size_t i, size_t len, unsigned char type);
+
+// Separator to put before an entry found below the path
+static size_t entry_slashes(const GlobWalk *w, size_t len) {
+    return len > 0 && w->path[len - 1] != '/';
+}
+
+// Entry k of a listing
+static const char *entry_name(const DirListing *list, size_t k, size_t *name_len) {
+    *name_len = list->offsets[k + 1] - list->offsets[k] - 1;
+    return list->names + list->offsets[k];
+}
+
+// Everything below the path, for a trailing **
+static void walk_all(GlobWalk *w, size_t len) {
+    w->path[len] = '\0';
+    const DirListing *list = cache_get(w->path, len);
+    if (!list) return;
+
+    for (size_t k = 0; k < list->count; k++) {
+        size_t name_len;
+        const char *name = entry_name(list, k, &name_len);
+        if (name[0] == '.') continue;
+        size_t next = path_append(w, len, entry_slashes(w, len), name, name_len);
+        emit(w, next, list->types[k]);
+        if (is_real_dir(w, list->types[k])) walk_all(w, next);
+    }
+}
+
+// Match the rest of the pattern at every depth below the path
+static void walk_globstar(GlobWalk *w, size_t i, size_t len) {
+    walk(w, i + 1, len, DT_DIR);
+
+    w->path[len] = '\0';
+    const DirListing *list = cache_get(w->path, len);
+    if (!list) return;
+
+    for (size_t k = 0; k < list->count; k++) {
+        size_t name_len;
+        const char *name = entry_name(list, k, &name_len);
+        if (name[0] == '.') continue;
+        size_t next = path_append(w, len, entry_slashes(w, len), name, name_len);
+        if (is_real_dir(w, list->types[k])) walk_globstar(w, i, next);
+    }
+}
+
+// Match segment i and the ones after it below the first len bytes of the path
+static void walk(GlobWalk *w, size_t i, size_t len, unsigned char type) {
+    if (i == w->seg_count) {
+        emit(w, len, type);
+        return;
+    }
+
+    const GlobSegment *seg = &w->segs[i];
+    bool last = i + 1 == w->seg_count;
+
+    if (seg->kind == SEG_LITERAL) {
+        size_t next = path_append(w, len, seg->slashes, seg->text, strlen(seg->text));
+        struct stat st;
+        if (!last) {
+            walk(w, i + 1, next, DT_UNKNOWN);
+        } else if (lstat(w->path, &st) == 0) {
+            emit(w, next, DT_UNKNOWN);
+        }
+        return;
+    }
+
+    if (seg->kind == SEG_GLOBSTAR) {
+        if (last) {
+            // The directory itself, then everything in it
+            if (len > 0) {
+                bool dir_only = w->dir_only;
+                w->dir_only = true;
+                emit(w, len, DT_DIR);
+                w->dir_only = dir_only;
+            }
+            walk_all(w, len);
+        } else {
+            walk_globstar(w, i, len);
+        }
+        return;
+    }
+
+    w->path[len] = '\0';
+    const DirListing *list = cache_get(w->path, len);
+    if (!list) return;
+
+    for (size_t k = 0; k < list->count; k++) {
+        size_t name_len;
+        const char *name = entry_name(list, k, &name_len);
+        if (!segment_matches(seg, name, name_len)) continue;
+
+        size_t next = path_append(w, len, seg->slashes, name, name_len);
+        if (last) {
+            emit(w, next, list->types[k]);
+        } else if (is_dir(w, list->types[k])) {
+            walk(w, i + 1, next, DT_DIR);
+        }
+    }
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+char **fileglob_expand(const char *pattern, bool recurse, int *count) {
+    *count = 0;
+    if (!pattern || !*pattern) return NULL;
+
+    ArenaMark mark = arena_mark();
+    GlobWalk w = { 0 };
+    size_t pattern_len = strlen(pattern);
+    w.segs = arena_alloc((pattern_len / 2 + 1) * sizeof(GlobSegment));
+    w.path_cap = pattern_len + 256;
+    w.path = xrealloc(NULL, w.path_cap);
+
+    // Split on / into components; an absolute pattern starts from /
+    size_t start_len = 0;
+    const char *p = pattern;
+    while (*p == '/') w.path[start_len++] = *p++;
+    size_t slashes = 0;
+    while (*p) {
+        const char *seg_end = p;
+        while (*seg_end && *seg_end != '/') {
+            if (*seg_end == '\\' && seg_end[1]) seg_end++;
+            seg_end++;
+        }
+        GlobSegment *seg = &w.segs[w.seg_count++];
+        compile_segment(seg, p, (size_t)(seg_end - p), recurse);
+        seg->slashes = slashes;
+        p = seg_end;
+        for (slashes = 0; *p == '/'; p++) slashes++;
+        if (slashes && !*p) w.dir_only = true;
+    }
+    w.path[start_len] = '\0';
+
+    walk(&w, 0, start_len, DT_DIR);
+    free(w.path);
+    arena_release(mark);
+
+    if (w.count == 0) {
+        free(w.results);
+        return NULL;
+    }
+    qsort(w.results, w.count, sizeof(char *), compare_paths);
+    w.results[w.count] = NULL;
+    *count = (int)w.count;
+    return w.results;
+}
@@ -0,0 +1,52 @@
+#ifndef FILEGLOB_H
+#define FILEGLOB_H
+
+#include <stdbool.h>
+
+// ============================================================================
+// PATHNAME EXPANSION
+// ============================================================================
+//
+// Matches glob patterns against the file system. A pattern is compiled once
+// into per-component matchers (literal, wildcard tokens with 256-bit
+// bracket sets, or ** for any depth of directories), so each directory
+// entry is tested without reparsing the pattern. Directories are read in
+// large batches, and entry types come from d_type, so only symbolic links
+// and file systems without d_type need a stat().
+//
+// Listings are cached and shared by every pattern of one command: `cp *.c
+// *.h dir/` reads the current directory once. When the next command is
+// expanded (or a command substitution finishes) each listing is checked
+// against its directory's identity and modification time before reuse, so
+// a loop over `*.log` in an unchanged directory costs one stat() per pass.
+// Directories modified within a second of being read are always read again.
+//
+// ============================================================================
+
+/**
+ * Expand a glob pattern into the paths it matches
+ * Literal characters are escaped with a backslash, as for glob(3). Names
+ * starting with '.' only match a pattern component starting with '.'.
+ * A component that is exactly ** matches any number of directories when
+ * recurse is true, and is the same as * otherwise.
+ *
+ * @param pattern Pattern to expand
+ * @param recurse Whether ** descends into subdirectories
+ * @param count Receives the number of matches
+ * @return Sorted NULL-terminated array of paths (caller frees the array and
+ *         each string), or NULL if nothing matched
+ */
+char **fileglob_expand(const char *pattern, bool recurse, int *count);
+
+/**
+ * Check each cached listing against its directory before its next use
+ * Called between commands, which may have changed the directories.
+ */
+void fileglob_cache_recheck(void);
+
+/**
+ * Drop the cached directory listings
+ */
+void fileglob_cache_clear(void);
+
+#endif // FILEGLOB_H
@@ -6,7 +6,7 @@
 // This is NOT the limit for external command arguments - that uses ARG_MAX
 #define MAX_LINE 4096
 
-// MAX_ARGS: Internal buffer size for argument tracking during expansion
+// MAX_ARGS: Initial size of argument arrays; they double as needed
 // The actual limit for external commands is the system's ARG_MAX (queried via sysconf)
 #define MAX_ARGS 256
 
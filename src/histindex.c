@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <string.h>
+#include "histindex.h"
+
+static HistIndexNode *node_new(const char *label, size_t len) {
+    HistIndexNode *node = calloc(1, sizeof(HistIndexNode));
+    if (!node) return NULL;
+
+    node->label = malloc(len + 1);
+    if (!node->label) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->label, label, len);
+    node->label[len] = '\0';
+    node->label_len = len;
+    return node;
+}
+
+static void node_free_tree(HistIndexNode *node) {
+    while (node) {
+        HistIndexNode *next = node->next;
+        node_free_tree(node->child);
+        free(node->label);
+        free(node->entry);
+        free(node);
+        node = next;
+    }
+}
+
+static HistIndexNode *find_child(const HistIndexNode *node, char c) {
+    for (HistIndexNode *child = node->child; child; child = child->next) {
+        if (child->label[0] == c) return child;
+    }
+    return NULL;
+}
+
+static size_t common_length(const char *a, size_t a_len, const char *b, size_t b_len) {
+    size_t n = 0;
+    while (n < a_len && n < b_len && a[n] == b[n]) n++;
+    return n;
+}
+
+// Split node's label after at bytes; the tail moves into a new only child
+static int node_split(HistIndexNode *node, size_t at) {
+    HistIndexNode *tail = node_new(node->label + at, node->label_len - at);
+    if (!tail) return -1;
+
+    tail->child = node->child;
+    tail->entry = node->entry;
+    tail->count = node->count;
+    tail->seq = node->seq;
+    tail->best = node->best == node ? tail : node->best;
+
+    node->label[at] = '\0';
+    node->label_len = at;
+    node->child = tail;
+    node->entry = NULL;
+    node->count = 0;
+    node->seq = 0;
+    node->best = tail->best;
+    return 0;
+}
+
+// Fold an only child into a node that holds no line of its own
+static void node_merge_child(HistIndexNode *node) {
+    HistIndexNode *child = node->child;
+    char *label = realloc(node->label, node->label_len + child->label_len + 1);
+    if (!label) return;
+
+    memcpy(label + node->label_len, child->label, child->label_len + 1);
+    node->label = label;
+    node->label_len += child->label_len;
+    node->child = child->child;
+    node->entry = child->entry;
+    node->count = child->count;
+    node->seq = child->seq;
+
+    free(child->label);
+    free(child);
+}
+
+static void node_update_best(HistIndexNode *node) {
+    node->best = node->entry ? node : NULL;
+    for (const HistIndexNode *child = node->child; child; child = child->next) {
+        if (child->best && (!node->best || child->best->seq > node->best->seq)) {
+            node->best = child->best;
+        }
+    }
+}
+
+static int path_push(HistIndex *index, size_t depth, HistIndexNode *node) {
+    if (depth >= index->path_cap) {
+        size_t cap = index->path_cap ? index->path_cap * 2 : 64;
+        HistIndexNode **path = realloc(index->path, cap * sizeof(HistIndexNode *));
+        if (!path) return -1;
+        index->path = path;
+        index->path_cap = cap;
+    }
+    index->path[depth] = node;
+    return 0;
+}
+
+void histindex_init(HistIndex *index) {
+    memset(index, 0, sizeof(HistIndex));
+}
+
+void histindex_clear(HistIndex *index) {
+    node_free_tree(index->root.child);
+    free(index->root.entry);
+    free(index->path);
+    histindex_init(index);
+}
+
+void histindex_add(HistIndex *index, const char *line) {
+    if (!line) return;
+
+    HistIndexNode *node = &index->root;
+    size_t depth = 0;
+    const char *rest = line;
+    size_t len = strlen(line);
+
+    if (path_push(index, depth++, node) != 0) return;
+    while (len > 0) {
+        HistIndexNode *child = find_child(node, rest[0]);
+        if (!child) {
+            child = node_new(rest, len);
+            if (!child) return;
+            child->next = node->child;
+            node->child = child;
+        } else {
+            size_t common = common_length(child->label, child->label_len, rest, len);
+            if (common < child->label_len && node_split(child, common) != 0) return;
+        }
+        if (path_push(index, depth++, child) != 0) return;
+        rest += child->label_len;
+        len -= child->label_len;
+        node = child;
+    }
+
+    if (!node->entry) {
+        node->entry = strdup(line);
+        if (!node->entry) return;
+    }
+    node->count++;
+    node->seq = ++index->seq;
+
+    // The newest line is the best match for every prefix on its path
+    for (size_t i = 0; i < depth; i++) {
+        index->path[i]->best = node;
+    }
+}
+
+void histindex_remove(HistIndex *index, const char *line) {
+    if (!line) return;
+
+    HistIndexNode *node = &index->root;
+    size_t depth = 0;
+    const char *rest = line;
+    size_t len = strlen(line);
+
+    if (path_push(index, depth++, node) != 0) return;
+    while (len > 0) {
+        node = find_child(node, rest[0]);
+        if (!node || node->label_len > len || memcmp(node->label, rest, node->label_len) != 0) {
+            return;
+        }
+        if (path_push(index, depth++, node) != 0) return;
+        rest += node->label_len;
+        len -= node->label_len;
+    }
+
+    if (!node->entry || --node->count > 0) return;
+    free(node->entry);
+    node->entry = NULL;
+    node->seq = 0;
+
+    // Prune and re-rank bottom-up; only nodes on the path can change
+    for (size_t i = depth; i-- > 0;) {
+        HistIndexNode *cur = index->path[i];
+        if (i > 0 && !cur->entry && !cur->child) {
+            HistIndexNode *parent = index->path[i - 1];
+            HistIndexNode **link = &parent->child;
+            while (*link != cur) link = &(*link)->next;
+            *link = cur->next;
+            free(cur->label);
+            free(cur);
+            continue;
+        }
+        if (i > 0 && !cur->entry && cur->child && !cur->child->next) {
+            node_merge_child(cur);
+        }
+        node_update_best(cur);
+    }
+}
+
+const char *histindex_find(const HistIndex *index, const char *prefix) {
+    if (!prefix) return NULL;
+
+    const HistIndexNode *node = &index->root;
+    size_t len = strlen(prefix);
+
+    while (len > 0) {
+        node = find_child(node, prefix[0]);
+        if (!node) return NULL;
+
+        size_t common = common_length(node->label, node->label_len, prefix, len);
+        if (common == len) break;  // Prefix ends on this edge
+        if (common < node->label_len) return NULL;
+        prefix += common;
+        len -= common;
+    }
+
+    return node->best ? node->best->entry : NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef HISTINDEX_H
+#define HISTINDEX_H
+
+#include <stddef.h>
+
+// ============================================================================
+// HISTORY PREFIX INDEX
+// ============================================================================
+//
+// A radix tree over the distinct lines in history. Every node remembers the
+// most recently added line in its subtree, so the newest line starting with
+// a prefix is found by walking the prefix alone, independent of how many
+// entries the history holds. Autosuggestions query it on every keystroke.
+//
+// ============================================================================
+
+typedef struct HistIndexNode {
+    char *label;                        // Edge label from the parent
+    size_t label_len;
+    struct HistIndexNode *child;        // First child
+    struct HistIndexNode *next;         // Next sibling
+    char *entry;                        // Line ending at this node, or NULL
+    int count;                          // History entries holding this line
+    unsigned long seq;                  // When the line was last added
+    const struct HistIndexNode *best;   // Most recent line in this subtree
+} HistIndexNode;
+
+typedef struct {
+    HistIndexNode root;
+    unsigned long seq;                  // Last sequence number handed out
+    HistIndexNode **path;               // Scratch: nodes visited by add/remove
+    size_t path_cap;
+} HistIndex;
+
+/**
+ * Initialize an empty index
+ *
+ * @param index Index to initialize
+ */
+void histindex_init(HistIndex *index);
+
+/**
+ * Free all nodes of an index, leaving it empty
+ *
+ * @param index Index to clear
+ */
+void histindex_clear(HistIndex *index);
+
+/**
+ * Record a line added to history; it becomes the most recent match for
+ * each of its prefixes
+ *
+ * @param index Index to update
+ * @param line Line that was added
+ */
+void histindex_add(HistIndex *index, const char *line);
+
+/**
+ * Record that one history entry holding line was dropped
+ * Lines still held by other entries stay in the index.
+ *
+ * @param index Index to update
+ * @param line Line that was removed
+ */
+void histindex_remove(HistIndex *index, const char *line);
+
+/**
+ * Find the most recently added line starting with prefix
+ *
+ * @param index Index to search
+ * @param prefix Prefix to match
+ * @return Matching line (owned by the index), or NULL if none
+ */
+const char *histindex_find(const HistIndex *index, const char *prefix);
+
+#endif // HISTINDEX_H
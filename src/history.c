@@ -6,11 +6,17 @@
 #include <unistd.h>
 #include <pwd.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include "history.h"
+#include "histindex.h"
 #include "safe_string.h"
 #include "colors.h"
 #include "hash.h"
+#include "shellvar.h"
 #include "utils.h"
 
 // History storage
@@ -20,10 +26,12 @@ static int history_filesize = 0;   // Max entries in file (HISTFILESIZE)
 static int history_count_val = 0;  // Current count
 static int history_start = 0;      // For circular buffer
 static int history_position = -1;  // Current position for navigation
+static int history_file_lines = 0; // Entries in the history file (as far as we know)
+static HistIndex prefix_index;     // Newest entry for each prefix (autosuggest)
 
 // Get history size from environment
 static int get_histsize(void) {
-    const char *histsize = getenv("HISTSIZE");
+    const char *histsize = shellvar_get("HISTSIZE");
     if (histsize) {
         int size = atoi(histsize);
         if (size == -1) return -1;  // Unlimited
@@ -34,7 +42,7 @@ static int get_histsize(void) {
 
 // Get history file size from environment
 static int get_histfilesize(void) {
-    const char *histfilesize = getenv("HISTFILESIZE");
+    const char *histfilesize = shellvar_get("HISTFILESIZE");
     if (histfilesize) {
         int size = atoi(histfilesize);
         if (size == -1) return -1;  // Unlimited
@@ -45,13 +53,13 @@ static int get_histfilesize(void) {
 
 // Get history file path
 static void get_history_path(char *path, size_t size) {
-    const char *histfile = getenv("HISTFILE");
+    const char *histfile = shellvar_get("HISTFILE");
     if (histfile) {
         safe_strcpy(path, histfile, size);
         return;
     }
 
-    const char *home = getenv("HOME");
+    const char *home = shellvar_get("HOME");
     if (!home) {
         struct passwd pw;
         struct passwd *result = NULL;
@@ -71,7 +79,7 @@ static void get_history_path(char *path, size_t size) {
 
 // Check HISTCONTROL setting
 static int should_ignore_space(void) {
-    const char *histcontrol = getenv("HISTCONTROL");
+    const char *histcontrol = shellvar_get("HISTCONTROL");
     if (!histcontrol) return 1;  // Default: ignore space
 
     return (strstr(histcontrol, "ignorespace") != NULL ||
@@ -79,7 +87,7 @@ static int should_ignore_space(void) {
 }
 
 static int should_ignore_dups(void) {
-    const char *histcontrol = getenv("HISTCONTROL");
+    const char *histcontrol = shellvar_get("HISTCONTROL");
     if (!histcontrol) return 1;  // Default: ignore dups
 
     return (strstr(histcontrol, "ignoredups") != NULL ||
@@ -87,7 +95,7 @@ static int should_ignore_dups(void) {
 }
 
 static int should_erase_dups(void) {
-    const char *histcontrol = getenv("HISTCONTROL");
+    const char *histcontrol = shellvar_get("HISTCONTROL");
     if (!histcontrol) return 0;
 
     return strstr(histcontrol, "erasedups") != NULL;
@@ -141,6 +149,7 @@ static void erase_duplicates(const char *line) {
         int idx = history_index(i);
         if (idx >= 0 && history[idx] && strcmp(history[idx], line) == 0) {
             // Found duplicate, remove it
+            histindex_remove(&prefix_index, history[idx]);
             free(history[idx]);
 
             // Shift everything after it down
@@ -157,6 +166,69 @@ static void erase_duplicates(const char *line) {
     }
 }
 
+// Open the history file and take a lock on it (released by close)
+static int history_open_locked(const char *path, int flags, int operation) {
+    int fd = open(path, flags | O_CLOEXEC, 0600);
+    if (fd == -1) return -1;
+
+    while (flock(fd, operation) == -1) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+static int write_fully(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Lines the file may grow past HISTFILESIZE before it is compacted
+static int compact_slack(int filesize) {
+    return filesize / 2 > HISTORY_COMPACT_MIN_SLACK ? filesize / 2 : HISTORY_COMPACT_MIN_SLACK;
+}
+
+// Append one entry to the history file
+// Other shells append to the same file, so it is never rewritten here;
+// the file is only trimmed once it is well past HISTFILESIZE
+static void history_append(const char *line) {
+    char history_path[1024];
+    get_history_path(history_path, sizeof(history_path));
+
+    if (history_path[0] == '\0') return;
+
+    int fd = history_open_locked(history_path, O_WRONLY | O_CREAT | O_APPEND, LOCK_EX);
+    if (fd == -1) return;
+
+    // One write per entry, so concurrent readers never see half a line
+    size_t len = strlen(line);
+    char *entry = malloc(len + 1);
+    if (entry) {
+        memcpy(entry, line, len);
+        entry[len] = '\n';
+        if (write_fully(fd, entry, len + 1) == 0) {
+            history_file_lines++;
+        }
+        free(entry);
+    }
+    close(fd);
+
+    int filesize = get_histfilesize();
+    if (filesize != -1 && history_file_lines > filesize + compact_slack(filesize)) {
+        history_compact();
+    }
+}
+
 // Add command to history
 void history_add(const char *line) {
     if (!line || *line == '\0' || !history) return;
@@ -200,6 +272,7 @@ void history_add(const char *line) {
         } else {
             // Allocation failed, remove oldest
             if (history_count_val > 0) {
+                histindex_remove(&prefix_index, history[history_start]);
                 free(history[history_start]);
                 history[history_start] = NULL;
                 history_start = (history_start + 1) % history_size;
@@ -208,6 +281,7 @@ void history_add(const char *line) {
         }
     } else if (histsize_limit != -1 && history_count_val >= histsize_limit) {
         // Limited size - remove oldest entry
+        histindex_remove(&prefix_index, history[history_start]);
         free(history[history_start]);
         history[history_start] = NULL;
         history_start = (history_start + 1) % history_size;
@@ -219,13 +293,14 @@ void history_add(const char *line) {
     history[idx] = strdup(line);
     if (history[idx]) {
         history_count_val++;
+        histindex_add(&prefix_index, line);
     }
 
     // Reset position to end
     history_position = -1;
 
     // Save immediately to file
-    history_save();
+    history_append(line);
 }
 
 // Get history entry
@@ -289,16 +364,7 @@ void history_reset_position(void) {
 const char *history_search_prefix(const char *prefix) {
     if (!prefix || *prefix == '\0') return NULL;
 
-    size_t prefix_len = strlen(prefix);
-
-    for (int i = history_count_val - 1; i >= 0; i--) {
-        const char *cmd = history_get(i);
-        if (cmd && strncmp(cmd, prefix, prefix_len) == 0) {
-            return cmd;
-        }
-    }
-
-    return NULL;
+    return histindex_find(&prefix_index, prefix);
 }
 
 // Search for command containing substring
@@ -441,8 +507,20 @@ void history_save(void) {
 
     if (history_path[0] == '\0') return;
 
-    FILE *fp = fopen(history_path, "w");
-    if (!fp) return;
+    // Truncate only once the lock is held, so appends from other shells
+    // are not lost in between
+    int fd = history_open_locked(history_path, O_WRONLY | O_CREAT, LOCK_EX);
+    if (fd == -1) return;
+    if (ftruncate(fd, 0) == -1) {
+        close(fd);
+        return;
+    }
+
+    FILE *fp = fdopen(fd, "w");
+    if (!fp) {
+        close(fd);
+        return;
+    }
 
     // Determine how many entries to write
     int filesize = get_histfilesize();
@@ -462,6 +540,139 @@ void history_save(void) {
     }
     fflush(fp);
     fclose(fp);
+    history_file_lines = entries_to_write;
+}
+
+// Drop every line of data that appears again later, keeping the newest
+// copy in place; returns the new size
+static size_t drop_earlier_duplicates(char *data, size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\n') count++;
+    }
+    if (size > 0 && data[size - 1] != '\n') count++;
+    if (count < 2) return size;
+
+    size_t slot_count = 16;
+    while (slot_count < count * 2) slot_count *= 2;
+    size_t *starts = malloc((count + 1) * sizeof(size_t));
+    size_t *slots = calloc(slot_count, sizeof(size_t));  // line number + 1, 0 is empty
+    bool *keep = malloc(count * sizeof(bool));
+    if (!starts || !slots || !keep) {
+        free(starts);
+        free(slots);
+        free(keep);
+        return size;
+    }
+
+    size_t n = 0;
+    starts[n++] = 0;
+    for (size_t i = 0; i < size && n < count; i++) {
+        if (data[i] == '\n') starts[n++] = i + 1;
+    }
+    starts[count] = size;
+
+    // Newest first, so the copy that survives is the last one
+    for (size_t line = count; line-- > 0;) {
+        const char *text = data + starts[line];
+        size_t len = starts[line + 1] - starts[line];
+        if (len > 0 && text[len - 1] == '\n') len--;
+
+        unsigned int hash = 2166136261u;
+        for (size_t i = 0; i < len; i++) {
+            hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+        }
+
+        keep[line] = true;
+        size_t slot = hash & (slot_count - 1);
+        while (slots[slot]) {
+            size_t other = slots[slot] - 1;
+            size_t other_len = starts[other + 1] - starts[other];
+            if (other_len > 0 && data[starts[other + 1] - 1] == '\n') other_len--;
+            if (other_len == len && memcmp(data + starts[other], text, len) == 0) {
+                keep[line] = false;
+                break;
+            }
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        if (keep[line]) slots[slot] = line + 1;
+    }
+
+    size_t out = 0;
+    for (size_t line = 0; line < count; line++) {
+        if (!keep[line]) continue;
+        size_t len = starts[line + 1] - starts[line];
+        memmove(data + out, data + starts[line], len);
+        out += len;
+    }
+
+    free(starts);
+    free(slots);
+    free(keep);
+    return out;
+}
+
+// Trim the history file to its last HISTFILESIZE entries
+// With erasedups, earlier copies of repeated entries are dropped as well:
+// entries are appended as they are added, so the file holds duplicates
+// until it is next compacted
+void history_compact(void) {
+    int filesize = get_histfilesize();
+    bool erase = should_erase_dups();
+    if (filesize == -1 && !erase) return;
+
+    char history_path[1024];
+    get_history_path(history_path, sizeof(history_path));
+
+    if (history_path[0] == '\0') return;
+
+    int fd = history_open_locked(history_path, O_RDWR, LOCK_EX);
+    if (fd == -1) return;
+
+    struct stat st;
+    char *data = NULL;
+    if (fstat(fd, &st) == -1 || st.st_size == 0 || !(data = malloc((size_t)st.st_size))) {
+        close(fd);
+        return;
+    }
+
+    size_t size = 0;
+    while (size < (size_t)st.st_size) {
+        ssize_t n = read(fd, data + size, (size_t)st.st_size - size);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        size += (size_t)n;
+    }
+    size_t read_size = size;
+    if (erase) size = drop_earlier_duplicates(data, size);
+
+    int total = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\n') total++;
+    }
+    if (size > 0 && data[size - 1] != '\n') total++;
+
+    // Skip the oldest entries beyond the limit
+    size_t start = 0;
+    int kept = total;
+    if (filesize != -1 && total > filesize) {
+        kept = filesize;
+        for (int skip = total - filesize; skip > 0 && start < size; start++) {
+            if (data[start] == '\n') skip--;
+        }
+    }
+
+    // Rewrite in place under the lock; appenders wait for it
+    if (start == 0 && size == read_size) {
+        history_file_lines = total;
+    } else if (lseek(fd, 0, SEEK_SET) == 0 &&
+               write_fully(fd, data + start, size - start) == 0 &&
+               ftruncate(fd, (off_t)(size - start)) == 0) {
+        history_file_lines = kept;
+    }
+
+    free(data);
+    close(fd);
 }
 
 // Load history from file
@@ -471,18 +682,24 @@ void history_load(void) {
 
     if (history_path[0] == '\0') return;
 
-    FILE *fp = fopen(history_path, "r");
-    if (!fp) return;
+    int fd = history_open_locked(history_path, O_RDONLY, LOCK_SH);
+    if (fd == -1) return;
+    FILE *fp = fdopen(fd, "r");
+    if (!fp) {
+        close(fd);
+        return;
+    }
+    history_file_lines = 0;
 
     // Save old HISTCONTROL
-    const char *old_histcontrol = getenv("HISTCONTROL");
+    const char *old_histcontrol = shellvar_get("HISTCONTROL");
     char saved_histcontrol[256] = {0};
     if (old_histcontrol) {
         safe_strcpy(saved_histcontrol, old_histcontrol, sizeof(saved_histcontrol));
     }
 
     // Temporarily disable HISTCONTROL during load
-    unsetenv("HISTCONTROL");
+    shellvar_unset("HISTCONTROL");
 
     char line[HISTORY_MAX_LINE];
     while (fgets(line, sizeof(line), fp)) {
@@ -493,6 +710,7 @@ void history_load(void) {
             line[len - 1] = '\0';
         }
 
+        history_file_lines++;
         if (line[0] != '\0') {
             // Check if we need to grow or wrap
             if (history_count_val >= history_size) {
@@ -513,6 +731,7 @@ void history_load(void) {
                     }
                 } else {
                     // Wrap around
+                    histindex_remove(&prefix_index, history[history_start]);
                     free(history[history_start]);
                     history[history_start] = NULL;
                     history_start = (history_start + 1) % history_size;
@@ -524,6 +743,7 @@ void history_load(void) {
             history[idx] = strdup(line);
             if (history[idx]) {
                 history_count_val++;
+                histindex_add(&prefix_index, line);
             }
         }
     }
@@ -532,7 +752,7 @@ void history_load(void) {
 
     // Restore HISTCONTROL
     if (saved_histcontrol[0] != '\0') {
-        setenv("HISTCONTROL", saved_histcontrol, 1);
+        shellvar_set("HISTCONTROL", saved_histcontrol);
     }
 
     history_reset_position();
@@ -551,4 +771,5 @@ void history_clear(void) {
     history_count_val = 0;
     history_start = 0;
     history_position = -1;
+    histindex_clear(&prefix_index);
 }
@@ -6,6 +6,7 @@
 #define HISTORY_DEFAULT_SIZE 1000
 #define HISTORY_DEFAULT_FILESIZE 2000
 #define HISTORY_MAX_LINE 4096
+#define HISTORY_COMPACT_MIN_SLACK 100  // Entries past HISTFILESIZE before trimming
 
 /**
  * Initialize history system
@@ -110,9 +111,19 @@ char *history_expand(const char *line);
 
 /**
  * Save history to ~/.hash_history
+ * Replaces the file with the in-memory history (history -w).
  */
 void history_save(void);
 
+/**
+ * Trim ~/.hash_history to its newest HISTFILESIZE entries
+ * New entries are appended as they are added, so the file is only
+ * compacted once it grows well past the limit and when the shell exits.
+ * Entries appended by other shells are kept. With HISTCONTROL=erasedups
+ * only the newest copy of each entry is kept.
+ */
+void history_compact(void);
+
 /**
  * Load history from ~/.hash_history
  */
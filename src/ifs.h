@@ -1,23 +1,40 @@
 #ifndef IFS_H
 #define IFS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 // Default IFS value (space, tab, newline) per POSIX
 #define DEFAULT_IFS " \t\n"
 
+// Classes of bytes in an IfsTable
+#define IFS_NONE    0       // Not in IFS: part of a field
+#define IFS_WHITE   1       // Space, tab or newline in IFS
+#define IFS_DELIM   2       // Any other IFS character
+
+// Separators that are compared eight bytes at a time
+#define IFS_WORD_MAX 4
+
+// Classification of every byte by the current IFS, rebuilt when IFS changes
+typedef struct {
+    unsigned char type[256];    // IFS_* for each byte
+    bool empty;                 // IFS is set to "": no splitting
+    int distinct;               // Number of distinct IFS bytes
+    uint64_t splat[IFS_WORD_MAX]; // Each IFS byte repeated in all eight lanes
+} IfsTable;
+
 // Get current IFS value from shell variable or default
 // Returns DEFAULT_IFS if IFS is unset
 // Returns empty string if IFS is set to empty (disables splitting)
 const char *ifs_get(void);
 
-// Check if character is an IFS whitespace character
-// IFS whitespace chars are: space, tab, newline that appear in IFS
-int ifs_is_whitespace(char c, const char *ifs);
+// Get the classification table for the current IFS
+// The table is rebuilt only when the value of IFS differs from the last call
+const IfsTable *ifs_table(void);
 
-// Perform IFS word splitting on argument array
-// Splits content within \x03...\x03 markers on IFS characters
-// May grow the argument array (one arg can become multiple)
-// Returns 0 on success, -1 on error
-// If splitting occurred, *args_ptr is updated to new array
-int ifs_split_args(char ***args_ptr, int *arg_count);
+// Length of the run of non-IFS bytes at the start of s (at most len)
+// Scans eight bytes at a time when IFS has few distinct characters
+size_t ifs_field_length(const IfsTable *table, const char *s, size_t len);
 
 #endif
@@ -19,6 +19,10 @@ static int next_job_id = 1;
 static int current_job = 0;  // Most recent job
 static pid_t last_bg_pid = 0;  // PID of most recent background job (for $!)
 
+// Helper process outside the job table, and whether the handler reaped it
+static volatile pid_t helper_pid = 0;
+static volatile sig_atomic_t helper_reaped = 0;
+
 // Initialize job control
 void jobs_init(void) {
     // Clear job table
@@ -424,6 +428,9 @@ void jobs_sigchld_handler(int sig) {
 
     // Reap all terminated children (but not stopped ones)
     while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0) {
+        if (pid == helper_pid && (WIFEXITED(status) || WIFSIGNALED(status))) {
+            helper_reaped = 1;
+        }
         const Job *job = jobs_get_by_pid(pid);
         if (job) {
             // Only update if terminated, not stopped
@@ -437,6 +444,15 @@ void jobs_sigchld_handler(int sig) {
     errno = saved_errno;
 }
 
+void jobs_watch_helper(pid_t pid) {
+    helper_pid = pid;
+    helper_reaped = 0;
+}
+
+bool jobs_helper_outstanding(pid_t pid) {
+    return pid > 0 && pid == helper_pid && !helper_reaped;
+}
+
 // Get last background PID (for $!)
 pid_t jobs_get_last_bg_pid(void) {
     return last_bg_pid;
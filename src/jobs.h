@@ -138,6 +138,25 @@ int jobs_background(int job_id);
  */
 void jobs_sigchld_handler(int sig);
 
+/**
+ * Watch a helper process that is not a job (e.g. the prompt's git worker)
+ * Call with SIGCHLD blocked from before the process is started, so the
+ * handler cannot reap it unnoticed. Only the latest helper is watched.
+ *
+ * @param pid Process ID of the helper
+ */
+void jobs_watch_helper(pid_t pid);
+
+/**
+ * Check whether a watched helper has not been reaped yet
+ * Call with SIGCHLD blocked; once reaped, its pid may belong to another
+ * process and must not be signalled.
+ *
+ * @param pid Process ID of the helper
+ * @return true if pid is the watched helper and is still outstanding
+ */
+bool jobs_helper_outstanding(pid_t pid);
+
 /**
  * Get the PID of the most recently started background job
  * Used for $! expansion
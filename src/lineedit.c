@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
 #include <unistd.h>
 #include <termios.h>
 #include <ctype.h>
@@ -20,6 +22,7 @@
 #include "color_config.h"
 #include "colors.h"
 #include "autosuggest.h"
+#include "prompt.h"
 
 #define MAX_LINE_LENGTH 4096
 
@@ -1163,6 +1166,29 @@ static void handle_default(LineEdit *edit, int c) {
     }
 }
 
+// Wait for a key, redrawing the prompt if the git worker reports meanwhile
+static void wait_for_key(const LineEdit *edit) {
+    int git_fd;
+    while ((git_fd = prompt_git_worker_fd()) >= 0) {
+        struct pollfd fds[2] = {
+            { .fd = STDIN_FILENO, .events = POLLIN },
+            { .fd = git_fd, .events = POLLIN }
+        };
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        if (fds[1].revents && prompt_git_poll() && !search_state.active) {
+            // Only redraw the primary prompt, which lives in the same buffer
+            if (prompt_regenerate() == edit->prompt) {
+                refresh_line(edit);
+            }
+        }
+        if (fds[0].revents) return;
+    }
+}
+
 // Read a line with editing capabilities
 char *lineedit_read_line(const char *prompt) {
     static LineEdit edit = (LineEdit){0};
@@ -1204,6 +1230,7 @@ char *lineedit_read_line(const char *prompt) {
     fflush(stdout);
 
     while (1) {
+        wait_for_key(&edit);
         int c = read_key();
 
         if (c == -1) break;
@@ -290,9 +290,8 @@ int main(int argc, char *argv[]) {
 
     // Ensure PATH is set - if not inherited, set a sensible default
     // This ensures child processes can find standard commands like osascript
-    if (!getenv("PATH")) {
+    if (!shellvar_get("PATH")) {
         const char *default_path = "/usr/local/bin:/usr/bin:/bin:/usr/sbin:/sbin";
-        setenv("PATH", default_path, 1);
         shellvar_set("PATH", default_path);
         shellvar_set_export("PATH");
     }
@@ -395,33 +394,10 @@ int main(int argc, char *argv[]) {
         }
 
         // Read and execute from stdin
-        char line[MAX_LINE];
-        script_state.in_script = true;
-
-        int result = 1;
-        while (1) {
-            // Clear buffer before each read to prevent corruption
-            // when lines don't end with newline
-            memset(line, 0, sizeof(line));
-            if (!fgets(line, sizeof(line), stdin)) break;
-            // Remove trailing newline
-            size_t len = strlen(line);
-            if (len > 0 && line[len - 1] == '\n') {
-                line[len - 1] = '\0';
-            }
+        int result = script_execute_stdin();
 
-            result = script_process_line(line);
-            // Exit if the exit command was called (returns 0)
-            if (result == 0) {
-                break;
-            }
-        }
-
-        script_state.in_script = false;
-
-        // Check for unclosed control structures
-        if (script_state.context_depth > 0) {
-            fprintf(stderr, "%s: unexpected end of file\n", HASH_NAME);
+        // Input ended inside an unfinished command
+        if (result < 0) {
             trap_execute_exit();
             script_cleanup();
             return 1;
@@ -495,6 +471,9 @@ int main(int argc, char *argv[]) {
     // Run Command Loop
     loop();
 
+    // Trim the history file that was appended to during the session
+    history_compact();
+
     // Run logout scripts for login shells
     if (is_login_shell_global) {
         config_load_logout_files();
@@ -6,6 +6,7 @@
 #include "parser.h"
 #include "lineedit.h"
 #include "utils.h"
+#include "cmdsub.h"
 
 typedef struct {
     int bufsize;
@@ -16,6 +17,7 @@ typedef struct {
     char *write_pos;
     int in_single_quote;
     int in_double_quote;
+    int in_array_list;     // Inside the parentheses of name=(...)
     size_t token_start_idx;
     int token_has_content; // Track if current token has any content (including empty quotes)
 } Parser;
@@ -39,10 +41,28 @@ static void skip_whitespace(Parser *parser) {
     }
 }
 
+// Add the token that starts at token_start_idx, doubling the array when full
+static void push_token(Parser *parser) {
+    parser->tokens[parser->position] = &parser->output[parser->token_start_idx];
+    parser->position++;
+
+    if (parser->position >= parser->bufsize) {
+        parser->bufsize *= 2;
+        char **new_tokens = realloc(parser->tokens, parser->bufsize * sizeof(char*));
+        if (!new_tokens) {
+            free(parser->tokens);
+            free(parser->output);
+            fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+            exit(EXIT_FAILURE);
+        }
+        parser->tokens = new_tokens;
+    }
+}
+
 static void mark_and_write_char(Parser *parser) {
     // Special characters inside quotes - use SOH marker (\x01) to prevent special handling
     // Handles: $ in single quotes, ~ in any quotes, glob chars (*, ?, [) in any quotes,
-    // redirect/pipe operators (<, >, |, &, ;) in any quotes
+    // redirect/pipe operators (<, >, |, &, ;) and brace expansion ({, }, ,) in any quotes
     *parser->write_pos++ = '\x01';
     *parser->write_pos++ = *parser->read_pos++;
 }
@@ -96,8 +116,9 @@ static void handle_backslash(Parser *parser) {
             parser->read_pos++;
         } else {
             // Remove backslash, keep the character
-            // If it's a glob character, redirection operator, or tilde, mark it to prevent special handling
-            if (char_in_string(*parser->read_pos, "*?[<>|&;~")) {
+            // If it's a glob character, redirection operator, tilde or brace expansion
+            // character, mark it to prevent special handling
+            if (char_in_string(*parser->read_pos, "*?[<>|&;~{},")) {
                 mark_and_write_char(parser); // Marker to prevent special interpretation
                 return;
             }
@@ -106,6 +127,26 @@ static void handle_backslash(Parser *parser) {
     }
 }
 
+// A quote ends a $name reference: when a name character or a brace follows,
+// write the reference as ${name} so that brace expansion or the following
+// text cannot extend the name ("$x"a is $x followed by a)
+static void end_name_at_quote(Parser *parser) {
+    char next = *parser->read_pos;
+    if (!isalnum((unsigned char)next) && next != '_' && next != '{') return;
+
+    char *start = parser->output + parser->token_start_idx;
+    char *name = parser->write_pos;
+    while (name > start && (isalnum((unsigned char)name[-1]) || name[-1] == '_')) name--;
+    if (name == parser->write_pos || name == start || name[-1] != '$') return;
+    if (name - 1 > start && name[-2] == '\x01') return;  // Literal $
+
+    size_t len = (size_t)(parser->write_pos - name);
+    memmove(name + 1, name, len);
+    *name = '{';
+    parser->write_pos++;
+    *parser->write_pos++ = '}';
+}
+
 static void handle_doller(Parser *parser) {
     if (parser->in_single_quote) {
         mark_and_write_char(parser);
@@ -140,15 +181,12 @@ static void handle_doller(Parser *parser) {
         }
         *parser->write_pos++ = *parser->read_pos++;  // $
         *parser->write_pos++ = *parser->read_pos++;  // (
-        int depth = 1;
-        while (*parser->read_pos && depth > 0) {
-            if (*parser->read_pos == '(') {
-                depth++;
-            } else if (*parser->read_pos == ')') {
-                depth--;
-            }
-            *parser->write_pos++ = *parser->read_pos++;
-        }
+        // The matching ) skips case patterns, which close no parenthesis
+        const char *end = cmdsub_find_end(parser->read_pos, false);
+        size_t len = end ? (size_t)(end - parser->read_pos) + 1 : strlen(parser->read_pos);
+        memcpy(parser->write_pos, parser->read_pos, len);
+        parser->write_pos += len;
+        parser->read_pos += len;
     } else if (*(parser->read_pos + 1) == '{') {
         // ${...} parameter expansion - keep everything until matching }
         // Must track nested braces for constructs like ${var:-${default}}
@@ -218,11 +256,15 @@ static void handle_doller(Parser *parser) {
 static void handle_backtick(Parser *parser) {
     if (parser->in_single_quote) {
         // In single quotes, backtick is literal
-        *parser->write_pos++ = *parser->read_pos++;
+        mark_and_write_char(parser);
         return;
     }
 
     // Backtick command substitution - keep everything until matching `
+    // Mark as quoted if inside double quotes - don't split or glob the output
+    if (parser->in_double_quote) {
+        *parser->write_pos++ = '\x02';
+    }
     *parser->write_pos++ = *parser->read_pos++;  // Opening `
     while (*parser->read_pos && *parser->read_pos != '`') {
         if (*parser->read_pos == '\\' && *(parser->read_pos + 1) == '`') {
@@ -240,6 +282,17 @@ static void handle_backtick(Parser *parser) {
 
 static void handle_space(Parser *parser) {
     if (parser->in_single_quote || parser->in_double_quote) {
+        if (parser->in_array_list) {
+            // Quoted blank inside name=(...) does not separate elements
+            mark_and_write_char(parser);
+        } else {
+            *parser->write_pos++ = *parser->read_pos++;
+        }
+        return;
+    }
+
+    if (parser->in_array_list) {
+        // Elements of name=(...) are separated later; the list is one token
         *parser->write_pos++ = *parser->read_pos++;
         return;
     }
@@ -249,20 +302,7 @@ static void handle_space(Parser *parser) {
 
     // Add token to array if it has content (including empty quoted strings)
     if (parser->output[parser->token_start_idx] != '\0' || parser->token_has_content) {
-        parser->tokens[parser->position] = &parser->output[parser->token_start_idx];
-        parser->position++;
-
-        if (parser->position >= parser->bufsize) {
-            parser->bufsize += MAX_ARGS;
-            char **new_tokens = realloc(parser->tokens, parser->bufsize * sizeof(char*));
-            if (!new_tokens) {
-                free(parser->tokens);
-                free(parser->output);
-                fprintf(stderr, "%s: allocation error\n", HASH_NAME);
-                exit(EXIT_FAILURE);
-            }
-            parser->tokens = new_tokens;
-        }
+        push_token(parser);
     }
 
     // Skip whitespace
@@ -301,19 +341,7 @@ static void handle_angle_bracket(Parser *parser) {
     // Otherwise, end current token first
     if (!token_is_fd_number && (current_token_len > 0 || parser->token_has_content)) {
         *parser->write_pos++ = '\0';
-        parser->tokens[parser->position] = &parser->output[parser->token_start_idx];
-        parser->position++;
-        if (parser->position >= parser->bufsize) {
-            parser->bufsize += MAX_ARGS;
-            char **new_tokens = realloc(parser->tokens, parser->bufsize * sizeof(char*));
-            if (!new_tokens) {
-                free(parser->tokens);
-                free(parser->output);
-                fprintf(stderr, "%s: allocation error\n", HASH_NAME);
-                exit(EXIT_FAILURE);
-            }
-            parser->tokens = new_tokens;
-        }
+        push_token(parser);
         parser->token_start_idx = (size_t)(parser->write_pos - parser->output);
     }
     // Now collect the redirection operator (>, >>, <, <<, etc.)
@@ -329,23 +357,45 @@ static void handle_angle_bracket(Parser *parser) {
     }
     // End this token
     *parser->write_pos++ = '\0';
-    parser->tokens[parser->position] = &parser->output[parser->token_start_idx];
-    parser->position++;
-    if (parser->position >= parser->bufsize) {
-        parser->bufsize += MAX_ARGS;
-        char **new_tokens = realloc(parser->tokens, parser->bufsize * sizeof(char*));
-        if (!new_tokens) {
-            free(parser->tokens);
-            free(parser->output);
-            fprintf(stderr, "%s: allocation error\n", HASH_NAME);
-            exit(EXIT_FAILURE);
-        }
-        parser->tokens = new_tokens;
-    }
+    push_token(parser);
     parser->token_start_idx = (size_t)(parser->write_pos - parser->output);
     parser->token_has_content = 0;
 }
 
+// Check whether the token so far is name= or name+= (unquoted)
+static bool token_is_assignment_prefix(const Parser *parser) {
+    const char *s = parser->output + parser->token_start_idx;
+    size_t n = (size_t)(parser->write_pos - s);
+    if (n < 2 || s[n - 1] != '=') return false;
+    n--;
+    if (s[n - 1] == '+') n--;
+    if (n == 0 || !(isalpha((unsigned char)s[0]) || s[0] == '_')) return false;
+    for (size_t i = 1; i < n; i++) {
+        if (!isalnum((unsigned char)s[i]) && s[i] != '_') return false;
+    }
+    return true;
+}
+
+static void handle_paren(Parser *parser) {
+    bool quoted = parser->in_single_quote || parser->in_double_quote;
+    if (quoted) {
+        if (parser->in_array_list) {
+            mark_and_write_char(parser);
+        } else {
+            *parser->write_pos++ = *parser->read_pos++;
+        }
+        return;
+    }
+
+    // name=( starts an array list, kept in the token up to the closing )
+    if (*parser->read_pos == '(' && !parser->in_array_list && token_is_assignment_prefix(parser)) {
+        parser->in_array_list = 1;
+    } else if (*parser->read_pos == ')' && parser->in_array_list) {
+        parser->in_array_list = 0;
+    }
+    *parser->write_pos++ = *parser->read_pos++;
+}
+
 static void handle_tilde(Parser *parser) {
     if (parser->in_single_quote || parser->in_double_quote) {
         mark_and_write_char(parser);
@@ -386,6 +436,7 @@ ParseResult parse_line(const char *line) {
         .position = 0,
         .in_single_quote = 0,
         .in_double_quote = 0,
+        .in_array_list = 0,
         .token_start_idx = 0,
         .token_has_content = 0,
     };
@@ -424,6 +475,7 @@ ParseResult parse_line(const char *line) {
                     parser.in_single_quote = !parser.in_single_quote;
                     parser.token_has_content = 1;  // Mark that this token exists (even if empty after quotes)
                     parser.read_pos++;
+                    end_name_at_quote(&parser);
                     continue;
                 }
                 break;
@@ -434,6 +486,7 @@ ParseResult parse_line(const char *line) {
                     parser.in_double_quote = !parser.in_double_quote;
                     parser.token_has_content = 1;  // Mark that this token exists (even if empty after quotes)
                     parser.read_pos++;
+                    end_name_at_quote(&parser);
                     continue;
                 }
                 break;
@@ -455,12 +508,20 @@ ParseResult parse_line(const char *line) {
                 handle_tilde(&parser);
                 continue;
 
+            case '(':
+            case ')':
+                handle_paren(&parser);
+                continue;
+
             case '*':
             case '?':
             case '[':
             case '|':
             case '&':
             case ';':
+            case '{':
+            case '}':
+            case ',':
                 if (parser.in_single_quote || parser.in_double_quote) {
                     mark_and_write_char(&parser);
                     continue;
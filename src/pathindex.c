@@ -0,0 +1,253 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "pathindex.h"
+#include "shellvar.h"
+
+#define PATHINDEX_DEFAULT_PATH "/usr/bin:/bin"
+
+typedef struct {
+    char *dir;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    bool exists;
+    bool racy;              // Modified too close to the scan to trust mtime
+} PathDir;
+
+typedef struct {
+    char *name;
+    unsigned int dir;       // Index into dirs, in PATH order
+    bool exec;              // Executable when the directory was scanned
+} PathEntry;
+
+static struct {
+    char *path;             // PATH value the index was built for
+    PathDir *dirs;
+    size_t dir_count;
+    PathEntry *entries;     // Sorted by name, then PATH order
+    size_t count;
+    size_t cap;
+    unsigned long generation;
+} pindex;
+
+static struct timespec stat_mtime(const struct stat *st) {
+#ifdef __APPLE__
+    return st->st_mtimespec;
+#else
+    return st->st_mtim;
+#endif
+}
+
+static void stamp_dir(PathDir *d, time_t scan_time) {
+    struct stat st;
+    if (stat(d->dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        d->exists = false;
+        return;
+    }
+
+    d->exists = true;
+    d->dev = st.st_dev;
+    d->ino = st.st_ino;
+    d->mtime = stat_mtime(&st);
+    // An entry added within the same clock tick as the scan would leave
+    // the mtime unchanged; such directories are rescanned on next use
+    d->racy = d->mtime.tv_sec >= scan_time - 1;
+}
+
+static bool dir_unchanged(const PathDir *d) {
+    if (d->racy) return false;
+
+    struct stat st;
+    if (stat(d->dir, &st) != 0 || !S_ISDIR(st.st_mode)) return !d->exists;
+    if (!d->exists) return false;
+
+    struct timespec mtime = stat_mtime(&st);
+    return st.st_dev == d->dev && st.st_ino == d->ino &&
+           mtime.tv_sec == d->mtime.tv_sec && mtime.tv_nsec == d->mtime.tv_nsec;
+}
+
+static void free_entries(void) {
+    for (size_t i = 0; i < pindex.count; i++) {
+        free(pindex.entries[i].name);
+    }
+    pindex.count = 0;
+}
+
+void pathindex_clear(void) {
+    free_entries();
+    free(pindex.entries);
+    pindex.entries = NULL;
+    pindex.cap = 0;
+
+    for (size_t i = 0; i < pindex.dir_count; i++) {
+        free(pindex.dirs[i].dir);
+    }
+    free(pindex.dirs);
+    pindex.dirs = NULL;
+    pindex.dir_count = 0;
+
+    free(pindex.path);
+    pindex.path = NULL;
+    pindex.generation++;
+}
+
+static int add_entry(const char *name, unsigned int dir, bool exec) {
+    if (pindex.count >= pindex.cap) {
+        size_t cap = pindex.cap ? pindex.cap * 2 : 1024;
+        PathEntry *entries = realloc(pindex.entries, cap * sizeof(PathEntry));
+        if (!entries) return -1;
+        pindex.entries = entries;
+        pindex.cap = cap;
+    }
+
+    char *copy = strdup(name);
+    if (!copy) return -1;
+    pindex.entries[pindex.count].name = copy;
+    pindex.entries[pindex.count].dir = dir;
+    pindex.entries[pindex.count].exec = exec;
+    pindex.count++;
+    return 0;
+}
+
+static void scan_dir(unsigned int idx) {
+    DIR *dp = opendir(pindex.dirs[idx].dir);
+    if (!dp) return;
+
+    int fd = dirfd(dp);
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+#ifdef DT_DIR
+        if (entry->d_type == DT_DIR) continue;
+#endif
+        bool exec = faccessat(fd, name, X_OK, 0) == 0;
+        if (add_entry(name, idx, exec) != 0) break;
+    }
+
+    closedir(dp);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const PathEntry *ea = a;
+    const PathEntry *eb = b;
+    int cmp = strcmp(ea->name, eb->name);
+    if (cmp != 0) return cmp;
+    return (ea->dir > eb->dir) - (ea->dir < eb->dir);
+}
+
+static void rebuild(const char *path) {
+    pathindex_clear();
+
+    pindex.path = strdup(path);
+    if (!pindex.path) return;
+
+    // Empty components are skipped, as in the PATH search itself
+    size_t max_dirs = 1;
+    for (const char *p = path; *p; p++) {
+        if (*p == ':') max_dirs++;
+    }
+    pindex.dirs = calloc(max_dirs, sizeof(PathDir));
+    if (!pindex.dirs) return;
+
+    time_t scan_time = time(NULL);
+    const char *p = path;
+    while (*p) {
+        size_t len = strcspn(p, ":");
+        if (len > 0) {
+            PathDir *d = &pindex.dirs[pindex.dir_count];
+            d->dir = strndup(p, len);
+            if (!d->dir) break;
+            stamp_dir(d, scan_time);
+            scan_dir((unsigned int)pindex.dir_count);
+            pindex.dir_count++;
+        }
+        p += len;
+        if (*p == ':') p++;
+    }
+
+    qsort(pindex.entries, pindex.count, sizeof(PathEntry), compare_entries);
+}
+
+// Bring the index up to date with PATH and the directories it names
+static void refresh(void) {
+    const char *path = shellvar_get("PATH");
+    if (!path) path = PATHINDEX_DEFAULT_PATH;
+
+    if (pindex.path && strcmp(pindex.path, path) == 0) {
+        size_t i = 0;
+        while (i < pindex.dir_count && dir_unchanged(&pindex.dirs[i])) i++;
+        if (i == pindex.dir_count) return;
+    }
+
+    rebuild(path);
+}
+
+// First entry whose name is not less than key
+static size_t lower_bound(const char *key, size_t key_len) {
+    size_t lo = 0;
+    size_t hi = pindex.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncmp(pindex.entries[mid].name, key, key_len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+char *pathindex_find(const char *name) {
+    if (!name || !*name || strchr(name, '/')) return NULL;
+
+    refresh();
+
+    size_t len = strlen(name);
+    for (size_t i = lower_bound(name, len + 1);
+         i < pindex.count && strcmp(pindex.entries[i].name, name) == 0; i++) {
+        const PathEntry *e = &pindex.entries[i];
+        char full[PATH_MAX];
+        if (snprintf(full, sizeof(full), "%s/%s", pindex.dirs[e->dir].dir, name) >= (int)sizeof(full)) {
+            continue;
+        }
+        // Permissions can change without touching the directory
+        if (access(full, X_OK) == 0) return strdup(full);
+    }
+
+    return NULL;
+}
+
+int pathindex_complete(const char *prefix, const char **names, int max) {
+    if (!prefix || !names || max <= 0) return 0;
+
+    refresh();
+
+    size_t prefix_len = strlen(prefix);
+    int n = 0;
+    for (size_t i = lower_bound(prefix, prefix_len);
+         i < pindex.count && n < max && strncmp(pindex.entries[i].name, prefix, prefix_len) == 0; i++) {
+        const PathEntry *e = &pindex.entries[i];
+        if (!e->exec) continue;
+        if (n > 0 && strcmp(names[n - 1], e->name) == 0) continue;
+        names[n++] = e->name;
+    }
+
+    return n;
+}
+
+unsigned long pathindex_generation(void) {
+    refresh();
+    return pindex.generation;
+}
@@ -0,0 +1,51 @@
+#ifndef PATHINDEX_H
+#define PATHINDEX_H
+
+#include <stddef.h>
+
+// ============================================================================
+// PATH EXECUTABLE INDEX
+// ============================================================================
+//
+// One sorted listing of the entries in every PATH directory, shared by
+// command lookup, Tab completion and syntax highlighting. It is rebuilt
+// when PATH changes or when a directory's identity or modification time
+// changes, so a query costs one stat() per PATH directory instead of a
+// readdir() or access() scan.
+//
+// ============================================================================
+
+/**
+ * Find the first executable named name in PATH
+ * PATH defaults to /usr/bin:/bin when unset.
+ *
+ * @param name Command name (must not contain '/')
+ * @return Full path (caller must free), or NULL if not found
+ */
+char *pathindex_find(const char *name);
+
+/**
+ * List the distinct executable names in PATH starting with prefix
+ *
+ * @param prefix Prefix to match
+ * @param names Receives the names in sorted order (owned by the index,
+ *              valid until the next query)
+ * @param max Capacity of names
+ * @return Number of names stored
+ */
+int pathindex_complete(const char *prefix, const char **names, int max);
+
+/**
+ * Get a number that changes whenever the index is rebuilt
+ * Lets callers that cache lookups notice new or removed commands.
+ *
+ * @return Current generation
+ */
+unsigned long pathindex_generation(void);
+
+/**
+ * Drop the index; the next query rebuilds it
+ */
+void pathindex_clear(void);
+
+#endif // PATHINDEX_H
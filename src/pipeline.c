@@ -1,13 +1,17 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <signal.h>
 #include <errno.h>
 #include <ctype.h>
+#include <limits.h>
 #include "hash.h"
 #include "pipeline.h"
 #include "parser.h"
@@ -15,32 +19,82 @@
 #include "safe_string.h"
 #include "redirect.h"
 #include "builtins.h"
-#include "varexpand.h"
-#include "expand.h"
-#include "cmdsub.h"
-#include "arith.h"
 #include "script.h"
+#include "wordexpand.h"
+#include "shellvar.h"
+#include "config.h"
 
 extern int last_command_exit_code;
 
-// Check if string is a valid variable assignment (VAR=VALUE)
-// Returns pointer to '=' if valid, NULL otherwise
-static char *is_var_assignment(const char *arg) {
-    if (!arg) return NULL;
+// Pipe capacity commands of fcntl(); glibc only declares them for _GNU_SOURCE
+#if defined(__linux__) && !defined(F_SETPIPE_SZ)
+#define F_SETPIPE_SZ 1031
+#endif
+
+// HASH_PIPE_SIZE as last read, and the capacity it asks for (0 keeps the
+// kernel's default). A failed resize is reported once per setting.
+static char *pipe_size_text;
+static int pipe_size;
+static bool pipe_size_warned;
+
+// Parse a size in bytes with an optional K or M suffix
+// Returns -1 if the text is not a positive size
+static long parse_pipe_size(const char *text) {
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (errno != 0 || end == text || value <= 0) return -1;
+
+    long unit = 1;
+    if (*end == 'k' || *end == 'K') {
+        unit = 1024;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        unit = 1024 * 1024;
+        end++;
+    }
+    if (*end != '\0' || value > INT_MAX / unit) return -1;
+    return value * unit;
+}
 
-    char *equals = strchr(arg, '=');
-    if (!equals || equals == arg) return NULL;
+// Capacity HASH_PIPE_SIZE asks for, parsed again only when it changes
+static int configured_pipe_size(void) {
+    const char *text = shellvar_get("HASH_PIPE_SIZE");
+    if (!text || !*text) return 0;
+    if (pipe_size_text && strcmp(text, pipe_size_text) == 0) return pipe_size;
+
+    free(pipe_size_text);
+    pipe_size_text = strdup(text);
+    pipe_size_warned = false;
+    long size = parse_pipe_size(text);
+    if (size < 0) {
+        fprintf(stderr, "%s: HASH_PIPE_SIZE: invalid size: %s\n", HASH_NAME, text);
+        size = 0;
+    }
+    pipe_size = (int)size;
+    return pipe_size;
+}
 
-    // Check if characters before = form a valid variable name
-    for (const char *p = arg; p < equals; p++) {
-        if (p == arg) {
-            if (!isalpha(*p) && *p != '_') return NULL;
-        } else {
-            if (!isalnum(*p) && *p != '_') return NULL;
+int pipeline_pipe(int fds[2]) {
+    if (pipe(fds) == -1) return -1;
+
+#ifdef F_SETPIPE_SZ
+    int size = configured_pipe_size();
+    if (size > 0) {
+        // The kernel rounds up to a power of two pages; above
+        // /proc/sys/fs/pipe-max-size only privileged processes may go
+        int set = fcntl(fds[1], F_SETPIPE_SZ, size);
+#ifdef DEBUG
+        fprintf(stderr, "DEBUG: pipe size %d requested, %d set\n", size, set);
+#endif
+        if (set == -1 && !pipe_size_warned) {
+            fprintf(stderr, "%s: HASH_PIPE_SIZE: cannot resize pipe to %d bytes: %s\n",
+                    HASH_NAME, size, strerror(errno));
+            pipe_size_warned = true;
         }
     }
-
-    return equals;
+#endif
+    return 0;
 }
 
 // Check if a command is a compound command (brace group or subshell)
@@ -179,185 +233,224 @@ Pipeline *pipeline_parse(char *line) {
     return pipeline;
 }
 
-// Calls _exit()
-static void run_child_process(const Pipeline *pipeline, int (*pipes)[2], int num_pipes, int i) {
-    // Child process
-
-    // Set up input (stdin)
-    if (i > 0) {
-        // Not first command - read from previous pipe
-        dup2(pipes[i - 1][0], STDIN_FILENO);
-    }
-
-    // Set up output (stdout)
-    if (i < pipeline->count - 1) {
-        // Not last command - write to next pipe
-        dup2(pipes[i][1], STDOUT_FILENO);
-    }
-
-    // Close all pipe file descriptors
-    for (int j = 0; j < num_pipes; j++) {
-        close(pipes[j][0]);
-        close(pipes[j][1]);
-    }
+// Run one stage of a text pipeline (called in the forked child)
+// Returns the exit status for the child
+static int run_text_stage(int i, void *data) {
+    const Pipeline *pipeline = data;
 
     // Check if this is a compound command (brace group or subshell)
     // If so, execute via script_execute_string which handles these properly
     if (is_compound_command(pipeline->commands[i].cmd_line)) {
-        // Replace newlines with semicolons to handle multi-line compound commands
-        // script_execute_string tokenizes by newlines, which would break up the command
-        char *cmd_copy = strdup(pipeline->commands[i].cmd_line);
-        if (cmd_copy) {
-            for (char *p = cmd_copy; *p; p++) {
-                if (*p == '\n') *p = ';';
-            }
-        }
-        int result = script_execute_string(cmd_copy ? cmd_copy : pipeline->commands[i].cmd_line);
-        free(cmd_copy);
-        fflush(stdout);
-        fflush(stderr);
-        _exit(result < 0 ? EXIT_FAILURE : last_command_exit_code);
+        int result = script_execute_string(pipeline->commands[i].cmd_line);
+        return result < 0 ? EXIT_FAILURE : last_command_exit_code;
     }
 
     // Parse and execute command
     char *line_copy = strdup(pipeline->commands[i].cmd_line);
-    if (!line_copy) _exit(EXIT_FAILURE);
+    if (!line_copy) return EXIT_FAILURE;
 
     ParseResult parsed = parse_line(line_copy);
     if (!parsed.tokens) {
         free(line_copy);
-        _exit(EXIT_FAILURE);
+        return EXIT_FAILURE;
     }
-    char **args = parsed.tokens;
-
-    // Perform variable expansion, command substitution, and arithmetic expansion
-    expand_tilde(args);
-    cmdsub_args(args);
-    arith_args(args);
-    varexpand_args(args, last_command_exit_code);
-
-    // Count args for glob expansion
-    int arg_count = 0;
-    while (args[arg_count] != NULL) arg_count++;
-
-    // Glob (pathname) expansion
-    char **glob_args = args;
-    int glob_arg_count = arg_count;
-    expand_glob(&glob_args, &glob_arg_count);
-
-    // Use expanded args if glob expansion happened
-    if (glob_args != args) {
-        free(args);
-        args = glob_args;
+    // Expand words into fields (quoting is removed by the expansion)
+    FieldList fields;
+    fieldlist_init(&fields);
+    int expand_rc = wordexpand_command(parsed.tokens, &fields);
+    free(parsed.tokens);
+    free(parsed.buffer);
+    free(line_copy);
+    if (expand_rc != 0) {
+        fieldlist_free(&fields);
+        return EXIT_FAILURE;
     }
 
-    // Parse redirections (before stripping markers, so escaped operators aren't treated as redirections)
-    RedirInfo *redir = redirect_parse(args);
-    char **exec_args = redir ? redir->args : args;
-
-    // Strip quote markers after redirect parsing
-    strip_quote_markers_args(exec_args);
-
     // Handle prefix variable assignments (VAR=value cmd)
-    // Count prefix assignments and set them in the environment
     int prefix_count = 0;
-    while (exec_args[prefix_count] && is_var_assignment(exec_args[prefix_count])) {
+    while (fields.fields[prefix_count] && (fields.flags[prefix_count] & FIELD_ASSIGNMENT)) {
+        char *equals = strchr(fields.fields[prefix_count], '=');
+        *equals = '\0';
+        shellvar_set(fields.fields[prefix_count], equals + 1);
+        shellvar_set_export(fields.fields[prefix_count]);
+        *equals = '=';
         prefix_count++;
     }
 
-    // Set prefix variables in environment and shift exec_args to actual command
-    if (prefix_count > 0 && exec_args[prefix_count] != NULL) {
-        for (int j = 0; j < prefix_count; j++) {
-            char *equals = is_var_assignment(exec_args[j]);
-            *equals = '\0';
-            const char *name = exec_args[j];
-            const char *value = equals + 1;
-            setenv(name, value, 1);
-            *equals = '=';  // Restore for potential debugging
-        }
-        // Point exec_args past the prefix assignments to the actual command
-        exec_args = &exec_args[prefix_count];
-    }
+    // Parse redirections of the command after the assignments
+    char **cmd_fields = fields.fields + prefix_count;
+    RedirInfo *redir = redirect_parse_fields(cmd_fields, fields.flags + prefix_count);
+    char **exec_args = redir ? redir->args : cmd_fields;
 
     // Apply redirections
     if (redir && redirect_apply(redir) != 0) {
         redirect_free(redir);
-        free(parsed.buffer);
-        free(args);
-        free(line_copy);
-        _exit(EXIT_FAILURE);
+        fieldlist_free(&fields);
+        return EXIT_FAILURE;
+    }
+
+    // Nothing left to run (assignments or redirections only)
+    if (!exec_args[0]) {
+        redirect_free(redir);
+        fieldlist_free(&fields);
+        return EXIT_SUCCESS;
     }
 
     // Try builtin first (handles times, echo, etc. in pipelines)
     int builtin_result = try_builtin(exec_args);
     if (builtin_result != -1) {
-        // It was a builtin - flush output and exit with appropriate code
-        fflush(stdout);
-        fflush(stderr);
+        // It was a builtin - exit with appropriate code
         redirect_free(redir);
-        free(parsed.buffer);
-        free(args);
-        free(line_copy);
-        _exit(builtin_result == 1 ? 0 : builtin_result);
+        fieldlist_free(&fields);
+        return builtin_result == 1 ? 0 : builtin_result;
     }
 
     // Not a builtin - execute as external command
-    if (execvp(exec_args[0], exec_args) == -1) {
+    char *cmd_path = cmd_hash_find(exec_args[0]);
+    if (execute_exec_path(cmd_path, exec_args) == -1) {
         perror(HASH_NAME);
     }
+    free(cmd_path);
 
     redirect_free(redir);
-    free(parsed.buffer);
-    free(args);
-    free(line_copy);
-    _exit(EXIT_FAILURE);
+    fieldlist_free(&fields);
+    return EXIT_FAILURE;
 }
 
-// Execute a pipeline
-int pipeline_execute(const Pipeline *pipeline) {
-    if (!pipeline || pipeline->count == 0) return -1;
-    if (pipeline->count == 1) return -1;  // Single command, shouldn't be here
+// Exit status of a waited stage, as $? reports it
+static int stage_status(pid_t wpid, int status) {
+    if (wpid > 0 && WIFEXITED(status)) return WEXITSTATUS(status);
+    if (wpid > 0 && WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 1;
+}
+
+static long timeval_ms(const struct timeval *tv) {
+    return (long)tv->tv_sec * 1000 + (long)(tv->tv_usec / 1000);
+}
+
+// CPU time used by this shell and its waited children, in milliseconds
+static void shell_cpu_ms(long *user, long *sys) {
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    *user = timeval_ms(&self.ru_utime) + timeval_ms(&children.ru_utime);
+    *sys = timeval_ms(&self.ru_stime) + timeval_ms(&children.ru_stime);
+}
+
+// Set PIPESTATUS and PIPESTATS from the stages' statuses and usage
+static void record_stages(int count, const int *statuses, const struct rusage *usage) {
+    shellvar_set_pipestatus(statuses, count);
+
+    // "status user sys maxrss": CPU seconds and peak resident size in KB
+    char (*text)[80] = malloc(count * sizeof(*text));
+    ShellVarElement *elems = malloc(count * sizeof(ShellVarElement));
+    if (text && elems) {
+        for (int i = 0; i < count; i++) {
+            long user = timeval_ms(&usage[i].ru_utime);
+            long sys = timeval_ms(&usage[i].ru_stime);
+            snprintf(text[i], sizeof(text[i]), "%d %ld.%03ld %ld.%03ld %ld", statuses[i],
+                     user / 1000, user % 1000, sys / 1000, sys % 1000, usage[i].ru_maxrss);
+            elems[i].key = NULL;
+            elems[i].value = text[i];
+        }
+        shellvar_array_assign("PIPESTATS", elems, count, false);
+    }
+    free(text);
+    free(elems);
+}
+
+// Run stages connected by pipes and wait for all of them
+int pipeline_run(int count, int (*run_stage)(int index, void *data),
+                 int (*run_last)(void *data), void *data) {
+    if (count < 1 || !run_stage) return -1;
+    if (count < 2) run_last = NULL;
+    int forked = run_last ? count - 1 : count;
 
-    int num_pipes = pipeline->count - 1;
-    int (*pipes)[2] = malloc(num_pipes * sizeof(int[2]));
-    pid_t *pids = malloc(pipeline->count * sizeof(pid_t));
+    int num_pipes = count - 1;
+    int (*pipes)[2] = malloc((num_pipes > 0 ? num_pipes : 1) * sizeof(int[2]));
+    pid_t *pids = malloc(count * sizeof(pid_t));
+    int *statuses = malloc(count * sizeof(int));
+    struct rusage *usage = calloc(count, sizeof(struct rusage));
 
-    if (!pipes || !pids) {
+    if (!pipes || !pids || !statuses || !usage) {
         free(pipes);
         free(pids);
+        free(statuses);
+        free(usage);
         return -1;
     }
 
     // Create all pipes
     for (int i = 0; i < num_pipes; i++) {
-        if (pipe(pipes[i]) == -1) {
+        if (pipeline_pipe(pipes[i]) == -1) {
             perror("pipe");
+            for (int j = 0; j < i; j++) {
+                close(pipes[j][0]);
+                close(pipes[j][1]);
+            }
             free(pipes);
             free(pids);
+            free(statuses);
+            free(usage);
             return -1;
         }
     }
 
+    // Flush before forking so children don't inherit buffered output
+    fflush(stdout);
+    fflush(stderr);
+
+    // Block SIGCHLD until every stage has been waited for
+    // This prevents the SIGCHLD handler from reaping our children
+    sigset_t block_mask, old_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block_mask, &old_mask);
+
     // Fork and execute each command
-    for (int i = 0; i < pipeline->count; i++) {
+    int started = 0;
+    for (int i = 0; i < forked; i++) {
         pids[i] = fork();
 
         if (pids[i] == -1) {
             perror("fork");
-            // Clean up pipes
+            break;
+        }
+
+        if (pids[i] == 0) {
+            // Child process
+            sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+            // Not first command - read from previous pipe
+            if (i > 0) {
+                dup2(pipes[i - 1][0], STDIN_FILENO);
+            }
+
+            // Not last command - write to next pipe
+            if (i < count - 1) {
+                dup2(pipes[i][1], STDOUT_FILENO);
+            }
+
+            // Close all pipe file descriptors
             for (int j = 0; j < num_pipes; j++) {
                 close(pipes[j][0]);
                 close(pipes[j][1]);
             }
-            free(pipes);
-            free(pids);
-            return -1;
-        }
 
-        if (pids[i] == 0) {
-            // run_child_process calls _exit()
-            run_child_process(pipeline, pipes, num_pipes, i);
+            int status = run_stage(i, data);
+            fflush(stdout);
+            fflush(stderr);
+            _exit(status);
         }
+        started++;
+    }
+
+    // The last stage runs in this shell, reading from the last pipe
+    int saved_stdin = -1;
+    bool run_here = run_last && started == forked;
+    if (run_here) {
+        saved_stdin = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+        dup2(pipes[num_pipes - 1][0], STDIN_FILENO);
     }
 
     // Parent process - close all pipes
@@ -366,41 +459,77 @@ int pipeline_execute(const Pipeline *pipeline) {
         close(pipes[i][1]);
     }
 
-    // Block SIGCHLD while waiting for pipeline processes
-    // This prevents the SIGCHLD handler from reaping our children
-    sigset_t block_mask, old_mask;
-    sigemptyset(&block_mask);
-    sigaddset(&block_mask, SIGCHLD);
-    sigprocmask(SIG_BLOCK, &block_mask, &old_mask);
+    if (run_here) {
+        long user_before, sys_before;
+        shell_cpu_ms(&user_before, &sys_before);
+        statuses[count - 1] = run_last(data);
+        fflush(stdout);
 
-    // Wait for all children
-    int last_exit_code = 0;
-    for (int i = 0; i < pipeline->count; i++) {
+        // The stage's usage is what the shell and the children it waited
+        // for used meanwhile; its peak size is the shell's
+        long user_after, sys_after;
+        shell_cpu_ms(&user_after, &sys_after);
+        struct rusage *last = &usage[count - 1];
+        last->ru_utime.tv_sec = (user_after - user_before) / 1000;
+        last->ru_utime.tv_usec = (user_after - user_before) % 1000 * 1000;
+        last->ru_stime.tv_sec = (sys_after - sys_before) / 1000;
+        last->ru_stime.tv_usec = (sys_after - sys_before) % 1000 * 1000;
+        struct rusage self;
+        getrusage(RUSAGE_SELF, &self);
+        last->ru_maxrss = self.ru_maxrss;
+
+        // Closing the pipe lets earlier stages see the reader is gone
+        if (saved_stdin >= 0) {
+            dup2(saved_stdin, STDIN_FILENO);
+            close(saved_stdin);
+        } else {
+            close(STDIN_FILENO);
+        }
+    }
+
+    // Wait for all children, collecting each one's status and usage
+    for (int i = 0; i < started; i++) {
         int status;
         pid_t wpid;
         do {
-            wpid = waitpid(pids[i], &status, 0);
+            wpid = wait4(pids[i], &status, 0, &usage[i]);
         } while (wpid == -1 && errno == EINTR);
-
-        // Track exit code of last command
-        if (i == pipeline->count - 1) {
-            if (wpid > 0 && WIFEXITED(status)) {
-                last_exit_code = WEXITSTATUS(status);
-            } else if (wpid > 0 && WIFSIGNALED(status)) {
-                last_exit_code = 128 + WTERMSIG(status);
-            } else {
-                last_exit_code = 1;
-            }
-        }
+        statuses[i] = stage_status(wpid, status);
     }
 
     // Restore SIGCHLD handling
     sigprocmask(SIG_SETMASK, &old_mask, NULL);
 
+    int result = -1;
+    if (started == forked) {
+        record_stages(count, statuses, usage);
+
+        // With pipefail the rightmost failing stage decides the status
+        result = statuses[count - 1];
+        if (shell_option_pipefail()) {
+            result = 0;
+            for (int i = count - 1; i >= 0; i--) {
+                if (statuses[i] != 0) {
+                    result = statuses[i];
+                    break;
+                }
+            }
+        }
+    }
+
     free(pipes);
     free(pids);
+    free(statuses);
+    free(usage);
+    return result;
+}
+
+// Execute a pipeline
+int pipeline_execute(const Pipeline *pipeline) {
+    if (!pipeline || pipeline->count == 0) return -1;
+    if (pipeline->count == 1) return -1;  // Single command, shouldn't be here
 
-    return last_exit_code;
+    return pipeline_run(pipeline->count, run_text_stage, NULL, (void *)pipeline);
 }
 
 // Free pipeline
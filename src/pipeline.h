@@ -30,6 +30,35 @@ Pipeline *pipeline_parse(char *line);
  */
 int pipeline_execute(const Pipeline *pipeline);
 
+/**
+ * Run stages connected by pipes
+ * Forks one child per stage with stdin/stdout wired to its neighbours and
+ * calls run_stage in it; the return value becomes the child's exit status.
+ * Shared by text pipelines and compiled script pipelines.
+ *
+ * When run_last is given, the last stage is not forked: run_last is called
+ * in this shell with stdin reading from the pipe, which is restored before
+ * the other stages are waited for (lastpipe).
+ *
+ * @param count Number of stages
+ * @param run_stage Stage body, called in the child with the stage index
+ * @param run_last Body of the last stage run in this shell, or NULL
+ * @param data Passed through to run_stage and run_last
+ * @return Exit code of the last stage, or -1 on error
+ */
+int pipeline_run(int count, int (*run_stage)(int index, void *data),
+                 int (*run_last)(void *data), void *data);
+
+/**
+ * Create a pipe for a pipeline or command substitution
+ * When HASH_PIPE_SIZE is set, the pipe's capacity is set to it with
+ * F_SETPIPE_SZ (Linux); failing that, the default capacity is kept.
+ *
+ * @param fds Receives the read and write ends, as pipe() does
+ * @return 0 on success, -1 on error
+ */
+int pipeline_pipe(int fds[2]);
+
 /**
  * Free a pipeline structure
  *
@@ -3,7 +3,14 @@
 #include <string.h>
 #include <unistd.h>
 #include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <pwd.h>
 #include "prompt.h"
 #include "colors.h"
@@ -12,6 +19,7 @@
 #include "cmdsub.h"
 #include "varexpand.h"
 #include "jobs.h"
+#include "shellvar.h"
 #include "utils.h"
 
 PromptConfig prompt_config;
@@ -26,7 +34,7 @@ void prompt_init(void) {
 void prompt_set_fancy_default(void) {
     // Only set fancy default if PS1 is not already in environment
     // and no custom PS1 has been configured
-    if (getenv("PS1") == NULL && !prompt_config.use_custom_ps1) {
+    if (shellvar_get("PS1") == NULL && !prompt_config.use_custom_ps1) {
         prompt_config.use_custom_ps1 = true;
         // Default PS1: <path> git:(branch) #>
         safe_strcpy(prompt_config.ps1, "\\w\\g \\e#>\\e", MAX_PROMPT_LENGTH);
@@ -41,46 +49,332 @@ void prompt_set_ps1(const char *ps1) {
     prompt_config.use_custom_ps1 = true;
 }
 
-char *prompt_git_branch(void) {
-    FILE *fp = popen("git rev-parse --abbrev-ref HEAD 2>/dev/null", "r");
-    if (!fp) return NULL;
+// ============================================================================
+// Git status
+// ============================================================================
+//
+// The branch is read straight from HEAD in the repository's git directory.
+// Whether the work tree is dirty is only known by running git status, which
+// can take a long time in a large repository, so it runs in a background
+// worker. The prompt shows the last known state for the repository at once
+// and is redrawn by the line editor when the worker reports.
+
+#define GIT_CACHE_SIZE 8
+
+// Identity of a file, enough to notice that git rewrote it
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    bool exists;
+} GitStamp;
+
+typedef struct {
+    char git_dir[PATH_MAX];
+    GitStamp index;
+    GitStamp head;
+    bool dirty;
+    bool valid;
+    unsigned long serial;   // Prompt the state was last refreshed for
+} GitDirtyEntry;
+
+static struct {
+    GitDirtyEntry entries[GIT_CACHE_SIZE];
+    size_t next_victim;
+    unsigned long serial;       // Bumped for every new prompt
+    pid_t pid;                  // Running worker, or 0
+    int fd;                     // Read end of the worker's stdout
+    char git_dir[PATH_MAX];     // Repository the worker is checking
+    GitStamp index;             // Stamps taken when the worker started
+    GitStamp head;
+    unsigned long launch_serial;
+} git_state = { .fd = -1 };
+
+static void git_stamp(GitStamp *stamp, const char *git_dir, const char *name) {
+    char path[PATH_MAX];
+    struct stat st;
+
+    memset(stamp, 0, sizeof(GitStamp));
+    if (snprintf(path, sizeof(path), "%s/%s", git_dir, name) >= (int)sizeof(path)) return;
+    if (stat(path, &st) != 0) return;
+
+    stamp->dev = st.st_dev;
+    stamp->ino = st.st_ino;
+    stamp->size = st.st_size;
+    stamp->mtime = st.st_mtime;
+    stamp->exists = true;
+}
 
-    static char branch[256];
-    if (fgets(branch, sizeof(branch), fp) != NULL) {
-        // Ensure null termination
-        branch[sizeof(branch) - 1] = '\0';
-
-        // Remove newline safely
-        size_t len = safe_strlen(branch, sizeof(branch));
-        if (len > 0 && branch[len - 1] == '\n') {
-            branch[len - 1] = '\0';
-        }
+static bool git_stamp_equal(const GitStamp *a, const GitStamp *b) {
+    return a->exists == b->exists && a->dev == b->dev && a->ino == b->ino &&
+           a->size == b->size && a->mtime == b->mtime;
+}
+
+// Read the first line of a small file, without the newline
+static bool read_first_line(const char *path, char *buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n <= 0) return false;
 
-        pclose(fp);
+    buf[n] = '\0';
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return true;
+}
+
+// Find the git directory and work tree containing the current directory
+// A .git file (worktrees, submodules) names the real directory with "gitdir:"
+static bool git_find_dirs(char *git_dir, char *work_tree, size_t size) {
+    char dir[PATH_MAX];
+    if (!getcwd(dir, sizeof(dir))) return false;
+
+    while (1) {
+        char path[PATH_MAX];
+        struct stat st;
+
+        if (snprintf(path, sizeof(path), "%s/.git", strcmp(dir, "/") == 0 ? "" : dir) < (int)sizeof(path) &&
+            stat(path, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                safe_strcpy(git_dir, path, size);
+                safe_strcpy(work_tree, dir, size);
+                return true;
+            }
+
+            char line[PATH_MAX];
+            if (S_ISREG(st.st_mode) && read_first_line(path, line, sizeof(line)) &&
+                strncmp(line, "gitdir: ", 8) == 0) {
+                const char *target = line + 8;
+                if (target[0] == '/') {
+                    safe_strcpy(git_dir, target, size);
+                } else if (snprintf(git_dir, size, "%s/%s", strcmp(dir, "/") == 0 ? "" : dir,
+                                    target) >= (int)size) {
+                    return false;
+                }
+                safe_strcpy(work_tree, dir, size);
+                return true;
+            }
+        }
 
-        if (safe_strlen(branch, sizeof(branch)) > 0) {
-            return branch;
+        char *slash = strrchr(dir, '/');
+        if (!slash || strcmp(dir, "/") == 0) return false;
+        if (slash == dir) {
+            dir[1] = '\0';
+        } else {
+            *slash = '\0';
         }
     }
+}
+
+// Turn the contents of HEAD into the name shown in the prompt
+static bool git_parse_head(const char *head, char *branch, size_t size) {
+    if (strncmp(head, "ref: ", 5) == 0) {
+        const char *ref = head + 5;
+        if (strncmp(ref, "refs/heads/", 11) == 0) ref += 11;
+        if (!*ref) return false;
+        safe_strcpy(branch, ref, size);
+        return true;
+    }
+
+    // Detached HEAD holds a commit id, which rev-parse --abbrev-ref shows as "HEAD"
+    if (!isxdigit((unsigned char)head[0])) return false;
+    safe_strcpy(branch, "HEAD", size);
+    return true;
+}
+
+char *prompt_git_branch(void) {
+    static char branch[256];
+    char git_dir[PATH_MAX];
+    char work_tree[PATH_MAX];
+    char path[PATH_MAX];
+    char head[PATH_MAX];
+
+    if (!git_find_dirs(git_dir, work_tree, sizeof(git_dir))) return NULL;
+    if (snprintf(path, sizeof(path), "%s/HEAD", git_dir) >= (int)sizeof(path)) return NULL;
+    if (!read_first_line(path, head, sizeof(head))) return NULL;
+    if (!git_parse_head(head, branch, sizeof(branch))) return NULL;
+
+    return branch;
+}
 
-    pclose(fp);
+static GitDirtyEntry *git_cache_find(const char *git_dir) {
+    for (size_t i = 0; i < GIT_CACHE_SIZE; i++) {
+        GitDirtyEntry *entry = &git_state.entries[i];
+        if (entry->valid && strcmp(entry->git_dir, git_dir) == 0) return entry;
+    }
     return NULL;
 }
 
+static void git_cache_store(bool dirty) {
+    GitDirtyEntry *entry = git_cache_find(git_state.git_dir);
+    if (!entry) {
+        entry = &git_state.entries[git_state.next_victim];
+        git_state.next_victim = (git_state.next_victim + 1) % GIT_CACHE_SIZE;
+        safe_strcpy(entry->git_dir, git_state.git_dir, sizeof(entry->git_dir));
+        entry->valid = true;
+    }
+
+    entry->index = git_state.index;
+    entry->head = git_state.head;
+    entry->dirty = dirty;
+    entry->serial = git_state.launch_serial;
+}
+
+// Forget the worker, killing it first if asked
+// Once the SIGCHLD handler has reaped it, its pid may belong to another
+// process, so only a worker that is still outstanding is signalled
+static void git_worker_release(bool kill_worker) {
+    sigset_t block_mask, old_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block_mask, &old_mask);
+
+    if (jobs_helper_outstanding(git_state.pid)) {
+        if (kill_worker) kill(git_state.pid, SIGKILL);
+        // The SIGCHLD handler reaps it if it has not exited yet
+        waitpid(git_state.pid, NULL, WNOHANG);
+    }
+    git_state.pid = 0;
+
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+static void git_worker_stop(void) {
+    if (git_state.fd >= 0) {
+        close(git_state.fd);
+        git_state.fd = -1;
+    }
+    if (git_state.pid > 0) git_worker_release(true);
+}
+
+static void git_worker_start(const char *git_dir, const char *work_tree) {
+    int fds[2];
+    if (pipe(fds) != 0) return;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+
+    // Own process group, so ^C at the prompt or job control never reach it
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGTSTP);
+    sigaddset(&defaults, SIGTTIN);
+    sigaddset(&defaults, SIGTTOU);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    // SIGCHLD stays blocked until the worker is watched, so the handler
+    // cannot reap it first; the worker itself starts with the old mask
+    sigset_t block_mask, old_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block_mask, &old_mask);
+    posix_spawnattr_setsigmask(&attr, &old_mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK |
+                                    POSIX_SPAWN_SETPGROUP);
+
+    char dir_arg[PATH_MAX + 16];
+    char tree_arg[PATH_MAX + 16];
+    snprintf(dir_arg, sizeof(dir_arg), "--git-dir=%s", git_dir);
+    snprintf(tree_arg, sizeof(tree_arg), "--work-tree=%s", work_tree);
+    char *argv[] = {
+        "git", dir_arg, tree_arg, "--no-optional-locks",
+        "status", "--porcelain", "--untracked-files=normal", NULL
+    };
+
+    pid_t pid;
+    int rc = posix_spawnp(&pid, "git", &actions, &attr, argv, shellvar_environ());
+
+    if (rc == 0) jobs_watch_helper(pid);
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(fds[1]);
+
+    if (rc != 0) {
+        close(fds[0]);
+        return;
+    }
+
+    git_state.pid = pid;
+    git_state.fd = fds[0];
+    safe_strcpy(git_state.git_dir, git_dir, sizeof(git_state.git_dir));
+}
+
 // Check if git repo has uncommitted changes
+// Returns the cached state at once and starts a worker if it may be stale.
 bool prompt_git_dirty(void) {
-    FILE *fp = popen("git status --porcelain 2>/dev/null", "r");
-    if (!fp) return false;
+    char git_dir[PATH_MAX];
+    char work_tree[PATH_MAX];
+    if (!git_find_dirs(git_dir, work_tree, sizeof(git_dir))) return false;
+
+    // Pick up a result that arrived while a command was running
+    prompt_git_poll();
 
-    char line[256];
-    bool dirty = false;
+    GitStamp index;
+    GitStamp head;
+    git_stamp(&index, git_dir, "index");
+    git_stamp(&head, git_dir, "HEAD");
 
-    if (fgets(line, sizeof(line), fp) != NULL) {
-        dirty = true;  // If there's any output, repo is dirty
+    GitDirtyEntry *entry = git_cache_find(git_dir);
+    bool fresh = entry && git_stamp_equal(&entry->index, &index) &&
+                 git_stamp_equal(&entry->head, &head);
+
+    // Editing a tracked file touches neither the index nor HEAD, so every
+    // new prompt refreshes once even when the stamps match
+    bool stale = !fresh || entry->serial != git_state.serial;
+
+    if (git_state.pid > 0 && strcmp(git_state.git_dir, git_dir) != 0) {
+        git_worker_stop();
     }
+    if (stale && git_state.pid == 0) {
+        git_state.index = index;
+        git_state.head = head;
+        git_state.launch_serial = git_state.serial;
+        git_worker_start(git_dir, work_tree);
+    }
+
+    return entry ? entry->dirty : false;
+}
+
+int prompt_git_worker_fd(void) {
+    return git_state.fd;
+}
 
-    pclose(fp);
-    return dirty;
+bool prompt_git_poll(void) {
+    if (git_state.fd < 0) return false;
+
+    char buf[512];
+    ssize_t n = read(git_state.fd, buf, sizeof(buf));
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return false;
+
+    // Any output means dirty; no need to wait for the rest of it
+    bool dirty = n > 0;
+
+    close(git_state.fd);
+    git_state.fd = -1;
+    git_worker_release(dirty);
+
+    GitDirtyEntry *entry = git_cache_find(git_state.git_dir);
+    bool changed = !entry || entry->dirty != dirty;
+    git_cache_store(dirty);
+    return changed;
 }
 
 // Get current working directory
@@ -89,7 +383,7 @@ char *prompt_get_cwd(void) {
 
     if (getcwd(cwd, sizeof(cwd)) != NULL) {
         // Replace home directory with ~
-        const char *home = getenv("HOME");
+        const char *home = shellvar_get("HOME");
         if (home && strncmp(cwd, home, strlen(home)) == 0) {
             static char short_cwd[PATH_MAX];
             snprintf(short_cwd, sizeof(short_cwd), "~%s", cwd + strlen(home));
@@ -120,7 +414,7 @@ char *prompt_get_current_dir(void) {
 char *prompt_get_user(void) {
     static char username[256];
 
-    const char *user = getenv("USER");
+    const char *user = shellvar_get("USER");
     if (user) {
         safe_strcpy(username, user, sizeof(username));
         return username;
@@ -293,11 +587,13 @@ static void handle_dynamic_expansion(char *prompt, const char *ps1, int last_exi
     // Set environment variables for prompt programs like Starship
     char status_str[16];
     snprintf(status_str, sizeof(status_str), "%d", last_exit_code);
-    setenv("STATUS", status_str, 1);
+    shellvar_set("STATUS", status_str);
+    shellvar_set_export("STATUS");
 
     char jobs_str[16];
     snprintf(jobs_str, sizeof(jobs_str), "%d", jobs_count());
-    setenv("NUM_JOBS", jobs_str, 1);
+    shellvar_set("NUM_JOBS", jobs_str);
+    shellvar_set_export("NUM_JOBS");
 
     // Make a mutable copy for expansion
     char ps1_copy[MAX_PROMPT_LENGTH];
@@ -334,13 +630,24 @@ static void handle_dynamic_expansion(char *prompt, const char *ps1, int last_exi
     // Don't add extra reset/space for external prompts - they handle their own formatting
 }
 
+static int prompt_last_exit_code;
+
 // Generate prompt
 char *prompt_generate(int last_exit_code) {
+    git_state.serial++;
+    prompt_last_exit_code = last_exit_code;
+    return prompt_regenerate();
+}
+
+// Render the prompt again for the same command line, e.g. after the git
+// worker reported; the string is rebuilt in the same buffer
+char *prompt_regenerate(void) {
     static char prompt[MAX_PROMPT_LENGTH];
+    int last_exit_code = prompt_last_exit_code;
 
     // Get PS1 from environment or config
     const char *ps1;
-    const char *ps1_env = getenv("PS1");
+    const char *ps1_env = shellvar_get("PS1");
     bool ps1_from_env = false;
 
     if (ps1_env) {
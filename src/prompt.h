@@ -23,15 +23,28 @@ void prompt_set_fancy_default(void);
 // last_exit_code: exit code of previous command
 char *prompt_generate(int last_exit_code);
 
+// Render the prompt again with the last exit code, into the same buffer
+// Used to redraw the prompt when background git status arrives
+char *prompt_regenerate(void);
+
 // Set custom PS1
 void prompt_set_ps1(const char *ps1);
 
 // Get current git branch (returns NULL if not in a repo)
+// Read from HEAD directly; no git process is started
 char *prompt_git_branch(void);
 
 // Check if git repo has uncommitted changes
+// Returns the last known state and refreshes it in a background worker
 bool prompt_git_dirty(void);
 
+// Descriptor to watch for the git worker's result (-1 if none is running)
+int prompt_git_worker_fd(void);
+
+// Collect the git worker's result if it is ready
+// Returns true if the dirty state changed and the prompt should be redrawn
+bool prompt_git_poll(void);
+
 // Get current working directory
 char *prompt_get_cwd(void);
 
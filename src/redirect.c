@@ -1,12 +1,18 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #include "redirect.h"
 #include "safe_string.h"
 #include "hash.h"
@@ -14,9 +20,13 @@
 #include "varexpand.h"
 #include "execute.h"
 #include "utils.h"
+#include "wordexpand.h"
 
 #define MAX_REDIRECTS 16
 
+// Flag for memfd_create(); not exposed by the POSIX headers
+#define HEREDOC_MFD_CLOEXEC 0x0001U
+
 // Create new redirection info
 static RedirInfo *create_redir_info(void) {
     RedirInfo *info = malloc(sizeof(RedirInfo));
@@ -94,6 +104,11 @@ static int add_heredoc(RedirInfo *info, RedirType type, const char *delimiter) {
 
 // Parse redirections from args
 RedirInfo *redirect_parse(char **args) {
+    return redirect_parse_fields(args, NULL);
+}
+
+// Parse redirections from expanded fields
+RedirInfo *redirect_parse_fields(char **args, const unsigned char *flags) {
     if (!args || !args[0]) return NULL;
 
     RedirInfo *info = create_redir_info();
@@ -115,8 +130,9 @@ RedirInfo *redirect_parse(char **args) {
     for (int i = 0; args[i] != NULL; i++) {
         char *arg = args[i];
 
-        // Skip args that start with quote marker - these are escaped and shouldn't be treated as operators
-        if (arg[0] == '\x01') {
+        // Quoted words and expansion results are never operators; without
+        // field flags, quoted words are told apart by a leading quote marker
+        if (flags ? !(flags[i] & FIELD_OPERATOR) : arg[0] == '\x01') {
             info->args[new_arg_idx++] = arg;
             continue;
         }
@@ -304,6 +320,72 @@ RedirInfo *redirect_parse(char **args) {
     return info;
 }
 
+static int write_fully(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Anonymous file for a heredoc body: memfd on Linux, else an unlinked
+// temporary file
+static int heredoc_file(void) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    int fd = (int)syscall(SYS_memfd_create, "hash-heredoc", HEREDOC_MFD_CLOEXEC);
+    if (fd != -1) return fd;
+#endif
+    const char *dir = getenv("TMPDIR");
+    if (!dir || !*dir) dir = "/tmp";
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/hash-heredoc-XXXXXX", dir) >= (int)sizeof(path)) {
+        return -1;
+    }
+    int tmp = mkstemp(path);
+    if (tmp == -1) return -1;
+    unlink(path);
+    fcntl(tmp, F_SETFD, FD_CLOEXEC);
+    return tmp;
+}
+
+// Open a descriptor that reads a heredoc body from its start
+// A body that fits in an empty pipe is written into one; anything larger
+// would block the writer before the command reads, so it goes to a file
+static int heredoc_open(const char *content, size_t len) {
+    int pipefd[2];
+    if (pipe(pipefd) == -1) return -1;
+
+    size_t capacity = PIPE_BUF;
+#ifdef F_GETPIPE_SZ
+    int size = fcntl(pipefd[1], F_GETPIPE_SZ);
+    if (size > 0 && (size_t)size > capacity) capacity = (size_t)size;
+#endif
+    if (len <= capacity) {
+        int rc = write_fully(pipefd[1], content, len);
+        close(pipefd[1]);
+        if (rc != 0) {
+            close(pipefd[0]);
+            return -1;
+        }
+        return pipefd[0];
+    }
+    close(pipefd[0]);
+    close(pipefd[1]);
+
+    int fd = heredoc_file();
+    if (fd == -1) return -1;
+    if (write_fully(fd, content, len) != 0 || lseek(fd, 0, SEEK_SET) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
 // Apply redirections
 int redirect_apply(const RedirInfo *info) {
     if (!info) return 0;
@@ -401,12 +483,6 @@ int redirect_apply(const RedirInfo *info) {
             case REDIR_HEREDOC_NOTAB: {
                 // << DELIMITER or <<- DELIMITER
                 if (redir->heredoc_content) {
-                    int pipefd[2];
-                    if (pipe(pipefd) == -1) {
-                        perror(HASH_NAME);
-                        return -1;
-                    }
-
                     // If delimiter was not quoted, expand variables and command substitutions
                     const char *content = redir->heredoc_content;
                     char *expanded = NULL;
@@ -431,24 +507,20 @@ int redirect_apply(const RedirInfo *info) {
                         // Check for expansion error (e.g., ${x?word} with unset x)
                         if (varexpand_had_error()) {
                             free(expanded);
-                            close(pipefd[0]);
-                            close(pipefd[1]);
                             return -1;
                         }
                     }
 
-                    // Write heredoc content to pipe
-                    size_t len = strlen(content);
-                    ssize_t written = write(pipefd[1], content, len);
-                    (void)written;  // Ignore write result for simplicity
-
+                    int fd = heredoc_open(content, strlen(content));
                     free(expanded);  // Free expanded content if any
+                    if (fd == -1) {
+                        perror(HASH_NAME);
+                        return -1;
+                    }
 
-                    close(pipefd[1]);  // Close write end
-
-                    // Replace stdin with read end of pipe
-                    dup2(pipefd[0], STDIN_FILENO);
-                    close(pipefd[0]);
+                    // Replace stdin with the heredoc body
+                    dup2(fd, STDIN_FILENO);
+                    close(fd);
                 }
                 break;
             }
@@ -491,6 +563,84 @@ int redirect_apply(const RedirInfo *info) {
     return 0;
 }
 
+// Describe redirections as posix_spawn file actions
+int redirect_spawn_actions(const RedirInfo *info, posix_spawn_file_actions_t *actions) {
+    if (!info) return 0;
+
+    for (int i = 0; i < info->count; i++) {
+        const Redirection *redir = &info->redirs[i];
+        int rc = 0;
+
+        switch (redir->type) {
+            case REDIR_INPUT:
+                rc = posix_spawn_file_actions_addopen(actions, STDIN_FILENO, redir->filename,
+                                                      O_RDONLY, 0);
+                break;
+
+            case REDIR_OUTPUT:
+                rc = posix_spawn_file_actions_addopen(actions, STDOUT_FILENO, redir->filename,
+                                                      O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                break;
+
+            case REDIR_APPEND:
+                rc = posix_spawn_file_actions_addopen(actions, STDOUT_FILENO, redir->filename,
+                                                      O_WRONLY | O_CREAT | O_APPEND, 0644);
+                break;
+
+            case REDIR_ERROR:
+                rc = posix_spawn_file_actions_addopen(actions, STDERR_FILENO, redir->filename,
+                                                      O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                break;
+
+            case REDIR_ERROR_APPEND:
+                rc = posix_spawn_file_actions_addopen(actions, STDERR_FILENO, redir->filename,
+                                                      O_WRONLY | O_CREAT | O_APPEND, 0644);
+                break;
+
+            case REDIR_BOTH:
+                rc = posix_spawn_file_actions_addopen(actions, STDOUT_FILENO, redir->filename,
+                                                      O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (rc == 0) {
+                    rc = posix_spawn_file_actions_adddup2(actions, STDOUT_FILENO, STDERR_FILENO);
+                }
+                break;
+
+            case REDIR_ERROR_TO_OUT:
+                rc = posix_spawn_file_actions_adddup2(actions, STDOUT_FILENO, STDERR_FILENO);
+                break;
+
+            case REDIR_OUT_TO_ERROR:
+                rc = posix_spawn_file_actions_adddup2(actions, STDERR_FILENO, STDOUT_FILENO);
+                break;
+
+            case REDIR_INPUT_DUP:
+            case REDIR_OUTPUT_DUP:
+            case REDIR_FD_DUP: {
+                int dest_fd = redir->type == REDIR_INPUT_DUP ? STDIN_FILENO :
+                              redir->type == REDIR_OUTPUT_DUP ? STDOUT_FILENO : redir->dest_fd;
+                int src_fd = redir->type == REDIR_FD_DUP ? redir->src_fd : atoi(redir->filename);
+                // A closed source fd is reported by redirect_apply in a forked child
+                if (fcntl(src_fd, F_GETFD) == -1) return -1;
+                rc = posix_spawn_file_actions_adddup2(actions, src_fd, dest_fd);
+                break;
+            }
+
+            case REDIR_HEREDOC:
+            case REDIR_HEREDOC_NOTAB:
+                // The body is fed through a pipe written by the shell
+                return -1;
+
+            case REDIR_NONE:
+            default:
+                break;
+        }
+
+        if (rc != 0) return -1;
+    }
+
+    return 0;
+}
+
 // Free redirection info
 void redirect_free(RedirInfo *info) {
     if (!info) return;
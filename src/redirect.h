@@ -1,6 +1,8 @@
 #ifndef REDIRECT_H
 #define REDIRECT_H
 
+#include <spawn.h>
+
 // Redirection types
 typedef enum {
     REDIR_NONE,
@@ -47,6 +49,16 @@ typedef struct {
  */
 RedirInfo *redirect_parse(char **args);
 
+/**
+ * Parse redirections from expanded fields
+ * Only fields flagged FIELD_OPERATOR are taken as operators; a quoted
+ * "<" or a variable holding ">" stays an ordinary argument.
+ * @param args Expanded fields (from wordexpand_command)
+ * @param flags FIELD_* flags for each field
+ * @return RedirInfo structure (caller must free)
+ */
+RedirInfo *redirect_parse_fields(char **args, const unsigned char *flags);
+
 /**
  * Apply redirections before executing command
  * Opens files and sets up file descriptors
@@ -56,6 +68,17 @@ RedirInfo *redirect_parse(char **args);
  */
 int redirect_apply(const RedirInfo *info);
 
+/**
+ * Translate redirections into posix_spawn file actions
+ * Here-documents and duplications of closed descriptors cannot be
+ * expressed this way; callers fall back to fork and redirect_apply.
+ *
+ * @param info Redirection info (NULL adds nothing)
+ * @param actions Initialized file actions to append to
+ * @return 0 on success, -1 if the redirections need a forked child
+ */
+int redirect_spawn_actions(const RedirInfo *info, posix_spawn_file_actions_t *actions);
+
 /**
  * Free redirection info
  *
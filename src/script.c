@@ -27,6 +27,8 @@
 #include "cmdsub.h"
 #include "expand.h"
 #include "utils.h"
+#include "ast.h"
+#include "arena.h"
 
 // Global script state
 ScriptState script_state;
@@ -48,6 +50,8 @@ static size_t heredoc_content_cap = 0;
 static char *pending_heredoc = NULL;
 static int pending_heredoc_quoted = 0;
 
+static void function_program_release(FunctionProgram *program);
+
 // ============================================================================
 // Keywords Table
 // ============================================================================
@@ -94,10 +98,22 @@ void script_init(void) {
 }
 
 void script_cleanup(void) {
-    // Free function bodies
-    for (int i = 0; i < script_state.function_count; i++) {
-        free(script_state.functions[i].body);
-    }
+    // Free function table
+    for (size_t i = 0; i < script_state.function_buckets; i++) {
+        ShellFunction *func = script_state.functions[i];
+        while (func) {
+            ShellFunction *next = func->next;
+            free(func->name);
+            free(func->body);
+            function_program_release(func->program);
+            free(func);
+            func = next;
+        }
+    }
+    free(script_state.functions);
+    script_state.functions = NULL;
+    script_state.function_buckets = 0;
+    script_state.function_count = 0;
 
     // Free context stack resources
     for (int i = 0; i < script_state.context_depth; i++) {
@@ -124,6 +140,10 @@ void script_cleanup(void) {
         free(script_state.positional_params);
     }
 
+    // Free compiled arithmetic and the chunks kept by the command arena
+    arith_cache_clear();
+    arena_cleanup();
+
     script_init();  // Reset to clean state
 }
 
@@ -172,116 +192,8 @@ static int heredoc_append(const char *line, int strip_tabs) {
     return 0;
 }
 
-// Read a complete line from file, handling backslash-newline continuations
-// and multi-line quoted strings
-// Returns dynamically allocated string (caller must free), or NULL on EOF/error
-static char *read_complete_line(FILE *fp) {
-    char *result = NULL;
-    size_t result_len = 0;
-    size_t result_cap = 0;
-    char buf[MAX_SCRIPT_LINE];
-    bool in_single_quote = false;
-    bool in_double_quote = false;
-    int brace_depth = 0;  // Track ${...} depth - # inside braces is not a comment
-    int paren_depth = 0;  // Track (...) depth for multi-line subshells
-
-    while (fgets(buf, sizeof(buf), fp)) {
-        size_t len = strlen(buf);
-
-        // Grow result buffer if needed
-        size_t new_len = result_len + len + 1;
-        if (new_len > result_cap) {
-            size_t new_cap = result_cap ? result_cap * 2 : 256;
-            if (new_cap < new_len) new_cap = new_len;
-            char *new_result = realloc(result, new_cap);
-            if (!new_result) {
-                free(result);
-                return NULL;
-            }
-            result = new_result;
-            result_cap = new_cap;
-        }
-
-        // Append buffer to result and track quote/paren state
-        bool in_comment = false;
-        for (size_t i = 0; i < len; i++) {
-            char c = buf[i];
-            result[result_len++] = c;
-
-            // Once in a comment, stop tracking (comments end at newline)
-            if (in_comment) {
-                if (c == '\n') in_comment = false;  // Reset at newline for next line
-                continue;
-            }
-
-            // Track quote state
-            // Backslash escapes next character when not in single quotes
-            if (c == '\\' && !in_single_quote && i + 1 < len) {
-                i++;
-                result[result_len++] = buf[i];
-                continue;
-            }
-            if (c == '\'' && !in_double_quote) {
-                in_single_quote = !in_single_quote;
-            } else if (c == '"' && !in_single_quote) {
-                in_double_quote = !in_double_quote;
-            } else if (!in_single_quote && !in_double_quote) {
-                if (c == '{') {
-                    brace_depth++;
-                } else if (c == '}' && brace_depth > 0) {
-                    brace_depth--;
-                } else if (c == '(') {
-                    paren_depth++;
-                } else if (c == ')' && paren_depth > 0) {
-                    paren_depth--;
-                } else if (c == '#' && brace_depth == 0) {
-                    // Start of comment - stop tracking for rest of line
-                    in_comment = true;
-                }
-            }
-        }
-        result[result_len] = '\0';
-
-        // Check for line continuation (backslash before newline)
-        // Only do continuation when not inside single quotes
-        // (POSIX: \<newline> is literal inside single quotes, continuation elsewhere)
-        if (result_len >= 2 && result[result_len - 1] == '\n' && result[result_len - 2] == '\\' &&
-            !in_single_quote) {
-            // Remove backslash-newline and continue reading
-            result_len -= 2;
-            result[result_len] = '\0';
-            continue;
-        }
-
-        // Continue reading if we're inside a quote (to complete multi-line strings)
-        if (in_single_quote || in_double_quote) {
-            continue;
-        }
-
-        // Continue reading if we're inside unclosed parentheses (multi-line subshell)
-        if (paren_depth > 0) {
-            continue;
-        }
-
-        // Remove trailing newline
-        if (result_len > 0 && result[result_len - 1] == '\n') {
-            result[result_len - 1] = '\0';
-            result_len--;
-        }
-
-        return result;
-    }
-
-    // Return what we have (might be partial line at EOF)
-    if (result && result_len > 0) {
-        return result;
-    }
-    free(result);
-    return NULL;
-}
-
 // Read a complete logical line from a string buffer, advancing *ptr past consumed input.
-// Similar to read_complete_line but operates on a string instead of FILE*.
+// Used when replaying a buffered loop body.
 // Handles quotes, multi-line subshells, etc.
 // Returns allocated string (caller must free) or NULL at end of input.
 static char *read_complete_line_from_string(const char **ptr) {
@@ -383,128 +295,6 @@ static char *read_complete_line_from_string(const char **ptr) {
     return NULL;
 }
 
-// Collect heredoc content from file until delimiter is found
-// For unquoted heredocs (quoted=0), backslash-newline is treated as line continuation
-// Returns the collected content (caller must free), or NULL on error
-static char *heredoc_collect_from_file(FILE *fp, const char *delimiter, int strip_tabs, int quoted) {
-    heredoc_reset();
-
-    char line[MAX_SCRIPT_LINE];
-    char *accumulated = NULL;  // For handling line continuations
-    size_t accum_len = 0;
-    size_t accum_cap = 0;
-
-    while (fgets(line, sizeof(line), fp)) {
-        // Remove trailing newline
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') {
-            line[len-1] = '\0';
-            len--;
-        }
-
-        // Check for delimiter (only on raw lines, not accumulated)
-        if (!accumulated) {
-            const char *check = line;
-            if (strip_tabs) {
-                while (*check == '\t') check++;
-            }
-
-            if (strcmp(check, delimiter) == 0) {
-                // Found delimiter - return collected content
-                char *result = heredoc_content;
-                heredoc_content = NULL;
-                heredoc_content_len = 0;
-                heredoc_content_cap = 0;
-                return result;
-            }
-        }
-
-        // Handle line continuation for unquoted heredocs
-        if (!quoted && len > 0 && line[len-1] == '\\') {
-            // Line ends with backslash - accumulate for continuation
-            line[len-1] = '\0';  // Remove trailing backslash
-            len--;
-
-            // Grow accumulated buffer
-            size_t needed = accum_len + len + 1;
-            if (needed > accum_cap) {
-                size_t new_cap = accum_cap ? accum_cap * 2 : 256;
-                if (new_cap < needed) new_cap = needed;
-                char *new_accum = realloc(accumulated, new_cap);
-                if (!new_accum) {
-                    free(accumulated);
-                    heredoc_reset();
-                    return NULL;
-                }
-                accumulated = new_accum;
-                accum_cap = new_cap;
-            }
-
-            memcpy(accumulated + accum_len, line, len);
-            accum_len += len;
-            accumulated[accum_len] = '\0';
-            continue;  // Read next line to continue
-        }
-
-        // Complete line (no continuation or quoted heredoc)
-        const char *final_line;
-        if (accumulated) {
-            // Append current line to accumulated content
-            size_t needed = accum_len + len + 1;
-            if (needed > accum_cap) {
-                char *new_accum = realloc(accumulated, needed);
-                if (!new_accum) {
-                    free(accumulated);
-                    heredoc_reset();
-                    return NULL;
-                }
-                accumulated = new_accum;
-            }
-            memcpy(accumulated + accum_len, line, len + 1);
-            final_line = accumulated;
-        } else {
-            final_line = line;
-        }
-
-        // Add line to heredoc content
-        if (heredoc_append(final_line, strip_tabs) < 0) {
-            free(accumulated);
-            heredoc_reset();
-            return NULL;
-        }
-
-        // Reset accumulator
-        free(accumulated);
-        accumulated = NULL;
-        accum_len = 0;
-        accum_cap = 0;
-    }
-
-    // Handle any remaining accumulated content (file ended mid-continuation)
-    if (accumulated) {
-        if (accum_len > 0) {
-            if (heredoc_append(accumulated, strip_tabs) < 0) {
-                free(accumulated);
-                heredoc_reset();
-                return NULL;
-            }
-        }
-        free(accumulated);
-    }
-
-    // EOF without delimiter - return what we have (POSIX allows this with warning)
-    if (!script_state.silent_errors) {
-        fprintf(stderr, "%s: warning: here-document delimited by end-of-file (wanted '%s')\n",
-                HASH_NAME, delimiter);
-    }
-
-    char *result = heredoc_content;
-    heredoc_content = NULL;
-    heredoc_content_len = 0;
-    heredoc_content_cap = 0;
-    return result;
-}
-
 // ============================================================================
 // Line Splitting (handle semicolons in compound commands)
 // ============================================================================
@@ -953,33 +743,108 @@ bool script_eval_condition(const char *condition) {
 // Function Management
 // ============================================================================
 
+// Drop one reference to a compiled function body
+static void function_program_release(FunctionProgram *program) {
+    if (!program || --program->refs > 0) return;
+    ast_free(program->root);
+    free(program);
+}
+
+// Parse a function body once so calls do not re-tokenize it
+// Returns NULL if the body does not parse; such functions run from text
+// and report the syntax error when called
+static FunctionProgram *function_program_compile(const char *body) {
+    FunctionProgram *program = malloc(sizeof(FunctionProgram));
+    if (!program) return NULL;
+
+    bool old_silent = script_state.silent_errors;
+    script_state.silent_errors = true;
+    AstParseStatus status = ast_parse_program(body, strlen(body), &program->root);
+    script_state.silent_errors = old_silent;
+
+    if (status != AST_PARSE_OK) {
+        free(program);
+        return NULL;
+    }
+    program->refs = 1;
+    return program;
+}
+
+// Hash a function name into the table
+static size_t function_hash(const char *name, size_t buckets) {
+    unsigned int hash = 0;
+    while (*name) {
+        hash = hash * 31 + (unsigned char)*name++;
+    }
+    return hash % buckets;
+}
+
+// Double the number of buckets once the table is full
+static int function_table_grow(void) {
+    size_t new_buckets = script_state.function_buckets ? script_state.function_buckets * 2 : FUNC_TABLE_INITIAL;
+    ShellFunction **new_table = calloc(new_buckets, sizeof(ShellFunction *));
+    if (!new_table) return -1;
+
+    for (size_t i = 0; i < script_state.function_buckets; i++) {
+        ShellFunction *func = script_state.functions[i];
+        while (func) {
+            ShellFunction *next = func->next;
+            size_t h = function_hash(func->name, new_buckets);
+            func->next = new_table[h];
+            new_table[h] = func;
+            func = next;
+        }
+    }
+
+    free(script_state.functions);
+    script_state.functions = new_table;
+    script_state.function_buckets = new_buckets;
+    return 0;
+}
+
 int script_define_function(const char *name, const char *body) {
     if (!name || !body) return -1;
 
     extern int last_command_exit_code;
 
-    for (int i = 0; i < script_state.function_count; i++) {
-        if (strcmp(script_state.functions[i].name, name) == 0) {
-            free(script_state.functions[i].body);
-            script_state.functions[i].body = strdup(body);
-            script_state.functions[i].body_len = strlen(body);
-            // POSIX: function definition sets exit code to 0
-            last_command_exit_code = 0;
-            return 0;
-        }
+    ShellFunction *func = script_get_function(name);
+    if (func) {
+        char *new_body = strdup(body);
+        if (!new_body) return -1;
+        free(func->body);
+        func->body = new_body;
+        func->body_len = strlen(body);
+        // Running calls keep their own reference to the old body
+        function_program_release(func->program);
+        func->program = function_program_compile(body);
+        // POSIX: function definition sets exit code to 0
+        last_command_exit_code = 0;
+        return 0;
     }
 
-    if (script_state.function_count >= MAX_FUNCTIONS) {
-        fprintf(stderr, "%s: too many functions\n", HASH_NAME);
+    // Keep chains short: grow when there are as many functions as buckets
+    if ((size_t)script_state.function_count >= script_state.function_buckets &&
+        function_table_grow() < 0) {
+        fprintf(stderr, "%s: allocation error\n", HASH_NAME);
         return -1;
     }
 
-    ShellFunction *func = &script_state.functions[script_state.function_count];
-    safe_strcpy(func->name, name, MAX_FUNC_NAME);
+    func = calloc(1, sizeof(ShellFunction));
+    if (!func) return -1;
+    func->name = strdup(name);
     func->body = strdup(body);
+    if (!func->name || !func->body) {
+        free(func->name);
+        free(func->body);
+        free(func);
+        return -1;
+    }
     func->body_len = strlen(body);
+    func->program = function_program_compile(body);
 
-    if (!func->body) return -1;
+    size_t h = function_hash(name, script_state.function_buckets);
+    func->next = script_state.functions[h];
+    script_state.functions[h] = func;
 
     script_state.function_count++;
     // POSIX: function definition sets exit code to 0
@@ -988,12 +853,14 @@ int script_define_function(const char *name, const char *body) {
 }
 
 ShellFunction *script_get_function(const char *name) {
-    if (!name) return NULL;
+    if (!name || script_state.function_count == 0) return NULL;
 
-    for (int i = 0; i < script_state.function_count; i++) {
-        if (strcmp(script_state.functions[i].name, name) == 0) {
-            return &script_state.functions[i];
+    ShellFunction *func = script_state.functions[function_hash(name, script_state.function_buckets)];
+    while (func) {
+        if (strcmp(func->name, name) == 0) {
+            return func;
         }
+        func = func->next;
     }
     return NULL;
 }
@@ -1022,7 +889,23 @@ int script_execute_function(const ShellFunction *func, int argc, char **argv) {
     // Increment function call depth (still useful for tracking)
     script_state.function_call_depth++;
 
-    (void)script_execute_string(func->body);  // Result handled via last_command_exit_code
+    // Result handled via last_command_exit_code
+    FunctionProgram *program = func->program;
+    if (program) {
+        // Hold a reference: the function may redefine itself while running
+        program->refs++;
+        bool old_in_script = script_state.in_script;
+        script_state.in_script = true;
+        if (program->root) {
+            (void)ast_execute(program->root, true);
+        } else {
+            last_command_exit_code = 0;
+        }
+        script_state.in_script = old_in_script;
+        function_program_release(program);
+    } else {
+        (void)script_execute_string(func->body);
+    }
 
     // Decrement function call depth
     script_state.function_call_depth--;
@@ -1608,11 +1491,6 @@ static int append_to_func_body(ScriptContext *ctx, const char *line) {
     if (needed > ctx->func_body_cap) {
         size_t new_cap = ctx->func_body_cap ? ctx->func_body_cap * 2 : 1024;
         if (new_cap < needed) new_cap = needed;
-        if (new_cap > MAX_FUNC_BODY) new_cap = MAX_FUNC_BODY;
-        if (needed > MAX_FUNC_BODY) {
-            fprintf(stderr, "%s: function body too large\n", HASH_NAME);
-            return -1;
-        }
 
         char *new_body = realloc(ctx->func_body, new_cap);
         if (!new_body) return -1;
@@ -1640,11 +1518,6 @@ static int append_to_loop_body(ScriptContext *ctx, const char *line) {
     if (needed > ctx->loop_body_cap) {
         size_t new_cap = ctx->loop_body_cap ? ctx->loop_body_cap * 2 : 1024;
         if (new_cap < needed) new_cap = needed;
-        if (new_cap > MAX_FUNC_BODY) new_cap = MAX_FUNC_BODY;  // Use same limit
-        if (needed > MAX_FUNC_BODY) {
-            fprintf(stderr, "%s: loop body too large\n", HASH_NAME);
-            return -1;
-        }
 
         char *new_body = realloc(ctx->loop_body, new_cap);
         if (!new_body) return -1;
@@ -2017,7 +1890,6 @@ static int process_for(const char *line) {
             return is_interactive ? 1 : 0;  // Exit in non-interactive mode
         }
         shellvar_set(ctx->loop_var, ctx->loop_values[0]);
-        setenv(ctx->loop_var, ctx->loop_values[0], 1);
     }
 
     return 1;  // Continue processing
@@ -2338,7 +2210,6 @@ static int process_done(const char *line) {
                     return is_interactive ? 1 : 0;  // Exit in non-interactive mode
                 }
                 shellvar_set(ctx->loop_var, ctx->loop_values[ctx->loop_index]);
-                setenv(ctx->loop_var, ctx->loop_values[ctx->loop_index], 1);
             }
             ctx->should_execute = true;
             int result = execute_loop_body(ctx->loop_body);
@@ -2502,8 +2373,6 @@ static int process_done(const char *line) {
 
 // Forward declarations for case pattern matching
 static char *remove_shell_quotes(const char *str);
-static char *expand_case_word(const char *word);
-static char *expand_case_pattern(const char *pattern);
 
 // Append line to case body buffer (reuses loop_body fields)
 static int append_to_case_body(ScriptContext *ctx, const char *line) {
@@ -2713,7 +2582,7 @@ static int execute_case_body(const char *body, const char *word) {
                     while (end > single_pat && isspace(*end)) *end-- = '\0';
 
                     // Expand pattern (variable expansion, then quote removal)
-                    char *expanded_pat = expand_case_pattern(single_pat);
+                    char *expanded_pat = script_expand_case_pattern(single_pat);
                     if (expanded_pat) {
                         if (case_pattern_matches(expanded_pat, word)) {
                             this_matches = true;
@@ -3036,7 +2905,7 @@ static char *add_pattern_markers(const char *word) {
     return result;
 }
 
-static char *expand_case_word(const char *word) {
+char *script_expand_case_word(const char *word) {
     if (!word) return strdup("");
 
     extern int last_command_exit_code;
@@ -3110,9 +2979,9 @@ static char *expand_case_word(const char *word) {
     return result;
 }
 
-// Expand case pattern - similar to expand_case_word but marks ALL $ as quoted
+// Expand case pattern - similar to script_expand_case_word but marks ALL $ as quoted
 // so expanded characters are treated as literals
-static char *expand_case_pattern(const char *pattern) {
+char *script_expand_case_pattern(const char *pattern) {
     if (!pattern) return strdup("");
 
     extern int last_command_exit_code;
@@ -3303,7 +3172,7 @@ static int process_case(const char *line) {
             // Execute the case body if parent allows
             extern int last_command_exit_code;
             if (parent_executing) {
-                char *expanded_word = expand_case_word(ctx->case_word);
+                char *expanded_word = script_expand_case_word(ctx->case_word);
                 int exit_code = execute_case_body(body, expanded_word);
                 last_command_exit_code = exit_code;
                 free(expanded_word);
@@ -3359,7 +3228,7 @@ static int process_esac(const char *line) {
 
     if (parent_executing && ctx->case_word && ctx->loop_body) {
         // Expand the case word before matching
-        char *expanded_word = expand_case_word(ctx->case_word);
+        char *expanded_word = script_expand_case_word(ctx->case_word);
         int exit_code = execute_case_body(ctx->loop_body, expanded_word);
         last_command_exit_code = exit_code;
         free(expanded_word);
@@ -3596,6 +3465,52 @@ static int process_single_line(const char *line) {
 // Script File Execution
 // ============================================================================
 
+// Check whether only blanks and newlines remain
+static bool rest_is_blank(const char *text, size_t len, size_t pos) {
+    for (; pos < len; pos++) {
+        if (!isspace((unsigned char)text[pos])) return false;
+    }
+    return true;
+}
+
+// Compile and run script text one complete command at a time
+// Each command is parsed into a syntax tree before it runs, so aliases and
+// functions defined by earlier commands are visible to later ones
+static int execute_script_text(const char *text, size_t len, const char *label) {
+    size_t pos = 0;
+    int result = 1;  // 1 = continue, 0 = exit called, < 0 = error
+
+    while (result > 0 && pos < len) {
+        AstNode *node = NULL;
+        AstParseStatus status = ast_parse_next(text, len, &pos, true, &node);
+
+        if (status == AST_PARSE_INCOMPLETE) {
+            if (!script_state.silent_errors) {
+                if (label) {
+                    fprintf(stderr, "%s: %s: unexpected end of file\n", HASH_NAME, label);
+                } else {
+                    fprintf(stderr, "%s: syntax error: unexpected end of file\n", HASH_NAME);
+                }
+            }
+            last_command_exit_code = 2;
+            result = -1;
+            break;
+        }
+        if (status == AST_PARSE_ERROR) {
+            last_command_exit_code = 2;
+            result = -1;
+            break;
+        }
+        if (!node) continue;
+
+        // The final command may replace a command substitution child
+        result = ast_execute(node, rest_is_blank(text, len, pos));
+        ast_free(node);
+    }
+
+    return result;
+}
+
 int script_execute_file(const char *filepath, int argc, char **argv) {
     return script_execute_file_ex(filepath, argc, argv, false);
 }
@@ -3646,9 +3561,6 @@ int script_execute_file_ex(const char *filepath, int argc, char **argv, bool sil
     // Increment function call depth so break/continue only see loops in this file
     script_state.function_call_depth++;
 
-    // Save context depth to detect unclosed structures only from THIS file
-    int saved_context_depth = script_state.context_depth;
-
     // Set up script state
     script_state.in_script = true;
     script_state.script_path = filepath;
@@ -3665,75 +3577,29 @@ int script_execute_file_ex(const char *filepath, int argc, char **argv, bool sil
         }
     }
 
-    int result = 1;  // 1 = continue, 0 = exit called, < 0 = error
-
-    // Skip shebang line if present
-    char *first_line = read_complete_line(fp);
-    if (first_line) {
-        if (first_line[0] != '#' || first_line[1] != '!') {
-            // Not a shebang, process this line
-            // Check for heredoc and collect content if present
-            if (redirect_has_heredoc(first_line)) {
-                int strip_tabs = 0;
-                int quoted = 0;
-                char *delim = redirect_get_heredoc_delim(first_line, &strip_tabs, &quoted);
-                if (delim) {
-                    free(pending_heredoc);
-                    pending_heredoc = heredoc_collect_from_file(fp, delim, strip_tabs, quoted);
-                    pending_heredoc_quoted = quoted;
-                    free(delim);
-                }
-            }
-            script_state.script_line = 0;  // Will be incremented by process_line
-            result = script_process_line(first_line);
-            // Clear pending heredoc after processing
-            free(pending_heredoc);
-            pending_heredoc = NULL;
-            pending_heredoc_quoted = 0;
+    // Compile and run the whole file; a shebang line is just a comment
+    char *text = NULL;
+    size_t text_len = 0;
+    size_t text_cap = 0;
+    char chunk[8192];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        if (text_len + n + 1 > text_cap) {
+            size_t new_cap = text_cap ? text_cap * 2 : sizeof(chunk) * 2;
+            while (new_cap < text_len + n + 1) new_cap *= 2;
+            char *new_text = realloc(text, new_cap);
+            if (!new_text) break;
+            text = new_text;
+            text_cap = new_cap;
         }
-        free(first_line);
-    }
-
-    // Process remaining lines (stop if result == 0 means exit was called)
-    while (result > 0) {
-        char *full_line = read_complete_line(fp);
-        if (!full_line) break;
-
-        // Check for heredoc and collect content if present
-        if (redirect_has_heredoc(full_line)) {
-            int strip_tabs = 0;
-            int quoted = 0;
-            char *delim = redirect_get_heredoc_delim(full_line, &strip_tabs, &quoted);
-            if (delim) {
-                free(pending_heredoc);
-                pending_heredoc = heredoc_collect_from_file(fp, delim, strip_tabs, quoted);
-                pending_heredoc_quoted = quoted;
-                free(delim);
-            }
-        }
-
-        result = script_process_line(full_line);
-        free(full_line);
-
-        // Clear pending heredoc after processing
-        free(pending_heredoc);
-        pending_heredoc = NULL;
-        pending_heredoc_quoted = 0;
+        memcpy(text + text_len, chunk, n);
+        text_len += n;
     }
 
     fclose(fp);
 
-    // Check for unclosed control structures (only those added by THIS file)
-    if (script_state.context_depth > saved_context_depth) {
-        if (!silent_errors && !script_state.silent_errors) {
-            fprintf(stderr, "%s: %s: unexpected end of file\n", HASH_NAME, filepath);
-        }
-        // Clear only the contexts added by this file
-        while (script_state.context_depth > saved_context_depth) {
-            script_pop_context();
-        }
-        result = 1;
-    }
+    int result = text ? execute_script_text(text, text_len, filepath) : 1;
+    free(text);
 
     // Cleanup
     script_state.in_script = false;
@@ -3746,101 +3612,102 @@ int script_execute_file_ex(const char *filepath, int argc, char **argv, bool sil
     break_pending = old_break_pending;
     continue_pending = old_continue_pending;
 
+    // return in a sourced file only ends that file
+    return_pending = false;
+
     // For return (-2), use the last exit code
     // For other errors (< 0), return 1
     return (result < 0 && result != -2) ? 1 : execute_get_last_exit_code();
 }
 
-// Preprocess script to handle backslash-newline continuations
-// Respects quote context: \<newline> is literal inside single quotes
-// Also respects comments: quotes inside comments are ignored
-// Returns newly allocated string (caller must free)
-static char *preprocess_line_continuations(const char *script) {
-    if (!script) return NULL;
+int script_execute_string(const char *script) {
+    if (!script) return 0;
 
-    size_t len = strlen(script);
-    char *result = malloc(len + 1);
-    if (!result) return NULL;
+    bool old_in_script = script_state.in_script;
+    script_state.in_script = true;
 
-    bool in_single_quote = false;
-    bool in_double_quote = false;
-    bool in_comment = false;
-    int brace_depth = 0;  // Track ${...} depth - # inside braces is not a comment
+    int result = execute_script_text(script, strlen(script), NULL);
 
-    size_t j = 0;
-    for (size_t i = 0; i < len; i++) {
-        char c = script[i];
+    script_state.in_script = old_in_script;
 
-        // Comments end at newline
-        if (in_comment) {
-            result[j++] = c;
-            if (c == '\n') {
-                in_comment = false;
+    // Return exit code for compatibility with main.c and cmdsub.c
+    // For return (-2), use the last exit code
+    // For other errors (< 0), return 1
+    return (result < 0 && result != -2) ? 1 : execute_get_last_exit_code();
+}
+
+int script_execute_stdin(void) {
+    char *text = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    size_t pos = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    bool at_eof = false;
+    int result = 1;
+
+    script_state.in_script = true;
+
+    // Read only as much input as the next command needs: commands such as
+    // read or cat may consume the rest of stdin themselves
+    while (result != 0) {
+        AstNode *node = NULL;
+        AstParseStatus status = (pos < len || at_eof)
+            ? ast_parse_next(text, len, &pos, at_eof, &node)
+            : AST_PARSE_INCOMPLETE;
+
+        if (status == AST_PARSE_INCOMPLETE) {
+            if (at_eof) {
+                fprintf(stderr, "%s: unexpected end of file\n", HASH_NAME);
+                result = -1;
+                break;
             }
-            continue;
-        }
 
-        // Check for backslash-newline (line continuation)
-        // Only remove when not inside single quotes
-        if (c == '\\' && i + 1 < len && script[i + 1] == '\n' && !in_single_quote) {
-            // Skip both backslash and newline
-            i++;  // Skip newline (loop will advance past backslash)
+            // Drop consumed text, then append the next line
+            if (pos > 0) {
+                memmove(text, text + pos, len - pos);
+                len -= pos;
+                pos = 0;
+            }
+            ssize_t n = fd_read_line(STDIN_FILENO, &line, &line_cap);
+            if (n <= 0) {
+                at_eof = true;
+                if (len == 0) break;
+                continue;
+            }
+            if (len + (size_t)n + 1 > cap) {
+                size_t new_cap = cap ? cap * 2 : 256;
+                while (new_cap < len + (size_t)n + 1) new_cap *= 2;
+                char *new_text = realloc(text, new_cap);
+                if (!new_text) {
+                    result = -1;
+                    break;
+                }
+                text = new_text;
+                cap = new_cap;
+            }
+            memcpy(text + len, line, (size_t)n);
+            len += (size_t)n;
+            text[len] = '\0';
             continue;
         }
 
-        result[j++] = c;
-
-        // Track quote state
-        // Backslash escapes next character when not in single quotes
-        if (c == '\\' && !in_single_quote && i + 1 < len) {
-            i++;
-            result[j++] = script[i];
+        if (status == AST_PARSE_ERROR) {
+            // Keep reading like an interactive shell would
+            last_command_exit_code = 2;
             continue;
         }
-        if (c == '\'' && !in_double_quote) {
-            in_single_quote = !in_single_quote;
-        } else if (c == '"' && !in_single_quote) {
-            in_double_quote = !in_double_quote;
-        } else if (c == '{' && !in_single_quote) {
-            brace_depth++;
-        } else if (c == '}' && !in_single_quote && brace_depth > 0) {
-            brace_depth--;
-        } else if (c == '#' && !in_single_quote && !in_double_quote && brace_depth == 0) {
-            in_comment = true;
-        }
-    }
-    result[j] = '\0';
-    return result;
-}
-
-int script_execute_string(const char *script) {
-    if (!script) return 0;
 
-    // Preprocess to handle backslash-newline continuations
-    char *preprocessed = preprocess_line_continuations(script);
-    if (!preprocessed) return 1;
-
-    char *script_copy = preprocessed;
-
-    bool old_in_script = script_state.in_script;
-    script_state.in_script = true;
-
-    int result = 1;  // 1 = continue, 0 = exit called, < 0 = error
-    char *saveptr;
-    const char *line = strtok_r(script_copy, "\n", &saveptr);
-
-    while (line && result > 0) {
-        result = script_process_line(line);
-        line = strtok_r(NULL, "\n", &saveptr);
+        if (node) {
+            result = ast_execute(node, at_eof && rest_is_blank(text, len, pos));
+            ast_free(node);
+        }
     }
 
-    script_state.in_script = old_in_script;
-    free(script_copy);
-
-    // Return exit code for compatibility with main.c and cmdsub.c
-    // For return (-2), use the last exit code
-    // For other errors (< 0), return 1
-    return (result < 0 && result != -2) ? 1 : execute_get_last_exit_code();
+    script_state.in_script = false;
+    free(line);
+    free(text);
+    return result;
 }
 
 // Get a positional parameter value
@@ -3851,6 +3718,11 @@ const char *script_get_positional_param(int index) {
     return script_state.positional_params ? script_state.positional_params[index] : NULL;
 }
 
+// Get the number of positional parameters ($#)
+int script_get_positional_count(void) {
+    return script_state.positional_count > 0 ? script_state.positional_count - 1 : 0;
+}
+
 // Set positional parameters ($1, $2, etc.) from set builtin
 // $0 is preserved, only $1 onwards are replaced
 void script_set_positional_params(int argc, char **argv) {
@@ -3900,6 +3772,13 @@ int script_get_pending_heredoc_quoted(void) {
     return pending_heredoc_quoted;
 }
 
+// Replace the pending heredoc with a copy of content (NULL clears it)
+void script_set_pending_heredoc(const char *content, int quoted) {
+    free(pending_heredoc);
+    pending_heredoc = content ? strdup(content) : NULL;
+    pending_heredoc_quoted = content ? quoted : 0;
+}
+
 // Clear pending heredoc (for forked children to prevent recursive expansion)
 void script_clear_pending_heredoc(void) {
     // Don't free - parent still owns the memory
@@ -17,9 +17,7 @@
 // ============================================================================
 
 #define MAX_SCRIPT_DEPTH 64      // Maximum nesting depth for control structures
-#define MAX_FUNC_NAME 128        // Maximum function name length
-#define MAX_FUNC_BODY 8192       // Maximum function body size
-#define MAX_FUNCTIONS 256        // Maximum number of defined functions
+#define FUNC_TABLE_INITIAL 64    // Initial function hash table size
 #define MAX_SCRIPT_LINE 4096     // Maximum line length in scripts
 
 // ============================================================================
@@ -114,10 +112,21 @@ typedef struct {
 // Function Definition
 // ============================================================================
 
+struct AstNode;
+
+// Compiled function body, shared by the function table and running calls
+// so that redefining a function while it runs is safe
 typedef struct {
-    char name[MAX_FUNC_NAME];
+    struct AstNode *root;   // NULL for an empty body
+    int refs;
+} FunctionProgram;
+
+typedef struct ShellFunction {
+    char *name;
     char *body;             // Function body (commands)
     size_t body_len;
+    FunctionProgram *program; // Parsed body, NULL if it failed to parse
+    struct ShellFunction *next; // Next entry in the same hash bucket
 } ShellFunction;
 
 // ============================================================================
@@ -129,8 +138,9 @@ typedef struct {
     ScriptContext context_stack[MAX_SCRIPT_DEPTH];
     int context_depth;
 
-    // Function definitions
-    ShellFunction functions[MAX_FUNCTIONS];
+    // Function definitions (hash table, grown as functions are added)
+    ShellFunction **functions;
+    size_t function_buckets;
     int function_count;
 
     // Script execution state
@@ -199,6 +209,16 @@ int script_execute_file_ex(const char *filepath, int argc, char **argv, bool sil
  */
 int script_execute_string(const char *script);
 
+/**
+ * Execute commands read from standard input (piped input or -s)
+ * Input is read one line at a time and each complete command runs before
+ * more input is read, so commands may consume the rest of stdin themselves
+ *
+ * @return 0 if exit was called, -1 if input ended inside a command,
+ *         1 otherwise
+ */
+int script_execute_stdin(void);
+
 /**
  * Process a single line of script
  * This handles control structures and can buffer incomplete statements
@@ -277,6 +297,23 @@ int script_pop_context(void);
  */
 ContextType script_current_context(void);
 
+/**
+ * Expand the word of a case statement (no field splitting or globbing)
+ *
+ * @param word Word as written after "case"
+ * @return Newly allocated expanded word (caller must free)
+ */
+char *script_expand_case_word(const char *word);
+
+/**
+ * Expand a case pattern; characters produced by quoted parts or
+ * expansions match literally
+ *
+ * @param pattern Pattern as written before ")"
+ * @return Newly allocated fnmatch() pattern (caller must free)
+ */
+char *script_expand_case_pattern(const char *pattern);
+
 // ============================================================================
 // Function Management
 // ============================================================================
@@ -384,6 +421,13 @@ LineType script_classify_line(const char *line);
  */
 const char *script_get_positional_param(int index);
 
+/**
+ * Get the number of positional parameters ($#)
+ *
+ * @return Count of $1, $2, ... (not including $0)
+ */
+int script_get_positional_count(void);
+
 /**
  * Set positional parameters ($1, $2, etc.) from set builtin
  * Note: $0 is preserved, only $1 onwards are replaced
@@ -409,6 +453,15 @@ const char *script_get_pending_heredoc(void);
  */
 int script_get_pending_heredoc_quoted(void);
 
+/**
+ * Set the pending heredoc content for the next command
+ * The content is copied; any previous content is freed
+ *
+ * @param content Heredoc body, or NULL to clear
+ * @param quoted 1 if the delimiter was quoted (no expansion)
+ */
+void script_set_pending_heredoc(const char *content, int quoted);
+
 /**
  * Clear the pending heredoc content
  * Used when forking for command substitution to prevent recursive expansion
@@ -1,35 +1,123 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "shellvar.h"
 #include "hash.h"
 #include "utils.h"
+#include "builtins.h"
+#include "arith.h"
+
+extern char **environ;
+
+// An indexed array keeps its elements in one vector while the highest index
+// stays below twice the element count plus this slack; past that it is
+// stored by index in the hash table associative arrays use
+#define ARRAY_DENSE_SLACK 16
+
+// Entry of an associative array
+typedef struct {
+    char *key;              // NULL once the entry is removed
+    char *value;
+} AssocEntry;
+
+// Elements of an array variable
+typedef struct ShellArray {
+    bool assoc;
+    bool sparse;            // Indexed, but kept in entries keyed by index
+    bool unsorted;          // Sparse entries are not in index order
+    size_t count;           // Elements set
+
+    // Indexed: value at each index, NULL for an index that is not set
+    char **items;
+    size_t size;            // Highest index set + 1 (also when sparse)
+    size_t cap;
+
+    // Associative or sparse: entries in insertion order (index order for a
+    // sorted sparse array), and a linear-probing index whose slots hold
+    // entry number + 1 (0 is empty)
+    AssocEntry *entries;
+    size_t used;            // Entries appended, including removed ones
+    size_t entry_cap;
+    unsigned int *slots;
+    size_t slot_count;      // Power of two
+} ShellArray;
 
 // Shell variable entry
 typedef struct ShellVar {
     char *name;
-    char *value;
-    int attrs;              // VAR_ATTR_READONLY, VAR_ATTR_EXPORT
+    char *value;            // NULL when unset, or an integer not yet read as text
+    char *env_entry;        // "name=value" while listed in the exported environment
+    ShellArray *array;      // Elements of an array variable (value is unused)
+    long ival;              // Native value of an integer variable
+    bool has_ival;          // ival is the current value
+    int attrs;              // VAR_ATTR_* flags
+    unsigned long journal_id;   // Undo journal that last saved this entry
     struct ShellVar *next;
 } ShellVar;
 
-// Hash table for variables
-#define SHELLVAR_HASH_SIZE 256
-static ShellVar *var_table[SHELLVAR_HASH_SIZE];
+// Hash table for variables; the bucket count is a power of two and
+// doubles when the table is more than three quarters full
+#define SHELLVAR_INITIAL_BUCKETS 64
+static ShellVar **var_table;
+static size_t var_buckets;
+static size_t var_count;
+
+// Changes whenever an entry is created or freed, so ShellVarRef handles
+// know when to look their variable up again
+static unsigned long var_generation;
+
+// Exported environment handed to exec, rebuilt only after an exported
+// variable changed. Entries replaced since the last rebuild stay allocated
+// until then, since environ may still point at them.
+static char **env_array;
+static bool env_dirty = true;
+static char **env_retired;
+static size_t env_retired_count;
+static size_t env_retired_cap;
+
+// Exit statuses of the last pipeline, kept as numbers and turned into the
+// PIPESTATUS array only when something reads it, since every command sets it
+static int *pipestatus;
+static int pipestatus_count;
+static int pipestatus_cap;
+static bool pipestatus_pending;
+
+static void pipestatus_store(void);
+
+// Undo journal of an in-process command: the first change to a variable
+// saves a copy of it (or notes that it did not exist), so only the
+// variables the command touches are copied and put back
+typedef struct {
+    char *name;
+    struct ShellVar *saved;     // NULL if the variable did not exist
+} JournalEntry;
+
+struct ShellVarSnapshot {
+    unsigned long id;
+    JournalEntry *entries;
+    size_t count;
+    size_t cap;
+    struct ShellVarSnapshot *outer;
+};
+
+static ShellVarSnapshot *journal;
+static unsigned long journal_next_id;
 
-// Simple hash function
+// FNV-1a; the low bits pick the bucket
 static unsigned int hash_name(const char *name) {
-    unsigned int hash = 0;
+    unsigned int hash = 2166136261u;
     while (*name) {
-        hash = hash * 31 + (unsigned char)*name++;
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
     }
-    return hash % SHELLVAR_HASH_SIZE;
+    return hash;
 }
 
-// Find a variable entry
-static ShellVar *find_var(const char *name) {
-    unsigned int h = hash_name(name);
-    ShellVar *v = var_table[h];
+// Find a variable entry without storing pending statuses
+static ShellVar *lookup_var(const char *name) {
+    if (!var_table) return NULL;
+
+    ShellVar *v = var_table[hash_name(name) & (var_buckets - 1)];
     while (v) {
         if (strcmp(v->name, name) == 0) {
             return v;
@@ -39,28 +127,577 @@ static ShellVar *find_var(const char *name) {
     return NULL;
 }
 
-void shellvar_init(void) {
-    memset(var_table, 0, sizeof(var_table));
+// Find a variable entry
+static ShellVar *find_var(const char *name) {
+    if (pipestatus_pending && name[0] == 'P' && strcmp(name, "PIPESTATUS") == 0) {
+        pipestatus_store();
+    }
+    return lookup_var(name);
 }
 
-void shellvar_cleanup(void) {
-    for (int i = 0; i < SHELLVAR_HASH_SIZE; i++) {
+static const char *array_scalar(const ShellArray *a);
+
+// Get a variable's value as text, formatting an integer the first time
+static const char *var_text(ShellVar *v) {
+    if (v->array) return array_scalar(v->array);
+    if (!v->value && v->has_ival) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%ld", v->ival);
+        v->value = strdup(buf);
+    }
+    return v->value;
+}
+
+// Drop a variable's environment entry; the environment must be rebuilt
+static void retire_env_entry(ShellVar *v) {
+    env_dirty = true;
+    if (!v->env_entry) return;
+
+    if (env_retired_count == env_retired_cap) {
+        size_t cap = env_retired_cap ? env_retired_cap * 2 : 16;
+        char **retired = realloc(env_retired, cap * sizeof(char *));
+        if (!retired) return;  // Leak the entry rather than leave environ dangling
+        env_retired = retired;
+        env_retired_cap = cap;
+    }
+    env_retired[env_retired_count++] = v->env_entry;
+    v->env_entry = NULL;
+}
+
+// Value a variable contributes to the environment; arrays are not exported
+static const char *env_value(ShellVar *v) {
+    if (!(v->attrs & VAR_ATTR_EXPORT) || v->array) return NULL;
+    return var_text(v);
+}
+
+static void array_free(ShellArray *a);
+
+static void free_var(ShellVar *v) {
+    if (v->env_entry) retire_env_entry(v);
+    array_free(v->array);
+    free(v->name);
+    free(v->value);
+    free(v);
+}
+
+static void free_var_chain(ShellVar *v) {
+    while (v) {
+        ShellVar *next = v->next;
+        free_var(v);
+        v = next;
+    }
+}
+
+// Rehash every entry into a table with twice the buckets
+static void grow_table(void) {
+    size_t buckets = var_buckets * 2;
+    ShellVar **table = calloc(buckets, sizeof(ShellVar *));
+    if (!table) return;  // Keep the longer chains
+
+    for (size_t i = 0; i < var_buckets; i++) {
         ShellVar *v = var_table[i];
         while (v) {
             ShellVar *next = v->next;
-            free(v->name);
-            free(v->value);
-            free(v);
+            unsigned int h = hash_name(v->name) & (buckets - 1);
+            v->next = table[h];
+            table[h] = v;
             v = next;
         }
-        var_table[i] = NULL;
     }
+    free(var_table);
+    var_table = table;
+    var_buckets = buckets;
+}
+
+static ShellArray *array_copy(const ShellArray *a);
+
+// Detached copy of a variable, without its environment entry
+static ShellVar *copy_var(const ShellVar *v) {
+    ShellVar *copy = malloc(sizeof(ShellVar));
+    if (!copy) return NULL;
+
+    *copy = *v;
+    copy->name = strdup(v->name);
+    copy->value = v->value ? strdup(v->value) : NULL;
+    copy->env_entry = NULL;
+    copy->array = v->array ? array_copy(v->array) : NULL;
+    copy->next = NULL;
+    if (!copy->name || (v->value && !copy->value) || (v->array && !copy->array)) {
+        free_var(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+// Record a variable's state (NULL if it does not exist) in the journal
+static void journal_save(const char *name, const ShellVar *v) {
+    if (journal->count == journal->cap) {
+        size_t cap = journal->cap ? journal->cap * 2 : 16;
+        JournalEntry *entries = realloc(journal->entries, cap * sizeof(JournalEntry));
+        if (!entries) return;
+        journal->entries = entries;
+        journal->cap = cap;
+    }
+
+    JournalEntry *e = &journal->entries[journal->count];
+    e->name = strdup(name);
+    e->saved = v ? copy_var(v) : NULL;
+    if (!e->name || (v && !e->saved)) {
+        free(e->name);
+        if (e->saved) free_var(e->saved);
+        return;
+    }
+    journal->count++;
+}
+
+// Save a variable in the journal before its first change
+static void journal_touch(ShellVar *v) {
+    if (!journal || v->journal_id == journal->id) return;
+    journal_save(v->name, v);
+    v->journal_id = journal->id;
+}
+
+// Find a variable that is about to be changed
+static ShellVar *find_var_to_change(const char *name) {
+    ShellVar *v = find_var(name);
+    if (v) journal_touch(v);
+    return v;
+}
+
+// Create a variable and insert it into the table
+static ShellVar *new_var(const char *name, const char *value, int attrs) {
+    if (!var_table) {
+        var_table = calloc(SHELLVAR_INITIAL_BUCKETS, sizeof(ShellVar *));
+        if (!var_table) return NULL;
+        var_buckets = SHELLVAR_INITIAL_BUCKETS;
+    }
+
+    ShellVar *v = malloc(sizeof(ShellVar));
+    if (!v) return NULL;
+
+    v->name = strdup(name);
+    v->value = value ? strdup(value) : NULL;
+    v->env_entry = NULL;
+    v->array = NULL;
+    v->ival = 0;
+    v->has_ival = false;
+    v->attrs = attrs;
+    v->journal_id = 0;
+    if (journal) {
+        journal_save(name, NULL);
+        v->journal_id = journal->id;
+    }
+
+    if ((var_count + 1) * 4 > var_buckets * 3) grow_table();
+    unsigned int h = hash_name(name) & (var_buckets - 1);
+    v->next = var_table[h];
+    var_table[h] = v;
+    var_count++;
+
+    if (attrs & VAR_ATTR_EXPORT) env_dirty = true;
+    var_generation++;
+    return v;
+}
+
+// ----------------------------------------------------------------------------
+// Array storage
+// ----------------------------------------------------------------------------
+
+static void *array_grow(void *ptr, size_t *cap, size_t needed, size_t item_size) {
+    size_t new_cap = *cap ? *cap : 8;
+    while (new_cap < needed) new_cap *= 2;
+    void *grown = realloc(ptr, new_cap * item_size);
+    if (!grown) return NULL;
+    *cap = new_cap;
+    return grown;
+}
+
+static ShellArray *array_new(bool assoc) {
+    ShellArray *a = calloc(1, sizeof(ShellArray));
+    if (a) a->assoc = assoc;
+    return a;
+}
+
+// Drop every element, keeping the kind of array
+static void array_clear(ShellArray *a) {
+    for (size_t i = 0; i < a->size && a->items; i++) {
+        free(a->items[i]);
+    }
+    for (size_t i = 0; i < a->used; i++) {
+        free(a->entries[i].key);
+        free(a->entries[i].value);
+    }
+    free(a->items);
+    free(a->entries);
+    free(a->slots);
+    bool assoc = a->assoc;
+    memset(a, 0, sizeof(ShellArray));
+    a->assoc = assoc;
+}
+
+static void array_free(ShellArray *a) {
+    if (!a) return;
+    array_clear(a);
+    free(a);
+}
+
+// Entry number of a key, or -1
+static long assoc_find(const ShellArray *a, const char *key) {
+    if (!a->slots) return -1;
+    size_t mask = a->slot_count - 1;
+    for (size_t i = hash_name(key) & mask; a->slots[i]; i = (i + 1) & mask) {
+        const AssocEntry *e = &a->entries[a->slots[i] - 1];
+        if (e->key && strcmp(e->key, key) == 0) return (long)(a->slots[i] - 1);
+    }
+    return -1;
+}
+
+// Rebuild the index with the given number of slots, dropping removed entries
+static int assoc_rehash(ShellArray *a, size_t slot_count) {
+    unsigned int *slots = calloc(slot_count, sizeof(unsigned int));
+    if (!slots) return -1;
+
+    size_t live = 0;
+    for (size_t i = 0; i < a->used; i++) {
+        if (!a->entries[i].key) continue;
+        a->entries[live] = a->entries[i];
+        size_t h = hash_name(a->entries[live].key) & (slot_count - 1);
+        while (slots[h]) h = (h + 1) & (slot_count - 1);
+        slots[h] = (unsigned int)(live + 1);
+        live++;
+    }
+    free(a->slots);
+    a->slots = slots;
+    a->slot_count = slot_count;
+    a->used = live;
+    return 0;
+}
+
+static int assoc_set(ShellArray *a, const char *key, char *value) {
+    long found = assoc_find(a, key);
+    if (found >= 0) {
+        free(a->entries[found].value);
+        a->entries[found].value = value;
+        return 0;
+    }
+
+    // Removed entries keep their slots until the next rehash, so count them
+    if ((a->used + 1) * 4 > a->slot_count * 3) {
+        size_t slot_count = 16;
+        while ((a->count + 1) * 2 > slot_count) slot_count *= 2;
+        if (assoc_rehash(a, slot_count) != 0) {
+            free(value);
+            return -1;
+        }
+    }
+    if (a->used >= a->entry_cap) {
+        AssocEntry *entries = array_grow(a->entries, &a->entry_cap, a->used + 1, sizeof(AssocEntry));
+        if (!entries) {
+            free(value);
+            return -1;
+        }
+        a->entries = entries;
+    }
+
+    char *key_copy = strdup(key);
+    if (!key_copy) {
+        free(value);
+        return -1;
+    }
+    a->entries[a->used] = (AssocEntry){ key_copy, value };
+    size_t mask = a->slot_count - 1;
+    size_t h = hash_name(key) & mask;
+    while (a->slots[h]) h = (h + 1) & mask;
+    a->slots[h] = (unsigned int)(a->used + 1);
+    a->used++;
+    a->count++;
+    return 0;
+}
+
+static void assoc_unset(ShellArray *a, const char *key) {
+    long found = assoc_find(a, key);
+    if (found < 0) return;
+    free(a->entries[found].key);
+    free(a->entries[found].value);
+    a->entries[found].key = NULL;
+    a->entries[found].value = NULL;
+    a->count--;
+}
+
+// Index of a sparse array entry, whose key is the index in decimal
+static size_t entry_index(const AssocEntry *e) {
+    return strtoul(e->key, NULL, 10);
+}
+
+static int sparse_set(ShellArray *a, size_t index, char *value) {
+    char key[24];
+    snprintf(key, sizeof(key), "%zu", index);
+    size_t count = a->count;
+    if (assoc_set(a, key, value) != 0) return -1;
+    if (a->count != count && index + 1 < a->size) a->unsorted = true;
+    if (index >= a->size) a->size = index + 1;
+    return 0;
+}
+
+// Move the elements of a dense array into entries keyed by index
+static int array_make_sparse(ShellArray *a) {
+    char **items = a->items;
+    size_t size = a->size;
+    a->items = NULL;
+    a->size = 0;
+    a->cap = 0;
+    a->count = 0;
+    a->sparse = true;
+
+    int status = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (items[i] && status == 0) {
+            status = sparse_set(a, i, items[i]);
+        } else {
+            free(items[i]);
+        }
+    }
+    free(items);
+    return status;
+}
+
+static int indexed_set(ShellArray *a, size_t index, char *value) {
+    if (!a->sparse && index >= a->size &&
+        index / 2 >= a->count + 1 + ARRAY_DENSE_SLACK / 2 && array_make_sparse(a) != 0) {
+        free(value);
+        return -1;
+    }
+    if (a->sparse) return sparse_set(a, index, value);
+
+    if (index >= a->cap) {
+        char **items = array_grow(a->items, &a->cap, index + 1, sizeof(char *));
+        if (!items) {
+            free(value);
+            return -1;
+        }
+        a->items = items;
+    }
+    if (index >= a->size) {
+        memset(a->items + a->size, 0, (index + 1 - a->size) * sizeof(char *));
+        a->size = index + 1;
+    }
+    if (a->items[index]) {
+        free(a->items[index]);
+    } else {
+        a->count++;
+    }
+    a->items[index] = value;
+    return 0;
+}
+
+static void indexed_unset(ShellArray *a, size_t index) {
+    if (a->sparse) {
+        char key[24];
+        snprintf(key, sizeof(key), "%zu", index);
+        assoc_unset(a, key);
+        if (index + 1 != a->size) return;
+        a->size = 0;
+        for (size_t i = 0; i < a->used; i++) {
+            if (a->entries[i].key && entry_index(&a->entries[i]) >= a->size) {
+                a->size = entry_index(&a->entries[i]) + 1;
+            }
+        }
+        return;
+    }
+
+    if (index >= a->size || !a->items[index]) return;
+    free(a->items[index]);
+    a->items[index] = NULL;
+    a->count--;
+    while (a->size > 0 && !a->items[a->size - 1]) a->size--;
+}
+
+// Value at an index, or NULL
+static const char *indexed_get(const ShellArray *a, size_t index) {
+    if (a->sparse) {
+        char key[24];
+        snprintf(key, sizeof(key), "%zu", index);
+        long found = assoc_find(a, key);
+        return found >= 0 ? a->entries[found].value : NULL;
+    }
+    return index < a->size ? a->items[index] : NULL;
+}
+
+static int compare_entries(const void *x, const void *y) {
+    const AssocEntry *a = x;
+    const AssocEntry *b = y;
+    if (!a->key || !b->key) return !a->key - !b->key;
+    size_t i = entry_index(a);
+    size_t j = entry_index(b);
+    return (i > j) - (i < j);
+}
+
+// Put the entries of a sparse array in index order for walking it
+static int sparse_sort(ShellArray *a) {
+    if (!a->unsorted) return 0;
+    qsort(a->entries, a->used, sizeof(AssocEntry), compare_entries);
+    if (assoc_rehash(a, a->slot_count) != 0) return -1;
+    a->unsorted = false;
+    return 0;
+}
+
+// Element 0 (or key "0"), which $name reads
+static const char *array_scalar(const ShellArray *a) {
+    if (a->assoc) {
+        long found = assoc_find(a, "0");
+        return found >= 0 ? a->entries[found].value : NULL;
+    }
+    return indexed_get(a, 0);
+}
+
+static ShellArray *array_copy(const ShellArray *a) {
+    ShellArray *copy = array_new(a->assoc);
+    if (!copy) return NULL;
+
+    for (size_t i = 0; i < a->size && a->items; i++) {
+        if (a->items[i] && indexed_set(copy, i, strdup(a->items[i])) != 0) break;
+    }
+    for (size_t i = 0; i < a->used; i++) {
+        if (!a->entries[i].key) continue;
+        char *value = strdup(a->entries[i].value);
+        int status = a->sparse ? indexed_set(copy, entry_index(&a->entries[i]), value)
+                               : assoc_set(copy, a->entries[i].key, value);
+        if (status != 0) break;
+    }
+    return copy;
+}
+
+// Evaluate an indexed array subscript; negative values count back from the end
+static bool array_index(const ShellVar *v, const char *subscript, size_t *index) {
+    long n;
+    char *end;
+    n = strtol(subscript, &end, 10);
+    if (end == subscript || *end) {
+        if (arith_evaluate(subscript, &n) != 0) {
+            fprintf(stderr, "%s: %s[%s]: bad array subscript\n", HASH_NAME, v->name, subscript);
+            return false;
+        }
+    }
+
+    size_t size = v->array ? v->array->size : (var_text((ShellVar *)v) ? 1 : 0);
+    if (n < 0) n += (long)size;
+    if (n < 0) {
+        fprintf(stderr, "%s: %s[%s]: bad array subscript\n", HASH_NAME, v->name, subscript);
+        return false;
+    }
+    *index = (size_t)n;
+    return true;
+}
+
+// Turn a variable into an array; a scalar value becomes element 0
+static int array_convert(ShellVar *v, bool assoc) {
+    ShellArray *a = array_new(assoc);
+    if (!a) return -1;
+
+    const char *text = var_text(v);
+    if (text) {
+        char *copy = strdup(text);
+        if (!copy || (assoc ? assoc_set(a, "0", copy) : indexed_set(a, 0, copy)) != 0) {
+            array_free(a);
+            return -1;
+        }
+    }
+
+    // Arrays are not exported
+    if (v->attrs & VAR_ATTR_EXPORT) retire_env_entry(v);
+    free(v->value);
+    v->value = NULL;
+    v->has_ival = false;
+    v->array = a;
+    v->attrs |= assoc ? VAR_ATTR_ASSOC : VAR_ATTR_ARRAY;
+    return 0;
+}
+
+// Set one element of an array variable
+static int array_store(ShellVar *v, const char *subscript, const char *value) {
+    // Elements of an integer array are evaluated like integer variables
+    char *copy;
+    if (v->attrs & VAR_ATTR_INTEGER) {
+        long n;
+        if (arith_evaluate(value, &n) != 0) {
+            fprintf(stderr, "%s: %s: arithmetic syntax error\n", HASH_NAME, value);
+            return -1;
+        }
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%ld", n);
+        copy = strdup(buf);
+    } else {
+        copy = strdup(value);
+    }
+    if (!copy) return -1;
+
+    if (v->array->assoc) return assoc_set(v->array, subscript, copy);
+
+    size_t index;
+    if (!array_index(v, subscript, &index)) {
+        free(copy);
+        return -1;
+    }
+    return indexed_set(v->array, index, copy);
+}
+
+void shellvar_init(void) {
+    shellvar_cleanup();
+}
+
+void shellvar_cleanup(void) {
+    for (size_t i = 0; i < var_buckets; i++) {
+        free_var_chain(var_table[i]);
+    }
+    free(var_table);
+    var_table = NULL;
+    var_buckets = 0;
+    var_count = 0;
+    env_dirty = true;
+    var_generation++;
+    pipestatus_pending = false;
+}
+
+void shellvar_set_pipestatus(const int *statuses, int count) {
+    if (count > pipestatus_cap) {
+        int *grown = realloc(pipestatus, count * sizeof(int));
+        if (!grown) return;
+        pipestatus = grown;
+        pipestatus_cap = count;
+    }
+    memcpy(pipestatus, statuses, count * sizeof(int));
+    pipestatus_count = count;
+    pipestatus_pending = true;
+}
+
+// Assign the recorded statuses to PIPESTATUS
+static void pipestatus_store(void) {
+    // Cleared first: the assignment looks the variable up again
+    pipestatus_pending = false;
+
+    char (*text)[16] = malloc(pipestatus_count * sizeof(*text));
+    ShellVarElement *elems = malloc(pipestatus_count * sizeof(ShellVarElement));
+    if (text && elems) {
+        for (int i = 0; i < pipestatus_count; i++) {
+            snprintf(text[i], sizeof(text[i]), "%d", pipestatus[i]);
+            elems[i].key = NULL;
+            elems[i].value = text[i];
+        }
+        shellvar_array_assign("PIPESTATUS", elems, pipestatus_count, false);
+    }
+    free(text);
+    free(elems);
 }
 
 int shellvar_set(const char *name, const char *value) {
     if (!name) return -1;
 
-    ShellVar *v = find_var(name);
+    ShellVar *v = find_var_to_change(name);
+
+    // Remembered command paths depend on PATH
+    if (strcmp(name, "PATH") == 0 && !(v && (v->attrs & VAR_ATTR_READONLY))) {
+        cmd_hash_clear();
+    }
 
     if (v) {
         // Variable exists
@@ -69,31 +706,34 @@ int shellvar_set(const char *name, const char *value) {
             return -1;
         }
 
+        // name=value assigns element 0 of an array
+        if (v->array) {
+            return value ? array_store(v, "0", value) : 0;
+        }
+
+        // Assignments to an integer variable are arithmetic
+        if ((v->attrs & VAR_ATTR_INTEGER) && value) {
+            long n;
+            if (arith_evaluate(value, &n) != 0) {
+                fprintf(stderr, "%s: %s: arithmetic syntax error\n", HASH_NAME, value);
+                return -1;
+            }
+            return shellvar_set_int(name, n);
+        }
+
         // Update value
         free(v->value);
         v->value = value ? strdup(value) : NULL;
+        v->has_ival = false;
 
-        // If exported, sync to environment
+        // Exported values reach the environment at the next rebuild
         if (v->attrs & VAR_ATTR_EXPORT) {
-            if (value) {
-                setenv(name, value, 1);
-            } else {
-                unsetenv(name);
-            }
+            retire_env_entry(v);
         }
     } else {
         // Create new variable
-        v = malloc(sizeof(ShellVar));
+        v = new_var(name, value, 0);
         if (!v) return -1;
-
-        v->name = strdup(name);
-        v->value = value ? strdup(value) : NULL;
-        v->attrs = 0;
-
-        // Insert into hash table
-        unsigned int h = hash_name(name);
-        v->next = var_table[h];
-        var_table[h] = v;
     }
 
     return 0;
@@ -103,48 +743,355 @@ const char *shellvar_get(const char *name) {
     if (!name) return NULL;
 
     // First check our internal table
-    const ShellVar *v = find_var(name);
-    if (v && v->value) {
-        return v->value;
+    ShellVar *v = find_var(name);
+    const char *value = v ? var_text(v) : NULL;
+    if (value) {
+        return value;
     }
 
     // Fall back to environment
     return getenv(name);
 }
 
-int shellvar_unset(const char *name) {
+// Store the native value of an integer variable
+static void store_int(ShellVar *v, long value) {
+    journal_touch(v);
+
+    // The text form is made again only if someone reads it
+    free(v->value);
+    v->value = NULL;
+    v->ival = value;
+    v->has_ival = true;
+
+    if (v->attrs & VAR_ATTR_EXPORT) {
+        retire_env_entry(v);
+    }
+}
+
+int shellvar_set_int(const char *name, long value) {
+    ShellVar *v = find_var(name);
+    if (!v || !(v->attrs & VAR_ATTR_INTEGER) || v->array) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%ld", value);
+        return shellvar_set(name, buf);
+    }
+
+    if (v->attrs & VAR_ATTR_READONLY) {
+        fprintf(stderr, "%s: %s: readonly variable\n", HASH_NAME, name);
+        return -1;
+    }
+
+    store_int(v, value);
+    return 0;
+}
+
+bool shellvar_get_int(const char *name, long *value) {
+    const ShellVar *v = find_var(name);
+    if (!v || !v->has_ival) return false;
+
+    *value = v->ival;
+    return true;
+}
+
+// Find the variable a handle refers to, looking it up again only if
+// variables were created or freed since the last use
+static ShellVar *ref_resolve(ShellVarRef *ref) {
+    if (ref->generation != var_generation) {
+        ref->var = find_var(ref->name);
+        ref->generation = var_generation;
+    }
+    return ref->var;
+}
+
+void shellvar_ref_init(ShellVarRef *ref, const char *name) {
+    ref->name = name;
+    ref->var = find_var(name);
+    ref->generation = var_generation;
+}
+
+bool shellvar_ref_get_number(ShellVarRef *ref, long *value) {
+    const ShellVar *v = ref_resolve(ref);
+    if (v && v->has_ival) {
+        *value = v->ival;
+        return true;
+    }
+
+    // Same fallback to the environment as shellvar_get()
+    const char *text = v ? var_text((ShellVar *)v) : NULL;
+    if (!text) text = getenv(ref->name);
+    if (!text) return false;
+
+    *value = strtol(text, NULL, 10);
+    return true;
+}
+
+int shellvar_ref_set_int(ShellVarRef *ref, long value) {
+    ShellVar *v = ref_resolve(ref);
+    if (v && (v->attrs & VAR_ATTR_INTEGER) && !(v->attrs & VAR_ATTR_READONLY) && !v->array) {
+        store_int(v, value);
+        return 0;
+    }
+    return shellvar_set_int(ref->name, value);
+}
+
+int shellvar_set_integer(const char *name) {
+    if (!name) return -1;
+
+    ShellVar *v = find_var_to_change(name);
+
+    if (!v) {
+        v = new_var(name, getenv(name), 0);
+        if (!v) return -1;
+    }
+    // A value set before the attribute is kept as it is; arithmetic reads
+    // it as text until the next assignment
+    v->attrs |= VAR_ATTR_INTEGER;
+    return 0;
+}
+
+int shellvar_clear_integer(const char *name) {
+    if (!name) return -1;
+
+    ShellVar *v = find_var_to_change(name);
+    if (v && (v->attrs & VAR_ATTR_INTEGER)) {
+        var_text(v);
+        v->has_ival = false;
+        v->attrs &= ~VAR_ATTR_INTEGER;
+    }
+    return 0;
+}
+
+bool shellvar_is_integer(const char *name) {
+    if (!name) return false;
+
+    const ShellVar *v = find_var(name);
+    return v && (v->attrs & VAR_ATTR_INTEGER);
+}
+
+int shellvar_declare_array(const char *name, bool assoc) {
     if (!name) return -1;
 
+    ShellVar *v = find_var_to_change(name);
+    if (!v) {
+        v = new_var(name, getenv(name), 0);
+        if (!v) return -1;
+    }
+
+    if (v->array) {
+        if (v->array->assoc == assoc) return 0;
+        fprintf(stderr, "%s: %s: cannot convert %s array to %s\n", HASH_NAME, name,
+                assoc ? "indexed" : "associative", assoc ? "associative" : "indexed");
+        return -1;
+    }
+    if (v->attrs & VAR_ATTR_READONLY) {
+        fprintf(stderr, "%s: %s: readonly variable\n", HASH_NAME, name);
+        return -1;
+    }
+    return array_convert(v, assoc);
+}
+
+bool shellvar_is_array(const char *name) {
+    if (!name) return false;
+
+    const ShellVar *v = find_var(name);
+    return v && v->array;
+}
+
+bool shellvar_is_assoc(const char *name) {
+    if (!name) return false;
+
+    const ShellVar *v = find_var(name);
+    return v && v->array && v->array->assoc;
+}
+
+int shellvar_array_set(const char *name, const char *subscript, const char *value) {
+    if (!name || !subscript || !value) return -1;
+
+    ShellVar *v = find_var_to_change(name);
+    if (!v) {
+        v = new_var(name, NULL, 0);
+        if (!v) return -1;
+    }
+    if (v->attrs & VAR_ATTR_READONLY) {
+        fprintf(stderr, "%s: %s: readonly variable\n", HASH_NAME, name);
+        return -1;
+    }
+    if (!v->array && array_convert(v, false) != 0) return -1;
+
+    return array_store(v, subscript, value);
+}
+
+const char *shellvar_array_get(const char *name, const char *subscript) {
+    if (!name || !subscript) return NULL;
+
     ShellVar *v = find_var(name);
+    if (v && v->array && v->array->assoc) {
+        long found = assoc_find(v->array, subscript);
+        return found >= 0 ? v->array->entries[found].value : NULL;
+    }
 
-    if (v && (v->attrs & VAR_ATTR_READONLY)) {
+    // A scalar, or a variable only in the environment, is element 0
+    if (!v || !v->array) {
+        ShellVar scalar = { .name = (char *)name };
+        size_t index;
+        if (!array_index(v ? v : &scalar, subscript, &index) || index != 0) return NULL;
+        return shellvar_get(name);
+    }
+
+    size_t index;
+    if (!array_index(v, subscript, &index)) return NULL;
+    return indexed_get(v->array, index);
+}
+
+int shellvar_array_unset(const char *name, const char *subscript) {
+    if (!name || !subscript) return -1;
+
+    ShellVar *v = find_var_to_change(name);
+    if (!v) return 0;
+    if (v->attrs & VAR_ATTR_READONLY) {
         fprintf(stderr, "unset: %s is read-only\n", name);
         return -1;
     }
 
-    // Remove from our table
-    unsigned int h = hash_name(name);
-    ShellVar *prev = NULL;
-    v = var_table[h];
-    while (v) {
-        if (strcmp(v->name, name) == 0) {
-            if (prev) {
-                prev->next = v->next;
-            } else {
-                var_table[h] = v->next;
+    if (v->array && v->array->assoc) {
+        assoc_unset(v->array, subscript);
+        return 0;
+    }
+
+    size_t index;
+    if (!array_index(v, subscript, &index)) return -1;
+    if (!v->array) {
+        return index == 0 ? shellvar_unset(name) : 0;
+    }
+    indexed_unset(v->array, index);
+    return 0;
+}
+
+size_t shellvar_array_count(const char *name) {
+    if (!name) return 0;
+
+    ShellVar *v = find_var(name);
+    if (v && v->array) return v->array->count;
+    return shellvar_get(name) ? 1 : 0;
+}
+
+int shellvar_array_assign(const char *name, const ShellVarElement *elems, size_t count, bool append) {
+    if (!name) return -1;
+
+    ShellVar *v = find_var_to_change(name);
+    if (!v) {
+        v = new_var(name, NULL, 0);
+        if (!v) return -1;
+    }
+    if (v->attrs & VAR_ATTR_READONLY) {
+        fprintf(stderr, "%s: %s: readonly variable\n", HASH_NAME, name);
+        return -1;
+    }
+    if (!v->array && array_convert(v, false) != 0) return -1;
+    if (!append) array_clear(v->array);
+
+    int status = 0;
+    size_t next = v->array->size;
+    for (size_t i = 0; i < count; i++) {
+        if (v->array->assoc) {
+            if (!elems[i].key) {
+                fprintf(stderr, "%s: %s: %s: must use subscript when assigning associative array\n",
+                        HASH_NAME, name, elems[i].value);
+                status = -1;
+            } else if (array_store(v, elems[i].key, elems[i].value) != 0) {
+                status = -1;
             }
-            free(v->name);
-            free(v->value);
-            free(v);
-            break;
+            continue;
         }
-        prev = v;
-        v = v->next;
+
+        // [n]=value moves the next index along to n + 1
+        char index[24];
+        if (elems[i].key) {
+            size_t n;
+            if (!array_index(v, elems[i].key, &n)) {
+                status = -1;
+                continue;
+            }
+            next = n;
+        }
+        snprintf(index, sizeof(index), "%zu", next++);
+        if (array_store(v, index, elems[i].value) != 0) status = -1;
     }
+    return status;
+}
+
+bool shellvar_array_iter(const char *name, ShellVarIter *it) {
+    it->var = name ? find_var(name) : NULL;
+    it->scalar = NULL;
+    it->pos = 0;
+    if (it->var && it->var->array) {
+        if (it->var->array->sparse && sparse_sort(it->var->array) != 0) return false;
+        return true;
+    }
+
+    it->var = NULL;
+    it->scalar = name ? shellvar_get(name) : NULL;
+    return it->scalar != NULL;
+}
 
-    // Also unset from environment
+bool shellvar_array_next(ShellVarIter *it, const char **key, const char **value) {
+    const char *k = NULL;
+    const char *val = NULL;
+
+    if (!it->var) {
+        if (it->pos++ > 0 || !it->scalar) return false;
+        k = "0";
+        val = it->scalar;
+    } else if (it->var->array->assoc || it->var->array->sparse) {
+        const ShellArray *a = it->var->array;
+        while (it->pos < a->used && !a->entries[it->pos].key) it->pos++;
+        if (it->pos >= a->used) return false;
+        k = a->entries[it->pos].key;
+        val = a->entries[it->pos].value;
+        it->pos++;
+    } else {
+        const ShellArray *a = it->var->array;
+        while (it->pos < a->size && !a->items[it->pos]) it->pos++;
+        if (it->pos >= a->size) return false;
+        snprintf(it->index, sizeof(it->index), "%zu", it->pos);
+        k = it->index;
+        val = a->items[it->pos];
+        it->pos++;
+    }
+
+    if (key) *key = k;
+    if (value) *value = val;
+    return true;
+}
+
+int shellvar_unset(const char *name) {
+    if (!name) return -1;
+
+    ShellVar *v = find_var_to_change(name);
+
+    if (v && (v->attrs & VAR_ATTR_READONLY)) {
+        fprintf(stderr, "unset: %s is read-only\n", name);
+        return -1;
+    }
+
+    // Remove from our table
+    if (v) {
+        ShellVar **link = &var_table[hash_name(name) & (var_buckets - 1)];
+        while (*link != v) link = &(*link)->next;
+        *link = v->next;
+        if (v->attrs & VAR_ATTR_EXPORT) env_dirty = true;
+        free_var(v);
+        var_count--;
+        var_generation++;
+    }
+
+    // Also unset from environment, which the getenv() fallback reads
     unsetenv(name);
 
+    if (strcmp(name, "PATH") == 0) {
+        cmd_hash_clear();
+    }
+
     return 0;
 }
 
@@ -160,26 +1107,13 @@ bool shellvar_isset(const char *name) {
 int shellvar_set_readonly(const char *name) {
     if (!name) return -1;
 
-    ShellVar *v = find_var(name);
+    ShellVar *v = find_var_to_change(name);
 
     if (!v) {
-        // Create entry for readonly even if not set
-        v = malloc(sizeof(ShellVar));
+        // Create entry for readonly even if not set, with any value
+        // from the environment
+        v = new_var(name, getenv(name), 0);
         if (!v) return -1;
-
-        v->name = strdup(name);
-        v->value = NULL;
-        v->attrs = 0;
-
-        // Check environment for initial value
-        const char *env_val = getenv(name);
-        if (env_val) {
-            v->value = strdup(env_val);
-        }
-
-        unsigned int h = hash_name(name);
-        v->next = var_table[h];
-        var_table[h] = v;
     }
 
     v->attrs |= VAR_ATTR_READONLY;
@@ -196,29 +1130,30 @@ bool shellvar_is_readonly(const char *name) {
 int shellvar_set_export(const char *name) {
     if (!name) return -1;
 
-    ShellVar *v = find_var(name);
+    ShellVar *v = find_var_to_change(name);
 
     if (!v) {
-        // Create entry for export
-        v = malloc(sizeof(ShellVar));
+        // Create entry for export, keeping any value from the environment
+        v = new_var(name, getenv(name), 0);
         if (!v) return -1;
+    }
 
-        v->name = strdup(name);
-        v->value = NULL;
-        v->attrs = 0;
-
-        unsigned int h = hash_name(name);
-        v->next = var_table[h];
-        var_table[h] = v;
+    if (!(v->attrs & VAR_ATTR_EXPORT)) {
+        v->attrs |= VAR_ATTR_EXPORT;
+        env_dirty = true;
     }
 
-    v->attrs |= VAR_ATTR_EXPORT;
+    return 0;
+}
 
-    // Sync to environment
-    if (v->value) {
-        setenv(name, v->value, 1);
-    }
+int shellvar_clear_export(const char *name) {
+    if (!name) return -1;
 
+    ShellVar *v = find_var_to_change(name);
+    if (v && (v->attrs & VAR_ATTR_EXPORT)) {
+        v->attrs &= ~VAR_ATTR_EXPORT;
+        retire_env_entry(v);
+    }
     return 0;
 }
 
@@ -229,13 +1164,60 @@ bool shellvar_is_exported(const char *name) {
     return v && (v->attrs & VAR_ATTR_EXPORT);
 }
 
+char **shellvar_environ(void) {
+    if (!env_dirty && env_array) return env_array;
+
+    size_t count = 0;
+    for (size_t i = 0; i < var_buckets; i++) {
+        for (ShellVar *v = var_table[i]; v; v = v->next) {
+            if (env_value(v)) count++;
+        }
+    }
+
+    char **array = malloc((count + 1) * sizeof(char *));
+    if (!array) return env_array ? env_array : environ;
+
+    // Only variables whose value changed need a new "name=value" string
+    size_t n = 0;
+    for (size_t i = 0; i < var_buckets; i++) {
+        for (ShellVar *v = var_table[i]; v; v = v->next) {
+            const char *value = env_value(v);
+            if (!value) continue;
+            if (!v->env_entry) {
+                size_t name_len = strlen(v->name);
+                size_t value_len = strlen(value);
+                v->env_entry = malloc(name_len + value_len + 2);
+                if (!v->env_entry) continue;
+                memcpy(v->env_entry, v->name, name_len);
+                v->env_entry[name_len] = '=';
+                memcpy(v->env_entry + name_len + 1, value, value_len + 1);
+            }
+            array[n++] = v->env_entry;
+        }
+    }
+    array[n] = NULL;
+
+    // getenv() and library code see the same environment as children
+    environ = array;
+    free(env_array);
+    env_array = array;
+
+    for (size_t i = 0; i < env_retired_count; i++) {
+        free(env_retired[i]);
+    }
+    env_retired_count = 0;
+    env_dirty = false;
+    return env_array;
+}
+
 void shellvar_list_readonly(void) {
-    for (int i = 0; i < SHELLVAR_HASH_SIZE; i++) {
+    for (size_t i = 0; i < var_buckets; i++) {
         ShellVar *v = var_table[i];
         while (v) {
             if (v->attrs & VAR_ATTR_READONLY) {
-                if (v->value) {
-                    printf("readonly %s='%s'\n", v->name, v->value);
+                const char *value = var_text(v);
+                if (value) {
+                    printf("readonly %s='%s'\n", v->name, value);
                 } else {
                     printf("readonly %s\n", v->name);
                 }
@@ -248,12 +1230,13 @@ void shellvar_list_readonly(void) {
 void shellvar_list_exported(void) {
     // First, list variables from our internal table that are marked for export
     // This includes variables without values (export x without assignment)
-    for (int i = 0; i < SHELLVAR_HASH_SIZE; i++) {
+    for (size_t i = 0; i < var_buckets; i++) {
         ShellVar *v = var_table[i];
         while (v) {
             if (v->attrs & VAR_ATTR_EXPORT) {
-                if (v->value) {
-                    printf("export %s=\"%s\"\n", v->name, v->value);
+                const char *value = var_text(v);
+                if (value) {
+                    printf("export %s=\"%s\"\n", v->name, value);
                 } else {
                     printf("export %s\n", v->name);
                 }
@@ -263,7 +1246,6 @@ void shellvar_list_exported(void) {
     }
 
     // Also list from environment for variables not in our table
-    extern char **environ;
     for (char **env = environ; *env; env++) {
         // Parse name from NAME=value
         const char *equals = strchr(*env, '=');
@@ -282,41 +1264,24 @@ void shellvar_list_exported(void) {
     }
 }
 
-void shellvar_sync_to_env(const char *name) {
-    const ShellVar *v = find_var(name);
-    if (v && (v->attrs & VAR_ATTR_EXPORT) && v->value) {
-        setenv(name, v->value, 1);
-    }
-}
-
 void shellvar_sync_from_env(void) {
-    // Import critical environment variables
+    // Import the environment as exported variables
     // This is called at shell startup
-    extern char **environ;
     for (char **env = environ; *env; env++) {
         const char *eq = strchr(*env, '=');
-        if (eq) {
-            size_t namelen = eq - *env;
-            char *name = malloc(namelen + 1);
-            if (name) {
-                memcpy(name, *env, namelen);
-                name[namelen] = '\0';
-
-                // Create entry marked as exported
-                ShellVar *v = malloc(sizeof(ShellVar));
-                if (v) {
-                    v->name = name;
-                    v->value = strdup(eq + 1);
-                    v->attrs = VAR_ATTR_EXPORT;
-
-                    unsigned int h = hash_name(name);
-                    v->next = var_table[h];
-                    var_table[h] = v;
-                } else {
-                    free(name);
-                }
-            }
+        if (!eq) continue;
+
+        size_t namelen = eq - *env;
+        char *name = malloc(namelen + 1);
+        if (!name) continue;
+        memcpy(name, *env, namelen);
+        name[namelen] = '\0';
+
+        // The first definition of a name wins, as with getenv()
+        if (!find_var(name)) {
+            new_var(name, eq + 1, VAR_ATTR_EXPORT);
         }
+        free(name);
     }
 }
 
@@ -353,16 +1318,56 @@ static void print_quoted_value(const char *value) {
     printf("'");
 }
 
+// Print text in double quotes, escaping the characters special inside them
+static void print_double_quoted(const char *value) {
+    putchar('"');
+    for (const char *p = value; *p; p++) {
+        if (char_in_string(*p, "\"\\$`")) putchar('\\');
+        putchar(*p);
+    }
+    putchar('"');
+}
+
+// Print the elements of an array as a compound assignment: ([key]="value" ...)
+static void print_array(ShellVar *v) {
+    ShellVarIter it = { .var = v };
+    const char *key;
+    const char *value;
+    bool first = true;
+
+    putchar('(');
+    while (shellvar_array_next(&it, &key, &value)) {
+        if (!first) putchar(' ');
+        first = false;
+        putchar('[');
+        if (v->array->assoc) {
+            print_quoted_value(key);
+        } else {
+            fputs(key, stdout);
+        }
+        printf("]=");
+        print_double_quoted(value);
+    }
+    putchar(')');
+}
+
 // List all shell variables (for `set` with no arguments)
 void shellvar_list_all(void) {
-    extern char **environ;
+    if (pipestatus_pending) pipestatus_store();
 
     // First, list all variables from our internal table (includes local variables)
-    for (int i = 0; i < SHELLVAR_HASH_SIZE; i++) {
+    for (size_t i = 0; i < var_buckets; i++) {
         for (ShellVar *v = var_table[i]; v; v = v->next) {
-            if (v->value) {  // Only print if variable has a value
+            if (v->array) {
+                printf("%s=", v->name);
+                print_array(v);
+                printf("\n");
+                continue;
+            }
+            const char *value = var_text(v);
+            if (value) {  // Only print if variable has a value
                 printf("%s=", v->name);
-                print_quoted_value(v->value);
+                print_quoted_value(value);
                 printf("\n");
             }
         }
@@ -388,3 +1393,156 @@ void shellvar_list_all(void) {
         }
     }
 }
+
+// Print one variable as a declare command
+static void print_declare(ShellVar *v) {
+    char flags[8];
+    size_t n = 0;
+    if (v->attrs & VAR_ATTR_ARRAY) flags[n++] = 'a';
+    if (v->attrs & VAR_ATTR_ASSOC) flags[n++] = 'A';
+    if (v->attrs & VAR_ATTR_INTEGER) flags[n++] = 'i';
+    if (v->attrs & VAR_ATTR_READONLY) flags[n++] = 'r';
+    if (v->attrs & VAR_ATTR_EXPORT) flags[n++] = 'x';
+    if (n == 0) flags[n++] = '-';
+    flags[n] = '\0';
+
+    if (v->array) {
+        printf("declare -%s %s=", flags, v->name);
+        print_array(v);
+        printf("\n");
+        return;
+    }
+
+    const char *value = var_text(v);
+    if (!value) {
+        printf("declare -%s %s\n", flags, v->name);
+        return;
+    }
+
+    printf("declare -%s %s=", flags, v->name);
+    print_double_quoted(value);
+    printf("\n");
+}
+
+int shellvar_print_declare(const char *name) {
+    ShellVar *v = find_var(name);
+    if (!v) return -1;
+
+    print_declare(v);
+    return 0;
+}
+
+void shellvar_list_declare(int attrs) {
+    if (pipestatus_pending) pipestatus_store();
+
+    for (size_t i = 0; i < var_buckets; i++) {
+        for (ShellVar *v = var_table[i]; v; v = v->next) {
+            if ((v->attrs & attrs) == attrs) {
+                print_declare(v);
+            }
+        }
+    }
+}
+
+ShellVarSnapshot *shellvar_snapshot(void) {
+    if (pipestatus_pending) pipestatus_store();
+
+    ShellVarSnapshot *snap = calloc(1, sizeof(ShellVarSnapshot));
+    if (!snap) return NULL;
+
+    snap->id = ++journal_next_id;
+    snap->outer = journal;
+    journal = snap;
+    return snap;
+}
+
+size_t shellvar_snapshot_saved(const ShellVarSnapshot *snap) {
+    return snap ? snap->count : 0;
+}
+
+void shellvar_restore(ShellVarSnapshot *snap) {
+    if (!snap) return;
+
+    // Putting entries back is not itself a change to record
+    journal = snap->outer;
+
+    // Remembered command paths depend on PATH
+    char *old_path = NULL;
+    bool path_touched = false;
+    for (size_t i = 0; i < snap->count; i++) {
+        if (strcmp(snap->entries[i].name, "PATH") == 0) {
+            ShellVar *path = lookup_var("PATH");
+            const char *text = path ? var_text(path) : NULL;
+            old_path = text ? strdup(text) : NULL;
+            path_touched = true;
+            break;
+        }
+    }
+
+    // Exported variables that are unchanged keep their environment entries,
+    // so a command that touched no exports needs no rebuild
+    bool dirty = env_dirty;
+    size_t retired_before = env_retired_count;
+
+    // Newest first, so the oldest saved state of each variable wins
+    for (size_t i = snap->count; i-- > 0;) {
+        JournalEntry *e = &snap->entries[i];
+        ShellVar *cur = lookup_var(e->name);
+        if (cur) {
+            ShellVar **link = &var_table[hash_name(e->name) & (var_buckets - 1)];
+            while (*link != cur) link = &(*link)->next;
+            *link = cur->next;
+            var_count--;
+
+            const char *saved_value = e->saved ? env_value(e->saved) : NULL;
+            const char *cur_value = env_value(cur);
+            if (saved_value && cur_value && cur->env_entry && strcmp(cur_value, saved_value) == 0) {
+                e->saved->env_entry = cur->env_entry;
+                cur->env_entry = NULL;
+            }
+            free_var(cur);
+        }
+
+        ShellVar *saved = e->saved;
+        if (saved) {
+            if (!var_table) {
+                var_table = calloc(SHELLVAR_INITIAL_BUCKETS, sizeof(ShellVar *));
+                if (!var_table) {
+                    free_var(saved);
+                    free(e->name);
+                    continue;
+                }
+                var_buckets = SHELLVAR_INITIAL_BUCKETS;
+            }
+            if ((var_count + 1) * 4 > var_buckets * 3) grow_table();
+            unsigned int h = hash_name(saved->name) & (var_buckets - 1);
+            saved->next = var_table[h];
+            var_table[h] = saved;
+            var_count++;
+            if (env_value(saved) && !saved->env_entry) dirty = true;
+        }
+        free(e->name);
+    }
+    if (env_retired_count != retired_before) dirty = true;
+
+    if (path_touched) {
+        ShellVar *path = lookup_var("PATH");
+        const char *new_path = path ? var_text(path) : NULL;
+        if ((old_path || new_path) && (!old_path || !new_path || strcmp(old_path, new_path) != 0)) {
+            cmd_hash_clear();
+        }
+        free(old_path);
+    }
+
+    if (snap->count > 0) {
+        env_dirty = dirty;
+        var_generation++;
+    }
+    free(snap->entries);
+    free(snap);
+
+    // A stale environ could show a dropped export through getenv()
+    if (env_dirty && env_array && environ == env_array) {
+        shellvar_environ();
+    }
+}
@@ -2,10 +2,14 @@
 #define SHELLVAR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 // Variable attributes
 #define VAR_ATTR_READONLY  0x01
 #define VAR_ATTR_EXPORT    0x02
+#define VAR_ATTR_INTEGER   0x04
+#define VAR_ATTR_ARRAY     0x08
+#define VAR_ATTR_ASSOC     0x10
 
 // Initialize shell variable system
 void shellvar_init(void);
@@ -21,6 +25,116 @@ int shellvar_set(const char *name, const char *value);
 // Returns NULL if not set
 const char *shellvar_get(const char *name);
 
+// Set a variable from an arithmetic result
+// An integer variable keeps the native value and is formatted as text only
+// when read; any other variable gets the decimal string
+// Returns 0 on success, -1 on error (e.g., readonly variable)
+int shellvar_set_int(const char *name, long value);
+
+// Get the native value of an integer variable without converting text
+// Returns false if the variable is not an integer variable with a value
+bool shellvar_get_int(const char *name, long *value);
+
+// Handle to a variable for code that reads and writes it repeatedly, such
+// as compiled arithmetic. It keeps the entry found by the last lookup and
+// looks the name up again only after variables were created or freed.
+struct ShellVar;
+typedef struct {
+    const char *name;           // Not owned; must outlive the handle
+    struct ShellVar *var;       // Entry in the table, or NULL
+    unsigned long generation;   // Table generation var was found in
+} ShellVarRef;
+
+// Initialize a handle for the variable called name
+void shellvar_ref_init(ShellVarRef *ref, const char *name);
+
+// Get a variable's value as a number (decimal text is converted)
+// Returns false if the variable is not set
+bool shellvar_ref_get_number(ShellVarRef *ref, long *value);
+
+// Set a variable from an arithmetic result, as shellvar_set_int()
+// Returns 0 on success, -1 on error (e.g., readonly variable)
+int shellvar_ref_set_int(ShellVarRef *ref, long value);
+
+// Give a variable the integer attribute (declare -i); later assignments
+// are evaluated as arithmetic expressions
+// Returns 0 on success, -1 on error
+int shellvar_set_integer(const char *name);
+
+// Remove the integer attribute, keeping the current value as text
+// Returns 0 on success, -1 on error
+int shellvar_clear_integer(const char *name);
+
+// Check if variable has the integer attribute
+bool shellvar_is_integer(const char *name);
+
+// Array variables. An indexed array keeps its elements in one vector
+// addressed by index; an associative array keeps its entries in insertion
+// order with an open-addressed hash index over them. Element lookups and
+// assignments take constant time either way. Subscripts are passed as text:
+// an indexed array evaluates them as arithmetic, an associative array uses
+// them as keys. A scalar variable reads as an array with one element, and
+// $name reads element 0 (or key "0") of an array.
+
+// Make a variable an array (declare -a, or -A when assoc is true); a
+// scalar value becomes element 0
+// Returns 0 on success, -1 on error (e.g., converting between array kinds)
+int shellvar_declare_array(const char *name, bool assoc);
+
+// Check if variable is an indexed or associative array
+bool shellvar_is_array(const char *name);
+
+// Check if variable is an associative array
+bool shellvar_is_assoc(const char *name);
+
+// Set one element, creating an indexed array if the variable does not exist
+// Returns 0 on success, -1 on error (e.g., readonly or bad subscript)
+int shellvar_array_set(const char *name, const char *subscript, const char *value);
+
+// Get one element
+// Returns NULL if the variable or the element is not set
+const char *shellvar_array_get(const char *name, const char *subscript);
+
+// Unset one element (unset 'name[subscript]')
+// Returns 0 on success, -1 on error (e.g., readonly variable)
+int shellvar_array_unset(const char *name, const char *subscript);
+
+// Number of elements set (${#name[@]})
+size_t shellvar_array_count(const char *name);
+
+// Element of a compound assignment; key is NULL for the next index
+typedef struct {
+    const char *key;
+    const char *value;
+} ShellVarElement;
+
+// Assign name=(...): replace the elements, or add to them when append is
+// true (name+=(...)). A variable that is not an array becomes an indexed one.
+// Returns 0 on success, -1 on error
+int shellvar_array_assign(const char *name, const ShellVarElement *elems, size_t count, bool append);
+
+// Record the exit status of each stage of the last pipeline (or of the last
+// command, as a single status) for the PIPESTATUS array
+// The array is only built when the variable is next read
+void shellvar_set_pipestatus(const int *statuses, int count);
+
+// Position in a walk over the elements of an array
+typedef struct {
+    struct ShellVar *var;       // Array being walked, or NULL for a scalar
+    const char *scalar;         // Value of a scalar, read as element 0
+    size_t pos;
+    char index[24];             // Key of the last indexed element, as text
+} ShellVarIter;
+
+// Start walking a variable's elements, in index or insertion order
+// Returns false if the variable is not set
+// The variable must not be changed until the walk is over
+bool shellvar_array_iter(const char *name, ShellVarIter *it);
+
+// Get the next element and its key (either may be NULL if not wanted)
+// Returns false after the last element
+bool shellvar_array_next(ShellVarIter *it, const char **key, const char **value);
+
 // Unset a shell variable
 // Returns 0 on success, -1 on error (e.g., readonly variable)
 int shellvar_unset(const char *name);
@@ -39,22 +153,52 @@ bool shellvar_is_readonly(const char *name);
 // Returns 0 on success, -1 on error
 int shellvar_set_export(const char *name);
 
+// Remove the export attribute, keeping the value as a shell variable
+// Returns 0 on success, -1 on error
+int shellvar_clear_export(const char *name);
+
 // Check if variable is exported
 bool shellvar_is_exported(const char *name);
 
+// Get the environment for child processes: "name=value" for every exported
+// variable that has a value. The array is cached and rebuilt only after an
+// exported variable changed; environ is pointed at it as well. Valid until
+// the next change to an exported variable.
+char **shellvar_environ(void);
+
 // List all readonly variables (for `readonly` with no args)
 void shellvar_list_readonly(void);
 
 // List all exported variables (for `export` with no args)
 void shellvar_list_exported(void);
 
-// Sync a shell variable to environment (for exported vars)
-void shellvar_sync_to_env(const char *name);
-
 // Sync environment to shell variables on startup
 void shellvar_sync_from_env(void);
 
 // List all shell variables (for `set` with no arguments)
 void shellvar_list_all(void);
 
+// Print a variable with its attributes as a declare command (declare -p name)
+// Returns 0 on success, -1 if the variable does not exist
+int shellvar_print_declare(const char *name);
+
+// List variables that have all of the given attributes as declare commands
+// (declare -p with no names; 0 lists every variable)
+void shellvar_list_declare(int attrs);
+
+// Undo journal of variable changes
+typedef struct ShellVarSnapshot ShellVarSnapshot;
+
+// Start recording variable changes so that commands run in-process can be
+// undone; each variable is copied only when it is first changed
+// Snapshots nest and must be restored innermost first
+// Returns NULL on allocation failure
+ShellVarSnapshot *shellvar_snapshot(void);
+
+// Number of variables the snapshot has saved so far
+size_t shellvar_snapshot_saved(const ShellVarSnapshot *snap);
+
+// Put back the variables changed since shellvar_snapshot() and free the snapshot
+void shellvar_restore(ShellVarSnapshot *snap);
+
 #endif // SHELLVAR_H
@@ -10,6 +10,7 @@
 #include "safe_string.h"
 #include "danger.h"
 #include "utils.h"
+#include "pathindex.h"
 
 // Command cache for performance
 #define CMD_CACHE_SIZE 128
@@ -17,6 +18,7 @@
 typedef struct {
     char name[64];
     int result;  // 0=invalid, 1=external, 2=builtin, 3=alias
+    unsigned long generation;  // PATH index generation the result came from
 } CmdCacheEntry;
 
 static CmdCacheEntry cmd_cache[CMD_CACHE_SIZE];
@@ -48,9 +50,11 @@ void syntax_cache_clear(void) {
 int syntax_check_command(const char *cmd) {
     if (!cmd || !*cmd) return 0;
 
-    // Check cache first
+    // Check cache first; a rebuilt PATH index means commands came or went
+    unsigned long generation = pathindex_generation();
     unsigned int idx = hash_string(cmd) % CMD_CACHE_SIZE;
-    if (cmd_cache[idx].name[0] && strcmp(cmd_cache[idx].name, cmd) == 0) {
+    if (cmd_cache[idx].name[0] && strcmp(cmd_cache[idx].name, cmd) == 0 &&
+        cmd_cache[idx].generation == generation) {
         return cmd_cache[idx].result;
     }
 
@@ -76,6 +80,7 @@ int syntax_check_command(const char *cmd) {
     // Cache the result
     safe_strcpy(cmd_cache[idx].name, cmd, sizeof(cmd_cache[idx].name));
     cmd_cache[idx].result = result;
+    cmd_cache[idx].generation = generation;
 
     return result;
 }
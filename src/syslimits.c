@@ -3,6 +3,7 @@
 #include <string.h>
 #include <errno.h>
 #include "syslimits.h"
+#include "shellvar.h"
 
 // Default ARG_MAX if sysconf fails (256KB - conservative for older systems)
 #define DEFAULT_ARG_MAX 262144
@@ -10,8 +11,6 @@
 // Cache the ARG_MAX value (queried once)
 static long cached_arg_max = 0;
 
-extern char **environ;
-
 long syslimits_arg_max(void) {
     if (cached_arg_max == 0) {
         cached_arg_max = sysconf(_SC_ARG_MAX);
@@ -39,11 +38,12 @@ size_t syslimits_args_size(char **args) {
 }
 
 size_t syslimits_env_size(void) {
-    if (!environ) return 0;
+    char **envp = shellvar_environ();
+    if (!envp) return 0;
 
     size_t total = 0;
-    for (int i = 0; environ[i] != NULL; i++) {
-        total += strlen(environ[i]) + 1;
+    for (int i = 0; envp[i] != NULL; i++) {
+        total += strlen(envp[i]) + 1;
         total += sizeof(char *);
     }
     total += sizeof(char *);
@@ -11,6 +11,7 @@
 #include <regex.h>
 #include "test_builtin.h"
 #include "hash.h"
+#include "shellvar.h"
 #include "safe_string.h"
 
 // Forward declarations for recursive parsing
@@ -717,7 +718,7 @@ static int eval_double_bracket_primary(char **args, int *pos, int argc) {
                 return test_terminal(operand);
             case 'v':  // [[ -v VAR ]] - variable is set
                 (*pos) += 2;
-                return (getenv(operand) != NULL) ? 0 : 1;
+                return shellvar_isset(operand) ? 0 : 1;
             default:
                 break;
         }
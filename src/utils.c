@@ -1,3 +1,9 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "utils.h"
 
 // Search for character in the string
@@ -10,3 +16,47 @@ bool char_in_string(char c, const char *str) {
 
     return false;
 }
+
+// Make room for at least need bytes in a growable line buffer
+static bool line_reserve(char **line, size_t *cap, size_t need) {
+    if (need <= *cap) return true;
+    size_t new_cap = *cap ? *cap : 128;
+    while (new_cap < need) new_cap *= 2;
+    char *p = realloc(*line, new_cap);
+    if (!p) return false;
+    *line = p;
+    *cap = new_cap;
+    return true;
+}
+
+// Read a line from fd, leaving the offset just past the newline
+ssize_t fd_read_line(int fd, char **line, size_t *cap) {
+    size_t len = 0;
+    bool seekable = lseek(fd, 0, SEEK_CUR) >= 0;
+
+    for (;;) {
+        size_t chunk = seekable ? 4096 : 1;
+        if (!line_reserve(line, cap, len + chunk + 1)) return -1;
+
+        ssize_t n = read(fd, *line + len, chunk);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+
+        char *nl = memchr(*line + len, '\n', (size_t)n);
+        if (nl) {
+            size_t used = (size_t)(nl - (*line + len)) + 1;
+            // Give back what was read beyond the newline
+            if ((size_t)n > used) lseek(fd, -(off_t)((size_t)n - used), SEEK_CUR);
+            len += used;
+            break;
+        }
+        len += (size_t)n;
+    }
+
+    if (!line_reserve(line, cap, len + 1)) return -1;
+    (*line)[len] = '\0';
+    return (ssize_t)len;
+}
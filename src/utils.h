@@ -2,6 +2,8 @@
 #define UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
 
 /**
  * Check whether character is in the string.
@@ -22,4 +24,20 @@
  */
 bool char_in_string(char c, const char *str);
 
+/**
+ * Read one line from a file descriptor without reading past it.
+ * Seekable descriptors are read in blocks and rewound to just after the
+ * newline; pipes and terminals are read a byte at a time. Either way the
+ * descriptor is left positioned at the start of the next line, so a child
+ * process sharing it sees exactly the unread input.
+ *
+ * @param fd File descriptor to read from
+ * @param line In/out: growable buffer (may start as NULL)
+ * @param cap In/out: capacity of *line
+ *
+ * @return Number of bytes stored in *line including the newline (if any),
+ *      0 at end of file, or -1 on error. *line is always NUL-terminated.
+ */
+ssize_t fd_read_line(int fd, char **line, size_t *cap);
+
 #endif // UTILS_H
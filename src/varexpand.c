@@ -5,6 +5,7 @@
 #include <ctype.h>
 #include <fnmatch.h>
 #include "varexpand.h"
+#include "arena.h"
 #include "safe_string.h"
 #include "hash.h"
 #include "script.h"
@@ -14,19 +15,20 @@
 #include "ifs.h"
 #include "utils.h"
 
-#define MAX_EXPANDED_LENGTH 8192
+// Starting size of the result buffer, beyond the input length
+#define EXPAND_INITIAL_SLACK 256
 
 // Track if an unset variable error occurred during expansion
 static bool varexpand_error = false;
 
 // Convert \x01 markers in pattern to backslash escapes for fnmatch
-// Returns a static buffer - not thread safe
+// Returns a string in the command arena
 static const char *convert_pattern_for_fnmatch(const char *pattern) {
-    static char converted[2048];
+    char *converted = arena_alloc(strlen(pattern) + 1);
     size_t out = 0;
     const char *p = pattern;
 
-    while (*p && out < sizeof(converted) - 2) {
+    while (*p) {
         if (*p == '\x01' && *(p + 1)) {
             // Marker followed by character - convert to backslash escape
             converted[out++] = '\\';
@@ -76,13 +78,13 @@ static const char *get_positional_param(int n) {
 }
 
 // Add \x02 marker before each $ in word to indicate quoted context
-// Returns a static buffer - caller should use immediately or copy
+// Returns a string in the command arena
 static const char *mark_dollars_as_quoted(const char *word) {
-    static char marked[4096];
+    char *marked = arena_alloc(strlen(word) * 2 + 1);
     size_t out = 0;
     const char *p = word;
 
-    while (*p && out < sizeof(marked) - 2) {
+    while (*p) {
         if (*p == '$' && (out == 0 || marked[out-1] != '\x02')) {
             // Add \x02 marker before $ if not already marked
             marked[out++] = '\x02';
@@ -93,24 +95,210 @@ static const char *mark_dollars_as_quoted(const char *word) {
     return marked;
 }
 
+// Find the ] that closes a subscript; p points just past the [
+static const char *subscript_end(const char *p) {
+    int depth = 1;
+    for (; *p; p++) {
+        if (*p == '\x01' && *(p + 1)) {
+            p++;
+        } else if (*p == '[') {
+            depth++;
+        } else if (*p == ']' && --depth == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Check for an [@] or [*] subscript (the parser may mark the character)
+static char subscript_all(const char *sub, size_t len) {
+    if (len == 2 && *sub == '\x01') {
+        sub++;
+        len--;
+    }
+    return (len == 1 && char_in_string(*sub, "@*")) ? *sub : 0;
+}
+
+// Expand parameters in a subscript and drop the quoting markers
+// Returns a string in the command arena
+static char *expand_subscript(const char *sub, size_t len, int last_exit_code) {
+    char *text = arena_strndup(sub, len);
+    char *expanded = NULL;
+    if (strchr(text, '$')) {
+        expanded = varexpand_expand(text, last_exit_code);
+        if (expanded) text = expanded;
+    }
+
+    char *key = arena_alloc(strlen(text) + 1);
+    size_t n = 0;
+    for (const char *p = text; *p; p++) {
+        if (*p == '\x01' && *(p + 1)) {
+            key[n++] = *++p;
+        } else if (!char_in_string(*p, "\x02\x03\x04")) {
+            key[n++] = *p;
+        }
+    }
+    key[n] = '\0';
+    free(expanded);
+    return key;
+}
+
+size_t varexpand_array(const char *str, int last_exit_code, VarArrayRef *ref) {
+    const char *p = str;
+    bool length = false;
+    ref->keys = false;
+    if (*p == '#') {
+        length = true;
+        p++;
+    } else if (*p == '!') {
+        ref->keys = true;
+        p++;
+    }
+
+    const char *name_start = p;
+    if (!isalpha((unsigned char)*p) && *p != '_') return 0;
+    while (is_varname_char(*p)) p++;
+    if (*p != '[') return 0;
+
+    const char *sub = p + 1;
+    const char *end = subscript_end(sub);
+    if (!end || *(end + 1) != '}') return 0;
+
+    size_t sub_len = (size_t)(end - sub);
+    char all = subscript_all(sub, sub_len);
+    if (ref->keys && !all) return 0;
+
+    char *name = arena_strndup(name_start, (size_t)(p - name_start));
+    ref->all = false;
+    ref->star = all == '*';
+    ref->value = NULL;
+
+    if (all) {
+        if (length) {
+            snprintf(ref->scratch, sizeof(ref->scratch), "%zu", shellvar_array_count(name));
+            ref->value = ref->scratch;
+        } else {
+            shellvar_array_iter(name, &ref->iter);
+            ref->all = true;
+        }
+    } else {
+        char *key = expand_subscript(sub, sub_len, last_exit_code);
+        ref->value = shellvar_array_get(name, key);
+        if (!ref->value) check_unset_error(name);
+        if (length) {
+            snprintf(ref->scratch, sizeof(ref->scratch), "%zu", ref->value ? strlen(ref->value) : 0);
+            ref->value = ref->scratch;
+        }
+    }
+    return (size_t)(end + 2 - str);
+}
+
+// Join the elements of an array reference into one string in the arena:
+// \x04 between fields, or the first IFS character for a quoted [*]
+static char *join_array(const VarArrayRef *ref, bool quoted) {
+    char sep = '\x04';
+    bool use_sep = true;
+    if (ref->star && quoted) {
+        const char *ifs = ifs_get();
+        sep = ifs[0];
+        use_sep = ifs[0] != '\0';
+    }
+
+    // Measure first so the string is allocated once
+    ShellVarIter it = ref->iter;
+    const char *key;
+    const char *value;
+    size_t total = 0;
+    while (shellvar_array_next(&it, &key, &value)) {
+        total += strlen(ref->keys ? key : value) + 1;
+    }
+
+    char *joined = arena_alloc(total + 1);
+    size_t n = 0;
+    bool first = true;
+    it = ref->iter;
+    while (shellvar_array_next(&it, &key, &value)) {
+        const char *s = ref->keys ? key : value;
+        if (!first && use_sep) joined[n++] = sep;
+        first = false;
+        size_t len = strlen(s);
+        memcpy(joined + n, s, len);
+        n += len;
+    }
+    joined[n] = '\0';
+    return joined;
+}
+
+// Join $1..$N into one string in the arena, with sep between them unless
+// use_sep is false
+static char *join_positional(char sep, bool use_sep) {
+    size_t total = 0;
+    for (int i = 1; i < script_state.positional_count; i++) {
+        const char *param = get_positional_param(i);
+        if (param) total += strlen(param) + 1;
+    }
+
+    char *joined = arena_alloc(total + 1);
+    size_t pos = 0;
+    for (int i = 1; i < script_state.positional_count; i++) {
+        const char *param = get_positional_param(i);
+        if (param) {
+            if (i > 1 && use_sep) joined[pos++] = sep;
+            size_t plen = strlen(param);
+            memcpy(joined + pos, param, plen);
+            pos += plen;
+        }
+    }
+    joined[pos] = '\0';
+    return joined;
+}
+
+// Expand the word of a ${var-word} style modifier, preserving quoting context
+// Returns the word itself or a string in the command arena
+static const char *expand_modifier_word(const char *word, bool is_quoted, int last_exit_code) {
+    if (!strchr(word, '$')) return word;
+
+    const char *word_to_expand = is_quoted ? mark_dollars_as_quoted(word) : word;
+    char *expanded_word = varexpand_expand(word_to_expand, last_exit_code);
+    if (!expanded_word) return word;
+
+    char *copy = arena_strndup(expanded_word, strlen(expanded_word));
+    free(expanded_word);
+    return copy;
+}
+
+// Make room for extra more bytes (and a terminator) in the result buffer,
+// doubling it so long expansions stay linear
+static char *reserve_result(char *result, size_t *size, size_t used, size_t extra) {
+    size_t needed = used + extra + 1;
+    if (needed <= *size) return result;
+
+    size_t new_size = *size * 2;
+    while (new_size < needed) new_size *= 2;
+    result = arena_realloc(result, *size, new_size);
+    *size = new_size;
+    return result;
+}
+
 // Expand environment variables in a string
 char *varexpand_expand(const char *str, int last_exit_code) {
     if (!str) return NULL;
 
-    // Allocate proportionally to input size (expansion can grow the string)
+    // Start proportional to the input; reserve_result() grows it as needed
     size_t input_len = strlen(str);
-    size_t result_size = input_len * 2 + 4096;
-    if (result_size < MAX_EXPANDED_LENGTH) {
-        result_size = MAX_EXPANDED_LENGTH;
-    }
+    size_t result_size = input_len * 2 + EXPAND_INITIAL_SLACK;
 
-    char *result = malloc(result_size);
-    if (!result) return NULL;
+    // Work in the command arena; only the finished string goes to the heap
+    ArenaMark mark = arena_mark();
+    char *result = arena_alloc(result_size);
 
     size_t out_pos = 0;
     const char *p = str;
 
-    while (*p && out_pos < result_size - 1) {
+    while (*p) {
+        // Every path below writes at most two bytes before appending a value
+        result = reserve_result(result, &result_size, out_pos, 2);
+
         if (*p == '\x01' && *(p + 1) == '\\' && *(p + 2) == '\\') {
             // Protected double backslash from single quotes - output both literally
             result[out_pos++] = '\\';
@@ -182,10 +370,6 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                 // POSIX: When quoted ("$*"), join with first character of IFS (single field)
                 // When unquoted, each param becomes a separate field (use \x04 separator)
                 if (*p == '\x01') p++;  // Skip marker if present
-                static char star_buf[MAX_EXPANDED_LENGTH];
-                star_buf[0] = '\0';
-                size_t pos = 0;
-
                 // Determine separator based on quoting context
                 char sep = '\x04';  // Default: separate fields for unquoted
                 bool use_sep = true;
@@ -198,46 +382,13 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                         sep = ifs[0];
                     }
                 }
-
-                for (int i = 1; i < script_state.positional_count && pos < sizeof(star_buf) - 1; i++) {
-                    const char *param = get_positional_param(i);
-                    if (param) {
-                        if (i > 1 && use_sep && pos < sizeof(star_buf) - 1) {
-                            star_buf[pos++] = sep;
-                        }
-                        size_t plen = strlen(param);
-                        if (pos + plen < sizeof(star_buf)) {
-                            memcpy(star_buf + pos, param, plen);
-                            pos += plen;
-                        }
-                    }
-                }
-                star_buf[pos] = '\0';
-                var_value = star_buf;
+                var_value = join_positional(sep, use_sep);
                 p++;
             } else if (*p == '@') {
                 // $@ - all positional parameters
                 // Both quoted ("$@") and unquoted ($@) produce separate fields
                 // Use \x04 separator to ensure each param becomes a separate argument
-                static char at_buf[MAX_EXPANDED_LENGTH];
-                at_buf[0] = '\0';
-                size_t pos = 0;
-                for (int i = 1; i < script_state.positional_count && pos < sizeof(at_buf) - 1; i++) {
-                    const char *param = get_positional_param(i);
-                    if (param) {
-                        if (i > 1 && pos < sizeof(at_buf) - 1) {
-                            // Use \x04 separator for both quoted and unquoted $@
-                            at_buf[pos++] = '\x04';
-                        }
-                        size_t plen = strlen(param);
-                        if (pos + plen < sizeof(at_buf)) {
-                            memcpy(at_buf + pos, param, plen);
-                            pos += plen;
-                        }
-                    }
-                }
-                at_buf[pos] = '\0';
-                var_value = at_buf;
+                var_value = join_positional('\x04', true);
                 p++;
             } else if (*p == '0') {
                 // $0 - script name or shell name
@@ -248,6 +399,15 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                 // ${VAR} or ${VAR-default} or ${VAR:-default} or ${#VAR} etc syntax
                 p++;  // Skip {
 
+                // ${name[subscript]}, ${#name[subscript]} and ${!name[@]}
+                VarArrayRef array_ref;
+                size_t array_used = varexpand_array(p, last_exit_code, &array_ref);
+                if (array_used > 0) {
+                    p += array_used;
+                    var_value = array_ref.all ? join_array(&array_ref, is_quoted) : array_ref.value;
+                    goto append_value;
+                }
+
                 // Check for ${#VAR} - string length syntax
                 bool get_length = false;
                 if (*p == '#' && *(p + 1) == '}') {
@@ -270,12 +430,26 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                 }
                 var_name[name_len] = '\0';
 
+                // An array element with a modifier: ${name[subscript]:-word}
+                const char *subscript = NULL;
+                char subscript_kind = 0;    // @ or * for every element
+                if (*p == '[' && name_len > 0) {
+                    const char *end = subscript_end(p + 1);
+                    if (end) {
+                        size_t sub_len = (size_t)(end - (p + 1));
+                        subscript_kind = subscript_all(p + 1, sub_len);
+                        if (!subscript_kind) {
+                            subscript = expand_subscript(p + 1, sub_len, last_exit_code);
+                        }
+                        p = end + 1;
+                    }
+                }
+
                 // Check for modifiers: - + = ? # % (and : prefix)
                 char modifier = 0;
                 bool check_null = false;
                 bool double_modifier = false;  // For ## and %%
-                static char word[1024];  // static to persist after scope
-                word[0] = '\0';
+                const char *word = "";
 
                 if (*p == ':') {
                     check_null = true;
@@ -291,17 +465,14 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                     }
 
                     // Parse the word/pattern until closing brace
-                    size_t word_len = 0;
+                    const char *word_start = p;
                     int brace_depth = 1;
-                    while (*p && brace_depth > 0 && word_len < sizeof(word) - 1) {
+                    while (*p) {
                         if (*p == '{') brace_depth++;
-                        else if (*p == '}') {
-                            brace_depth--;
-                            if (brace_depth == 0) break;
-                        }
-                        word[word_len++] = *p++;
+                        else if (*p == '}' && --brace_depth == 0) break;
+                        p++;
                     }
-                    word[word_len] = '\0';
+                    word = arena_strndup(word_start, (size_t)(p - word_start));
                 }
 
                 if (*p == '}') {
@@ -319,7 +490,16 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                                 break;
                             }
                         }
-                        if (is_positional) {
+                        if (subscript_kind) {
+                            // Modifiers apply to the elements joined together
+                            VarArrayRef all_ref = { .star = subscript_kind == '*' };
+                            if (shellvar_array_iter(var_name, &all_ref.iter) &&
+                                shellvar_array_count(var_name) > 0) {
+                                val = join_array(&all_ref, is_quoted);
+                            }
+                        } else if (subscript) {
+                            val = shellvar_array_get(var_name, subscript);
+                        } else if (is_positional) {
                             int param_num = atoi(var_name);
                             val = get_positional_param(param_num);
                         } else {
@@ -332,7 +512,6 @@ char *varexpand_expand(const char *str, int last_exit_code) {
 
                         // Apply modifier
                         // Note: POSIX requires the word to be expanded when used
-                        static char expanded_word_buf[4096];
                         const char *effective_word = word;
 
                         if (modifier == '-') {
@@ -340,15 +519,7 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                             // ${var:-word}: use word if unset or null
                             if (is_unset || (check_null && is_null)) {
                                 // Expand variables in word, preserving quoting context
-                                if (strchr(word, '$')) {
-                                    const char *word_to_expand = is_quoted ? mark_dollars_as_quoted(word) : word;
-                                    char *expanded_word = varexpand_expand(word_to_expand, last_exit_code);
-                                    if (expanded_word) {
-                                        safe_strcpy(expanded_word_buf, expanded_word, sizeof(expanded_word_buf));
-                                        free(expanded_word);
-                                        effective_word = expanded_word_buf;
-                                    }
-                                }
+                                effective_word = expand_modifier_word(word, is_quoted, last_exit_code);
                                 var_value = effective_word;
                             } else {
                                 var_value = val;
@@ -358,15 +529,7 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                             // ${var:+word}: use word if set and not null
                             if (!is_unset && (!check_null || !is_null)) {
                                 // Expand variables in word, preserving quoting context
-                                if (strchr(word, '$')) {
-                                    const char *word_to_expand = is_quoted ? mark_dollars_as_quoted(word) : word;
-                                    char *expanded_word = varexpand_expand(word_to_expand, last_exit_code);
-                                    if (expanded_word) {
-                                        safe_strcpy(expanded_word_buf, expanded_word, sizeof(expanded_word_buf));
-                                        free(expanded_word);
-                                        effective_word = expanded_word_buf;
-                                    }
-                                }
+                                effective_word = expand_modifier_word(word, is_quoted, last_exit_code);
                                 var_value = effective_word;
                             } else {
                                 var_value = "";
@@ -376,16 +539,12 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                             // ${var:=word}: assign word if unset or null
                             if (is_unset || (check_null && is_null)) {
                                 // Expand variables in word, preserving quoting context
-                                if (strchr(word, '$')) {
-                                    const char *word_to_expand = is_quoted ? mark_dollars_as_quoted(word) : word;
-                                    char *expanded_word = varexpand_expand(word_to_expand, last_exit_code);
-                                    if (expanded_word) {
-                                        safe_strcpy(expanded_word_buf, expanded_word, sizeof(expanded_word_buf));
-                                        free(expanded_word);
-                                        effective_word = expanded_word_buf;
-                                    }
+                                effective_word = expand_modifier_word(word, is_quoted, last_exit_code);
+                                if (subscript) {
+                                    shellvar_array_set(var_name, subscript, effective_word);
+                                } else {
+                                    shellvar_set(var_name, effective_word);
                                 }
-                                setenv(var_name, effective_word, 1);
                                 var_value = effective_word;
                             } else {
                                 var_value = val;
@@ -395,15 +554,7 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                             // ${var:?word}: error if unset or null
                             if (is_unset || (check_null && is_null)) {
                                 // Expand variables in word for error message, preserving quoting context
-                                if (strchr(word, '$')) {
-                                    const char *word_to_expand = is_quoted ? mark_dollars_as_quoted(word) : word;
-                                    char *expanded_word = varexpand_expand(word_to_expand, last_exit_code);
-                                    if (expanded_word) {
-                                        safe_strcpy(expanded_word_buf, expanded_word, sizeof(expanded_word_buf));
-                                        free(expanded_word);
-                                        effective_word = expanded_word_buf;
-                                    }
-                                }
+                                effective_word = expand_modifier_word(word, is_quoted, last_exit_code);
                                 if (effective_word[0]) {
                                     fprintf(stderr, "%s: %s\n", var_name, effective_word);
                                 } else {
@@ -418,11 +569,8 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                             // ${var#pattern}: remove smallest prefix matching pattern
                             // ${var##pattern}: remove largest prefix matching pattern
                             if (val) {
-                                static char pattern_result[4096];
-                                strncpy(pattern_result, val, sizeof(pattern_result) - 1);
-                                pattern_result[sizeof(pattern_result) - 1] = '\0';
-
                                 size_t val_len = strlen(val);
+                                char *pattern_result = arena_strndup(val, val_len);
                                 size_t match_len = 0;
 
                                 // Convert \x01 markers to fnmatch escapes
@@ -466,11 +614,8 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                             // ${var%pattern}: remove smallest suffix matching pattern
                             // ${var%%pattern}: remove largest suffix matching pattern
                             if (val) {
-                                static char pattern_result[4096];
-                                strncpy(pattern_result, val, sizeof(pattern_result) - 1);
-                                pattern_result[sizeof(pattern_result) - 1] = '\0';
-
                                 size_t val_len = strlen(val);
+                                char *pattern_result = arena_strndup(val, val_len);
                                 size_t keep_len = val_len;  // How much to keep
 
                                 // Convert \x01 markers to fnmatch escapes
@@ -554,9 +699,7 @@ char *varexpand_expand(const char *str, int last_exit_code) {
                 }
             } else {
                 // Just a $ followed by something else, keep the $
-                if (out_pos < result_size - 1) {
-                    result[out_pos++] = '$';
-                }
+                result[out_pos++] = '$';
                 is_literal_dollar = true;  // Not a variable expansion
             }
 
@@ -567,10 +710,12 @@ append_value:
                 // Do nothing - literal $ was already output
             } else if (var_value) {
                 size_t val_len = strlen(var_value);
+                // Worst case is a marker before every byte, or two markers around it all
+                result = reserve_result(result, &result_size, out_pos, val_len * 2 + 2);
                 if (val_len > 0) {
                     if (is_quoted) {
                         // Append with markers to prevent glob expansion and quote interpretation
-                        for (size_t i = 0; i < val_len && out_pos < result_size - 2; i++) {
+                        for (size_t i = 0; i < val_len; i++) {
                             char c = var_value[i];
                             if (char_in_string(c, "*?[]'\"\\<|>&~")) {
                                 // Add marker before special characters (globs, quotes, redirects, operators, tilde, bracket close)
@@ -580,23 +725,18 @@ append_value:
                         }
                     } else {
                         // Unquoted - wrap with \x03 markers for IFS splitting
-                        size_t space = result_size - 1 - out_pos;
-                        // Need space for: marker + value + marker
-                        size_t to_copy = (val_len < space - 2) ? val_len : (space > 2 ? space - 2 : 0);
-                        if (to_copy > 0 && out_pos < result_size - 2) {
-                            result[out_pos++] = '\x03';  // Start marker
-                            memcpy(result + out_pos, var_value, to_copy);
-                            out_pos += to_copy;
-                            result[out_pos++] = '\x03';  // End marker
-                        }
+                        result[out_pos++] = '\x03';  // Start marker
+                        memcpy(result + out_pos, var_value, val_len);
+                        out_pos += val_len;
+                        result[out_pos++] = '\x03';  // End marker
                     }
-                } else if (!is_quoted && out_pos < result_size - 2) {
+                } else if (!is_quoted) {
                     // Empty unquoted expansion - add markers so IFS splitting can remove it
                     // POSIX: empty unquoted expansion produces no field
                     result[out_pos++] = '\x03';
                     result[out_pos++] = '\x03';
                 }
-            } else if (!is_quoted && out_pos < result_size - 2) {
+            } else if (!is_quoted) {
                 // Unset variable in unquoted context - add empty markers for removal
                 // POSIX: unset variable in unquoted expansion produces no field
                 result[out_pos++] = '\x03';
@@ -611,24 +751,66 @@ append_value:
     }
 
     result[out_pos] = '\0';
-    return result;
+    char *expanded = malloc(out_pos + 1);
+    if (expanded) memcpy(expanded, result, out_pos + 1);
+    arena_release(mark);
+    return expanded;
 }
 
-// Expand variables in all arguments
-int varexpand_args(char **args, int last_exit_code) {
-    if (!args) return -1;
-
-    for (int i = 0; args[i] != NULL; i++) {
-        // Check if this argument contains $
-        if (strchr(args[i], '$') != NULL) {
-            char *expanded = varexpand_expand(args[i], last_exit_code);
-            if (expanded) {
-                // Replace argument with expanded version
-                // Note: args[i] points into line buffer, don't free it
-                args[i] = expanded;
-            }
+// Look up $name, $N or a special parameter without building a new string
+size_t varexpand_param(const char *str, int last_exit_code, char *scratch, size_t size,
+                       const char **value) {
+    const char *p = str;
+    *value = NULL;
+
+    // The parser marks ? inside double quotes
+    if (*p == '\x01' && *(p + 1) == '?') p++;
+
+    if (*p == '?') {
+        snprintf(scratch, size, "%d", last_exit_code);
+        *value = scratch;
+    } else if (*p == '$') {
+        snprintf(scratch, size, "%d", getpid());
+        *value = scratch;
+    } else if (*p == '!') {
+        pid_t bg_pid = jobs_get_last_bg_pid();
+        if (bg_pid > 0) {
+            snprintf(scratch, size, "%d", bg_pid);
+            *value = scratch;
+        } else {
+            *value = "";
+        }
+    } else if (*p == '#') {
+        int count = script_state.positional_count > 0 ? script_state.positional_count - 1 : 0;
+        snprintf(scratch, size, "%d", count);
+        *value = scratch;
+    } else if (*p == '0') {
+        const char *param0 = get_positional_param(0);
+        *value = param0 ? param0 : HASH_NAME;
+    } else if (isdigit(*p)) {
+        // Single digit for POSIX compliance
+        *value = get_positional_param(*p - '0');
+        if (!*value) {
+            char param_name[2] = { *p, '\0' };
+            check_unset_error(param_name);
         }
+    } else if (is_varname_char(*p)) {
+        size_t name_len = 0;
+        while (is_varname_char(p[name_len])) name_len++;
+
+        char name_buf[256];
+        char *name = name_len < sizeof(name_buf) ? name_buf : malloc(name_len + 1);
+        if (!name) return 0;
+        memcpy(name, p, name_len);
+        name[name_len] = '\0';
+
+        *value = shellvar_get(name);
+        if (!*value) check_unset_error(name);
+        if (name != name_buf) free(name);
+        return (size_t)(p - str) + name_len;
+    } else {
+        return 0;
     }
 
-    return 0;
+    return (size_t)(p - str) + 1;
 }
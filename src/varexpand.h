@@ -2,6 +2,8 @@
 #define VAREXPAND_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "shellvar.h"
 
 /**
  * Expand environment variables in a string
@@ -23,14 +25,43 @@
 char *varexpand_expand(const char *str, int last_exit_code);
 
 /**
- * Expand variables in all arguments
- * Modifies args array in place (replaces with expanded versions)
- *
- * @param args Null-terminated argument array
+ * Look up a simple parameter reference without allocating
+ * Handles $name, $N and the special parameters ?, $, !, # and 0; ${...},
+ * $@ and $* are left to the caller. Reports unset variables under set -u
+ * like varexpand_expand().
+ * @param str Text just after the $
  * @param last_exit_code Exit code for $? expansion
- * @return 0 on success, -1 on error
+ * @param scratch Buffer for values formatted on demand ($?, $$, ...)
+ * @param size Size of scratch
+ * @param value Receives the value, or NULL if the parameter is unset
+ * @return Bytes of str consumed, or 0 if str does not start a parameter
+ */
+size_t varexpand_param(const char *str, int last_exit_code, char *scratch, size_t size,
+                       const char **value);
+
+// Array reference found by varexpand_array()
+typedef struct {
+    ShellVarIter iter;          // Elements to expand when all is set
+    bool all;                   // [@] or [*]: every element, as with $@ and $*
+    bool star;                  // [*]
+    bool keys;                  // ${!name[@]}: the keys instead of the values
+    const char *value;          // One element or a count; NULL if unset
+    char scratch[32];           // Storage for a count
+} VarArrayRef;
+
+/**
+ * Look up ${name[subscript]}, ${#name[subscript]} or ${!name[@]} without
+ * joining elements into one string
+ * The subscript has its parameters expanded; indexed arrays then evaluate
+ * it as arithmetic. Reports unset elements under set -u like
+ * varexpand_expand().
+ * @param str Text just after the "${"
+ * @param last_exit_code Exit code for $? expansion in the subscript
+ * @param ref Receives the elements to walk or the single value
+ * @return Bytes of str consumed through the closing }, or 0 if str is not
+ *         one of these forms (no subscript, or a modifier follows)
  */
-int varexpand_args(char **args, int last_exit_code);
+size_t varexpand_array(const char *str, int last_exit_code, VarArrayRef *ref);
 
 /**
  * Check if an unset variable error occurred during expansion
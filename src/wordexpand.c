@@ -0,0 +1,838 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wordexpand.h"
+#include "arena.h"
+#include "arith.h"
+#include "brace.h"
+#include "cmdsub.h"
+#include "expand.h"
+#include "fileglob.h"
+#include "hash.h"
+#include "ifs.h"
+#include "script.h"
+#include "varexpand.h"
+
+extern int last_command_exit_code;
+
+// Fields up to this size are built on the stack, longer ones in the arena
+#define INLINE_FIELD 256
+
+typedef struct {
+    FieldList *out;
+    int flags;
+    bool join;              // Join $@ fields with spaces (no splitting)
+    bool split;             // Split unquoted results on IFS
+    bool error;
+
+    // Field being built
+    char *text;
+    unsigned char *quoted;  // Per byte: taken literally by pathname expansion
+    size_t len;
+    size_t cap;
+    bool started;           // Field exists even if empty ("" or "$empty")
+    bool globbable;         // Unquoted * or ?, or an unquoted [...]
+    bool open_bracket;      // Unquoted [ seen
+    bool after_space;       // Field just ended at IFS white space
+    const IfsTable *ifs;    // IFS table for splitting, NULL until needed
+
+    char text_inline[INLINE_FIELD];
+    unsigned char quoted_inline[INLINE_FIELD];
+} WordState;
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "%s: allocation error\n", HASH_NAME);
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static char *xstrndup(const char *s, size_t n) {
+    char *copy = xrealloc(NULL, n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+void fieldlist_init(FieldList *list) {
+    list->fields = NULL;
+    list->flags = NULL;
+    list->count = 0;
+    list->cap = 0;
+}
+
+void fieldlist_free(FieldList *list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->fields[i]);
+    }
+    free(list->fields);
+    free(list->flags);
+    fieldlist_init(list);
+}
+
+void fieldlist_push(FieldList *list, char *field, unsigned char flags) {
+    // Keep a slot for the terminating NULL
+    if (list->count + 1 >= list->cap) {
+        int cap = list->cap ? list->cap * 2 : 16;
+        list->fields = xrealloc(list->fields, (size_t)cap * sizeof(char *));
+        list->flags = xrealloc(list->flags, (size_t)cap);
+        list->cap = cap;
+    }
+    list->fields[list->count] = field;
+    list->flags[list->count] = flags;
+    list->count++;
+    list->fields[list->count] = NULL;
+}
+
+static void state_init(WordState *w, int flags, FieldList *out) {
+    w->out = out;
+    w->flags = flags;
+    w->join = !(flags & WORDEXP_SPLIT);
+    w->split = (flags & WORDEXP_SPLIT) != 0;
+    w->error = false;
+    w->text = w->text_inline;
+    w->quoted = w->quoted_inline;
+    w->len = 0;
+    w->cap = INLINE_FIELD;
+    w->started = false;
+    w->globbable = false;
+    w->open_bracket = false;
+    w->after_space = false;
+    w->ifs = NULL;
+}
+
+static void reserve(WordState *w, size_t extra) {
+    size_t needed = w->len + extra + 1;
+    if (needed <= w->cap) return;
+
+    size_t cap = w->cap * 2;
+    while (cap < needed) cap *= 2;
+    if (w->text == w->text_inline) {
+        w->text = memcpy(arena_alloc(cap), w->text_inline, w->len);
+        w->quoted = memcpy(arena_alloc(cap), w->quoted_inline, w->len);
+    } else {
+        w->text = arena_realloc(w->text, w->cap, cap);
+        w->quoted = arena_realloc(w->quoted, w->cap, cap);
+    }
+    w->cap = cap;
+}
+
+static void put_char(WordState *w, char c, bool quoted) {
+    reserve(w, 1);
+    w->text[w->len] = c;
+    w->quoted[w->len++] = quoted;
+    w->started = true;
+    w->after_space = false;
+    if (!quoted) {
+        if (c == '*' || c == '?') {
+            w->globbable = true;
+        } else if (c == '[') {
+            w->open_bracket = true;
+        } else if (c == ']' && w->open_bracket) {
+            w->globbable = true;
+        }
+    }
+}
+
+// Push the current field, replaced by its matches if it is a pattern
+static void end_field(WordState *w) {
+    w->text[w->len] = '\0';
+
+    int count = 0;
+    char **matches = NULL;
+    if ((w->flags & WORDEXP_GLOB) && w->globbable) {
+        // Quoted bytes become backslash escapes in the pattern
+        char *pattern = arena_alloc(w->len * 2 + 1);
+        size_t n = 0;
+        for (size_t i = 0; i < w->len; i++) {
+            if (w->quoted[i] && strchr("*?[]\\", w->text[i])) {
+                pattern[n++] = '\\';
+            }
+            pattern[n++] = w->text[i];
+        }
+        pattern[n] = '\0';
+        matches = expand_glob_pattern(pattern, &count);
+    }
+
+    if (matches) {
+        for (int i = 0; i < count; i++) {
+            fieldlist_push(w->out, matches[i], 0);
+        }
+        free(matches);
+    } else {
+        fieldlist_push(w->out, xstrndup(w->text, w->len), 0);
+    }
+
+    w->len = 0;
+    w->started = false;
+    w->globbable = false;
+    w->open_bracket = false;
+}
+
+// Append a run of bytes that all have the same quoting
+static void put_run(WordState *w, const char *s, size_t len, bool quoted) {
+    reserve(w, len);
+    memcpy(w->text + w->len, s, len);
+    memset(w->quoted + w->len, quoted, len);
+    w->len += len;
+    w->started = true;
+    w->after_space = false;
+    if (quoted) return;
+
+    // Same pattern tracking as put_char()
+    if (memchr(s, '*', len) || memchr(s, '?', len)) w->globbable = true;
+    const char *bracket = memchr(s, '[', len);
+    if (bracket) w->open_bracket = true;
+    if (w->open_bracket) {
+        const char *from = bracket ? bracket : s;
+        if (memchr(from, ']', len - (size_t)(from - s))) w->globbable = true;
+    }
+}
+
+// Whether an unquoted run would make its field a pattern
+static bool run_is_pattern(const WordState *w, const char *s, size_t len) {
+    return (w->flags & WORDEXP_GLOB) &&
+           (memchr(s, '*', len) || memchr(s, '?', len) || memchr(s, '[', len));
+}
+
+// Append the result of an expansion; unquoted results are split on IFS
+static void put_expansion(WordState *w, const char *s, size_t len, bool quoted) {
+    // Looked up once per word, and again only after an expansion that
+    // could have assigned IFS
+    if (w->split && !w->ifs) w->ifs = ifs_table();
+    const IfsTable *ifs = w->split ? w->ifs : NULL;
+    if (quoted || !ifs || ifs->empty) {
+        if (len > 0) put_run(w, s, len, quoted);
+        if (quoted) w->started = true;
+        return;
+    }
+
+    size_t i = 0;
+    while (i < len) {
+        size_t n = ifs_field_length(ifs, s + i, len - i);
+        bool pushed = false;
+        if (n > 0) {
+            if (!w->started && i + n < len && !run_is_pattern(w, s + i, n)) {
+                // A whole field of the result is copied to the list directly
+                fieldlist_push(w->out, xstrndup(s + i, n), 0);
+                pushed = true;
+            } else {
+                put_run(w, s + i, n, false);
+            }
+            i += n;
+            if (i == len) break;
+        }
+
+        if (ifs->type[(unsigned char)s[i]] == IFS_WHITE) {
+            // Leading white space is dropped; a run of it is one separator
+            if (w->started) {
+                end_field(w);
+                w->after_space = true;
+            } else if (pushed) {
+                w->after_space = true;
+            }
+        } else if (pushed) {
+            // The separator ended the field just pushed
+            w->after_space = false;
+        } else if (w->after_space) {
+            // Non-white separator absorbed into the white space before it
+            w->after_space = false;
+        } else {
+            // Each non-white separator delimits a field, even an empty one
+            end_field(w);
+        }
+        i++;
+    }
+}
+
+// Boundary between two positional parameters in $@ or unquoted $*
+static void field_break(WordState *w, bool quoted) {
+    if (w->join) {
+        put_char(w, ' ', quoted);
+    } else if (quoted || w->started) {
+        end_field(w);
+    }
+}
+
+static void note_errors(WordState *w) {
+    if (varexpand_had_error() || arith_had_unset_error()) {
+        w->error = true;
+    }
+}
+
+// An expansion that can assign variables may have changed IFS
+static void ifs_may_change(WordState *w) {
+    w->ifs = NULL;
+}
+
+// ~, ~user, ~+ or ~- up to the next / (or : in an assignment)
+static const char *expand_tilde_prefix(WordState *w, const char *p, bool in_assign) {
+    const char *end = p + 1;
+    while (*end && *end != '/' && !(in_assign && *end == ':')) {
+        // Any quoting or expansion in the prefix leaves the ~ alone
+        if ((unsigned char)*end < 0x05 || strchr("$`\\", *end)) {
+            put_char(w, '~', true);
+            return p + 1;
+        }
+        end++;
+    }
+
+    size_t len = (size_t)(end - p);
+    char *prefix = arena_strndup(p, len);
+
+    char *home = expand_tilde_path(prefix);
+    if (home) {
+        // The result of tilde expansion is not globbed
+        put_expansion(w, home, strlen(home), true);
+        free(home);
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            put_char(w, p[i], false);
+        }
+    }
+    return end;
+}
+
+// $@ and $*
+static void expand_positional(WordState *w, bool star, bool quoted) {
+    int count = script_state.positional_count;
+    char **params = script_state.positional_params;
+
+    if (star && quoted) {
+        // "$*" is one field joined by the first IFS character
+        const char *ifs = ifs_get();
+        w->started = true;
+        for (int i = 1; i < count; i++) {
+            if (i > 1 && ifs[0]) put_char(w, ifs[0], true);
+            if (params[i]) put_expansion(w, params[i], strlen(params[i]), true);
+        }
+        return;
+    }
+
+    for (int i = 1; i < count; i++) {
+        if (i > 1) field_break(w, quoted);
+        const char *param = params[i] ? params[i] : "";
+        put_expansion(w, param, strlen(param), quoted);
+    }
+}
+
+// ${name[@]} and ${name[*]}, or the keys for ${!name[@]}
+static void expand_array(WordState *w, VarArrayRef *ref, bool quoted) {
+    // "${name[*]}" is one field joined by the first IFS character
+    const char *ifs = (ref->star && quoted) ? ifs_get() : NULL;
+    if (ifs) w->started = true;
+
+    const char *key;
+    const char *value;
+    bool first = true;
+    while (shellvar_array_next(&ref->iter, &key, &value)) {
+        if (!first) {
+            if (!ifs) {
+                field_break(w, quoted);
+            } else if (ifs[0]) {
+                put_char(w, ifs[0], true);
+            }
+        }
+        first = false;
+        const char *s = ref->keys ? key : value;
+        put_expansion(w, s, strlen(s), quoted);
+    }
+}
+
+// ${...}, handed to varexpand with any nested substitutions done first
+static const char *expand_braced(WordState *w, const char *dollar, bool quoted) {
+    int depth = 1;
+    const char *q = dollar + 2;
+    while (*q) {
+        if ((*q == '\x01' || *q == '\\') && q[1]) {
+            q += 2;
+            continue;
+        }
+        if (*q == '{') {
+            depth++;
+        } else if (*q == '}' && --depth == 0) {
+            break;
+        }
+        q++;
+    }
+    if (!*q) {
+        put_char(w, '$', true);
+        return dollar + 1;
+    }
+
+    // ${name} is the same as $name
+    char scratch[32];
+    const char *plain;
+    size_t inner = (size_t)(q - dollar - 2);
+    if (inner == 1 && (dollar[2] == '@' || dollar[2] == '*')) {
+        expand_positional(w, dollar[2] == '*', quoted);
+        return q + 1;
+    }
+    if (inner > 0 && varexpand_param(dollar + 2, last_command_exit_code, scratch,
+                                     sizeof(scratch), &plain) == inner) {
+        note_errors(w);
+        if (plain) {
+            put_expansion(w, plain, strlen(plain), quoted);
+        } else if (quoted) {
+            w->started = true;
+        }
+        return q + 1;
+    }
+
+    // varexpand learns about double quotes from a \x02 before the $
+    size_t len = (size_t)(q + 1 - dollar);
+    char *text = arena_alloc(len + 2);
+    size_t n = 0;
+    if (quoted) text[n++] = '\x02';
+    memcpy(text + n, dollar, len);
+    text[n + len] = '\0';
+
+    if (strstr(text, "$(") || strchr(text, '`')) {
+        char *sub = cmdsub_expand(text);
+        if (sub) {
+            text = arena_strndup(sub, strlen(sub));
+            free(sub);
+        }
+    }
+    if (strstr(text, "$((")) {
+        char *sub = arith_expand(text);
+        if (sub) {
+            text = arena_strndup(sub, strlen(sub));
+            free(sub);
+        }
+    }
+    ifs_may_change(w);
+
+    // Array references are walked element by element instead of joined
+    VarArrayRef ref;
+    if (varexpand_array(text + (quoted ? 3 : 2), last_command_exit_code, &ref) > 0) {
+        note_errors(w);
+        if (ref.all) {
+            expand_array(w, &ref, quoted);
+        } else if (ref.value) {
+            put_expansion(w, ref.value, strlen(ref.value), quoted);
+        } else if (quoted) {
+            w->started = true;
+        }
+        return q + 1;
+    }
+
+    char *value = varexpand_expand(text, last_command_exit_code);
+    note_errors(w);
+    ifs_may_change(w);
+
+    // Decode varexpand's markers: \x01 quotes the next byte, \x03 brackets
+    // an unquoted value and \x04 separates positional parameters; the
+    // text between markers is added a run at a time
+    if (quoted) w->started = true;
+    const char *v = value ? value : "";
+    const char *run = v;
+    while (*v) {
+        if ((*v == '\x01' && v[1]) || *v == '\x03' || *v == '\x04') {
+            if (v > run) put_expansion(w, run, (size_t)(v - run), quoted);
+            if (*v == '\x01') {
+                put_char(w, v[1], true);
+                v++;
+            } else if (*v == '\x04') {
+                field_break(w, quoted);
+            }
+            run = ++v;
+        } else {
+            v++;
+        }
+    }
+    if (v > run) put_expansion(w, run, (size_t)(v - run), quoted);
+    free(value);
+    return q + 1;
+}
+
+// $(...) or `...`; returns NULL if the body is unterminated
+static const char *expand_command_sub(WordState *w, const char *body, bool backtick, bool quoted) {
+    const char *end = cmdsub_find_end(body, backtick);
+    if (!end) return NULL;
+
+    // Errors inside the substitution belong to its subshell
+    char *output = cmdsub_capture(body, (size_t)(end - body));
+    varexpand_clear_error();
+    arith_clear_unset_error();
+    ifs_may_change(w);
+    if (output) {
+        put_expansion(w, output, strlen(output), quoted);
+        free(output);
+    } else if (quoted) {
+        w->started = true;
+    }
+    return end + 1;
+}
+
+// Expansion starting at a $; p points just past it
+static const char *expand_dollar(WordState *w, const char *p, bool quoted) {
+    if (p[0] == '(' && p[1] == '(') {
+        long value;
+        const char *end = arith_substitute(p + 2, &value);
+        note_errors(w);
+        ifs_may_change(w);
+        if (end) {
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "%ld", value);
+            put_expansion(w, buf, (size_t)n, true);
+            return end;
+        }
+    }
+    if (p[0] == '(') {
+        const char *next = expand_command_sub(w, p + 1, false, quoted);
+        if (next) return next;
+        put_char(w, '$', true);
+        return p;
+    }
+    if (p[0] == '{') {
+        return expand_braced(w, p - 1, quoted);
+    }
+    if (p[0] == '@') {
+        expand_positional(w, false, quoted);
+        return p + 1;
+    }
+    if (p[0] == '*' || (p[0] == '\x01' && p[1] == '*')) {
+        expand_positional(w, true, quoted);
+        return p[0] == '*' ? p + 1 : p + 2;
+    }
+
+    char scratch[32];
+    const char *value;
+    size_t used = varexpand_param(p, last_command_exit_code, scratch, sizeof(scratch), &value);
+    if (used == 0) {
+        // A $ that starts no expansion is literal
+        put_char(w, '$', true);
+        return p;
+    }
+    note_errors(w);
+    if (value) {
+        put_expansion(w, value, strlen(value), quoted);
+    } else if (quoted) {
+        w->started = true;
+    }
+    return p + used;
+}
+
+// Length of NAME in a NAME=value word, or 0
+static size_t assignment_name_length(const char *word) {
+    if (!isalpha((unsigned char)word[0]) && word[0] != '_') return 0;
+    size_t n = 1;
+    while (isalnum((unsigned char)word[n]) || word[n] == '_') n++;
+    return word[n] == '=' ? n : 0;
+}
+
+static void expand_into(WordState *w, const char *word) {
+    const char *value = NULL;
+    if (w->flags & WORDEXP_ASSIGN) {
+        size_t name_len = assignment_name_length(word);
+        if (name_len) value = word + name_len + 1;
+    }
+
+    const char *p = word;
+    bool quoted = false;    // The next $ or ` is inside double quotes
+    while (*p) {
+        char c = *p;
+        if (c == '\x01' && p[1]) {
+            put_char(w, p[1], true);
+            p += 2;
+        } else if (c == '\x02' && (p[1] == '$' || p[1] == '`')) {
+            quoted = true;
+            p++;
+        } else if (c == '$') {
+            p = expand_dollar(w, p + 1, quoted);
+            quoted = false;
+        } else if (c == '`') {
+            const char *next = expand_command_sub(w, p + 1, true, quoted);
+            if (!next) {
+                put_char(w, c, true);
+                next = p + 1;
+            }
+            p = next;
+            quoted = false;
+        } else if (c == '~' && (p == word || p == value || (value && p > value && p[-1] == ':'))) {
+            p = expand_tilde_prefix(w, p, value != NULL);
+        } else {
+            // A backslash left in a token is always literal
+            put_char(w, c, c == '\\');
+            p++;
+        }
+    }
+}
+
+int wordexpand(const char *word, int flags, FieldList *out) {
+    if ((flags & WORDEXP_BRACE) && strchr(word, '{')) {
+        FieldList words;
+        fieldlist_init(&words);
+        if (brace_expand(word, &words)) {
+            int rc = 0;
+            // Empty words ({,}) are dropped, as unquoted empty expansions are
+            for (int i = 0; i < words.count && rc == 0; i++) {
+                if (!*words.fields[i]) continue;
+                rc = wordexpand(words.fields[i], flags & ~WORDEXP_BRACE, out);
+            }
+            fieldlist_free(&words);
+            return rc;
+        }
+    }
+
+    // Words with nothing to expand are copied as they are
+    if (!strpbrk(word, "\x01\x02$`~\\*?[")) {
+        fieldlist_push(out, xstrndup(word, strlen(word)), 0);
+        return 0;
+    }
+
+    ArenaMark mark = arena_mark();
+    WordState w;
+    state_init(&w, flags, out);
+    expand_into(&w, word);
+    if (w.started) end_field(&w);
+    arena_release(mark);
+    return w.error ? -1 : 0;
+}
+
+char *wordexpand_string(const char *word, int flags) {
+    FieldList fields;
+    fieldlist_init(&fields);
+
+    ArenaMark mark = arena_mark();
+    WordState w;
+    state_init(&w, flags & WORDEXP_ASSIGN, &fields);
+    expand_into(&w, word);
+    end_field(&w);
+    arena_release(mark);
+
+    char *result = fields.fields[0];
+    free(fields.fields);
+    free(fields.flags);
+    if (w.error) {
+        free(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Unquoted redirection operator, with or without an attached target
+static bool is_operator(const char *word) {
+    const char *p = word;
+    if (*p == '&' && p[1] == '>') return true;
+    while (isdigit((unsigned char)*p)) p++;
+    return *p == '<' || *p == '>';
+}
+
+// Operator whose target is the following word
+static bool operator_takes_target(const char *word) {
+    const char *p = word;
+    if (*p == '&') p++;
+    while (isdigit((unsigned char)*p)) p++;
+    return strcmp(p, "<") == 0 || strcmp(p, ">") == 0 || strcmp(p, ">>") == 0 ||
+           strcmp(p, "<<") == 0 || strcmp(p, "<<-") == 0 || strcmp(p, ">|") == 0;
+}
+
+static bool is_declaration_builtin(const char *word) {
+    return strcmp(word, "export") == 0 || strcmp(word, "readonly") == 0 ||
+           strcmp(word, "local") == 0 || strcmp(word, "declare") == 0 ||
+           strcmp(word, "typeset") == 0;
+}
+
+int wordexpand_command(char **words, FieldList *out) {
+    int count = 0;
+    bool has_redirect = false;
+    while (words[count]) {
+        if (is_operator(words[count])) has_redirect = true;
+        count++;
+    }
+
+    // Patterns of this command share directory listings; an earlier
+    // command may have changed the directories
+    fileglob_cache_recheck();
+
+    // POSIX order: redirections are expanded before assignments, so that
+    // ${x=...} in a redirection is seen by the rest of the command
+    ArenaMark mark = arena_mark();
+    char **targets = NULL;
+    int rc = 0;
+    if (has_redirect) {
+        targets = arena_alloc((size_t)count * sizeof(char *));
+        memset(targets, 0, (size_t)count * sizeof(char *));
+        for (int i = 0; i < count; i++) {
+            if (!is_operator(words[i])) continue;
+            targets[i] = wordexpand_string(words[i], 0);
+            if (!targets[i]) rc = -1;
+            if (operator_takes_target(words[i]) && i + 1 < count) {
+                i++;
+                targets[i] = wordexpand_string(words[i], 0);
+                if (!targets[i]) rc = -1;
+            }
+        }
+    }
+
+    bool in_prefix = true;
+    bool declaration = false;
+    for (int i = 0; i < count && rc == 0; i++) {
+        if (targets && targets[i]) {
+            fieldlist_push(out, targets[i], is_operator(words[i]) ? FIELD_OPERATOR : 0);
+            targets[i] = NULL;
+            continue;
+        }
+
+        int flags = WORDEXP_BRACE | WORDEXP_SPLIT | WORDEXP_GLOB;
+        unsigned char field_flags = 0;
+        bool assignment = assignment_name_length(words[i]) > 0;
+        if (assignment) {
+            flags |= WORDEXP_ASSIGN;
+            if (in_prefix || declaration) flags = WORDEXP_ASSIGN;
+            if (in_prefix) field_flags = FIELD_ASSIGNMENT;
+        } else if (in_prefix) {
+            in_prefix = false;
+            declaration = is_declaration_builtin(words[i]);
+        }
+
+        int first = out->count;
+        if (wordexpand(words[i], flags, out) != 0) rc = -1;
+        if (field_flags && out->count > first) out->flags[first] |= field_flags;
+    }
+
+    // Targets not handed to out (after an error)
+    if (targets) {
+        for (int i = 0; i < count; i++) {
+            free(targets[i]);
+        }
+    }
+    arena_release(mark);
+    return rc;
+}
+
+// Find the ] that closes a subscript; p points just past the [
+static const char *subscript_end(const char *p, const char *end) {
+    int depth = 1;
+    for (; p < end && *p; p++) {
+        if (*p == '\x01' && p + 1 < end) {
+            p++;
+        } else if (*p == '[') {
+            depth++;
+        } else if (*p == ']' && --depth == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+bool wordexpand_array_assignment(const char *word, ArrayAssignment *out) {
+    size_t len = strlen(word);
+    const char *end = word + len;
+    const char *p = word;
+    if (!isalpha((unsigned char)*p) && *p != '_') return false;
+    while (isalnum((unsigned char)*p) || *p == '_') p++;
+
+    out->name = word;
+    out->name_len = (size_t)(p - word);
+    out->subscript = NULL;
+    out->subscript_len = 0;
+    if (*p == '[') {
+        const char *close = subscript_end(p + 1, end);
+        if (!close) return false;
+        out->subscript = p + 1;
+        out->subscript_len = (size_t)(close - (p + 1));
+        p = close + 1;
+    }
+
+    out->append = *p == '+';
+    if (out->append) p++;
+    if (*p != '=') return false;
+    p++;
+
+    // The parser keeps the parentheses of name=(...) unquoted
+    out->list = !out->subscript && *p == '(' && len >= 2 && end[-1] == ')' && end[-2] != '\x01' &&
+                end - 1 > p;
+    if (out->list) {
+        out->value = p + 1;
+        out->value_len = (size_t)(end - 1 - out->value);
+        return true;
+    }
+    if (!out->subscript) return false;
+
+    out->value = p;
+    out->value_len = (size_t)(end - p);
+    return true;
+}
+
+// End of one element of a compound assignment list
+static const char *list_element_end(const char *p, const char *end) {
+    while (p < end && !isspace((unsigned char)*p)) {
+        if (*p == '\x01' && p + 1 < end) {
+            p += 2;
+        } else if (*p == '$' && p + 1 < end && (p[1] == '(' || p[1] == '{')) {
+            const char *close = NULL;
+            if (p[1] == '(') {
+                close = cmdsub_find_end(p + 2, false);
+            } else {
+                int depth = 0;
+                for (const char *q = p + 1; q < end; q++) {
+                    if (*q == '{') depth++;
+                    else if (*q == '}' && --depth == 0) {
+                        close = q;
+                        break;
+                    }
+                }
+            }
+            p = (close && close < end) ? close + 1 : end;
+        } else if (*p == '`') {
+            const char *close = cmdsub_find_end(p + 1, true);
+            p = (close && close < end) ? close + 1 : end;
+        } else {
+            p++;
+        }
+    }
+    return p;
+}
+
+int wordexpand_array_list(const char *list, size_t len, FieldList *out) {
+    const char *end = list + len;
+    const char *p = list;
+    int rc = 0;
+
+    while (rc == 0) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p >= end) break;
+        const char *elem_end = list_element_end(p, end);
+
+        // [key]=value names its key; the key is expanded but never split
+        const char *close = *p == '[' ? subscript_end(p + 1, elem_end) : NULL;
+        if (close && close + 1 < elem_end && close[1] == '=') {
+            char *key = wordexpand_string(arena_strndup(p + 1, (size_t)(close - (p + 1))), 0);
+            char *value = wordexpand_string(arena_strndup(close + 2, (size_t)(elem_end - (close + 2))),
+                                            WORDEXP_ASSIGN);
+            if (key && value) {
+                fieldlist_push(out, key, FIELD_KEY);
+                fieldlist_push(out, value, 0);
+            } else {
+                free(key);
+                free(value);
+                rc = -1;
+            }
+        } else {
+            char *word = arena_strndup(p, (size_t)(elem_end - p));
+            if (wordexpand(word, WORDEXP_BRACE | WORDEXP_SPLIT | WORDEXP_GLOB, out) != 0) rc = -1;
+        }
+        p = elem_end;
+    }
+    return rc;
+}
+
+char *wordexpand_quote(const char *field) {
+    size_t len = strlen(field);
+    char *quoted = xrealloc(NULL, len * 2 + 1);
+    size_t n = 0;
+    for (const char *p = field; *p; p++) {
+        if ((unsigned char)*p < 0x05 || strchr("$`\\~*?[]<>|&;'\"{},", *p)) {
+            quoted[n++] = '\x01';
+        }
+        quoted[n++] = *p;
+    }
+    quoted[n] = '\0';
+    return quoted;
+}
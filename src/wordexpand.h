@@ -0,0 +1,145 @@
+#ifndef WORDEXPAND_H
+#define WORDEXPAND_H
+
+// ============================================================================
+// WORD EXPANSION
+// ============================================================================
+//
+// Expands parser tokens into fields in a single left-to-right walk per word.
+// Tilde, parameter, command and arithmetic expansion append to the field
+// being built while a side table records which bytes were quoted; field
+// splitting happens as unquoted expansion results are appended, and pathname
+// expansion reads the side table when a field is finished. The resulting
+// fields are plain strings with no marker bytes, ready for exec.
+//
+// Quoting inside a token still arrives from the parser in-band: \x01 makes
+// the next byte literal and \x02 marks a $ or ` inside double quotes.
+//
+// ============================================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Field flags
+#define FIELD_OPERATOR      0x01    // Unquoted redirection operator (first field of its word)
+#define FIELD_ASSIGNMENT    0x02    // NAME=value before the command name
+#define FIELD_KEY           0x04    // [key] of a compound assignment; its value follows
+
+// Expansion flags
+#define WORDEXP_SPLIT       0x01    // Split unquoted expansion results on IFS
+#define WORDEXP_GLOB        0x02    // Pathname expansion of unquoted patterns
+#define WORDEXP_ASSIGN      0x04    // Tilde expansion after = and : as well
+#define WORDEXP_BRACE       0x08    // Brace expansion first ({a,b}, {1..10})
+
+typedef struct {
+    char **fields;              // Null-terminated
+    unsigned char *flags;       // FIELD_* for each field
+    int count;
+    int cap;
+} FieldList;
+
+/**
+ * Initialize an empty field list
+ *
+ * @param list List to initialize
+ */
+void fieldlist_init(FieldList *list);
+
+/**
+ * Free all fields of a list, leaving it empty
+ *
+ * @param list List to clear
+ */
+void fieldlist_free(FieldList *list);
+
+/**
+ * Append a field
+ *
+ * @param list List to append to
+ * @param field Field text (ownership passes to the list)
+ * @param flags FIELD_* flags for the field
+ */
+void fieldlist_push(FieldList *list, char *field, unsigned char flags);
+
+/**
+ * Expand one word into fields
+ * An unquoted expansion that is empty produces no field; "" and "$empty"
+ * produce one empty field. With WORDEXP_BRACE, each word of the brace
+ * expansion is expanded in turn.
+ *
+ * @param word Parser token
+ * @param flags WORDEXP_* flags
+ * @param out List the fields are appended to
+ * @return 0 on success, -1 if an expansion failed (set -u, ${x?}); the
+ *         error has already been reported
+ */
+int wordexpand(const char *word, int flags, FieldList *out);
+
+/**
+ * Expand one word into a single string, without splitting or globbing
+ * Used for assignment values and other single-word contexts.
+ *
+ * @param word Parser token
+ * @param flags WORDEXP_ASSIGN or 0
+ * @return Expanded string (newly allocated), or NULL if an expansion failed
+ */
+char *wordexpand_string(const char *word, int flags);
+
+/**
+ * Expand the words of a simple command
+ * Redirection words are expanded first, in order; then assignments and
+ * arguments. Assignments before the command name, redirection targets and
+ * assignment arguments of declaration builtins (export, readonly, ...) are
+ * not brace expanded, split or globbed.
+ *
+ * @param words Null-terminated parser tokens
+ * @param out List the fields are appended to
+ * @return 0 on success, -1 if an expansion failed
+ */
+int wordexpand_command(char **words, FieldList *out);
+
+// Parts of an array assignment word; pointers into the parser token
+typedef struct {
+    const char *name;
+    size_t name_len;
+    const char *subscript;      // name[subscript]=value; NULL for name=(list)
+    size_t subscript_len;
+    const char *value;          // The value, or the list inside the parentheses
+    size_t value_len;
+    bool append;                // += rather than =
+    bool list;                  // name=(list)
+} ArrayAssignment;
+
+/**
+ * Recognize name=(list), name[subscript]=value and their += forms
+ *
+ * @param word Parser token
+ * @param out Receives the parts of the word
+ * @return true if word is an array assignment
+ */
+bool wordexpand_array_assignment(const char *word, ArrayAssignment *out);
+
+/**
+ * Expand the list of a compound assignment name=(list)
+ * Each element is brace expanded, split and globbed like a command argument. An element
+ * written [key]=value gives a FIELD_KEY field holding the expanded key,
+ * followed by a field holding its value.
+ *
+ * @param list Text between the parentheses
+ * @param len Length of list
+ * @param out List the fields are appended to
+ * @return 0 on success, -1 if an expansion failed
+ */
+int wordexpand_array_list(const char *list, size_t len, FieldList *out);
+
+/**
+ * Quote an expanded field so that expanding it again yields it unchanged
+ * Used when expanded arguments are handed back to execute(), as for alias
+ * arguments.
+ *
+ * @param field Field text
+ * @return Parser-style token (newly allocated)
+ */
+char *wordexpand_quote(const char *field);
+
+#endif // WORDEXPAND_H
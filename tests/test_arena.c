@@ -0,0 +1,89 @@
+#include "unity.h"
+#include "../src/arena.h"
+#include <stdint.h>
+#include <string.h>
+
+static ArenaMark start;
+
+void setUp(void) {
+    start = arena_mark();
+}
+
+void tearDown(void) {
+    arena_release(start);
+    arena_cleanup();
+}
+
+// Test allocations are aligned and do not overlap
+void test_arena_alloc_aligned(void) {
+    char *a = arena_alloc(3);
+    char *b = arena_alloc(5);
+
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)a % 16);
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)b % 16);
+    TEST_ASSERT_TRUE(b >= a + 3);
+
+    memset(a, 'a', 3);
+    memset(b, 'b', 5);
+    TEST_ASSERT_EQUAL_INT('a', a[2]);
+}
+
+// Test release hands the same memory out again
+void test_arena_release_reuses(void) {
+    ArenaMark mark = arena_mark();
+    char *a = arena_alloc(100);
+    arena_release(mark);
+
+    char *b = arena_alloc(100);
+    TEST_ASSERT_EQUAL_PTR(a, b);
+}
+
+// Test nested marks release in order
+void test_arena_nested_marks(void) {
+    char *outer = arena_strndup("outer", 5);
+
+    ArenaMark mark = arena_mark();
+    for (int i = 0; i < 1000; i++) {
+        arena_alloc(1000);  // Spans several chunks
+    }
+    arena_release(mark);
+
+    TEST_ASSERT_EQUAL_STRING("outer", outer);
+    TEST_ASSERT_EQUAL_PTR(outer + 16, arena_alloc(1));
+}
+
+// Test a request larger than a chunk gets one of its own
+void test_arena_large_allocation(void) {
+    size_t size = ARENA_CHUNK_SIZE * 3;
+    char *big = arena_alloc(size);
+    memset(big, 'x', size);
+
+    char *small = arena_strndup("abc", 3);
+    TEST_ASSERT_EQUAL_STRING("abc", small);
+    TEST_ASSERT_EQUAL_INT('x', big[size - 1]);
+    TEST_ASSERT_TRUE(arena_high_water() >= size);
+}
+
+// Test the newest allocation grows in place and older ones are copied
+void test_arena_realloc(void) {
+    char *a = arena_strndup("hello", 5);
+    char *grown = arena_realloc(a, 6, 64);
+    TEST_ASSERT_EQUAL_PTR(a, grown);
+
+    arena_alloc(8);
+    char *moved = arena_realloc(grown, 64, 128);
+    TEST_ASSERT_TRUE(moved != grown);
+    TEST_ASSERT_EQUAL_STRING("hello", moved);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_arena_alloc_aligned);
+    RUN_TEST(test_arena_release_reuses);
+    RUN_TEST(test_arena_nested_marks);
+    RUN_TEST(test_arena_large_allocation);
+    RUN_TEST(test_arena_realloc);
+
+    return UNITY_END();
+}
@@ -1,6 +1,7 @@
 #include "unity.h"
 #include "../src/arith.h"
 #include "../src/shellvar.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -269,6 +270,68 @@ void test_arith_n_minus_1(void) {
     TEST_ASSERT_EQUAL_INT(4, result);
 }
 
+// Test a cached expression sees variables changed between evaluations
+void test_arith_cached_expression(void) {
+    long result;
+    shellvar_set("x", "2");
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("x * 10", &result));
+    TEST_ASSERT_EQUAL_INT(20, result);
+
+    shellvar_set("x", "3");
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("x * 10", &result));
+    TEST_ASSERT_EQUAL_INT(30, result);
+
+    // The variable is freed and created again
+    shellvar_unset("x");
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("x * 10", &result));
+    TEST_ASSERT_EQUAL_INT(0, result);
+    shellvar_set("x", "4");
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("x * 10", &result));
+    TEST_ASSERT_EQUAL_INT(40, result);
+}
+
+// Test expressions still evaluate after being evicted from the cache
+void test_arith_cache_eviction(void) {
+    long result;
+    char expr[32];
+    for (int i = 0; i < 200; i++) {
+        snprintf(expr, sizeof(expr), "%d + 1", i);
+        TEST_ASSERT_EQUAL_INT(0, arith_evaluate(expr, &result));
+        TEST_ASSERT_EQUAL_INT(i + 1, result);
+    }
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("0 + 1", &result));
+    TEST_ASSERT_EQUAL_INT(1, result);
+}
+
+// Test && || and ?: evaluate only the branch that is taken
+void test_arith_short_circuit(void) {
+    long result;
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("0 && (x = 1)", &result));
+    TEST_ASSERT_EQUAL_INT(0, result);
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("2 || (y = 1)", &result));
+    TEST_ASSERT_EQUAL_INT(1, result);
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("1 ? 5 : (n = 1)", &result));
+    TEST_ASSERT_EQUAL_INT(5, result);
+
+    TEST_ASSERT_NULL(shellvar_get("x"));
+    TEST_ASSERT_NULL(shellvar_get("y"));
+    TEST_ASSERT_NULL(shellvar_get("n"));
+}
+
+// Test the comma operator yields its last operand
+void test_arith_comma(void) {
+    long result;
+    TEST_ASSERT_EQUAL_INT(0, arith_evaluate("x = 4, x * 2", &result));
+    TEST_ASSERT_EQUAL_INT(8, result);
+}
+
+// Test trailing tokens are a syntax error
+void test_arith_trailing_token(void) {
+    long result;
+    TEST_ASSERT_EQUAL_INT(-1, arith_evaluate("1 2", &result));
+    TEST_ASSERT_EQUAL_INT(-1, arith_evaluate("(1 + 2", &result));
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -304,6 +367,11 @@ int main(void) {
     RUN_TEST(test_arith_divide_by_zero);
     RUN_TEST(test_arith_complex);
     RUN_TEST(test_arith_n_minus_1);
+    RUN_TEST(test_arith_cached_expression);
+    RUN_TEST(test_arith_cache_eviction);
+    RUN_TEST(test_arith_short_circuit);
+    RUN_TEST(test_arith_comma);
+    RUN_TEST(test_arith_trailing_token);
 
     return UNITY_END();
 }
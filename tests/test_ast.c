@@ -0,0 +1,261 @@
+#include "unity.h"
+#include "../src/ast.h"
+#include "../src/script.h"
+#include "../src/shellvar.h"
+#include <string.h>
+#include <stdlib.h>
+
+void setUp(void) {
+    script_init();
+}
+
+void tearDown(void) {
+    script_cleanup();
+}
+
+// Parse the first command of src, expecting a complete parse
+static AstNode *parse_one(const char *src) {
+    size_t pos = 0;
+    AstNode *node = NULL;
+    TEST_ASSERT_EQUAL(AST_PARSE_OK, ast_parse_next(src, strlen(src), &pos, true, &node));
+    TEST_ASSERT_NOT_NULL(node);
+    return node;
+}
+
+// ============================================================================
+// Parser Tests
+// ============================================================================
+
+void test_parse_simple_command(void) {
+    AstNode *node = parse_one("echo hello world\n");
+    TEST_ASSERT_EQUAL(AST_SIMPLE, node->type);
+    TEST_ASSERT_EQUAL(3, node->args.argc);
+    ast_free(node);
+}
+
+void test_parse_blank_input(void) {
+    const char *src = "\n  # comment only\n\n";
+    size_t pos = 0;
+    AstNode *node = NULL;
+    TEST_ASSERT_EQUAL(AST_PARSE_OK, ast_parse_next(src, strlen(src), &pos, true, &node));
+    TEST_ASSERT_NULL(node);
+    TEST_ASSERT_EQUAL(strlen(src), pos);
+}
+
+void test_parse_stops_at_newline(void) {
+    const char *src = "echo a\necho b\n";
+    size_t pos = 0;
+    AstNode *node = NULL;
+    TEST_ASSERT_EQUAL(AST_PARSE_OK, ast_parse_next(src, strlen(src), &pos, true, &node));
+    TEST_ASSERT_EQUAL(7, pos);
+    ast_free(node);
+}
+
+void test_parse_and_or_list(void) {
+    AstNode *node = parse_one("true && echo a || echo b");
+    TEST_ASSERT_EQUAL(AST_AND_OR, node->type);
+    TEST_ASSERT_EQUAL(3, node->child_count);
+    TEST_ASSERT_EQUAL(AST_OP_AND, node->ops[0]);
+    TEST_ASSERT_EQUAL(AST_OP_OR, node->ops[1]);
+    ast_free(node);
+}
+
+void test_parse_pipeline(void) {
+    AstNode *node = parse_one("! echo a | tr a b | cat");
+    TEST_ASSERT_EQUAL(AST_PIPELINE, node->type);
+    TEST_ASSERT_EQUAL(3, node->child_count);
+    TEST_ASSERT_TRUE(node->negate);
+    ast_free(node);
+}
+
+void test_parse_multiline_loop(void) {
+    AstNode *node = parse_one("for i in 1 2 3\ndo\n  echo $i\ndone\n");
+    TEST_ASSERT_EQUAL(AST_FOR, node->type);
+    TEST_ASSERT_EQUAL_STRING("i", node->var);
+    TEST_ASSERT_TRUE(node->has_words);
+    TEST_ASSERT_EQUAL(3, node->args.argc);
+    TEST_ASSERT_EQUAL(AST_SIMPLE, node->body->type);
+    ast_free(node);
+}
+
+void test_parse_if_elif_else(void) {
+    AstNode *node = parse_one("if false; then echo a; elif true; then echo b; else echo c; fi");
+    TEST_ASSERT_EQUAL(AST_IF, node->type);
+    TEST_ASSERT_NOT_NULL(node->else_part);
+    TEST_ASSERT_EQUAL(AST_IF, node->else_part->type);
+    TEST_ASSERT_NOT_NULL(node->else_part->else_part);
+    ast_free(node);
+}
+
+void test_parse_case_items(void) {
+    AstNode *node = parse_one("case $x in a|b) echo ab;; (c) echo c;& *) echo any;; esac");
+    TEST_ASSERT_EQUAL(AST_CASE, node->type);
+    TEST_ASSERT_EQUAL(3, node->item_count);
+    TEST_ASSERT_EQUAL(2, node->items[0].pattern_count);
+    TEST_ASSERT_TRUE(node->items[1].fallthrough);
+    ast_free(node);
+}
+
+void test_parse_case_in_cmdsub(void) {
+    AstNode *node = parse_one("x=$(case a in a) echo A;; (b) echo B;; esac); echo case $x");
+    TEST_ASSERT_EQUAL(AST_LIST, node->type);
+    TEST_ASSERT_EQUAL(2, node->child_count);
+    ast_free(node);
+
+    node = parse_one("x=$(echo case) y=$(echo esac)");
+    TEST_ASSERT_EQUAL(AST_SIMPLE, node->type);
+    ast_free(node);
+}
+
+void test_parse_heredoc_body(void) {
+    const char *src = "cat <<EOF\nline $x\nEOF\necho next\n";
+    size_t pos = 0;
+    AstNode *node = NULL;
+    TEST_ASSERT_EQUAL(AST_PARSE_OK, ast_parse_next(src, strlen(src), &pos, true, &node));
+    TEST_ASSERT_NOT_NULL(node);
+    TEST_ASSERT_EQUAL_STRING("line $x\n", node->heredoc);
+    TEST_ASSERT_EQUAL(0, node->heredoc_quoted);
+    TEST_ASSERT_EQUAL_STRING("echo next\n", src + pos);
+    ast_free(node);
+}
+
+void test_parse_function_body_text(void) {
+    AstNode *node = parse_one("greet() {\n  echo hi\n}\n");
+    TEST_ASSERT_EQUAL(AST_FUNCDEF, node->type);
+    TEST_ASSERT_EQUAL_STRING("greet", node->name);
+    TEST_ASSERT_EQUAL_STRING("echo hi", node->func_body);
+    ast_free(node);
+}
+
+void test_parse_incomplete_loop(void) {
+    const char *src = "while true; do\n  echo x\n";
+    size_t pos = 0;
+    AstNode *node = NULL;
+    TEST_ASSERT_EQUAL(AST_PARSE_INCOMPLETE, ast_parse_next(src, strlen(src), &pos, false, &node));
+    TEST_ASSERT_NULL(node);
+    TEST_ASSERT_EQUAL(0, pos);
+}
+
+void test_parse_incomplete_quote(void) {
+    const char *src = "echo \"open\n";
+    size_t pos = 0;
+    AstNode *node = NULL;
+    TEST_ASSERT_EQUAL(AST_PARSE_INCOMPLETE, ast_parse_next(src, strlen(src), &pos, false, &node));
+}
+
+void test_parse_unexpected_keyword(void) {
+    const char *src = "fi\necho ok\n";
+    size_t pos = 0;
+    AstNode *node = NULL;
+    script_state.silent_errors = true;
+    TEST_ASSERT_EQUAL(AST_PARSE_ERROR, ast_parse_next(src, strlen(src), &pos, true, &node));
+    TEST_ASSERT_NULL(node);
+    TEST_ASSERT_EQUAL(3, pos);  // Resumes after the offending line
+    script_state.silent_errors = false;
+}
+
+// ============================================================================
+// Execution Tests
+// ============================================================================
+
+void test_execute_for_loop(void) {
+    script_execute_string("s=\nfor i in a b c; do s=$s$i; done");
+    TEST_ASSERT_EQUAL_STRING("abc", shellvar_get("s"));
+}
+
+void test_execute_loop_reuses_tree(void) {
+    int result = script_execute_string("n=0\nwhile [ $n -lt 100 ]; do n=$((n + 1)); done");
+    TEST_ASSERT_EQUAL(0, result);
+    TEST_ASSERT_EQUAL_STRING("100", shellvar_get("n"));
+}
+
+void test_execute_nested_break(void) {
+    script_execute_string("r=\nfor i in 1 2; do for j in 1 2; do r=$r$i$j; break 2; done; done");
+    TEST_ASSERT_EQUAL_STRING("11", shellvar_get("r"));
+}
+
+void test_execute_continue(void) {
+    script_execute_string("r=\nfor i in 1 2 3; do if [ $i = 2 ]; then continue; fi; r=$r$i; done");
+    TEST_ASSERT_EQUAL_STRING("13", shellvar_get("r"));
+}
+
+void test_execute_case_fallthrough(void) {
+    script_execute_string("r=\ncase a in a) r=${r}1;& b) r=${r}2;; c) r=${r}3;; esac");
+    TEST_ASSERT_EQUAL_STRING("12", shellvar_get("r"));
+}
+
+void test_execute_case_in_cmdsub(void) {
+    script_execute_string("r=$(case a in a) echo A;; *) echo other;; esac)\nr=${r}$(echo case)");
+    TEST_ASSERT_EQUAL_STRING("Acase", shellvar_get("r"));
+}
+
+void test_execute_function_return_in_loop(void) {
+    int result = script_execute_string("f() {\n  for i in 1 2; do\n    return 5\n  done\n  r=after\n}\nr=before\nf");
+    TEST_ASSERT_EQUAL(5, result);
+    TEST_ASSERT_EQUAL_STRING("before", shellvar_get("r"));
+}
+
+void test_execute_until_loop(void) {
+    script_execute_string("k=0\nuntil [ $k -ge 3 ]\ndo\n  k=$((k + 1))\ndone");
+    TEST_ASSERT_EQUAL_STRING("3", shellvar_get("k"));
+}
+
+void test_execute_syntax_error_status(void) {
+    script_state.silent_errors = true;
+    int result = script_execute_string("if true; then");
+    script_state.silent_errors = false;
+    TEST_ASSERT_EQUAL(1, result);
+}
+
+void test_in_process_builtins_and_functions(void) {
+    script_define_function("show", "echo \"$1\"");
+    AstNode *node = parse_one("x=1; if [ -n \"$x\" ]; then show $x; fi");
+    TEST_ASSERT_TRUE(ast_can_run_in_process(node));
+    ast_free(node);
+}
+
+void test_in_process_rejects_child_work(void) {
+    const char *cases[] = { "echo a | cat", "ls", "cd /tmp", "echo a > f", "(echo a)", "echo a &" };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        AstNode *node = parse_one(cases[i]);
+        TEST_ASSERT_FALSE(ast_can_run_in_process(node));
+        ast_free(node);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    // Parser
+    RUN_TEST(test_parse_simple_command);
+    RUN_TEST(test_parse_blank_input);
+    RUN_TEST(test_parse_stops_at_newline);
+    RUN_TEST(test_parse_and_or_list);
+    RUN_TEST(test_parse_pipeline);
+    RUN_TEST(test_parse_multiline_loop);
+    RUN_TEST(test_parse_if_elif_else);
+    RUN_TEST(test_parse_case_items);
+    RUN_TEST(test_parse_case_in_cmdsub);
+    RUN_TEST(test_parse_heredoc_body);
+    RUN_TEST(test_parse_function_body_text);
+    RUN_TEST(test_parse_incomplete_loop);
+    RUN_TEST(test_parse_incomplete_quote);
+    RUN_TEST(test_parse_unexpected_keyword);
+
+    // Execution
+    RUN_TEST(test_execute_for_loop);
+    RUN_TEST(test_execute_loop_reuses_tree);
+    RUN_TEST(test_execute_nested_break);
+    RUN_TEST(test_execute_continue);
+    RUN_TEST(test_execute_case_fallthrough);
+    RUN_TEST(test_execute_case_in_cmdsub);
+    RUN_TEST(test_execute_function_return_in_loop);
+    RUN_TEST(test_execute_until_loop);
+    RUN_TEST(test_execute_syntax_error_status);
+
+    // In-process check
+    RUN_TEST(test_in_process_builtins_and_functions);
+    RUN_TEST(test_in_process_rejects_child_work);
+
+    return UNITY_END();
+}
@@ -0,0 +1,99 @@
+#include "unity.h"
+#include "../src/brace.h"
+#include <stdlib.h>
+#include <string.h>
+
+static FieldList words;
+
+void setUp(void) {
+    fieldlist_init(&words);
+}
+
+void tearDown(void) {
+    fieldlist_free(&words);
+}
+
+// Brace expand a token and join the words with spaces
+static const char *expand_joined(const char *word) {
+    static char joined[4096];
+    joined[0] = '\0';
+
+    fieldlist_free(&words);
+    if (!brace_expand(word, &words)) return NULL;
+    for (int i = 0; i < words.count; i++) {
+        if (i > 0) strcat(joined, " ");
+        strcat(joined, words.fields[i]);
+    }
+    return joined;
+}
+
+// Test comma lists with text around them, nesting and several lists
+void test_brace_lists(void) {
+    TEST_ASSERT_EQUAL_STRING("a b c", expand_joined("{a,b,c}"));
+    TEST_ASSERT_EQUAL_STRING("xay xby", expand_joined("x{a,b}y"));
+    TEST_ASSERT_EQUAL_STRING("a1 a2 b1 b2", expand_joined("{a,b}{1,2}"));
+    TEST_ASSERT_EQUAL_STRING("abf acdf acef", expand_joined("a{b,c{d,e}}f"));
+    TEST_ASSERT_EQUAL_STRING("xy xy", expand_joined("x{,}y"));
+    TEST_ASSERT_EQUAL_STRING("{a}b {a}c", expand_joined("{a}{b,c}"));
+}
+
+// Test numeric and character sequences
+void test_brace_sequences(void) {
+    TEST_ASSERT_EQUAL_STRING("1 2 3", expand_joined("{1..3}"));
+    TEST_ASSERT_EQUAL_STRING("3 2 1", expand_joined("{3..1}"));
+    TEST_ASSERT_EQUAL_STRING("1 4 7 10", expand_joined("{1..10..3}"));
+    TEST_ASSERT_EQUAL_STRING("10 6 2", expand_joined("{10..1..-4}"));
+    TEST_ASSERT_EQUAL_STRING("08 09 10", expand_joined("{08..10}"));
+    TEST_ASSERT_EQUAL_STRING("-2 -1 00 01", expand_joined("{-2..01}"));
+    TEST_ASSERT_EQUAL_STRING("a c e", expand_joined("{a..e..2}"));
+    TEST_ASSERT_EQUAL_STRING("9223372036854775806 9223372036854775807",
+                             expand_joined("{9223372036854775806..9223372036854775807}"));
+}
+
+// Test words without a brace expression are left alone
+void test_brace_not_expanded(void) {
+    TEST_ASSERT_NULL(expand_joined("{}"));
+    TEST_ASSERT_NULL(expand_joined("{a}"));
+    TEST_ASSERT_NULL(expand_joined("{a,b"));
+    TEST_ASSERT_NULL(expand_joined("{1..}"));
+    TEST_ASSERT_NULL(expand_joined("${x,y}"));
+    TEST_ASSERT_NULL(expand_joined("{a\x01,b}"));
+    TEST_ASSERT_NULL(expand_joined("\x01{a,b}"));
+    TEST_ASSERT_EQUAL_INT(0, words.count);
+
+    // Braces of ${...} inside a list are skipped
+    TEST_ASSERT_EQUAL_STRING("${x,y} z", expand_joined("{${x,y},z}"));
+}
+
+// Test a sequence between plain text is generated one word at a time
+void test_brace_sequence_lazy(void) {
+    BraceSequence seq;
+    TEST_ASSERT_TRUE(brace_sequence_init("f{01..3}.txt", &seq));
+    TEST_ASSERT_EQUAL_STRING("f01.txt", brace_sequence_next(&seq));
+    TEST_ASSERT_EQUAL_STRING("f02.txt", brace_sequence_next(&seq));
+    TEST_ASSERT_EQUAL_STRING("f03.txt", brace_sequence_next(&seq));
+    TEST_ASSERT_NULL(brace_sequence_next(&seq));
+    brace_sequence_free(&seq);
+
+    TEST_ASSERT_TRUE(brace_sequence_init("{1..1000000000}", &seq));
+    TEST_ASSERT_EQUAL_STRING("1", brace_sequence_next(&seq));
+    TEST_ASSERT_EQUAL_STRING("2", brace_sequence_next(&seq));
+    brace_sequence_free(&seq);
+
+    // Lists, several expressions and text needing expansion are not lazy
+    TEST_ASSERT_FALSE(brace_sequence_init("{a,b}", &seq));
+    TEST_ASSERT_FALSE(brace_sequence_init("{1..2}{1..2}", &seq));
+    TEST_ASSERT_FALSE(brace_sequence_init("$x{1..2}", &seq));
+    TEST_ASSERT_FALSE(brace_sequence_init("{1..2}*", &seq));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_brace_lists);
+    RUN_TEST(test_brace_sequences);
+    RUN_TEST(test_brace_not_expanded);
+    RUN_TEST(test_brace_sequence_lazy);
+
+    return UNITY_END();
+}
@@ -218,6 +218,55 @@ void test_try_builtin_type(void) {
     TEST_ASSERT_NOT_EQUAL_INT(-1, result);  // Should recognize type
 }
 
+// Test the command hash table remembers resolved paths
+void test_cmd_hash_find_remembers_path(void) {
+    cmd_hash_clear();
+    TEST_ASSERT_NULL(cmd_hash_lookup("sh"));
+
+    char *path = cmd_hash_find("sh");
+    TEST_ASSERT_NOT_NULL(path);
+    TEST_ASSERT_NOT_NULL(cmd_hash_lookup("sh"));
+    TEST_ASSERT_EQUAL_STRING(path, cmd_hash_lookup("sh"));
+    free(path);
+
+    cmd_hash_clear();
+}
+
+// Test paths containing a slash are never hashed
+void test_cmd_hash_find_skips_paths(void) {
+    cmd_hash_clear();
+    TEST_ASSERT_NULL(cmd_hash_find("/bin/sh"));
+    TEST_ASSERT_NULL(cmd_hash_lookup("/bin/sh"));
+}
+
+// Test hash -r forgets remembered paths
+void test_shell_hash_r_clears_table(void) {
+    char *path = cmd_hash_find("sh");
+    free(path);
+    TEST_ASSERT_NOT_NULL(cmd_hash_lookup("sh"));
+
+    char *args[] = {"hash", "-r", NULL};
+    TEST_ASSERT_EQUAL_INT(1, shell_hash(args));
+    TEST_ASSERT_NULL(cmd_hash_lookup("sh"));
+}
+
+// Test entries are bypassed while PATH differs from when they were found
+void test_cmd_hash_ignored_after_path_change(void) {
+    cmd_hash_clear();
+    char *old_path = strdup(getenv("PATH"));
+    char *path = cmd_hash_find("sh");
+    free(path);
+    TEST_ASSERT_NOT_NULL(cmd_hash_lookup("sh"));
+
+    setenv("PATH", "/nonexistent", 1);
+    TEST_ASSERT_NULL(cmd_hash_lookup("sh"));
+
+    setenv("PATH", old_path, 1);
+    TEST_ASSERT_NOT_NULL(cmd_hash_lookup("sh"));
+    free(old_path);
+    cmd_hash_clear();
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -242,6 +291,10 @@ int main(void) {
     RUN_TEST(test_try_builtin_exec);
     RUN_TEST(test_try_builtin_times);
     RUN_TEST(test_try_builtin_type);
+    RUN_TEST(test_cmd_hash_find_remembers_path);
+    RUN_TEST(test_cmd_hash_find_skips_paths);
+    RUN_TEST(test_shell_hash_r_clears_table);
+    RUN_TEST(test_cmd_hash_ignored_after_path_change);
 
     return UNITY_END();
 }
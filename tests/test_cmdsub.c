@@ -1,5 +1,7 @@
 #include "unity.h"
 #include "../src/cmdsub.h"
+#include "../src/script.h"
+#include "../src/shellvar.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -157,6 +159,34 @@ void test_cmdsub_with_args(void) {
     free(result);
 }
 
+// Test builtin-only body runs without leaking its assignments
+void test_cmdsub_in_process_isolates_vars(void) {
+    char *result = cmdsub_expand("$(inner_var=42; echo $inner_var)");
+
+    TEST_ASSERT_NOT_NULL(result);
+    strip_ifs_markers(result);
+    TEST_ASSERT_EQUAL_STRING("42", result);
+    TEST_ASSERT_NULL(shellvar_get("inner_var"));
+
+    free(result);
+}
+
+// Test function-only body output and exit status
+void test_cmdsub_in_process_function(void) {
+    script_init();
+    script_define_function("greet", "echo \"hi $1\"\nfalse");
+
+    char *result = cmdsub_expand("$(greet there)");
+
+    TEST_ASSERT_NOT_NULL(result);
+    strip_ifs_markers(result);
+    TEST_ASSERT_EQUAL_STRING("hi there", result);
+    TEST_ASSERT_EQUAL_INT(1, cmdsub_get_last_exit_code());
+
+    free(result);
+    script_cleanup();
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -172,6 +202,8 @@ int main(void) {
     RUN_TEST(test_cmdsub_multiline_output);
     RUN_TEST(test_cmdsub_empty_command);
     RUN_TEST(test_cmdsub_with_args);
+    RUN_TEST(test_cmdsub_in_process_isolates_vars);
+    RUN_TEST(test_cmdsub_in_process_function);
 
     return UNITY_END();
 }
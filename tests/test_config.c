@@ -1,5 +1,6 @@
 #include "unity.h"
 #include "../src/config.h"
+#include "../src/shellvar.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -117,6 +118,8 @@ void test_process_export(void) {
     int result = config_process_line(line);
     TEST_ASSERT_EQUAL_INT(0, result);
 
+    // The environment for children is built when it is next needed
+    shellvar_environ();
     const char *value = getenv("TEST_VAR");
     TEST_ASSERT_NOT_NULL(value);
     TEST_ASSERT_EQUAL_STRING("test_value", value);
@@ -0,0 +1,168 @@
+#include "unity.h"
+#include "../src/datamove.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define DATA_SIZE (1024 * 1024 + 123)
+
+static char *data;
+static char *back;
+
+void setUp(void) {
+    data = malloc(DATA_SIZE);
+    back = malloc(DATA_SIZE);
+    for (int i = 0; i < DATA_SIZE; i++) {
+        data[i] = (char)(i * 31 + i / 7);
+    }
+}
+
+void tearDown(void) {
+    free(data);
+    free(back);
+}
+
+// Unlinked temporary file holding the test data, positioned at its start
+static int data_file(void) {
+    char path[] = "/tmp/hash-datamove-XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    unlink(path);
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, (int)write(fd, data, DATA_SIZE));
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+static int empty_file(void) {
+    char path[] = "/tmp/hash-datamove-XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    unlink(path);
+    return fd;
+}
+
+// Read a whole file back from its start
+static void read_back(int fd) {
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, (int)lseek(fd, 0, SEEK_END));
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, (int)pread(fd, back, DATA_SIZE, 0));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(data, back, DATA_SIZE));
+}
+
+// Test a copy between two regular files
+void test_copy_file_to_file(void) {
+    int in = data_file();
+    int out = empty_file();
+
+    TEST_ASSERT_EQUAL_INT(0, datamove_copy(in, out));
+    read_back(out);
+
+    close(in);
+    close(out);
+}
+
+// Test a file copied into a pipe and the pipe copied into a file,
+// through a child like a pipeline stage
+void test_copy_through_pipe(void) {
+    int in = data_file();
+    int out = empty_file();
+    int pipefd[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(pipefd));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(pipefd[0]);
+        _exit(datamove_copy(in, pipefd[1]) == 0 ? 0 : 1);
+    }
+    close(pipefd[1]);
+    TEST_ASSERT_EQUAL_INT(0, datamove_copy(pipefd[0], out));
+    close(pipefd[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    TEST_ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    read_back(out);
+
+    close(in);
+    close(out);
+}
+
+// Test the copy starts at the input's current offset
+void test_copy_from_offset(void) {
+    int in = data_file();
+    int out = empty_file();
+    lseek(in, DATA_SIZE - 100, SEEK_SET);
+
+    TEST_ASSERT_EQUAL_INT(0, datamove_copy(in, out));
+    TEST_ASSERT_EQUAL_INT(100, (int)pread(out, back, DATA_SIZE, 0));
+    TEST_ASSERT_EQUAL_INT(0, memcmp(data + DATA_SIZE - 100, back, 100));
+
+    close(in);
+    close(out);
+}
+
+// Test only cat with plain operands is taken over
+void test_is_cat(void) {
+    const char *cat = access("/bin/cat", X_OK) == 0 ? "/bin/cat" : "/usr/bin/cat";
+    char *plain[] = {"cat", "a", "-", "b", NULL};
+    char *path[] = {(char *)cat, NULL};
+    char *option[] = {"cat", "-n", "a", NULL};
+    char *dashes[] = {"cat", "--", "a", NULL};
+    char *other[] = {"tac", "a", NULL};
+
+    TEST_ASSERT_TRUE(datamove_is_cat(cat, plain));
+    TEST_ASSERT_TRUE(datamove_is_cat(cat, path));
+    TEST_ASSERT_FALSE(datamove_is_cat(cat, option));
+    TEST_ASSERT_FALSE(datamove_is_cat(cat, dashes));
+    TEST_ASSERT_FALSE(datamove_is_cat(cat, other));
+    TEST_ASSERT_EQUAL_INT(-1, datamove_cat(cat, option));
+}
+
+// Test files generated on read, which describe the reading process, are
+// left to the real cat
+void test_cat_leaves_proc_self(void) {
+    if (access("/proc/self/status", R_OK) != 0) return;
+    const char *cat = access("/bin/cat", X_OK) == 0 ? "/bin/cat" : "/usr/bin/cat";
+    char *args[] = {"cat", "/proc/self/status", NULL};
+    char *mixed[] = {"cat", "/proc/thread-self/stat", "/dev/null", NULL};
+
+    TEST_ASSERT_EQUAL_INT(-1, datamove_cat(cat, args));
+    TEST_ASSERT_EQUAL_INT(-1, datamove_cat(cat, mixed));
+}
+
+// Test a different program named cat, earlier in PATH, is not taken over
+void test_is_cat_other_program(void) {
+    char dir[] = "/tmp/hash-datamove-XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char wrapper[sizeof(dir) + 8];
+    snprintf(wrapper, sizeof(wrapper), "%s/cat", dir);
+    FILE *fp = fopen(wrapper, "w");
+    TEST_ASSERT_NOT_NULL(fp);
+    fprintf(fp, "#!/bin/sh\necho wrapper\n");
+    fclose(fp);
+    chmod(wrapper, 0755);
+
+    char *args[] = {"cat", "a", NULL};
+    bool taken = datamove_is_cat(wrapper, args);
+    int status = datamove_cat(wrapper, args);
+    unlink(wrapper);
+    rmdir(dir);
+
+    TEST_ASSERT_FALSE(taken);
+    TEST_ASSERT_EQUAL_INT(-1, status);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_copy_file_to_file);
+    RUN_TEST(test_copy_through_pipe);
+    RUN_TEST(test_copy_from_offset);
+    RUN_TEST(test_is_cat);
+    RUN_TEST(test_is_cat_other_program);
+    RUN_TEST(test_cat_leaves_proc_self);
+
+    return UNITY_END();
+}
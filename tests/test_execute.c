@@ -1,8 +1,13 @@
 #include "unity.h"
 #include "../src/execute.h"
+#include "../src/config.h"
+#include "../src/shellvar.h"
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <stdio.h>
+#include <string.h>
 
 void setUp(void) {
     // Set up before each test
@@ -62,6 +67,93 @@ void test_execute_invalid_command(void) {
     TEST_ASSERT_EQUAL_INT(1, result);
 }
 
+// Test spawned command with an output redirection
+void test_execute_spawn_with_redirect(void) {
+    const char *path = "/tmp/hash_test_spawn.txt";
+    char *args[] = {"echo", "spawned", ">", (char *)path, NULL};
+
+    shell_option_set_spawn(true);
+    int result = execute(args);
+    shell_option_set_spawn(false);
+
+    TEST_ASSERT_EQUAL_INT(1, result);
+    TEST_ASSERT_EQUAL_INT(0, execute_get_last_exit_code());
+
+    char buf[32] = {0};
+    FILE *f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    fclose(f);
+    unlink(path);
+    TEST_ASSERT_EQUAL_STRING("spawned\n", buf);
+}
+
+// Test spawn failure reports the same status as a failed fork + exec
+void test_execute_spawn_missing_input(void) {
+    char *args[] = {"cat", "<", "/nonexistent/hash_test_input", NULL};
+
+    shell_option_set_spawn(true);
+    execute(args);
+    shell_option_set_spawn(false);
+
+    TEST_ASSERT_EQUAL_INT(1, execute_get_last_exit_code());
+}
+
+// Test a cat earlier in PATH than the system one is executed, not replaced
+// by the shell's own file copy
+void test_execute_cat_wrapper_in_path(void) {
+    char dir[] = "/tmp/hash_test_catXXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char wrapper[sizeof(dir) + 8];
+    char out[sizeof(dir) + 8];
+    snprintf(wrapper, sizeof(wrapper), "%s/cat", dir);
+    snprintf(out, sizeof(out), "%s/out", dir);
+
+    FILE *f = fopen(wrapper, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fprintf(f, "#!/bin/sh\necho wrapper\n");
+    fclose(f);
+    chmod(wrapper, 0755);
+
+    const char *old_path = getenv("PATH");
+    char *saved_path = strdup(old_path ? old_path : "/usr/bin:/bin");
+    char path[4096];
+    snprintf(path, sizeof(path), "%s:%s", dir, saved_path);
+    shellvar_set("PATH", path);
+
+    char *args[] = {"cat", "/dev/null", ">", out, NULL};
+    execute(args);
+
+    shellvar_set("PATH", saved_path);
+    free(saved_path);
+
+    char buf[32] = {0};
+    f = fopen(out, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    fclose(f);
+    unlink(out);
+    unlink(wrapper);
+    rmdir(dir);
+    TEST_ASSERT_EQUAL_STRING("wrapper\n", buf);
+}
+
+// Test cat of a process-relative file describes cat, not the shell
+void test_execute_cat_proc_self(void) {
+    if (access("/proc/self/status", R_OK) != 0) return;
+    const char *out = "/tmp/hash_test_cat_proc.txt";
+    char *args[] = {"cat", "/proc/self/status", ">", (char *)out, NULL};
+    execute(args);
+
+    char buf[64] = {0};
+    FILE *f = fopen(out, "r");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+    fclose(f);
+    unlink(out);
+    TEST_ASSERT_EQUAL_STRING("Name:\tcat\n", buf);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -71,6 +163,10 @@ int main(void) {
     RUN_TEST(test_execute_external_command_true);
     RUN_TEST(test_execute_external_command_with_args);
     RUN_TEST(test_execute_invalid_command);
+    RUN_TEST(test_execute_spawn_with_redirect);
+    RUN_TEST(test_execute_spawn_missing_input);
+    RUN_TEST(test_execute_cat_wrapper_in_path);
+    RUN_TEST(test_execute_cat_proc_self);
 
     return UNITY_END();
 }
@@ -0,0 +1,125 @@
+#include "unity.h"
+#include "../src/fileglob.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static char dir[PATH_MAX];
+static char saved_cwd[PATH_MAX];
+
+static void make_file(const char *name) {
+    FILE *f = fopen(name, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fclose(f);
+}
+
+// Expand pattern and join the matches with spaces
+static const char *glob_joined(const char *pattern, bool recurse) {
+    static char joined[4096];
+    joined[0] = '\0';
+
+    int count = 0;
+    char **matches = fileglob_expand(pattern, recurse, &count);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) strcat(joined, " ");
+        strcat(joined, matches[i]);
+        free(matches[i]);
+    }
+    free(matches);
+    return joined;
+}
+
+void setUp(void) {
+    TEST_ASSERT_NOT_NULL(getcwd(saved_cwd, sizeof(saved_cwd)));
+    snprintf(dir, sizeof(dir), "/tmp/hash_glob_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    TEST_ASSERT_EQUAL_INT(0, chdir(dir));
+
+    mkdir("src", 0755);
+    mkdir("src/lib", 0755);
+    mkdir(".git", 0755);
+    make_file("main.c");
+    make_file("util.h");
+    make_file(".hidden");
+    make_file("src/a.c");
+    make_file("src/b.txt");
+    make_file("src/lib/c.c");
+    make_file(".git/d.c");
+    TEST_ASSERT_EQUAL_INT(0, symlink("src", "link"));
+}
+
+void tearDown(void) {
+    fileglob_cache_clear();
+    TEST_ASSERT_EQUAL_INT(0, chdir(saved_cwd));
+
+    char cmd[PATH_MAX + 16];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", dir);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "failed to remove %s\n", dir);
+    }
+}
+
+// Test wildcards, brackets and the leading dot rule
+void test_fileglob_basic(void) {
+    TEST_ASSERT_EQUAL_STRING("link main.c src util.h", glob_joined("*", false));
+    TEST_ASSERT_EQUAL_STRING("main.c", glob_joined("*.c", false));
+    TEST_ASSERT_EQUAL_STRING("main.c util.h", glob_joined("*.[ch]", false));
+    TEST_ASSERT_EQUAL_STRING("util.h", glob_joined("[[:lower:]]til?h", false));
+    TEST_ASSERT_EQUAL_STRING("link src", glob_joined("[!mu]*", false));
+    TEST_ASSERT_EQUAL_STRING(". .. .git .hidden", glob_joined(".*", false));
+    TEST_ASSERT_EQUAL_STRING("", glob_joined("?hidden", false));
+    TEST_ASSERT_EQUAL_STRING("", glob_joined("*.none", false));
+}
+
+// Test patterns in several components, escapes and a trailing slash
+void test_fileglob_components(void) {
+    TEST_ASSERT_EQUAL_STRING("link/a.c src/a.c", glob_joined("*/*.c", false));
+    TEST_ASSERT_EQUAL_STRING("src/lib/c.c", glob_joined("src/*/c.c", false));
+    TEST_ASSERT_EQUAL_STRING("link/ src/", glob_joined("*/", false));
+    TEST_ASSERT_EQUAL_STRING("main.c", glob_joined("m\\ain.*", false));
+    TEST_ASSERT_EQUAL_STRING("", glob_joined("\\*.c", false));
+
+    char pattern[PATH_MAX + 16];
+    char expected[PATH_MAX + 16];
+    snprintf(pattern, sizeof(pattern), "%s/src/*.txt", dir);
+    snprintf(expected, sizeof(expected), "%s/src/b.txt", dir);
+    TEST_ASSERT_EQUAL_STRING(expected, glob_joined(pattern, false));
+}
+
+// Test ** descends into directories but not links or hidden directories
+void test_fileglob_globstar(void) {
+    TEST_ASSERT_EQUAL_STRING("main.c src/a.c src/lib/c.c", glob_joined("**/*.c", true));
+    TEST_ASSERT_EQUAL_STRING("src/ src/a.c src/b.txt src/lib src/lib/c.c",
+                             glob_joined("src/**", true));
+    TEST_ASSERT_EQUAL_STRING("link/ src/ src/lib/", glob_joined("**/", true));
+
+    // Without recursion ** is the same as *
+    TEST_ASSERT_EQUAL_STRING("link/a.c src/a.c", glob_joined("**/*.c", false));
+}
+
+// Test a listing is read again after its directory changes
+void test_fileglob_cache_recheck(void) {
+    TEST_ASSERT_EQUAL_STRING("src/a.c", glob_joined("src/*.c", false));
+
+    make_file("src/e.c");
+    fileglob_cache_recheck();
+    TEST_ASSERT_EQUAL_STRING("src/a.c src/e.c", glob_joined("src/*.c", false));
+
+    unlink("src/a.c");
+    fileglob_cache_recheck();
+    TEST_ASSERT_EQUAL_STRING("src/e.c", glob_joined("src/*.c", false));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_fileglob_basic);
+    RUN_TEST(test_fileglob_components);
+    RUN_TEST(test_fileglob_globstar);
+    RUN_TEST(test_fileglob_cache_recheck);
+
+    return UNITY_END();
+}
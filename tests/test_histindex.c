@@ -0,0 +1,94 @@
+#include "unity.h"
+#include "../src/histindex.h"
+#include <stdio.h>
+#include <string.h>
+
+static HistIndex index_under_test;
+
+void setUp(void) {
+    histindex_init(&index_under_test);
+}
+
+void tearDown(void) {
+    histindex_clear(&index_under_test);
+}
+
+// Test newest line wins for a shared prefix
+void test_histindex_newest_match(void) {
+    histindex_add(&index_under_test, "git status");
+    histindex_add(&index_under_test, "git commit");
+    histindex_add(&index_under_test, "grep foo");
+
+    TEST_ASSERT_EQUAL_STRING("grep foo", histindex_find(&index_under_test, "g"));
+    TEST_ASSERT_EQUAL_STRING("git commit", histindex_find(&index_under_test, "git"));
+    TEST_ASSERT_EQUAL_STRING("git status", histindex_find(&index_under_test, "git s"));
+    TEST_ASSERT_NULL(histindex_find(&index_under_test, "gix"));
+    TEST_ASSERT_NULL(histindex_find(&index_under_test, "git statuses"));
+}
+
+// Test adding a line again makes it the newest
+void test_histindex_readd_moves_to_front(void) {
+    histindex_add(&index_under_test, "make test");
+    histindex_add(&index_under_test, "make clean");
+    histindex_add(&index_under_test, "make test");
+
+    TEST_ASSERT_EQUAL_STRING("make test", histindex_find(&index_under_test, "make"));
+}
+
+// Test removal falls back to the next most recent line
+void test_histindex_remove(void) {
+    histindex_add(&index_under_test, "ls -la");
+    histindex_add(&index_under_test, "ls");
+    histindex_add(&index_under_test, "ls -l");
+
+    histindex_remove(&index_under_test, "ls -l");
+    TEST_ASSERT_EQUAL_STRING("ls", histindex_find(&index_under_test, "ls"));
+    TEST_ASSERT_EQUAL_STRING("ls -la", histindex_find(&index_under_test, "ls -"));
+
+    histindex_remove(&index_under_test, "ls");
+    TEST_ASSERT_EQUAL_STRING("ls -la", histindex_find(&index_under_test, "l"));
+
+    histindex_remove(&index_under_test, "ls -la");
+    TEST_ASSERT_NULL(histindex_find(&index_under_test, "l"));
+}
+
+// Test a line held by several entries stays until the last is removed
+void test_histindex_duplicate_count(void) {
+    histindex_add(&index_under_test, "echo hi");
+    histindex_add(&index_under_test, "echo hi");
+
+    histindex_remove(&index_under_test, "echo hi");
+    TEST_ASSERT_EQUAL_STRING("echo hi", histindex_find(&index_under_test, "echo"));
+
+    histindex_remove(&index_under_test, "echo hi");
+    TEST_ASSERT_NULL(histindex_find(&index_under_test, "echo"));
+}
+
+// Test many lines with shared prefixes
+void test_histindex_many_lines(void) {
+    char line[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(line, sizeof(line), "cmd %d", i);
+        histindex_add(&index_under_test, line);
+    }
+    for (int i = 4000; i < 5000; i++) {
+        snprintf(line, sizeof(line), "cmd %d", i);
+        histindex_remove(&index_under_test, line);
+    }
+
+    TEST_ASSERT_EQUAL_STRING("cmd 3999", histindex_find(&index_under_test, "cmd"));
+    TEST_ASSERT_EQUAL_STRING("cmd 1999", histindex_find(&index_under_test, "cmd 1"));
+    TEST_ASSERT_EQUAL_STRING("cmd 429", histindex_find(&index_under_test, "cmd 42"));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_histindex_newest_match);
+    RUN_TEST(test_histindex_readd_moves_to_front);
+    RUN_TEST(test_histindex_remove);
+    RUN_TEST(test_histindex_duplicate_count);
+    RUN_TEST(test_histindex_many_lines);
+
+    return UNITY_END();
+}
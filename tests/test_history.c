@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <stdio.h>
 
 void setUp(void) {
     // Use a non-existent file for tests to avoid loading user's actual history
@@ -297,6 +298,74 @@ void test_history_expand_none(void) {
     TEST_ASSERT_NULL(expanded);  // No expansion, returns NULL
 }
 
+#define TEST_HISTFILE "/tmp/hash_test_history_nonexistent_12345"
+
+// Count lines in the test history file, optionally copying the first one
+static int count_file_lines(char *first, size_t first_size) {
+    FILE *fp = fopen(TEST_HISTFILE, "r");
+    if (!fp) return -1;
+    char line[256];
+    int count = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (count == 0 && first) {
+            size_t len = strcspn(line, "\n");
+            if (len >= first_size) len = first_size - 1;
+            memcpy(first, line, len);
+            first[len] = '\0';
+        }
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+// Test entries are appended, keeping lines written by other shells
+void test_history_append_keeps_other_sessions(void) {
+    history_add("first");
+
+    FILE *fp = fopen(TEST_HISTFILE, "a");
+    TEST_ASSERT_NOT_NULL(fp);
+    fprintf(fp, "from another shell\n");
+    fclose(fp);
+
+    history_add("second");
+
+    char first[64] = {0};
+    TEST_ASSERT_EQUAL_INT(3, count_file_lines(first, sizeof(first)));
+    TEST_ASSERT_EQUAL_STRING("first", first);
+}
+
+// Test compaction keeps only the newest HISTFILESIZE entries
+void test_history_compact(void) {
+    FILE *fp = fopen(TEST_HISTFILE, "w");
+    TEST_ASSERT_NOT_NULL(fp);
+    for (int i = 0; i < 450; i++) {
+        fprintf(fp, "cmd %d\n", i);
+    }
+    fclose(fp);
+
+    history_compact();
+
+    char first[64] = {0};
+    TEST_ASSERT_EQUAL_INT(200, count_file_lines(first, sizeof(first)));
+    TEST_ASSERT_EQUAL_STRING("cmd 250", first);
+}
+
+// Test compaction with erasedups keeps only the newest copy of an entry
+void test_history_compact_erasedups(void) {
+    setenv("HISTCONTROL", "erasedups", 1);
+    history_add("ls");
+    history_add("pwd");
+    history_add("ls");
+    TEST_ASSERT_EQUAL_INT(3, count_file_lines(NULL, 0));
+
+    history_compact();
+
+    char first[64] = {0};
+    TEST_ASSERT_EQUAL_INT(2, count_file_lines(first, sizeof(first)));
+    TEST_ASSERT_EQUAL_STRING("pwd", first);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -321,6 +390,9 @@ int main(void) {
     RUN_TEST(test_history_expand_prefix);
     RUN_TEST(test_history_expand_escaped);
     RUN_TEST(test_history_expand_none);
+    RUN_TEST(test_history_append_keeps_other_sessions);
+    RUN_TEST(test_history_compact);
+    RUN_TEST(test_history_compact_erasedups);
 
     return UNITY_END();
 }
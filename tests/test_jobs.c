@@ -160,6 +160,30 @@ void test_jobs_multiple(void) {
     waitpid(pid2, NULL, 0);
 }
 
+// Test a watched helper is no longer outstanding once the handler reaps it
+void test_jobs_helper_reaped(void) {
+    sigset_t block_mask, old_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block_mask, &old_mask);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(0);
+    }
+    jobs_watch_helper(pid);
+    TEST_ASSERT_TRUE(jobs_helper_outstanding(pid));
+
+    // Let the SIGCHLD handler reap it
+    while (jobs_helper_outstanding(pid)) {
+        sigsuspend(&old_mask);
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    TEST_ASSERT_FALSE(jobs_helper_outstanding(pid));
+    TEST_ASSERT_EQUAL_INT(-1, waitpid(pid, NULL, WNOHANG));
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -171,6 +195,7 @@ int main(void) {
     RUN_TEST(test_jobs_get_nonexistent);
     RUN_TEST(test_jobs_get_current);
     RUN_TEST(test_jobs_multiple);
+    RUN_TEST(test_jobs_helper_reaped);
 
     return UNITY_END();
 }
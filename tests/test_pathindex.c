@@ -0,0 +1,126 @@
+#include "unity.h"
+#include "../src/pathindex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static char dir_a[PATH_MAX];
+static char dir_b[PATH_MAX];
+static char *saved_path;
+
+static void make_file(const char *dir, const char *name, mode_t mode) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fputs("#!/bin/sh\n", f);
+    fclose(f);
+    chmod(path, mode);
+}
+
+void setUp(void) {
+    const char *path = getenv("PATH");
+    saved_path = path ? strdup(path) : NULL;
+
+    snprintf(dir_a, sizeof(dir_a), "/tmp/hash_pidx_a_XXXXXX");
+    snprintf(dir_b, sizeof(dir_b), "/tmp/hash_pidx_b_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir_a));
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir_b));
+
+    char path_value[PATH_MAX * 2 + 2];
+    snprintf(path_value, sizeof(path_value), "%s:%s", dir_a, dir_b);
+    setenv("PATH", path_value, 1);
+    pathindex_clear();
+}
+
+void tearDown(void) {
+    if (saved_path) {
+        setenv("PATH", saved_path, 1);
+        free(saved_path);
+    } else {
+        unsetenv("PATH");
+    }
+    pathindex_clear();
+
+    char cmd[PATH_MAX * 2 + 16];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s' '%s'", dir_a, dir_b);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "failed to remove %s %s\n", dir_a, dir_b);
+    }
+}
+
+// Test the first executable in PATH order wins
+void test_pathindex_find_order(void) {
+    make_file(dir_a, "tool", 0755);
+    make_file(dir_b, "tool", 0755);
+
+    char expected[PATH_MAX + 8];
+    snprintf(expected, sizeof(expected), "%s/tool", dir_a);
+    char *found = pathindex_find("tool");
+    TEST_ASSERT_NOT_NULL(found);
+    TEST_ASSERT_EQUAL_STRING(expected, found);
+    free(found);
+}
+
+// Test non-executable files are skipped in favour of later directories
+void test_pathindex_find_skips_non_executable(void) {
+    make_file(dir_a, "tool", 0644);
+    make_file(dir_b, "tool", 0755);
+
+    char expected[PATH_MAX + 8];
+    snprintf(expected, sizeof(expected), "%s/tool", dir_b);
+    char *found = pathindex_find("tool");
+    TEST_ASSERT_NOT_NULL(found);
+    TEST_ASSERT_EQUAL_STRING(expected, found);
+    free(found);
+
+    TEST_ASSERT_NULL(pathindex_find("missing"));
+    TEST_ASSERT_NULL(pathindex_find("a/b"));
+}
+
+// Test a command created after the index was built is found
+void test_pathindex_sees_new_commands(void) {
+    TEST_ASSERT_NULL(pathindex_find("fresh"));
+    unsigned long generation = pathindex_generation();
+
+    make_file(dir_b, "fresh", 0755);
+    char *found = pathindex_find("fresh");
+    TEST_ASSERT_NOT_NULL(found);
+    free(found);
+    TEST_ASSERT_TRUE(pathindex_generation() != generation);
+}
+
+// Test completion lists distinct executable names in order
+void test_pathindex_complete(void) {
+    make_file(dir_a, "gitk", 0755);
+    make_file(dir_a, "git", 0755);
+    make_file(dir_b, "git", 0755);
+    make_file(dir_b, "gitdata", 0644);
+    make_file(dir_b, "grep", 0755);
+
+    const char *names[8];
+    int n = pathindex_complete("git", names, 8);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_EQUAL_STRING("git", names[0]);
+    TEST_ASSERT_EQUAL_STRING("gitk", names[1]);
+
+    n = pathindex_complete("", names, 8);
+    TEST_ASSERT_EQUAL_INT(3, n);
+
+    n = pathindex_complete("g", names, 1);
+    TEST_ASSERT_EQUAL_INT(1, n);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_pathindex_find_order);
+    RUN_TEST(test_pathindex_find_skips_non_executable);
+    RUN_TEST(test_pathindex_sees_new_commands);
+    RUN_TEST(test_pathindex_complete);
+
+    return UNITY_END();
+}
@@ -1,6 +1,15 @@
 #include "unity.h"
 #include "../src/pipeline.h"
+#include "../src/config.h"
+#include "../src/shellvar.h"
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(__linux__) && !defined(F_GETPIPE_SZ)
+#define F_GETPIPE_SZ 1032
+#endif
 
 void setUp(void) {
 }
@@ -95,6 +104,91 @@ void test_parse_complex_pipe(void) {
     pipeline_free(pipe);
 }
 
+// First stage: write a line for the last stage
+static int write_stage(int index, void *data) {
+    (void)index;
+    (void)data;
+    const char msg[] = "from child\n";
+    return write(STDOUT_FILENO, msg, sizeof(msg) - 1) == (ssize_t)(sizeof(msg) - 1) ? 0 : 1;
+}
+
+// Last stage run in this process: keep what it reads
+static int read_last(void *data) {
+    char *buf = data;
+    ssize_t n = read(STDIN_FILENO, buf, 63);
+    buf[n > 0 ? n : 0] = '\0';
+    return 5;
+}
+
+// Test the last stage runs in the calling process and stdin comes back
+void test_run_last_stage_in_shell(void) {
+    char buf[64] = "";
+    int saved = dup(STDIN_FILENO);
+
+    TEST_ASSERT_EQUAL_INT(5, pipeline_run(2, write_stage, read_last, buf));
+    TEST_ASSERT_EQUAL_STRING("from child\n", buf);
+
+    // stdin is the original descriptor again, not the pipe
+    struct stat before, after;
+    TEST_ASSERT_EQUAL_INT(0, fstat(saved, &before));
+    TEST_ASSERT_EQUAL_INT(0, fstat(STDIN_FILENO, &after));
+    TEST_ASSERT_TRUE(before.st_ino == after.st_ino && before.st_dev == after.st_dev);
+    close(saved);
+}
+
+// Stage exiting with the status given for its index
+static int status_stage(int index, void *data) {
+    const int *statuses = data;
+    return statuses[index];
+}
+
+// Test every stage's status is kept, and pipefail picks the last failure
+void test_stage_statuses(void) {
+    int statuses[] = {2, 3, 0};
+    config_init();
+
+    TEST_ASSERT_EQUAL_INT(0, pipeline_run(3, status_stage, NULL, statuses));
+    TEST_ASSERT_EQUAL_INT(3, (int)shellvar_array_count("PIPESTATUS"));
+    TEST_ASSERT_EQUAL_STRING("2", shellvar_array_get("PIPESTATUS", "0"));
+    TEST_ASSERT_EQUAL_STRING("3", shellvar_array_get("PIPESTATUS", "1"));
+    TEST_ASSERT_EQUAL_STRING("0", shellvar_array_get("PIPESTATUS", "2"));
+
+    // Each stage's usage starts with its status
+    TEST_ASSERT_EQUAL_INT(3, (int)shellvar_array_count("PIPESTATS"));
+    TEST_ASSERT_EQUAL_INT(0, strncmp(shellvar_array_get("PIPESTATS", "1"), "3 ", 2));
+
+    shell_option_set_pipefail(true);
+    TEST_ASSERT_EQUAL_INT(3, pipeline_run(3, status_stage, NULL, statuses));
+    statuses[0] = 0;
+    statuses[1] = 0;
+    TEST_ASSERT_EQUAL_INT(0, pipeline_run(3, status_stage, NULL, statuses));
+    shell_option_set_pipefail(false);
+
+    shellvar_cleanup();
+}
+
+// Test HASH_PIPE_SIZE sets the capacity of new pipes
+void test_pipe_size(void) {
+#ifdef F_GETPIPE_SZ
+    int fds[2];
+    shellvar_set("HASH_PIPE_SIZE", "256K");
+    TEST_ASSERT_EQUAL_INT(0, pipeline_pipe(fds));
+    TEST_ASSERT_EQUAL_INT(256 * 1024, fcntl(fds[0], F_GETPIPE_SZ));
+    close(fds[0]);
+    close(fds[1]);
+
+    // Unset, pipes keep the kernel's default
+    shellvar_unset("HASH_PIPE_SIZE");
+    TEST_ASSERT_EQUAL_INT(0, pipeline_pipe(fds));
+    int default_size = fcntl(fds[0], F_GETPIPE_SZ);
+    close(fds[0]);
+    close(fds[1]);
+    TEST_ASSERT_TRUE(default_size > 0 && default_size != 256 * 1024);
+
+    shellvar_cleanup();
+#endif
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -106,6 +200,9 @@ int main(void) {
     RUN_TEST(test_parse_single_command);
     RUN_TEST(test_parse_empty_line);
     RUN_TEST(test_parse_complex_pipe);
+    RUN_TEST(test_run_last_stage_in_shell);
+    RUN_TEST(test_stage_statuses);
+    RUN_TEST(test_pipe_size);
 
     return UNITY_END();
 }
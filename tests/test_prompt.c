@@ -3,6 +3,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/stat.h>
 
 void setUp(void) {
     prompt_init();
@@ -88,6 +91,91 @@ void test_git_dirty(void) {
     TEST_ASSERT_TRUE(true);
 }
 
+// Create a fake repository and enter it; returns false on setup failure
+static bool make_fake_repo(char *dir, size_t size, char *oldcwd, const char *head) {
+    snprintf(dir, size, "/tmp/hash_prompt_XXXXXX");
+    if (!mkdtemp(dir) || !getcwd(oldcwd, PATH_MAX)) return false;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/.git", dir);
+    mkdir(path, 0700);
+    snprintf(path, sizeof(path), "%s/.git/HEAD", dir);
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fputs(head, f);
+    fclose(f);
+
+    snprintf(path, sizeof(path), "%s/sub", dir);
+    mkdir(path, 0700);
+    return chdir(path) == 0;
+}
+
+static void remove_fake_repo(const char *dir, const char *oldcwd) {
+    char cmd[PATH_MAX + 16];
+    if (chdir(oldcwd) != 0) return;
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", dir);
+    TEST_ASSERT_EQUAL_INT(0, system(cmd));
+}
+
+// Test branch read from HEAD of an enclosing repository
+void test_git_branch_from_head(void) {
+    char dir[PATH_MAX];
+    char oldcwd[PATH_MAX];
+    TEST_ASSERT_TRUE(make_fake_repo(dir, sizeof(dir), oldcwd, "ref: refs/heads/feature/x\n"));
+
+    char *branch = prompt_git_branch();
+    TEST_ASSERT_NOT_NULL(branch);
+    TEST_ASSERT_EQUAL_STRING("feature/x", branch);
+
+    remove_fake_repo(dir, oldcwd);
+}
+
+// Test detached HEAD shows as "HEAD"
+void test_git_branch_detached(void) {
+    char dir[PATH_MAX];
+    char oldcwd[PATH_MAX];
+    TEST_ASSERT_TRUE(make_fake_repo(dir, sizeof(dir), oldcwd,
+                                    "3f786850e387550fdab836ed7e6dc881de23001b\n"));
+
+    char *branch = prompt_git_branch();
+    TEST_ASSERT_NOT_NULL(branch);
+    TEST_ASSERT_EQUAL_STRING("HEAD", branch);
+
+    remove_fake_repo(dir, oldcwd);
+}
+
+// Test dirty state arrives from the background worker
+void test_git_dirty_background(void) {
+    // Nothing to check without git installed
+    if (system("git --version >/dev/null 2>&1") != 0) return;
+
+    char dir[PATH_MAX];
+    char oldcwd[PATH_MAX];
+    char cmd[2 * PATH_MAX + 64];
+    snprintf(dir, sizeof(dir), "/tmp/hash_prompt_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    TEST_ASSERT_NOT_NULL(getcwd(oldcwd, sizeof(oldcwd)));
+    snprintf(cmd, sizeof(cmd), "git init -q '%s' && touch '%s/untracked'", dir, dir);
+    TEST_ASSERT_EQUAL_INT(0, system(cmd));
+    TEST_ASSERT_EQUAL_INT(0, chdir(dir));
+
+    // Nothing is known yet; the worker reports later
+    TEST_ASSERT_FALSE(prompt_git_dirty());
+    int fd = prompt_git_worker_fd();
+    TEST_ASSERT_TRUE(fd >= 0);
+
+    bool changed = false;
+    while (!changed && prompt_git_worker_fd() >= 0) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        TEST_ASSERT_EQUAL_INT(1, poll(&pfd, 1, 10000));
+        changed = prompt_git_poll();
+    }
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_TRUE(prompt_git_dirty());
+
+    remove_fake_repo(dir, oldcwd);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -101,6 +189,9 @@ int main(void) {
     RUN_TEST(test_prompt_failure_exit);
     RUN_TEST(test_git_branch);
     RUN_TEST(test_git_dirty);
+    RUN_TEST(test_git_branch_from_head);
+    RUN_TEST(test_git_branch_detached);
+    RUN_TEST(test_git_dirty_background);
 
     return UNITY_END();
 }
@@ -1,6 +1,8 @@
 #include "unity.h"
 #include "../src/redirect.h"
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 void setUp(void) {
 }
@@ -165,6 +167,72 @@ void test_parse_explicit_output_to_error(void) {
     redirect_free(info);
 }
 
+// Test file redirections translate into spawn file actions
+void test_spawn_actions_for_files(void) {
+    char *args[] = {"cmd", "<", "in.txt", "2>>", "err.log", NULL};
+    RedirInfo *info = redirect_parse(args);
+    posix_spawn_file_actions_t actions;
+
+    posix_spawn_file_actions_init(&actions);
+    TEST_ASSERT_EQUAL_INT(0, redirect_spawn_actions(info, &actions));
+    posix_spawn_file_actions_destroy(&actions);
+
+    redirect_free(info);
+}
+
+// Test here-documents are left to a forked child
+void test_spawn_actions_reject_heredoc(void) {
+    char *args[] = {"cat", "<<", "EOF", NULL};
+    RedirInfo *info = redirect_parse(args);
+    posix_spawn_file_actions_t actions;
+
+    posix_spawn_file_actions_init(&actions);
+    TEST_ASSERT_EQUAL_INT(-1, redirect_spawn_actions(info, &actions));
+    posix_spawn_file_actions_destroy(&actions);
+
+    redirect_free(info);
+}
+
+// Read stdin after applying a quoted here-document of the given size
+static void check_heredoc_body(size_t size) {
+    char *body = malloc(size + 1);
+    TEST_ASSERT_NOT_NULL(body);
+    for (size_t i = 0; i < size; i++) {
+        body[i] = (i % 64 == 63) ? '\n' : (char)('a' + i % 26);
+    }
+    body[size] = '\0';
+
+    char *args[] = {"cat", "<<", "EOF", NULL};
+    RedirInfo *info = redirect_parse(args);
+    redirect_set_heredoc_content(info, body, 1);
+
+    int saved_stdin = dup(STDIN_FILENO);
+    TEST_ASSERT_EQUAL_INT(0, redirect_apply(info));
+
+    char *got = malloc(size + 1);
+    size_t total = 0;
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, got + total, size + 1 - total)) > 0) {
+        total += (size_t)n;
+        if (total > size) break;
+    }
+    dup2(saved_stdin, STDIN_FILENO);
+    close(saved_stdin);
+
+    TEST_ASSERT_EQUAL_size_t(size, total);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(body, got, size));
+
+    free(got);
+    free(body);
+    redirect_free(info);
+}
+
+// Test here-documents larger than a pipe are delivered whole
+void test_apply_heredoc_sizes(void) {
+    check_heredoc_body(100);
+    check_heredoc_body(4 * 1024 * 1024);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -178,6 +246,9 @@ int main(void) {
     RUN_TEST(test_parse_no_redirects);
     RUN_TEST(test_parse_output_to_error);
     RUN_TEST(test_parse_explicit_output_to_error);
+    RUN_TEST(test_spawn_actions_for_files);
+    RUN_TEST(test_spawn_actions_reject_heredoc);
+    RUN_TEST(test_apply_heredoc_sizes);
 
     return UNITY_END();
 }
@@ -1,5 +1,7 @@
 #include "unity.h"
 #include "../src/script.h"
+#include "../src/shellvar.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -315,6 +317,25 @@ void test_define_function(void) {
     TEST_ASSERT_EQUAL_STRING("echo Hello", func->body);
 }
 
+void test_define_function_compiles_body(void) {
+    TEST_ASSERT_EQUAL(0, script_define_function("inc", "n=$((n + 1))\nm=done"));
+
+    ShellFunction *func = script_get_function("inc");
+    TEST_ASSERT_NOT_NULL(func);
+    TEST_ASSERT_NOT_NULL(func->program);
+    TEST_ASSERT_NOT_NULL(func->program->root);
+    TEST_ASSERT_EQUAL(1, func->program->refs);
+}
+
+void test_define_function_unparsable_body(void) {
+    // Bodies that do not parse are kept as text and fail when called
+    TEST_ASSERT_EQUAL(0, script_define_function("broken", "if true; then"));
+
+    ShellFunction *func = script_get_function("broken");
+    TEST_ASSERT_NOT_NULL(func);
+    TEST_ASSERT_NULL(func->program);
+}
+
 void test_get_undefined_function(void) {
     ShellFunction *func = script_get_function("undefined");
     TEST_ASSERT_NULL(func);
@@ -329,6 +350,52 @@ void test_redefine_function(void) {
     TEST_ASSERT_EQUAL_STRING("echo Hello", func->body);
 }
 
+void test_define_many_functions(void) {
+    // More functions than the initial table size, all still reachable
+    char name[32];
+    char body[32];
+    for (int i = 0; i < 500; i++) {
+        snprintf(name, sizeof(name), "fn%d", i);
+        snprintf(body, sizeof(body), "r=%d", i);
+        TEST_ASSERT_EQUAL(0, script_define_function(name, body));
+    }
+    TEST_ASSERT_EQUAL(500, script_state.function_count);
+
+    for (int i = 0; i < 500; i++) {
+        snprintf(name, sizeof(name), "fn%d", i);
+        snprintf(body, sizeof(body), "r=%d", i);
+        ShellFunction *func = script_get_function(name);
+        TEST_ASSERT_NOT_NULL(func);
+        TEST_ASSERT_EQUAL_STRING(body, func->body);
+    }
+}
+
+void test_define_large_function_body(void) {
+    size_t len = 64 * 1024;
+    char *body = malloc(len + 1);
+    TEST_ASSERT_NOT_NULL(body);
+    for (size_t i = 0; i < len; i += 8) {
+        memcpy(body + i, "r=big;\n\n", 8);
+    }
+    body[len] = '\0';
+
+    TEST_ASSERT_EQUAL(0, script_define_function("large", body));
+    ShellFunction *func = script_get_function("large");
+    TEST_ASSERT_NOT_NULL(func);
+    TEST_ASSERT_EQUAL(len, func->body_len);
+    free(body);
+}
+
+void test_redefine_function_while_running(void) {
+    // The running body must survive its own redefinition
+    script_define_function("once", "r=first\nonce() { r=second; }\nr=$r-end");
+    TEST_ASSERT_EQUAL(0, script_execute_string("once"));
+    TEST_ASSERT_EQUAL_STRING("first-end", shellvar_get("r"));
+
+    TEST_ASSERT_EQUAL(0, script_execute_string("once"));
+    TEST_ASSERT_EQUAL_STRING("second", shellvar_get("r"));
+}
+
 // ============================================================================
 // Script Processing Tests
 // ============================================================================
@@ -452,8 +519,13 @@ int main(void) {
 
     // Function management
     RUN_TEST(test_define_function);
+    RUN_TEST(test_define_function_compiles_body);
+    RUN_TEST(test_define_function_unparsable_body);
     RUN_TEST(test_get_undefined_function);
     RUN_TEST(test_redefine_function);
+    RUN_TEST(test_define_many_functions);
+    RUN_TEST(test_define_large_function_body);
+    RUN_TEST(test_redefine_function_while_running);
 
     // Script processing
     RUN_TEST(test_process_empty_line);
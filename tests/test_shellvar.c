@@ -0,0 +1,328 @@
+#include "unity.h"
+#include "../src/shellvar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+void setUp(void) {
+    shellvar_init();
+}
+
+void tearDown(void) {
+    shellvar_cleanup();
+}
+
+// Find "name=value" in an environment array
+static const char *env_find(char **envp, const char *name) {
+    size_t len = strlen(name);
+    for (; *envp; envp++) {
+        if (strncmp(*envp, name, len) == 0 && (*envp)[len] == '=') {
+            return *envp + len + 1;
+        }
+    }
+    return NULL;
+}
+
+// Test variables stay reachable as the table grows
+void test_shellvar_many_variables(void) {
+    char name[32];
+    char value[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "SV_%d", i);
+        snprintf(value, sizeof(value), "%d", i * 7);
+        TEST_ASSERT_EQUAL_INT(0, shellvar_set(name, value));
+    }
+    for (int i = 0; i < 5000; i += 37) {
+        snprintf(name, sizeof(name), "SV_%d", i);
+        snprintf(value, sizeof(value), "%d", i * 7);
+        TEST_ASSERT_EQUAL_STRING(value, shellvar_get(name));
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, shellvar_unset("SV_100"));
+    TEST_ASSERT_FALSE(shellvar_isset("SV_100"));
+    TEST_ASSERT_EQUAL_STRING("707", shellvar_get("SV_101"));
+}
+
+// Test only exported variables with values reach the environment
+void test_shellvar_environ_exported_only(void) {
+    shellvar_set("SV_LOCAL", "a");
+    shellvar_set("SV_EXPORTED", "b");
+    shellvar_set_export("SV_EXPORTED");
+    shellvar_set_export("SV_NO_VALUE");
+
+    char **envp = shellvar_environ();
+    TEST_ASSERT_NULL(env_find(envp, "SV_LOCAL"));
+    TEST_ASSERT_EQUAL_STRING("b", env_find(envp, "SV_EXPORTED"));
+    TEST_ASSERT_NULL(env_find(envp, "SV_NO_VALUE"));
+}
+
+// Test the environment is rebuilt only after an exported variable changes
+void test_shellvar_environ_cached(void) {
+    shellvar_set("SV_EXPORTED", "1");
+    shellvar_set_export("SV_EXPORTED");
+
+    char **envp = shellvar_environ();
+    shellvar_set("SV_LOCAL", "x");
+    TEST_ASSERT_EQUAL_PTR(envp, shellvar_environ());
+
+    shellvar_set("SV_EXPORTED", "2");
+    envp = shellvar_environ();
+    TEST_ASSERT_EQUAL_STRING("2", env_find(envp, "SV_EXPORTED"));
+
+    shellvar_clear_export("SV_EXPORTED");
+    envp = shellvar_environ();
+    TEST_ASSERT_NULL(env_find(envp, "SV_EXPORTED"));
+    TEST_ASSERT_EQUAL_STRING("2", shellvar_get("SV_EXPORTED"));
+}
+
+// Test restoring a snapshot undoes changes to exported variables
+void test_shellvar_snapshot_restore(void) {
+    shellvar_set("SV_EXPORTED", "old");
+    shellvar_set_export("SV_EXPORTED");
+    shellvar_environ();
+
+    ShellVarSnapshot *snap = shellvar_snapshot();
+    TEST_ASSERT_NOT_NULL(snap);
+    shellvar_set("SV_EXPORTED", "new");
+    shellvar_set("SV_ADDED", "x");
+    shellvar_set_export("SV_ADDED");
+    shellvar_environ();
+    shellvar_restore(snap);
+
+    char **envp = shellvar_environ();
+    TEST_ASSERT_EQUAL_STRING("old", env_find(envp, "SV_EXPORTED"));
+    TEST_ASSERT_NULL(env_find(envp, "SV_ADDED"));
+    TEST_ASSERT_FALSE(shellvar_is_exported("SV_ADDED"));
+}
+
+// Test integer variables evaluate assignments and format text on demand
+void test_shellvar_integer(void) {
+    shellvar_set_integer("SV_INT");
+    TEST_ASSERT_EQUAL_INT(0, shellvar_set("SV_INT", "3 * 4"));
+
+    long n = 0;
+    TEST_ASSERT_TRUE(shellvar_get_int("SV_INT", &n));
+    TEST_ASSERT_EQUAL_INT(12, n);
+
+    TEST_ASSERT_EQUAL_INT(0, shellvar_set_int("SV_INT", 41));
+    TEST_ASSERT_EQUAL_STRING("41", shellvar_get("SV_INT"));
+    TEST_ASSERT_TRUE(shellvar_get_int("SV_INT", &n));
+    TEST_ASSERT_EQUAL_INT(41, n);
+
+    TEST_ASSERT_EQUAL_INT(-1, shellvar_set("SV_INT", "1 +"));
+    TEST_ASSERT_EQUAL_STRING("41", shellvar_get("SV_INT"));
+}
+
+// Test arithmetic results stay text for variables without the attribute
+void test_shellvar_set_int_plain(void) {
+    TEST_ASSERT_EQUAL_INT(0, shellvar_set_int("SV_PLAIN", -7));
+    TEST_ASSERT_EQUAL_STRING("-7", shellvar_get("SV_PLAIN"));
+
+    long n = 0;
+    TEST_ASSERT_FALSE(shellvar_get_int("SV_PLAIN", &n));
+    TEST_ASSERT_EQUAL_INT(0, shellvar_set("SV_PLAIN", "1 +"));
+}
+
+// Test an exported integer reaches the environment as text
+void test_shellvar_integer_exported(void) {
+    shellvar_set_integer("SV_INT");
+    shellvar_set_export("SV_INT");
+    shellvar_set_int("SV_INT", 5);
+    TEST_ASSERT_EQUAL_STRING("5", env_find(shellvar_environ(), "SV_INT"));
+
+    shellvar_set_int("SV_INT", 6);
+    TEST_ASSERT_EQUAL_STRING("6", env_find(shellvar_environ(), "SV_INT"));
+}
+
+// Test indexed arrays keep holes and read element 0 as the scalar value
+void test_shellvar_indexed_array(void) {
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_set("SV_ARR", "0", "a"));
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_set("SV_ARR", "1+2", "d"));
+    TEST_ASSERT_TRUE(shellvar_is_array("SV_ARR"));
+    TEST_ASSERT_EQUAL_INT(2, shellvar_array_count("SV_ARR"));
+    TEST_ASSERT_EQUAL_STRING("a", shellvar_get("SV_ARR"));
+    TEST_ASSERT_EQUAL_STRING("d", shellvar_array_get("SV_ARR", "3"));
+    TEST_ASSERT_EQUAL_STRING("d", shellvar_array_get("SV_ARR", "-1"));
+    TEST_ASSERT_NULL(shellvar_array_get("SV_ARR", "1"));
+
+    ShellVarIter it;
+    const char *key;
+    const char *value;
+    TEST_ASSERT_TRUE(shellvar_array_iter("SV_ARR", &it));
+    TEST_ASSERT_TRUE(shellvar_array_next(&it, &key, &value));
+    TEST_ASSERT_EQUAL_STRING("0", key);
+    TEST_ASSERT_TRUE(shellvar_array_next(&it, &key, &value));
+    TEST_ASSERT_EQUAL_STRING("3", key);
+    TEST_ASSERT_EQUAL_STRING("d", value);
+    TEST_ASSERT_FALSE(shellvar_array_next(&it, &key, &value));
+
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_unset("SV_ARR", "3"));
+    TEST_ASSERT_EQUAL_INT(1, shellvar_array_count("SV_ARR"));
+}
+
+// Peak resident set size in kilobytes
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Test far-apart indices cost memory per element, not per index, and are
+// still walked in index order
+void test_shellvar_sparse_array(void) {
+    long before = peak_rss_kb();
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_set("SV_ARR", "1700000000", "epoch"));
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_set("SV_ARR", "16000000", "big"));
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_set("SV_ARR", "5", "small"));
+    TEST_ASSERT_TRUE(peak_rss_kb() - before < 4096);
+
+    TEST_ASSERT_EQUAL_INT(3, shellvar_array_count("SV_ARR"));
+    TEST_ASSERT_EQUAL_STRING("big", shellvar_array_get("SV_ARR", "16000000"));
+    TEST_ASSERT_EQUAL_STRING("epoch", shellvar_array_get("SV_ARR", "-1"));
+    TEST_ASSERT_NULL(shellvar_array_get("SV_ARR", "0"));
+
+    const char *expected[] = { "5", "16000000", "1700000000" };
+    ShellVarIter it;
+    const char *key;
+    TEST_ASSERT_TRUE(shellvar_array_iter("SV_ARR", &it));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(shellvar_array_next(&it, &key, NULL));
+        TEST_ASSERT_EQUAL_STRING(expected[i], key);
+    }
+    TEST_ASSERT_FALSE(shellvar_array_next(&it, &key, NULL));
+
+    // Appending goes after the highest index, which drops back on unset
+    ShellVarElement more[] = { { NULL, "next" } };
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_assign("SV_ARR", more, 1, true));
+    TEST_ASSERT_EQUAL_STRING("next", shellvar_array_get("SV_ARR", "1700000001"));
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_unset("SV_ARR", "1700000001"));
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_unset("SV_ARR", "1700000000"));
+    TEST_ASSERT_EQUAL_STRING("big", shellvar_array_get("SV_ARR", "-1"));
+}
+
+// Test compound assignment replaces, appends and honours [n]= indices
+void test_shellvar_array_assign(void) {
+    ShellVarElement first[] = { { NULL, "x" }, { "5", "y" }, { NULL, "z" } };
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_assign("SV_ARR", first, 3, false));
+    TEST_ASSERT_EQUAL_STRING("z", shellvar_array_get("SV_ARR", "6"));
+
+    ShellVarElement more[] = { { NULL, "w" } };
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_assign("SV_ARR", more, 1, true));
+    TEST_ASSERT_EQUAL_STRING("w", shellvar_array_get("SV_ARR", "7"));
+    TEST_ASSERT_EQUAL_INT(4, shellvar_array_count("SV_ARR"));
+
+    TEST_ASSERT_EQUAL_INT(0, shellvar_array_assign("SV_ARR", more, 1, false));
+    TEST_ASSERT_EQUAL_INT(1, shellvar_array_count("SV_ARR"));
+    TEST_ASSERT_EQUAL_STRING("w", shellvar_get("SV_ARR"));
+}
+
+// Test associative arrays stay consistent through growth and removals
+void test_shellvar_assoc_array(void) {
+    TEST_ASSERT_EQUAL_INT(0, shellvar_declare_array("SV_MAP", true));
+    TEST_ASSERT_TRUE(shellvar_is_assoc("SV_MAP"));
+
+    char key[32];
+    char value[32];
+    for (int i = 0; i < 20000; i++) {
+        snprintf(key, sizeof(key), "host%d.example.com", i);
+        snprintf(value, sizeof(value), "%d", i);
+        TEST_ASSERT_EQUAL_INT(0, shellvar_array_set("SV_MAP", key, value));
+    }
+    for (int i = 0; i < 20000; i += 2) {
+        snprintf(key, sizeof(key), "host%d.example.com", i);
+        shellvar_array_unset("SV_MAP", key);
+    }
+    TEST_ASSERT_EQUAL_INT(10000, shellvar_array_count("SV_MAP"));
+    TEST_ASSERT_NULL(shellvar_array_get("SV_MAP", "host100.example.com"));
+    TEST_ASSERT_EQUAL_STRING("101", shellvar_array_get("SV_MAP", "host101.example.com"));
+
+    // Insertion order is kept
+    ShellVarIter it;
+    const char *k;
+    TEST_ASSERT_TRUE(shellvar_array_iter("SV_MAP", &it));
+    TEST_ASSERT_TRUE(shellvar_array_next(&it, &k, NULL));
+    TEST_ASSERT_EQUAL_STRING("host1.example.com", k);
+
+    TEST_ASSERT_EQUAL_INT(-1, shellvar_declare_array("SV_MAP", false));
+}
+
+// Test restoring a snapshot brings back the elements of an array
+void test_shellvar_array_snapshot(void) {
+    shellvar_array_set("SV_ARR", "0", "old");
+
+    ShellVarSnapshot *snap = shellvar_snapshot();
+    TEST_ASSERT_NOT_NULL(snap);
+    shellvar_array_set("SV_ARR", "0", "new");
+    shellvar_array_set("SV_ARR", "1", "added");
+    shellvar_restore(snap);
+
+    TEST_ASSERT_EQUAL_STRING("old", shellvar_array_get("SV_ARR", "0"));
+    TEST_ASSERT_EQUAL_INT(1, shellvar_array_count("SV_ARR"));
+}
+
+// Test a snapshot copies only the variables changed after it, not a large
+// array that is merely in scope
+void test_shellvar_snapshot_copies_changed_only(void) {
+    char index[24];
+    for (int i = 0; i < 100000; i++) {
+        snprintf(index, sizeof(index), "%d", i);
+        shellvar_array_set("SV_BIG", index, "element");
+    }
+    shellvar_set("SV_KEEP", "old");
+    shellvar_set("SV_GONE", "old");
+
+    for (int round = 0; round < 2000; round++) {
+        ShellVarSnapshot *snap = shellvar_snapshot();
+        TEST_ASSERT_NOT_NULL(snap);
+        shellvar_set("SV_KEEP", "new");
+        shellvar_set("SV_KEEP", "newer");
+        shellvar_unset("SV_GONE");
+        shellvar_set("SV_ADDED", "x");
+        TEST_ASSERT_EQUAL_INT(3, shellvar_snapshot_saved(snap));
+        shellvar_restore(snap);
+    }
+
+    TEST_ASSERT_EQUAL_STRING("old", shellvar_get("SV_KEEP"));
+    TEST_ASSERT_EQUAL_STRING("old", shellvar_get("SV_GONE"));
+    TEST_ASSERT_FALSE(shellvar_isset("SV_ADDED"));
+    TEST_ASSERT_EQUAL_INT(100000, shellvar_array_count("SV_BIG"));
+}
+
+// Test nested snapshots each undo their own changes
+void test_shellvar_snapshot_nested(void) {
+    shellvar_set("SV_N", "0");
+
+    ShellVarSnapshot *outer = shellvar_snapshot();
+    shellvar_set("SV_N", "1");
+    ShellVarSnapshot *inner = shellvar_snapshot();
+    shellvar_set("SV_N", "2");
+    shellvar_set("SV_INNER", "x");
+    shellvar_restore(inner);
+    TEST_ASSERT_EQUAL_STRING("1", shellvar_get("SV_N"));
+    TEST_ASSERT_FALSE(shellvar_isset("SV_INNER"));
+    shellvar_restore(outer);
+
+    TEST_ASSERT_EQUAL_STRING("0", shellvar_get("SV_N"));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_shellvar_many_variables);
+    RUN_TEST(test_shellvar_environ_exported_only);
+    RUN_TEST(test_shellvar_environ_cached);
+    RUN_TEST(test_shellvar_snapshot_restore);
+    RUN_TEST(test_shellvar_integer);
+    RUN_TEST(test_shellvar_set_int_plain);
+    RUN_TEST(test_shellvar_integer_exported);
+    RUN_TEST(test_shellvar_indexed_array);
+    RUN_TEST(test_shellvar_sparse_array);
+    RUN_TEST(test_shellvar_array_assign);
+    RUN_TEST(test_shellvar_assoc_array);
+    RUN_TEST(test_shellvar_array_snapshot);
+    RUN_TEST(test_shellvar_snapshot_copies_changed_only);
+    RUN_TEST(test_shellvar_snapshot_nested);
+
+    return UNITY_END();
+}
@@ -278,6 +278,45 @@ void test_expand_positional_0_with_params(void) {
     free(result);
 }
 
+// Test values far longer than any fixed buffer expand whole
+void test_expand_long_value(void) {
+    size_t len = 100000;
+    char *value = malloc(len + 1);
+    memset(value, 'x', len);
+    value[len] = '\0';
+    value[0] = 'a';
+    setenv("LONG_VAR", value, 1);
+
+    char *result = varexpand_expand("\x02$LONG_VAR-${LONG_VAR#a}", 0);
+    TEST_ASSERT_NOT_NULL(result);
+    strip_ifs_markers(result);
+    TEST_ASSERT_EQUAL_size_t(len * 2, strlen(result));
+    TEST_ASSERT_EQUAL_INT('-', result[len]);
+
+    free(result);
+    free(value);
+    unsetenv("LONG_VAR");
+}
+
+// Test $@ keeps every positional parameter
+void test_expand_many_positional(void) {
+    int count = 50000;
+    script_state.positional_params = malloc((size_t)(count + 1) * sizeof(char*));
+    script_state.positional_params[0] = strdup("script.sh");
+    for (int i = 1; i <= count; i++) {
+        script_state.positional_params[i] = strdup("arg");
+    }
+    script_state.positional_count = count + 1;
+
+    char *result = varexpand_expand("$@", 0);
+    TEST_ASSERT_NOT_NULL(result);
+    strip_ifs_markers(result);
+    // Fields are separated by \x04
+    TEST_ASSERT_EQUAL_size_t((size_t)count * 4 - 1, strlen(result));
+
+    free(result);
+}
+
 int main(void) {
     UNITY_BEGIN();
 
@@ -301,6 +340,8 @@ int main(void) {
     RUN_TEST(test_expand_positional_braced);
     RUN_TEST(test_expand_positional_undefined);
     RUN_TEST(test_expand_positional_0_with_params);
+    RUN_TEST(test_expand_long_value);
+    RUN_TEST(test_expand_many_positional);
 
     return UNITY_END();
 }
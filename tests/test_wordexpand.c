@@ -0,0 +1,285 @@
+#include "unity.h"
+#include "../src/wordexpand.h"
+#include "../src/parser.h"
+#include "../src/script.h"
+#include "../src/shellvar.h"
+#include <stdlib.h>
+#include <string.h>
+
+static FieldList fields;
+
+void setUp(void) {
+    script_init();
+    fieldlist_init(&fields);
+}
+
+void tearDown(void) {
+    fieldlist_free(&fields);
+    script_cleanup();
+}
+
+// Parse a command line and expand its words into fields
+static int expand_line(const char *line) {
+    ParseResult parsed = parse_line(line);
+    int rc = wordexpand_command(parsed.tokens, &fields);
+    parse_result_free(&parsed);
+    return rc;
+}
+
+// Test unquoted expansions are split on IFS
+void test_wordexpand_split_unquoted(void) {
+    shellvar_set("WX", "a  b");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo $WX"));
+    TEST_ASSERT_EQUAL_INT(3, fields.count);
+    TEST_ASSERT_EQUAL_STRING("a", fields.fields[1]);
+    TEST_ASSERT_EQUAL_STRING("b", fields.fields[2]);
+    TEST_ASSERT_NULL(fields.fields[3]);
+
+    shellvar_unset("WX");
+}
+
+// Test non-white IFS characters delimit empty fields and join white space
+void test_wordexpand_split_delimiters(void) {
+    shellvar_set("IFS", " ,");
+    shellvar_set("WX", " a , b ,, c ,");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo $WX x$WX\"y\""));
+    const char *expected[] = { "echo", "a", "b", "", "c", "x", "a", "b", "", "c", "y" };
+    TEST_ASSERT_EQUAL_INT(11, fields.count);
+    for (int i = 0; i < 11; i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i], fields.fields[i]);
+    }
+
+    shellvar_unset("WX");
+    shellvar_unset("IFS");
+}
+
+// Test ${name} splits like $name, and a later IFS assignment in the
+// same word is seen
+void test_wordexpand_braced_split(void) {
+    shellvar_set("IFS", " ,");
+    shellvar_set("WX", " a , b ,, c ,");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo ${WX} ${WX:-x}"));
+    const char *expected[] = { "echo", "a", "b", "", "c", "a", "b", "", "c" };
+    TEST_ASSERT_EQUAL_INT(9, fields.count);
+    for (int i = 0; i < 9; i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i], fields.fields[i]);
+    }
+    fieldlist_free(&fields);
+
+    shellvar_unset("IFS");
+    shellvar_set("WX", "a:b c");
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo ${WX}\"${IFS:=:}\"${WX}"));
+    const char *assigned[] = { "echo", "a:b", "c:a", "b c" };
+    TEST_ASSERT_EQUAL_INT(4, fields.count);
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_STRING(assigned[i], fields.fields[i]);
+    }
+
+    shellvar_unset("WX");
+    shellvar_unset("IFS");
+}
+
+// Test quoted expansions stay one field with their white space
+void test_wordexpand_quoted_no_split(void) {
+    shellvar_set("WX", "a  b");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo \"$WX\" \"x$(echo 'c  d')y\""));
+    TEST_ASSERT_EQUAL_INT(3, fields.count);
+    TEST_ASSERT_EQUAL_STRING("a  b", fields.fields[1]);
+    TEST_ASSERT_EQUAL_STRING("xc  dy", fields.fields[2]);
+
+    shellvar_unset("WX");
+}
+
+// Test an empty unquoted expansion gives no field, "" gives an empty one
+void test_wordexpand_empty_fields(void) {
+    shellvar_set("WX", "");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo $WX \"\" \"$WX\""));
+    TEST_ASSERT_EQUAL_INT(3, fields.count);
+    TEST_ASSERT_EQUAL_STRING("", fields.fields[1]);
+    TEST_ASSERT_EQUAL_STRING("", fields.fields[2]);
+
+    shellvar_unset("WX");
+}
+
+// Test an operator that comes from an expansion is an ordinary argument
+void test_wordexpand_expanded_operator(void) {
+    shellvar_set("WX", ">");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo $WX '<'"));
+    TEST_ASSERT_EQUAL_INT(3, fields.count);
+    TEST_ASSERT_EQUAL_STRING(">", fields.fields[1]);
+    TEST_ASSERT_EQUAL_INT(0, fields.flags[1]);
+    TEST_ASSERT_EQUAL_STRING("<", fields.fields[2]);
+    TEST_ASSERT_EQUAL_INT(0, fields.flags[2]);
+
+    shellvar_unset("WX");
+}
+
+// Test redirections are flagged and their targets are not split
+void test_wordexpand_redirect_target(void) {
+    shellvar_set("WX", "out file");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo hi >$WX"));
+    TEST_ASSERT_EQUAL_INT(3, fields.count);
+    TEST_ASSERT_EQUAL_STRING(">out file", fields.fields[2]);
+    TEST_ASSERT_TRUE(fields.flags[2] & FIELD_OPERATOR);
+
+    shellvar_unset("WX");
+}
+
+// Test prefix assignments are flagged and not split
+void test_wordexpand_prefix_assignment(void) {
+    shellvar_set("WX", "a  b");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("V=$WX env"));
+    TEST_ASSERT_EQUAL_INT(2, fields.count);
+    TEST_ASSERT_EQUAL_STRING("V=a  b", fields.fields[0]);
+    TEST_ASSERT_TRUE(fields.flags[0] & FIELD_ASSIGNMENT);
+    TEST_ASSERT_EQUAL_INT(0, fields.flags[1]);
+
+    shellvar_unset("WX");
+}
+
+// Test expansions run left to right within a command
+void test_wordexpand_left_to_right(void) {
+    shellvar_set("WI", "1");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo $WI $((WI+=1)) $WI"));
+    TEST_ASSERT_EQUAL_INT(4, fields.count);
+    TEST_ASSERT_EQUAL_STRING("1", fields.fields[1]);
+    TEST_ASSERT_EQUAL_STRING("2", fields.fields[2]);
+    TEST_ASSERT_EQUAL_STRING("2", fields.fields[3]);
+
+    shellvar_unset("WI");
+}
+
+// Test an escaped backslash does not quote the $ after it
+void test_wordexpand_escaped_backslash(void) {
+    shellvar_set("WX", "v");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo \\\\$WX '$WX'"));
+    TEST_ASSERT_EQUAL_INT(3, fields.count);
+    TEST_ASSERT_EQUAL_STRING("\\v", fields.fields[1]);
+    TEST_ASSERT_EQUAL_STRING("$WX", fields.fields[2]);
+
+    shellvar_unset("WX");
+}
+
+// Test quoted pattern characters are not globbed and carry no markers
+void test_wordexpand_quoted_pattern(void) {
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo \"/*\" /\\*zz"));
+    TEST_ASSERT_EQUAL_INT(3, fields.count);
+    TEST_ASSERT_EQUAL_STRING("/*", fields.fields[1]);
+    TEST_ASSERT_EQUAL_STRING("/*zz", fields.fields[2]);
+}
+
+// Test a pattern that matches nothing is kept as written
+void test_wordexpand_glob_no_match(void) {
+    TEST_ASSERT_EQUAL_INT(0, wordexpand("/nonexistent-dir-*/x", WORDEXP_SPLIT | WORDEXP_GLOB, &fields));
+    TEST_ASSERT_EQUAL_INT(1, fields.count);
+    TEST_ASSERT_EQUAL_STRING("/nonexistent-dir-*/x", fields.fields[0]);
+}
+
+// Test a quoted field expands back to itself
+void test_wordexpand_quote_round_trip(void) {
+    const char *field = "a *$x `b` ~ \"c\" {d,e}";
+    char *quoted = wordexpand_quote(field);
+    TEST_ASSERT_NOT_NULL(quoted);
+
+    TEST_ASSERT_EQUAL_INT(0, wordexpand(quoted, WORDEXP_SPLIT | WORDEXP_GLOB, &fields));
+    TEST_ASSERT_EQUAL_INT(1, fields.count);
+    TEST_ASSERT_EQUAL_STRING(field, fields.fields[0]);
+
+    free(quoted);
+}
+
+// Test the single-string form joins instead of splitting
+void test_wordexpand_string(void) {
+    shellvar_set("WX", "a  b");
+
+    char *result = wordexpand_string("$WX", 0);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING("a  b", result);
+    free(result);
+
+    shellvar_unset("WX");
+}
+
+// Test "${a[@]}" gives one field per element and ${#a[@]} the count
+void test_wordexpand_array_elements(void) {
+    ShellVarElement elems[] = { { NULL, "a b" }, { NULL, "c" } };
+    shellvar_array_assign("WX", elems, 2, false);
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("echo \"${WX[@]}\" ${#WX[@]} ${WX[1]}"));
+    TEST_ASSERT_EQUAL_INT(5, fields.count);
+    TEST_ASSERT_EQUAL_STRING("a b", fields.fields[1]);
+    TEST_ASSERT_EQUAL_STRING("c", fields.fields[2]);
+    TEST_ASSERT_EQUAL_STRING("2", fields.fields[3]);
+    TEST_ASSERT_EQUAL_STRING("c", fields.fields[4]);
+
+    shellvar_unset("WX");
+}
+
+// Test the list of name=(...) keeps quoted blanks and names its keys
+void test_wordexpand_array_list(void) {
+    ParseResult parsed = parse_line("WX=(\"a b\" [k]=v c)");
+    TEST_ASSERT_NOT_NULL(parsed.tokens[0]);
+    TEST_ASSERT_NULL(parsed.tokens[1]);
+
+    ArrayAssignment assign;
+    TEST_ASSERT_TRUE(wordexpand_array_assignment(parsed.tokens[0], &assign));
+    TEST_ASSERT_TRUE(assign.list);
+    TEST_ASSERT_EQUAL_INT(0, wordexpand_array_list(assign.value, assign.value_len, &fields));
+    parse_result_free(&parsed);
+
+    TEST_ASSERT_EQUAL_INT(4, fields.count);
+    TEST_ASSERT_EQUAL_STRING("a b", fields.fields[0]);
+    TEST_ASSERT_EQUAL_STRING("k", fields.fields[1]);
+    TEST_ASSERT_TRUE(fields.flags[1] & FIELD_KEY);
+    TEST_ASSERT_EQUAL_STRING("v", fields.fields[2]);
+    TEST_ASSERT_EQUAL_STRING("c", fields.fields[3]);
+}
+
+// Test brace expansion of arguments, but not of quoted braces or assignments
+void test_wordexpand_braces(void) {
+    shellvar_set("WX", "v");
+
+    TEST_ASSERT_EQUAL_INT(0, expand_line("WY={a,b} echo \"$WX\"{1,2} \"{c,d}\" e\\,{f\\,g}"));
+    TEST_ASSERT_EQUAL_INT(6, fields.count);
+    TEST_ASSERT_EQUAL_STRING("WY={a,b}", fields.fields[0]);
+    TEST_ASSERT_EQUAL_STRING("v1", fields.fields[2]);
+    TEST_ASSERT_EQUAL_STRING("v2", fields.fields[3]);
+    TEST_ASSERT_EQUAL_STRING("{c,d}", fields.fields[4]);
+    TEST_ASSERT_EQUAL_STRING("e,{f,g}", fields.fields[5]);
+
+    shellvar_unset("WX");
+}
+
+int main(void) {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_wordexpand_split_unquoted);
+    RUN_TEST(test_wordexpand_split_delimiters);
+    RUN_TEST(test_wordexpand_braced_split);
+    RUN_TEST(test_wordexpand_quoted_no_split);
+    RUN_TEST(test_wordexpand_empty_fields);
+    RUN_TEST(test_wordexpand_expanded_operator);
+    RUN_TEST(test_wordexpand_redirect_target);
+    RUN_TEST(test_wordexpand_prefix_assignment);
+    RUN_TEST(test_wordexpand_left_to_right);
+    RUN_TEST(test_wordexpand_escaped_backslash);
+    RUN_TEST(test_wordexpand_quoted_pattern);
+    RUN_TEST(test_wordexpand_glob_no_match);
+    RUN_TEST(test_wordexpand_quote_round_trip);
+    RUN_TEST(test_wordexpand_string);
+    RUN_TEST(test_wordexpand_array_elements);
+    RUN_TEST(test_wordexpand_array_list);
+    RUN_TEST(test_wordexpand_braces);
+
+    return UNITY_END();
+}
@@ -0,0 +1,2 @@
+#include "unity.h"
+jmp_buf unity_jb; int unity_fails, unity_tests; const char *unity_cur;
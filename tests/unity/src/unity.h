@@ -0,0 +1,30 @@
+#ifndef UNITY_H
+#define UNITY_H
+#include <setjmp.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+extern jmp_buf unity_jb; extern int unity_fails, unity_tests; extern const char *unity_cur;
+void setUp(void); void tearDown(void);
+#define UNITY_BEGIN() (unity_fails=0, unity_tests=0, 0)
+#define UNITY_END() (printf("%d Tests %d Failures\n", unity_tests, unity_fails), unity_fails)
+#define RUN_TEST(f) do { unity_cur=#f; unity_tests++; if(!setjmp(unity_jb)){ setUp(); f(); } tearDown(); } while(0)
+#define U_FAIL(msg) do { printf("%s:%d:%s:FAIL: %s\n", __FILE__, __LINE__, unity_cur, msg); unity_fails++; longjmp(unity_jb,1);} while(0)
+#define TEST_FAIL_MESSAGE(m) U_FAIL(m)
+#define TEST_ASSERT_TRUE(c) do{ if(!(c)) U_FAIL("expected true: " #c);}while(0)
+#define TEST_ASSERT_FALSE(c) do{ if((c)) U_FAIL("expected false: " #c);}while(0)
+#define TEST_ASSERT(c) TEST_ASSERT_TRUE(c)
+#define TEST_ASSERT_NULL(p) TEST_ASSERT_TRUE((p)==NULL)
+#define TEST_ASSERT_NOT_NULL(p) TEST_ASSERT_TRUE((p)!=NULL)
+#define TEST_ASSERT_EQUAL_INT(e,a) do{ long long _e=(long long)(e), _a=(long long)(a); if(_e!=_a){char b[256]; snprintf(b,256,"expected %lld got %lld (%s)",_e,_a,#a); U_FAIL(b);} }while(0)
+#define TEST_ASSERT_EQUAL(e,a) TEST_ASSERT_EQUAL_INT(e,a)
+#define TEST_ASSERT_EQUAL_CHAR(e,a) TEST_ASSERT_EQUAL_INT(e,a)
+#define TEST_ASSERT_NOT_EQUAL_INT(e,a) TEST_ASSERT_TRUE((long long)(e)!=(long long)(a))
+#define TEST_ASSERT_NOT_EQUAL(e,a) TEST_ASSERT_TRUE((e)!=(a))
+#define TEST_ASSERT_EQUAL_PTR(e,a) TEST_ASSERT_TRUE((const void*)(e)==(const void*)(a))
+#define TEST_ASSERT_GREATER_THAN(t,a) TEST_ASSERT_TRUE((a)>(t))
+#define TEST_ASSERT_GREATER_OR_EQUAL(t,a) TEST_ASSERT_TRUE((a)>=(t))
+#define TEST_ASSERT_EQUAL_STRING(e,a) do{ const char *_e=(e), *_a=(a); if(!_e||!_a||strcmp(_e,_a)){char b[512]; snprintf(b,512,"expected \"%s\" got \"%s\"",_e?_e:"(null)",_a?_a:"(null)"); U_FAIL(b);} }while(0)
+#define TEST_ASSERT_EQUAL_size_t(e,a) TEST_ASSERT_EQUAL_INT(e,a)
+#define TEST_ASSERT_EQUAL_UINT(e,a) TEST_ASSERT_EQUAL_INT(e,a)
+#endif